@@ -0,0 +1,81 @@
+/*
+ * Campo Minado - interface dos bots (plug-ins carregados com dlopen, ver --bot)
+ *
+ * Um bot é uma biblioteca compartilhada que exporta o objeto BOT_SIMBOLO, do tipo Bot:
+ *
+ *     #include "bot.h"
+ *     const Bot bot_minecweeper = { BOT_VERSAO, "meu bot", iniciar, decidir, encerrar };
+ *
+ *     cc -O2 -shared -fPIC -o meu_bot.so meu_bot.c
+ *
+ * O jogo chama 'decidir' até a partida acabar; cada jogada sai pela função 'jogar' recebida,
+ * que a aplica na hora e devolve o resultado. A BotVista aponta direto para o estado visível
+ * que o motor mantém (sem cópia): depois de cada 'jogar' ela já mostra o tabuleiro novo.
+ * A vista nunca tem as minas escondidas: uma célula só mostra o número (ou a mina) depois de
+ * revelada.
+ */
+#ifndef BOT_H
+#define BOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOT_VERSAO  1
+#define BOT_SIMBOLO "bot_minecweeper"
+
+// Um byte por célula em BotVista.celulas. Escondida: só o bit de bandeira (0 = escondida sem
+// bandeira). Revelada: BOT_REVELADA, o número de minas em volta e, se era mina, BOT_MINA.
+#define BOT_REVELADA 0x80
+#define BOT_BANDEIRA 0x40
+#define BOT_MINA     0x20
+#define BOT_NUMERO   0x1f
+
+// Maior quantidade de vizinhos de uma célula (topologia 3d)
+#define BOT_MAX_VIZINHOS 26
+
+// Topologias (BotVista.topologia)
+enum { BOT_QUADRADA, BOT_TORO, BOT_HEX, BOT_3D };
+
+// Ações de 'jogar'. Revelar uma célula já revelada revela em volta dela (acorde); bandeira
+// alterna a bandeira de uma célula escondida.
+enum { BOT_JOGAR_REVELAR = 1, BOT_JOGAR_BANDEIRA = 2 };
+
+// Resultados de 'jogar'
+enum { BOT_NADA, BOT_FEITA, BOT_PERDEU, BOT_VENCEU };
+
+// Resultados de 'decidir'
+enum { BOT_CONTINUAR, BOT_DESISTIR };
+
+typedef struct BotVista {
+    size_t largura, altura;
+    size_t qtd_minas;
+    int topologia;
+    size_t camadas;                 // 3d: a altura é a soma das camadas
+
+    const uint8_t *celulas;         // largura * altura bytes: (x, y) em celulas[y * largura + x]
+    size_t reveladas;
+    size_t bandeiras;
+
+    // Vizinhos de (x, y) na topologia do tabuleiro (até BOT_MAX_VIZINHOS); devolve quantos são
+    unsigned (*vizinhos)(const struct BotVista *vista, size_t x, size_t y, size_t *vx, size_t *vy);
+} BotVista;
+
+// Aplica uma jogada e devolve BOT_NADA, BOT_FEITA, BOT_PERDEU ou BOT_VENCEU
+typedef int (*BotJogar)(void *contexto, int acao, size_t x, size_t y);
+
+typedef struct {
+    unsigned versao;                // BOT_VERSAO
+    const char *nome;
+
+    // Começo de uma partida: devolve o estado do bot para ela (pode ser NULL). Opcional.
+    void *(*iniciar)(const BotVista *vista, uint64_t semente);
+
+    // Faz uma ou mais jogadas com 'jogar'. Uma decisão que não muda o tabuleiro encerra a
+    // partida, como BOT_DESISTIR.
+    int (*decidir)(void *estado, const BotVista *vista, BotJogar jogar, void *contexto);
+
+    // Fim da partida: libera o estado. Opcional.
+    void (*encerrar)(void *estado);
+} Bot;
+
+#endif
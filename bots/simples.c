@@ -0,0 +1,88 @@
+/*
+ * Bot de exemplo (ver bot.h): as duas regras de uma célula só e, sem nenhuma, um chute.
+ *   - número == bandeiras em volta: revela em volta (acorde)
+ *   - número - bandeiras == escondidas em volta: todas as escondidas são minas
+ * O chute é uma célula escondida qualquer, sorteada com a semente da partida.
+ *
+ *     make bots && ./minecweeper --bot bots/simples.so --partidas 1000 --dificuldade D
+ */
+#include <stdlib.h>
+
+#include "bot.h"
+
+typedef struct {
+    uint64_t aleatorio;
+} Estado;
+
+static void *iniciar(const BotVista *vista, uint64_t semente) {
+    (void)vista;
+    Estado *e = malloc(sizeof(Estado));
+    if (e) e->aleatorio = semente | 1;
+    return e;
+}
+
+// xorshift64: basta para espalhar os chutes
+static uint64_t sortear(Estado *e) {
+    e->aleatorio ^= e->aleatorio << 13;
+    e->aleatorio ^= e->aleatorio >> 7;
+    e->aleatorio ^= e->aleatorio << 17;
+    return e->aleatorio;
+}
+
+static int decidir(void *estado, const BotVista *v, BotJogar jogar, void *contexto) {
+    Estado *e = estado;
+    if (!e) return BOT_DESISTIR;
+
+    // Primeira jogada: o meio do tabuleiro (o primeiro clique nunca é mina)
+    if (v->reveladas == 0) {
+        jogar(contexto, BOT_JOGAR_REVELAR, v->largura / 2, v->altura / 2);
+        return BOT_CONTINUAR;
+    }
+
+    size_t vx[BOT_MAX_VIZINHOS], vy[BOT_MAX_VIZINHOS];
+    unsigned jogadas = 0;
+    for (size_t y = 0; y < v->altura; y++) {
+        for (size_t x = 0; x < v->largura; x++) {
+            uint8_t c = v->celulas[y * v->largura + x];
+            if (!(c & BOT_REVELADA) || (c & BOT_MINA)) continue;
+
+            unsigned n = v->vizinhos(v, x, y, vx, vy), bandeiras = 0, escondidas = 0;
+            for (unsigned i = 0; i < n; i++) {
+                uint8_t viz = v->celulas[vy[i] * v->largura + vx[i]];
+                if (viz & BOT_BANDEIRA) bandeiras++;
+                else if (!(viz & BOT_REVELADA)) escondidas++;
+            }
+            if (!escondidas) continue;
+
+            unsigned numero = c & BOT_NUMERO;
+            if (numero == bandeiras) {
+                int r = jogar(contexto, BOT_JOGAR_REVELAR, x, y);
+                if (r == BOT_PERDEU || r == BOT_VENCEU) return BOT_CONTINUAR;
+                jogadas++;
+            } else if (numero - bandeiras == escondidas) {
+                for (unsigned i = 0; i < n; i++) {
+                    uint8_t viz = v->celulas[vy[i] * v->largura + vx[i]];
+                    if (!(viz & (BOT_REVELADA | BOT_BANDEIRA))) jogar(contexto, BOT_JOGAR_BANDEIRA, vx[i], vy[i]);
+                }
+                jogadas++;
+            }
+        }
+    }
+    if (jogadas) return BOT_CONTINUAR;
+
+    // Nenhuma regra serviu: chuta uma célula escondida sem bandeira
+    size_t total = v->largura * v->altura, inicio = (size_t)(sortear(e) % total);
+    for (size_t k = 0; k < total; k++) {
+        size_t i = (inicio + k) % total;
+        if (v->celulas[i] & (BOT_REVELADA | BOT_BANDEIRA)) continue;
+        jogar(contexto, BOT_JOGAR_REVELAR, i % v->largura, i / v->largura);
+        return BOT_CONTINUAR;
+    }
+    return BOT_DESISTIR;
+}
+
+static void encerrar(void *estado) {
+    free(estado);
+}
+
+const Bot bot_minecweeper = { BOT_VERSAO, "simples", iniciar, decidir, encerrar };
@@ -1,11 +1,38 @@
 /*CAMPO MINADO  VINÍCIUS DUARTE E VINÍCIUS SANTANA*/
+// fopencookie (o stdout da thread de desenho)
+#define _GNU_SOURCE
 
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
 #include <time.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bot.h"
 
 // --- CONFIGURAÇÕES E MACROS ---
 
@@ -14,20 +41,55 @@
 // Tamanho máximo do buffer de entrada
 #define TAM_BUFFER_ENTRADA 128
 
-// Acesso à matriz linearizada
-#define CELULA_EM(tabuleiro, x, y) ((tabuleiro)->celulas[(y) * (tabuleiro)->largura + (x)])
+// Bytes que uma célula colorida ocupa no máximo quando desenhada
+#define TAM_MAX_CELULA 32
+
+// Bytes lidos de uma vez do terminal no modo teclado
+#define TAM_BUFFER_TECLADO 256
+
+// A cada quantas jogadas a linha do tempo guarda uma cópia do tabuleiro
+#define INTERVALO_CHECKPOINT 32
+#define LIMITE_CANDIDATOS_SEM_CHUTE 100000 //desiste do gerador sem chute depois de tantos tabuleiros
+#define MINAS_POR_CELULA_LOTE 64 //a partir de 1 mina a cada 64 células, os números saem numa passada só
+
+// Eventos guardados por thread antes de gravar o trace (potência de 2; os mais antigos são sobrescritos)
+#define TAM_ANEL_TRACE 65536
+
+// Acesso à matriz linearizada. Com -DLADRILHOS as células ficam em ladrilhos 8x8 (64 bytes, uma
+// linha de cache) em vez de linha a linha: o vizinho de cima e o de baixo quase sempre caem na mesma
+// linha de cache da célula. Fora daqui o código só usa CELULA_EM e (x, y); o índice "lógico"
+// y * largura + x (hash, snapshot, listas) não depende do layout.
+#ifdef LADRILHOS
+#define LADRILHOS_POR_LINHA(tabuleiro) (((tabuleiro)->largura + 7) >> 3)
+#define INDICE_CELULA(tabuleiro, x, y) \
+    ((((y) >> 3) * LADRILHOS_POR_LINHA(tabuleiro) + ((x) >> 3)) * 64 + ((y) & 7) * 8 + ((x) & 7))
+#define CELULAS_ALOCADAS(tabuleiro) (LADRILHOS_POR_LINHA(tabuleiro) * (((tabuleiro)->altura + 7) >> 3) * 64)
+#define PASSO_VERTICAL(tabuleiro) 8
+#define CELULAS_CONTIGUAS(tabuleiro, x) (8 - ((x) & 7))  // até o fim da linha do ladrilho
+#define NOME_LAYOUT "ladrilhos 8x8"
+#else
+#define INDICE_CELULA(tabuleiro, x, y) ((y) * (tabuleiro)->largura + (x))
+#define CELULAS_ALOCADAS(tabuleiro) ((tabuleiro)->largura * (tabuleiro)->altura)
+#define PASSO_VERTICAL(tabuleiro) ((tabuleiro)->largura)
+#define CELULAS_CONTIGUAS(tabuleiro, x) ((tabuleiro)->largura - (x))
+#define NOME_LAYOUT "linhas"
+#endif
+#define CELULA_EM(tabuleiro, x, y) ((tabuleiro)->celulas[INDICE_CELULA(tabuleiro, x, y)])
 
 //cada célula é uma variável de 1 byte = 8bits, ou seja, uma celula guarda essas informações
 #define DESLOC_MINA      0x05 //uma mina
 #define DESLOC_BANDEIRA  0x06 //uma bandeira
 #define DESLOC_REVELADA  0x07 //uma celula que foi revelada 
-#define MASCARA_MINAS    0x0f //e o número de minas vizinhas (0,1,2,3)
+#define MASCARA_MINAS    0x1f //e o número de minas vizinhas (0 a 26: o 3D tem 26 vizinhos)
 
 // Leitura dos bits
 #define EH_MINA(cel)          (((cel) >> DESLOC_MINA)      & 0x1)
 #define TEM_BANDEIRA(cel)     (((cel) >> DESLOC_BANDEIRA)  & 0x1)
 #define ESTA_REVELADA(cel)    (((cel) >> DESLOC_REVELADA)  & 0x1)
 #define NUM_MINAS(cel)        ((cel) & MASCARA_MINAS)
+#define ESTADO_VISIVEL(cel)   ((cel) >> DESLOC_BANDEIRA) //o que o jogador vê: bandeira e revelada (0 a 3)
+// Byte que os bots veem (ver bot.h): a célula inteira se revelada, senão só a bandeira
+#define VISIVEL_BOT(cel)      (ESTA_REVELADA(cel) ? (cel) : (cel) & (1 << DESLOC_BANDEIRA))
 
 // Escrita dos bits
 #define DEFINIR_MINA(cel, bit)        ((cel) = ((cel) & ~(0x1 << DESLOC_MINA))      | ((bit) << DESLOC_MINA))
@@ -43,6 +105,31 @@ const int direcoes[][2] = {
     {0, -1}, {0, 1}, {-1, 0}, {1, 0},
 };
 
+// Hexágonos em linhas deslocadas: as linhas ímpares ficam meia célula à direita, então os
+// vizinhos de cima e de baixo dependem da paridade da linha
+const int direcoes_hex[2][6][2] = {
+    {{-1, 0}, {1, 0}, {-1, -1}, {0, -1}, {-1, 1}, {0, 1}},  // linha par
+    {{-1, 0}, {1, 0}, {0, -1}, {1, -1}, {0, 1}, {1, 1}},    // linha ímpar
+};
+
+#define MAX_VIZINHOS 26
+
+typedef enum {
+    TOPOLOGIA_QUADRADA,  // 8 vizinhos, bordas fechadas
+    TOPOLOGIA_TORO,      // 8 vizinhos, as bordas dão a volta
+    TOPOLOGIA_HEX,       // 6 vizinhos
+    TOPOLOGIA_3D,        // camadas empilhadas na vertical, 26 vizinhos
+    QTD_TOPOLOGIAS
+} Topologia;
+
+// Vizinhos de uma célula do miolo na topologia do tabuleiro ([paridade da linha], só o hex difere)
+typedef struct {
+    unsigned qtd;
+    int dx[2][MAX_VIZINHOS], dy[2][MAX_VIZINHOS], dz[MAX_VIZINHOS];
+    ptrdiff_t desloc[2][MAX_VIZINHOS];  // os mesmos vizinhos como deslocamento no vetor de células
+    bool desloc_entre_camadas;          // o layout deixa o deslocamento entre camadas fixo
+} Vizinhanca;
+
 // Tipo base da célula
 typedef uint8_t Celula;
 
@@ -66,449 +153,6743 @@ typedef struct NoPilha {
     size_t x, y;
     Celula valor_antigo;
     bool inicio_lote;
-    struct NoPilha *proximo;
+    struct NoPilha *proximo;   // em direção ao fundo (jogadas mais antigas)
+    struct NoPilha *anterior;  // em direção ao topo; permite descartar pelo fundo
 } NoPilha;
 
+//LINHA DO TEMPO: todas as jogadas da partida, inclusive as desfeitas (que podem ser refeitas)
+typedef struct {
+    uint8_t tipo;    // TipoMovimento
+    uint32_t x, y;
+    uint32_t x_fim, y_fim;  // último canto do retângulo (só nas jogadas em área)
+} Jogada;
+
+//CHECKPOINT: cópia comprimida do tabuleiro a cada INTERVALO_CHECKPOINT jogadas
+typedef struct {
+    unsigned char *celulas;     // células em RLE: (repetições em varint, valor)
+    size_t tamanho;
+    size_t celulas_reveladas;
+    uint64_t estado_aleatorio;
+    bool primeiro_clique_pendente;
+    uint64_t hash;
+    size_t *bandeiras;          // x, y das bandeiras na ordem da lista
+    size_t qtd_bandeiras;
+} Checkpoint;
+
+typedef struct {
+    Jogada *jogadas;
+    size_t qtd_jogadas;
+    size_t capacidade_jogadas;
+    size_t posicao;             // quantas jogadas estão aplicadas no tabuleiro agora
+
+    Checkpoint *checkpoints;    // checkpoints[k] = tabuleiro após k * INTERVALO_CHECKPOINT jogadas
+    size_t qtd_checkpoints;
+    size_t capacidade_checkpoints;
+    size_t bytes_checkpoints;
+    size_t checkpoints_afinados; // 1..checkpoints_afinados foram liberados pelo --desfazer-bytes
+} LinhaDoTempo;
+
+//QUADRO: buffer onde a tela é montada antes de ir para o terminal (uma escrita só por quadro)
+typedef struct {
+    char *dados;
+    size_t tamanho;
+    size_t capacidade;
+} Quadro;
+
+//HISTOGRAMA: tempos de uma operação em baldes de escala logarítmica (4 baldes por potência de 2)
+#define BALDES_POR_OITAVA     4
+#define QTD_BALDES_HISTOGRAMA (64 * BALDES_POR_OITAVA)
+
+typedef struct {
+    uint64_t baldes[QTD_BALDES_HISTOGRAMA];
+    uint64_t quantidade;
+    uint64_t total_ns;
+    uint64_t maximo_ns;
+    uint64_t unidades;   // células tocadas ou bytes emitidos, conforme a operação
+} Histograma;
+
+// Operações do motor que têm o tempo medido
+typedef enum {
+    OP_GERAR,
+    OP_REVELAR,
+    OP_ACORDE,
+    OP_DESFAZER,
+    OP_BANDEIRA,
+    OP_DESENHAR,
+    OP_ENTRADA,
+    OP_SEM_CHUTE,
+    QTD_OPERACOES
+} Operacao;
+
+typedef struct {
+    Histograma operacoes[QTD_OPERACOES];
+    uint64_t alocacoes;
+    uint64_t liberacoes;
+} Estatisticas;
+
 // --- ESTADO DO JOGO ---
 
+// Revelação que ainda não terminou (ver comecar_revelar): a fila da BFS e a jogada que a abriu.
+// Enquanto 'ativa', o lote de undo dela está aberto no topo da pilha.
+typedef struct {
+    bool ativa;
+    int tipo;                  // TipoMovimento (MOV_REVELAR, MOV_ACORDE ou MOV_REVELAR_AREA)
+    size_t x, y;
+    size_t x_fim, y_fim;       // MOV_REVELAR_AREA: último canto do retângulo (senão, x e y)
+    Operacao op;               // OP_REVELAR ou OP_ACORDE, para as estatísticas
+    bool acertou_mina;
+    bool protecao;             // a jogada tirou as minas do primeiro clique
+    size_t reveladas_antes;
+    uint64_t ns_gastos;        // soma das fatias: o tempo entre elas é do front end
+
+    NoFila *inicio, *fim;
+
+    // Ondas da BFS (para o trace): a onda termina quando o último nó que ela enfileirou sai da fila
+    NoFila *fim_onda;
+    uint64_t inicio_onda;
+    size_t reveladas_onda;
+} RevelacaoPendente;
+
 typedef struct {
     size_t largura;
     size_t altura;
     size_t qtd_minas;
     Celula *celulas;
+    size_t bytes_mapeados;     // células num mmap próprio (0 = realloc; ver MEMÓRIA DAS CÉLULAS)
+    size_t celulas_reveladas;  // controle rápido de vitória
+
+    // Gerador pseudoaleatório próprio do tabuleiro: a mesma semente gera as mesmas minas
+    uint64_t semente;
+    uint64_t estado_aleatorio;
+
+    // Até o primeiro revelar as minas podem sair de perto da célula clicada
+    bool primeiro_clique_pendente;
+    size_t jogada_protecao;    // jogada da linha do tempo que moveu as minas (SIZE_MAX = nenhuma)
+
+    // Modo sem chute: o primeiro clique troca o tabuleiro por um que se resolve só com lógica
+    bool sem_chute;
+    size_t candidatos_sem_chute;  // candidatos até o tabuleiro escolhido (0 = não gerado)
+    uint64_t ns_sem_chute;
     
     // Cabeças das estruturas
     NoListaDupla *inicio_bandeiras; 
+    size_t qtd_bandeiras;      // nós na lista de bandeiras (o rodapé não precisa percorrê-la)
     NoPilha *pilha_desfazer; 
-} Tabuleiro;
+    NoPilha *fundo_desfazer;   // nó mais antigo da pilha
 
-// Global para controle rápido de vitória
-size_t celulas_reveladas = 0;
+    // Tamanho da pilha de undo e limite opcional (0 = sem limite)
+    size_t lotes_desfazer;
+    size_t bytes_desfazer;
+    size_t lotes_descartados;  // lotes que saíram pelo fundo (voltar até eles usa a linha do tempo)
+    size_t lotes_criados;      // cresce a cada lote aberto: diz se uma jogada mudou algo
+    size_t limite_lotes;
+    size_t limite_bytes;
 
+    // Histórico completo para refazer e pular para qualquer jogada
+    LinhaDoTempo linha;
 
-// --- IMPLEMENTAÇÃO DAS ESTRUTURAS DE DADOS ---
+    // Hash Zobrist do estado visível (bandeira/revelada de cada célula), mantido célula a célula
+    uint64_t hash;
 
-// Adiciona coordenada à Lista Dupla de bandeiras.
-void lista_dupla_adicionar(Tabuleiro *t, size_t x, size_t y) {
-    NoListaDupla *no = malloc(sizeof(NoListaDupla)); //aloca memoria para um nó da lista e retorna um ponteiro 
-    no->x = x; //armazena coords. x no campo 'x' do novo nó
-    no->y = y; //armazena coords. y no campo 'y' do novo nó
-    no->proximo = t->inicio_bandeiras; // faz ponteiro do novo nó apontar para o que está no começo da lista
-    no->anterior = NULL; // não existe nó anterior ao primeiro
+    // Topologia (ver TOPOLOGIAS). No 3D a altura é a soma das camadas: a linha y fica na camada
+    // y / altura_camada, então o resto do motor continua vendo um tabuleiro 2D
+    Topologia topologia;
+    size_t camadas;
+    size_t altura_camada;
+    Vizinhanca viz;
 
-    if (t->inicio_bandeiras != NULL) {
-        t->inicio_bandeiras->anterior = no;
-    }
-    t->inicio_bandeiras = no;
-}
+    // Bitboards do estado visível, mantidos junto com as células (ver BITBOARDS)
+    uint64_t *bits_bandeira;
+    uint64_t *bits_revelada;
+    size_t palavras_por_linha;
 
-// Remove coordenada da Lista Dupla de bandeiras.
-void lista_dupla_remover(Tabuleiro *t, size_t x, size_t y) {
-    NoListaDupla *atual = t->inicio_bandeiras;
-    while (atual != NULL) {
-        if (atual->x == x && atual->y == y) {
-            if (atual->anterior){ atual->anterior->proximo = atual->proximo; }
-            if (atual->proximo) { atual->proximo->anterior = atual->anterior; }
-            if (atual == t->inicio_bandeiras){
-                t->inicio_bandeiras = atual->proximo;
-            }
-            free(atual);
-            return;
-        }
-        atual = atual->proximo;
-    }
-}
+    // Um bit por linha cujo estado visível mudou desde a última publicação para os espectadores
+    // (ver transmissao_publicar). Quem troca o tabuleiro inteiro liga todos
+    uint64_t *linhas_mudadas;
 
-// Desfaz a última jogada (reverte um lote inteiro).
-bool pilha_desfazer(Tabuleiro *t) {
-    if (t->pilha_desfazer == NULL) return false;
+    // Estado visível num byte por célula, linha a linha, para os bots (ver BOTS). Só existe com
+    // 'expor_visivel' e anda junto com os bitboards
+    bool expor_visivel;
+    uint8_t *visivel;
 
-    NoPilha *n = t->pilha_desfazer;
+    RevelacaoPendente revelacao;
 
-    // Se topo é marcador e nada depois dele → nada a desfazer
-    if (n->inicio_lote && n->proximo == NULL)
-        return false;
+    // Tempos das operações; acumulam entre partidas da mesma sessão
+    Estatisticas estat;
+} Tabuleiro;
 
-    // Remove marcador do topo (se for o caso)
-    if (n->inicio_lote) {
-        t->pilha_desfazer = n->proximo;
-        free(n);
-        n = t->pilha_desfazer;
-    }
+// Resultado de uma jogada aplicada ao tabuleiro
+typedef enum {
+    JOGADA_NADA,     // nada mudou
+    JOGADA_FEITA,    // o tabuleiro mudou e o jogo continua
+    JOGADA_MINA,     // acertou uma mina
+    JOGADA_VITORIA,  // todas as células seguras foram reveladas
+    JOGADA_SAIR,     // o jogador pediu para sair
+    JOGADA_EM_ANDAMENTO,  // revelação em fatias: falta continuar_movimento
+} ResultadoJogada;
 
-    // Agora desfaz até encontrar um marcador
-    while (n && !n->inicio_lote) {
+// Comandos digitados no modo de linhas
+typedef enum {
+    CMD_INVALIDO,
+    CMD_SAIR,
+    CMD_AJUDA,
+    CMD_DESFAZER,
+    CMD_REFAZER,
+    CMD_IR,
+    CMD_LISTAR_BANDEIRAS,
+    CMD_ESTATISTICAS,
+    CMD_MELHOR,
+    CMD_SALVAR,
+    CMD_CARREGAR,
+    CMD_REVELAR,
+    CMD_BANDEIRA,
+    CMD_LIMPAR,
+} TipoComando;
 
-        // restaurar célula
-        CELULA_EM(t, n->x, n->y) = n->valor_antigo;
+typedef struct {
+    TipoComando tipo;
+    size_t x, y;     // CMD_IR usa x como número da jogada
+    size_t x_fim, y_fim;  // retângulo (x, y)-(x_fim, y_fim), inclusive; uma célula só: x e y
+    bool area;       // digitado como intervalo ("r 0-15 0-29", "b 3 *"): vira uma jogada em área
+    const char *arquivo;  // CMD_SALVAR/CMD_CARREGAR: aponta para dentro da linha digitada
+} Comando;
 
-        // estatísticas
-        if (!ESTA_REVELADA(n->valor_antigo))
-            celulas_reveladas--;
+// Movimentos que o jogador pode fazer (os valores são gravados no replay)
+typedef enum {
+    MOV_REVELAR  = 1,
+    MOV_BANDEIRA = 2,
+    MOV_ACORDE   = 3,  // revelar ao redor de uma célula já revelada
+    MOV_DESFAZER = 4,
+    MOV_REFAZER  = 5,
+    MOV_IR       = 6,  // pular para a jogada x da linha do tempo
+    // Em área: o retângulo (x, y)-(x_fim, y_fim) inteiro numa jogada e num lote de undo
+    MOV_REVELAR_AREA  = 7,  // revela as células escondidas sem bandeira
+    MOV_BANDEIRA_AREA = 8,  // põe bandeira nas células escondidas
+    MOV_LIMPAR_AREA   = 9,  // tira as bandeiras
+} TipoMovimento;
 
-        // próximo item
-        NoPilha *tmp = n;
-        n = n->proximo;
-        free(tmp);
-    }
+#define MOVIMENTO_EM_AREA(tipo) ((tipo) >= MOV_REVELAR_AREA && (tipo) <= MOV_LIMPAR_AREA)
 
-    // remover o marcador
-    if (n && n->inicio_lote) {
-        NoPilha *tmp = n;
-        t->pilha_desfazer = n->proximo;
-        free(tmp);
-    } else {
-        t->pilha_desfazer = NULL;
-    }
 
-    return true;
+// --- MEDIÇÃO DE TEMPO E MEMÓRIA ---
+
+// Relógio monotônico em nanossegundos, usado para medir latências.
+uint64_t agora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
 }
 
-//Guarda jogada antiga na Pilha do Undo
-void empilhar_undo(Tabuleiro *t, size_t x, size_t y, Celula valor_antigo, bool inicio_lote)
-{
-    NoPilha *novo = malloc(sizeof(NoPilha));
-    if (!novo) return;
+// Balde do histograma onde cai uma duração: expoente de 2 e os 2 bits seguintes.
+size_t balde_histograma(uint64_t ns) {
+    if (ns < BALDES_POR_OITAVA) return (size_t)ns;
+    unsigned expoente = 63 - (unsigned)__builtin_clzll(ns);
+    return expoente * BALDES_POR_OITAVA + ((ns >> (expoente - 2)) & (BALDES_POR_OITAVA - 1));
+}
 
-    novo->x = x;
-    novo->y = y;
-    novo->valor_antigo = valor_antigo;
-    novo->inicio_lote = inicio_lote;
+// Menor duração que cai no balde 'b'.
+uint64_t inicio_balde(size_t b) {
+    if (b < BALDES_POR_OITAVA) return b;
+    // A oitava do expoente 1 fica vazia (2 e 3 já têm balde exato): seus baldes começam no 4
+    if (b < 2 * BALDES_POR_OITAVA) return BALDES_POR_OITAVA;
+    unsigned expoente = (unsigned)(b / BALDES_POR_OITAVA);
+    if (expoente >= 64) return UINT64_MAX;
+    return (uint64_t)(BALDES_POR_OITAVA + b % BALDES_POR_OITAVA) << (expoente - 2);
+}
 
-    novo->proximo = t->pilha_desfazer;  // empilha
-    t->pilha_desfazer = novo;
+// --- TRACE (FORMATO CHROME/PERFETTO) ---
+
+//Um trecho de tempo ("span") do trace, com um argumento numérico opcional
+typedef struct {
+    const char *nome;
+    const char *nome_arg;   // NULL = sem argumento
+    uint64_t inicio_ns;
+    uint64_t duracao_ns;
+    uint64_t valor_arg;
+} EventoTrace;
+
+//ANEL: buffer circular de uma thread; só ela escreve, então não precisa de trava
+typedef struct AnelTrace {
+    EventoTrace eventos[TAM_ANEL_TRACE];
+    _Atomic uint64_t escritos;      // total já escrito; a posição é escritos % TAM_ANEL_TRACE
+    _Atomic bool gravando;          // a thread dona está no meio de uma escrita
+    uint32_t tid;
+    struct AnelTrace *proximo;      // lista de todos os anéis (só cresce)
+} AnelTrace;
+
+static _Atomic bool trace_ativo = false;
+static const char *caminho_trace = NULL;
+static uint64_t trace_origem_ns = 0;
+static _Atomic(AnelTrace *) aneis_trace = NULL;
+static _Atomic uint32_t proximo_tid_trace = 1;
+static _Thread_local AnelTrace *anel_local = NULL;
+
+// Anel da thread atual, criado no primeiro evento e pendurado na lista global com CAS.
+AnelTrace *anel_da_thread(void) {
+    if (anel_local) return anel_local;
+
+    AnelTrace *anel = calloc(1, sizeof(AnelTrace));
+    if (!anel) return NULL;
+    anel->tid = atomic_fetch_add(&proximo_tid_trace, 1);
+
+    AnelTrace *topo = atomic_load(&aneis_trace);
+    do {
+        anel->proximo = topo;
+    } while (!atomic_compare_exchange_weak(&aneis_trace, &topo, anel));
+
+    anel_local = anel;
+    return anel;
 }
 
-//Funcionalidade da bandeira
-void alternar_bandeira(Tabuleiro *t, size_t x, size_t y) {
-    Celula *cel = &CELULA_EM(t, x, y);
+// Grava um span que começou em 'inicio_ns' e durou 'duracao_ns'.
+void trace_registrar(const char *nome, uint64_t inicio_ns, uint64_t duracao_ns,
+                     const char *nome_arg, uint64_t valor_arg) {
+    if (!trace_ativo) return;
 
-    // Não pode alternar bandeira se a célula já está revelada
-    if (ESTA_REVELADA(*cel)) return;
+    AnelTrace *anel = anel_da_thread();
+    if (!anel) return;
 
-    if (TEM_BANDEIRA(*cel)) {
-        // Remove bandeira da lista
-        lista_dupla_remover(t, x, y);
-        DEFINIR_BANDEIRA(*cel, false);
-    } else {
-        // Coloca bandeira na lista
-        lista_dupla_adicionar(t, x, y);
-        DEFINIR_BANDEIRA(*cel, true);
+    // Anuncia a escrita antes de conferir de novo se o trace está ligado: trace_gravar desliga
+    // antes de esperar os anéis, então ou ele vê esta escrita ou ela vê o trace desligado
+    atomic_store(&anel->gravando, true);
+    if (!atomic_load(&trace_ativo)) {
+        atomic_store_explicit(&anel->gravando, false, memory_order_release);
+        return;
     }
+
+    uint64_t n = atomic_load_explicit(&anel->escritos, memory_order_relaxed);
+    anel->eventos[n & (TAM_ANEL_TRACE - 1)] = (EventoTrace){
+        .nome = nome,
+        .nome_arg = nome_arg,
+        .inicio_ns = inicio_ns,
+        .duracao_ns = duracao_ns,
+        .valor_arg = valor_arg,
+    };
+    atomic_store_explicit(&anel->escritos, n + 1, memory_order_release);
+    atomic_store_explicit(&anel->gravando, false, memory_order_release);
 }
 
-//Inicia um nó que inicia um lote das celulas reveladas
-void empilhar_inicio_lote(Tabuleiro *t) {
-    NoPilha *n = malloc(sizeof(NoPilha));
-    n->inicio_lote = true;
-    n->proximo = t->pilha_desfazer;
-    t->pilha_desfazer = n;
+// Grava um span que começou em 'inicio_ns' e termina agora.
+void trace_span(const char *nome, uint64_t inicio_ns, const char *nome_arg, uint64_t valor_arg) {
+    if (!trace_ativo) return;
+    trace_registrar(nome, inicio_ns, agora_ns() - inicio_ns, nome_arg, valor_arg);
 }
 
-// --- LÓGICA DO JOGO ---
+// Escreve todos os anéis no arquivo JSON (chamada na saída do programa).
+// Threads que ainda rodam (pré-geração, faixas, transmissão) param de escrever quando o trace
+// é desligado; aqui só se espera a escrita que cada uma já tinha começado.
+void trace_gravar(void) {
+    if (!atomic_exchange(&trace_ativo, false)) return;
+    for (AnelTrace *anel = atomic_load(&aneis_trace); anel; anel = anel->proximo)
+        while (atomic_load_explicit(&anel->gravando, memory_order_acquire))
+            ;
 
-// Lê input do usuário removendo newline.
-void ler_entrada(char *buf, int tamanho) {
-    if (fgets(buf, tamanho, stdin) != NULL) {
-        buf[strcspn(buf, "\n")] = 0;
-    } else {
-        buf[0] = 0;
+    FILE *f = fopen(caminho_trace, "w");
+    if (!f) {
+        perror("ERRO: trace");
+        return;
     }
-}
 
-// Inicializa o tabuleiro e distribui minas.
-void iniciar_jogo(Tabuleiro *t) {
-    celulas_reveladas = 0;
-    t->inicio_bandeiras = NULL;
-    t->pilha_desfazer = NULL;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"campo minado\"}}");
 
-    t->celulas = realloc(t->celulas, t->largura * t->altura * sizeof(*t->celulas));
-    if (!t->celulas) {
-        perror("ERRO: malloc");
-        exit(EXIT_FAILURE);
+    uint64_t perdidos = 0;
+    for (AnelTrace *anel = atomic_load(&aneis_trace); anel; anel = anel->proximo) {
+        uint64_t escritos = atomic_load_explicit(&anel->escritos, memory_order_acquire);
+        uint64_t primeiro = escritos > TAM_ANEL_TRACE ? escritos - TAM_ANEL_TRACE : 0;
+        perdidos += primeiro;
+
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                   "\"args\":{\"name\":\"thread %u\"}}", anel->tid, anel->tid);
+
+        for (uint64_t i = primeiro; i < escritos; i++) {
+            const EventoTrace *ev = &anel->eventos[i & (TAM_ANEL_TRACE - 1)];
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                       "\"ts\":%.3f,\"dur\":%.3f",
+                    ev->nome, anel->tid,
+                    (ev->inicio_ns - trace_origem_ns) / 1e3,
+                    ev->duracao_ns / 1e3);
+            if (ev->nome_arg)
+                fprintf(f, ",\"args\":{\"%s\":%llu}", ev->nome_arg, (unsigned long long)ev->valor_arg);
+            fputc('}', f);
+        }
     }
-    memset(t->celulas, 0, t->largura * t->altura * sizeof(Celula));
 
-    // Distribuir minas
-    for (size_t i = 0; i < t->qtd_minas; i++) {
-        size_t x, y;
-        do {
-            x = rand() % t->largura;
-            y = rand() % t->altura;
-        } while (EH_MINA(CELULA_EM(t, x, y)));
+    fprintf(f, "\n]}\n");
+    fclose(f);
 
-        DEFINIR_MINA(CELULA_EM(t, x, y), true);
+    if (perdidos)
+        fprintf(stderr, "trace: %llu eventos antigos foram sobrescritos\n", (unsigned long long)perdidos);
+}
 
-        for (size_t j = 0; j < 8; j++) {
-            size_t nx = x + direcoes[j][0];
-            size_t ny = y + direcoes[j][1];
-            if (nx >= t->largura || ny >= t->altura) continue;
-            if (EH_MINA(CELULA_EM(t, nx, ny))) continue;
-            CELULA_EM(t, nx, ny)++;
+// Liga o trace; o arquivo é escrito quando o programa termina.
+void trace_iniciar(const char *caminho) {
+    caminho_trace = caminho;
+    trace_origem_ns = agora_ns();
+    trace_ativo = true;
+    atexit(trace_gravar);
+}
+
+// Registra uma operação que começou em 'inicio_ns' e acabou agora (também vira span no trace).
+void registrar_tempo(Tabuleiro *t, Operacao op, uint64_t inicio_ns, uint64_t unidades) {
+    // Nome do span no trace e do argumento de cada operação
+    static const char *const nomes_trace[QTD_OPERACOES] = {
+        "iniciar_jogo", "revelar_celula", "revelar_ao_redor", "pilha_desfazer",
+        "alternar_bandeira", "atualizar_tela", "interpretar_entrada", "gerar_sem_chute",
+    };
+    static const char *const args_trace[QTD_OPERACOES] = {
+        "celulas", "celulas", "celulas", "celulas", "celulas", "bytes", "bytes", "candidatos",
+    };
+
+    Histograma *h = &t->estat.operacoes[op];
+    uint64_t duracao = agora_ns() - inicio_ns;
+    trace_registrar(nomes_trace[op], inicio_ns, duracao, args_trace[op], unidades);
+
+    h->baldes[balde_histograma(duracao)]++;
+    h->quantidade++;
+    h->total_ns += duracao;
+    h->unidades += unidades;
+    if (duracao > h->maximo_ns) h->maximo_ns = duracao;
+}
+
+// Estimativa do percentil 'p' (0-100): fim do balde onde ele cai, limitado ao máximo visto.
+uint64_t percentil_histograma(const Histograma *h, double p) {
+    if (h->quantidade == 0) return 0;
+
+    uint64_t alvo = (uint64_t)(h->quantidade * p / 100.0);
+    if (alvo >= h->quantidade) alvo = h->quantidade - 1;
+
+    uint64_t acumulado = 0;
+    for (size_t b = 0; b < QTD_BALDES_HISTOGRAMA; b++) {
+        acumulado += h->baldes[b];
+        if (acumulado > alvo) {
+            uint64_t fim = inicio_balde(b + 1);
+            return fim < h->maximo_ns ? fim : h->maximo_ns;
         }
     }
+    return h->maximo_ns;
 }
 
-// Imprime célula colorida.
-void imprimir_celula(Celula c) {
-    printf("\x1b[1m");
+// Soma as medições de 'origem' às de 'destino' (trabalho feito em outro tabuleiro ou thread).
+void somar_estatisticas(Estatisticas *destino, const Estatisticas *origem) {
+    for (size_t op = 0; op < QTD_OPERACOES; op++) {
+        Histograma *d = &destino->operacoes[op];
+        const Histograma *o = &origem->operacoes[op];
+        if (o->quantidade == 0) continue;
+        for (size_t b = 0; b < QTD_BALDES_HISTOGRAMA; b++) d->baldes[b] += o->baldes[b];
+        d->quantidade += o->quantidade;
+        d->total_ns += o->total_ns;
+        d->unidades += o->unidades;
+        if (o->maximo_ns > d->maximo_ns) d->maximo_ns = o->maximo_ns;
+    }
+    destino->alocacoes += origem->alocacoes;
+    destino->liberacoes += origem->liberacoes;
+}
 
-    if (ESTA_REVELADA(c)) {
-        printf("\x1b[47m"); // Fundo claro
+// malloc/free que contam as alocações nas estatísticas do tabuleiro.
+void *alocar(Tabuleiro *t, size_t tamanho) {
+    t->estat.alocacoes++;
+    return malloc(tamanho);
+}
 
-        if (EH_MINA(c)) {
-            printf("\x1b[31m#");
-        } else if (NUM_MINAS(c) != 0) {
-            uint8_t num = NUM_MINAS(c);
+void liberar(Tabuleiro *t, void *p) {
+    if (p) t->estat.liberacoes++;
+    free(p);
+}
 
-            switch (num) {
-                case 1: printf("\x1b[94m"); break; 
-                case 2: printf("\x1b[32m"); break;
-                case 3: printf("\x1b[91m"); break;
-                case 4: printf("\x1b[34m"); break;
-                case 5: printf("\x1b[31m"); break;
-                case 6: printf("\x1b[36m"); break;
-                case 7: printf("\x1b[30m"); break;
-                case 8: printf("\x1b[90m"); break;
-            }
+// --- TOPOLOGIAS (TABELAS DE VIZINHOS) ---
 
-            printf("%u", num);
-        } else {
-            printf(" ");
-        }
+const char *const nomes_topologia[QTD_TOPOLOGIAS] = { "quadrada", "toro", "hex", "3d" };
 
-    } else {
-        printf("\x1b[100m");
-        if (TEM_BANDEIRA(c)) {
-            printf("\x1b[91m!");
+// Monta a tabela de vizinhos da topologia para as dimensões atuais do tabuleiro. A quadrada e o
+// toro seguem a ordem de 'direcoes' (a ordem da inundação e do undo não muda).
+void montar_vizinhanca(Tabuleiro *t) {
+    if (t->camadas == 0) t->camadas = 1;
+    t->altura_camada = t->altura / t->camadas;
+    Vizinhanca *v = &t->viz;
+    *v = (Vizinhanca){0};
+
+    for (unsigned p = 0; p < 2; p++) {
+        unsigned n = 0;
+        if (t->topologia == TOPOLOGIA_HEX) {
+            for (; n < 6; n++) {
+                v->dx[p][n] = direcoes_hex[p][n][0];
+                v->dy[p][n] = direcoes_hex[p][n][1];
+            }
+        } else if (t->topologia == TOPOLOGIA_3D) {
+            for (int dz = -1; dz <= 1; dz++)
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++) {
+                        if (!dx && !dy && !dz) continue;
+                        v->dx[p][n] = dx;
+                        v->dy[p][n] = dy;
+                        v->dz[n++] = dz;
+                    }
         } else {
-            printf("\x1b[37m.");
+            for (; n < 8; n++) {
+                v->dx[p][n] = direcoes[n][0];
+                v->dy[p][n] = direcoes[n][1];
+            }
         }
+        v->qtd = n;
     }
 
-    printf(" \x1b[0m");
+    // Entre camadas o passo é fixo nas linhas; nos ladrilhos só quando a camada fecha ladrilhos inteiros
+    ptrdiff_t passo_camada = t->camadas > 1
+        ? (ptrdiff_t)INDICE_CELULA(t, 0, t->altura_camada) - (ptrdiff_t)INDICE_CELULA(t, 0, 0) : 0;
+#ifdef LADRILHOS
+    v->desloc_entre_camadas = t->altura_camada % 8 == 0;
+#else
+    v->desloc_entre_camadas = true;
+#endif
+    for (unsigned p = 0; p < 2; p++)
+        for (unsigned j = 0; j < v->qtd; j++)
+            v->desloc[p][j] = v->dx[p][j] + v->dy[p][j] * (ptrdiff_t)PASSO_VERTICAL(t) + v->dz[j] * passo_camada;
 }
 
-//Imprime o tabuleiro completo.
-void imprimir_tabuleiro(Tabuleiro *t) {
-    printf("   X ");
-    for (size_t i = 0; i < t->largura; i++) {
-        size_t unidade = i % 10;
-        printf("%zu%c", unidade, " |"[unidade == 9]);
+// (x, y) tem todos os vizinhos sem borda nem volta: valem os deslocamentos fixos de 'viz.desloc'.
+bool no_miolo(const Tabuleiro *t, size_t x, size_t y) {
+    size_t yc = y, z = 0;
+    if (t->camadas > 1) {
+        z = y / t->altura_camada;
+        yc = y - z * t->altura_camada;
+        if (z == 0 || z + 1 >= t->camadas || !t->viz.desloc_entre_camadas) return false;
     }
-    printf("\n Y\x1b[1;40;37m +");
-    for (size_t i = 0; i < t->largura * 2 + 1; i++) printf("-");
-    printf("+ \x1b[0m\n");
+    bool miolo = x > 0 && yc > 0 && x + 1 < t->largura && yc + 1 < t->altura_camada;
+#ifdef LADRILHOS
+    miolo = miolo && ((x + 1) & 7) > 1 && ((y + 1) & 7) > 1;
+#endif
+    return miolo;
+}
 
-    for (size_t y = 0; y < t->altura; y++) {
-        printf("%2zu\x1b[1;40;37m |\x1b[%dm ", 
-               y, 
-               ESTA_REVELADA(CELULA_EM(t, 0, y)) ? 47 : 100
-        );
+// Vizinhos de (x, y) na topologia do tabuleiro, em (vx[i], vy[i]). Devolve quantos são.
+unsigned listar_vizinhos(const Tabuleiro *t, size_t x, size_t y, size_t *vx, size_t *vy) {
+    unsigned n = 0;
+    switch (t->topologia) {
+        case TOPOLOGIA_QUADRADA:
+            // Sem tabela: tabuleiros de rascunho (resolvedor, servidor) nem montam a vizinhança
+            for (unsigned j = 0; j < 8; j++) {
+                size_t nx = x + direcoes[j][0], ny = y + direcoes[j][1];
+                if (nx >= t->largura || ny >= t->altura) continue;
+                vx[n] = nx;
+                vy[n++] = ny;
+            }
+            return n;
 
-        for (size_t x = 0; x < t->largura; x++) {
-            imprimir_celula(CELULA_EM(t, x, y));
+        case TOPOLOGIA_TORO:
+            for (unsigned j = 0; j < 8; j++, n++) {
+                size_t nx = x + direcoes[j][0], ny = y + direcoes[j][1];
+                vx[n] = nx == SIZE_MAX ? t->largura - 1 : nx == t->largura ? 0 : nx;
+                vy[n] = ny == SIZE_MAX ? t->altura - 1 : ny == t->altura ? 0 : ny;
+            }
+            return n;
+
+        case TOPOLOGIA_3D: {
+            const Vizinhanca *v = &t->viz;
+            size_t z = y / t->altura_camada, yc = y - z * t->altura_camada;
+            for (unsigned j = 0; j < v->qtd; j++) {
+                size_t nx = x + v->dx[0][j], nyc = yc + v->dy[0][j], nz = z + v->dz[j];
+                if (nx >= t->largura || nyc >= t->altura_camada || nz >= t->camadas) continue;
+                vx[n] = nx;
+                vy[n++] = nz * t->altura_camada + nyc;
+            }
+            return n;
         }
 
-        printf("\x1b[1;40;37m| \x1b[0m\n");
+        default: {
+            const Vizinhanca *v = &t->viz;
+            unsigned p = y & 1;
+            for (unsigned j = 0; j < v->qtd; j++) {
+                size_t nx = x + v->dx[p][j], ny = y + v->dy[p][j];
+                if (nx >= t->largura || ny >= t->altura) continue;
+                vx[n] = nx;
+                vy[n++] = ny;
+            }
+            return n;
+        }
     }
-
-    printf("  \x1b[1;40;37m +");
-    for (size_t i = 0; i < t->largura * 2 + 1; i++) printf("-");
-    printf("+ \n\x1b[0m");
 }
 
-//Limpa a tela e redesenha interface com informações
-void atualizar_tela(Tabuleiro *t) {
-    printf("\x1b[H\x1b[2J"); 
-    imprimir_tabuleiro(t);
-
-    // Estatísticas das estruturas de dados
-    size_t jogadas_feitas = 0;
-    NoPilha *p = t->pilha_desfazer;
-    while (p) {
-        if (p->inicio_lote) jogadas_feitas++;
-        p = p->proximo;
-    }
+// Dimensões que a topologia aceita: o toro precisa de 3 colunas e 3 linhas (senão um vizinho
+// apareceria duas vezes) e o 3D de camadas com a mesma altura.
+bool topologia_valida(Topologia topologia, size_t largura, size_t altura, size_t camadas) {
+    if (topologia == TOPOLOGIA_TORO) return largura >= 3 && altura >= 3;
+    if (topologia == TOPOLOGIA_3D) return camadas > 0 && altura % camadas == 0;
+    return camadas <= 1;
+}
 
-    
-    size_t total_bandeiras = 0;
-    NoListaDupla *b = t->inicio_bandeiras;
-    while (b) { 
-        total_bandeiras++; 
-        b = b->proximo; 
+// Lê "quadrada", "toro", "hex" ou "3d". Devolve false se o nome não existe.
+bool ler_topologia(const char *nome, Topologia *topologia) {
+    for (int i = 0; i < QTD_TOPOLOGIAS; i++) {
+        if (strcmp(nome, nomes_topologia[i]) == 0) {
+            *topologia = (Topologia)i;
+            return true;
+        }
     }
-    
-    printf("--- Informações ---\n");
-    printf("Jogadas Feitas: %zu | Bandeiras Ativas: %zu\n",
-           jogadas_feitas,
-           total_bandeiras
-    );
+    return false;
 }
 
-//Revela uma célula usando Fila
-void revelar_celula(Tabuleiro *t, size_t x_inicio, size_t y_inicio) {
-    if (ESTA_REVELADA(CELULA_EM(t, x_inicio, y_inicio)) ||
-        TEM_BANDEIRA(CELULA_EM(t, x_inicio, y_inicio)))
-        return;
-    empilhar_inicio_lote(t);
-
-    // Macro local para enfileirar nós
-    NoFila *inicio = NULL, *fim = NULL;
-    #define ENFILEIRAR(px, py) do { \
-        NoFila *novo = malloc(sizeof(NoFila)); \
-        novo->x = (px); \
-        novo->y = (py); \
-        novo->proximo = NULL; \
-        if (fim) fim->proximo = novo; else inicio = novo; \
-        fim = novo; \
-    } while(0)
+// --- BITBOARDS DO ESTADO VISÍVEL ---
 
-    ENFILEIRAR(x_inicio, y_inicio);
-    
-    // Undo: início de lote
-    empilhar_undo(t, x_inicio, y_inicio, CELULA_EM(t, x_inicio, y_inicio), false);
+/*
+ * Uma linha de bits por linha do tabuleiro para "bandeira" e outra para "revelada". A coluna x
+ * fica no bit x + 2 e há duas linhas vazias acima e abaixo do tabuleiro, além de uma palavra
+ * sobrando no fim de cada linha: a vizinhança 3x3 (ou 5x5) de qualquer célula, inclusive nas
+ * bordas, sai de janelas de bits e popcounts, sem teste de borda nem desvio.
+ */
+#define GUARDA_BITS 2
+#define LINHA_DE_BITS(t, bits, y) ((bits) + ((y) + GUARDA_BITS) * (t)->palavras_por_linha)
 
-    DEFINIR_REVELADA(CELULA_EM(t, x_inicio, y_inicio), true);
-    celulas_reveladas++;
+void bits_zerar(Tabuleiro *t) {
+    size_t n = (t->altura + 2 * GUARDA_BITS) * t->palavras_por_linha;
+    memset(t->bits_bandeira, 0, n * sizeof(uint64_t));
+    memset(t->bits_revelada, 0, n * sizeof(uint64_t));
+    if (t->visivel) memset(t->visivel, 0, t->largura * t->altura);
+    memset(t->linhas_mudadas, 0xff, (t->altura + 63) / 64 * sizeof(uint64_t));
+}
 
-    // Se clicou em número ou mina, não expande
-    if (NUM_MINAS(CELULA_EM(t, x_inicio, y_inicio)) != 0 ||
-        EH_MINA(CELULA_EM(t, x_inicio, y_inicio))) {
-        free(inicio);
-        return;
+// Aloca (ou realoca) os bitboards do tamanho do tabuleiro, zerados.
+void bits_alocar(Tabuleiro *t) {
+    t->palavras_por_linha = (t->largura + 2 * GUARDA_BITS + 63) / 64 + 1;
+    size_t n = (t->altura + 2 * GUARDA_BITS) * t->palavras_por_linha;
+    t->bits_bandeira = realloc(t->bits_bandeira, n * sizeof(uint64_t));
+    t->bits_revelada = realloc(t->bits_revelada, n * sizeof(uint64_t));
+    t->linhas_mudadas = realloc(t->linhas_mudadas, (t->altura + 63) / 64 * sizeof(uint64_t));
+    if (t->expor_visivel) t->visivel = realloc(t->visivel, t->largura * t->altura);
+    if (!t->bits_bandeira || !t->bits_revelada || !t->linhas_mudadas || (t->expor_visivel && !t->visivel)) {
+        perror("ERRO: realloc");
+        exit(EXIT_FAILURE);
     }
+    bits_zerar(t);
+}
 
-    // BFS
-    while (inicio) {
-        NoFila *atual = inicio;
-        inicio = inicio->proximo;
-        if (!inicio) fim = NULL;
-
-        size_t cx = atual->x;
-        size_t cy = atual->y;
-        free(atual);
+void bits_escrever(const Tabuleiro *t, uint64_t *bits, size_t x, size_t y, bool ligado) {
+    uint64_t *palavra = LINHA_DE_BITS(t, bits, y) + ((x + GUARDA_BITS) >> 6);
+    unsigned b = (x + GUARDA_BITS) & 63;
+    *palavra = (*palavra & ~(1ull << b)) | ((uint64_t)ligado << b);
+}
 
-        for (size_t j = 0; j < 8; j++) {
-            size_t nx = cx + direcoes[j][0];
-            size_t ny = cy + direcoes[j][1];
+// 64 bits da linha a partir do bit p. Sempre lê duas palavras; o deslocamento em duas
+// partes evita o << 64 quando p cai no início de uma palavra.
+uint64_t bits_a_partir(const uint64_t *linha, size_t p) {
+    unsigned s = p & 63;
+    return (linha[p >> 6] >> s) | ((linha[(p >> 6) + 1] << 1) << (63 - s));
+}
 
-            if (nx >= t->largura || ny >= t->altura) continue;
+// Células x até x_fim (no máximo 64, a partir do bit 0) da linha y: as que têm bandeira, ou, sem
+// 'bandeiras', as escondidas sem bandeira. As jogadas em área pulam assim as células que não mudam.
+uint64_t bits_da_area(const Tabuleiro *t, size_t x, size_t x_fim, size_t y, bool bandeiras) {
+    size_t p = x + GUARDA_BITS;
+    uint64_t b = bits_a_partir(LINHA_DE_BITS(t, t->bits_bandeira, y), p);
+    if (!bandeiras) b = ~(b | bits_a_partir(LINHA_DE_BITS(t, t->bits_revelada, y), p));
+    return x_fim - x >= 63 ? b : b & ((1ull << (x_fim - x + 1)) - 1);
+}
 
-            Celula *prox = &CELULA_EM(t, nx, ny);
+// Quantos dos 8 vizinhos de (x, y) têm o bit ligado.
+unsigned contar_vizinhos_bits(const Tabuleiro *t, const uint64_t *bits, size_t x, size_t y) {
+    const uint64_t *meio = LINHA_DE_BITS(t, bits, y);
+    size_t p = x + GUARDA_BITS - 1;
+    unsigned janela = (unsigned)(bits_a_partir(meio - t->palavras_por_linha, p) & 7) |
+                      (unsigned)(bits_a_partir(meio, p) & 5) << 3 |
+                      (unsigned)(bits_a_partir(meio + t->palavras_por_linha, p) & 7) << 6;
+    return (unsigned)__builtin_popcount(janela);
+}
 
-            if (ESTA_REVELADA(*prox) || TEM_BANDEIRA(*prox)) continue;
+// Vizinhança 5x5 de (x, y) em 25 bits: linha y-2+r, coluna x-2+c no bit 5r + c.
+uint32_t janela_5x5(const Tabuleiro *t, const uint64_t *bits, size_t x, size_t y) {
+    const uint64_t *linha = LINHA_DE_BITS(t, bits, y) - GUARDA_BITS * t->palavras_por_linha;
+    uint32_t janela = 0;
+    for (unsigned r = 0; r < 5; r++, linha += t->palavras_por_linha)
+        janela |= (uint32_t)(bits_a_partir(linha, x + GUARDA_BITS - 2) & 31) << (5 * r);
+    return janela;
+}
 
-            // Undo: continuação do lote
-            empilhar_undo(t, nx, ny, *prox, false);
+// Quais casas da janela 5x5 de (x, y) caem dentro do tabuleiro.
+uint32_t janela_5x5_dentro(const Tabuleiro *t, size_t x, size_t y) {
+    uint32_t colunas = 31, dentro = 0;
+    if (x < 2) colunas &= 31u << (2 - x);
+    if (x + 2 >= t->largura) colunas &= 31u >> (x + 3 - t->largura);
+    for (unsigned r = 0; r < 5; r++)
+        if (y + r >= 2 && y + r - 2 < t->altura) dentro |= colunas << (5 * r);
+    return dentro;
+}
 
-            DEFINIR_REVELADA(*prox, true);
-            celulas_reveladas++;
+// Vizinhos de (x, y) que existem (8 no miolo, 5 na borda, 3 no canto).
+unsigned vizinhos_no_tabuleiro(const Tabuleiro *t, size_t x, size_t y) {
+    unsigned colunas = 1 + (x > 0) + (x + 1 < t->largura);
+    unsigned linhas = 1 + (y > 0) + (y + 1 < t->altura);
+    return colunas * linhas - 1;
+}
 
-            // Só expande células vazias
-            if (NUM_MINAS(*prox) == 0 && !EH_MINA(*prox)) {
-                ENFILEIRAR(nx, ny);
-            }
+// Refaz os bitboards a partir das células (depois de escrever células em bloco).
+void bits_reconstruir(Tabuleiro *t) {
+    bits_alocar(t);
+    for (size_t y = 0; y < t->altura; y++) {
+        for (size_t x = 0; x < t->largura; x++) {
+            Celula c = CELULA_EM(t, x, y);
+            if (TEM_BANDEIRA(c)) bits_escrever(t, t->bits_bandeira, x, y, true);
+            if (ESTA_REVELADA(c)) bits_escrever(t, t->bits_revelada, x, y, true);
+            if (t->visivel) t->visivel[y * t->largura + x] = VISIVEL_BOT(c);
         }
     }
-
-    #undef ENFILEIRAR
 }
 
-//Tenta revelar ao redor se a quantidade de bandeiras bater com o número da célula
-bool revelar_ao_redor(Tabuleiro *t, size_t x, size_t y) {
-    size_t num_minas = NUM_MINAS(CELULA_EM(t, x, y));
+// --- HASH ZOBRIST ---
 
-    // Conta quantas bandeiras existem ao redor
-    for (size_t i = 0; i < 8; i++) {
-        size_t nx = x + direcoes[i][0];
-        size_t ny = y + direcoes[i][1];
+// Finalizador do splitmix64: espalha os bits de 'z' (usado para chaves de hash).
+uint64_t misturar64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
 
-        if (nx >= t->largura || ny >= t->altura)
-            continue;
+// Chave da célula 'idx' no estado visível 'estado'. Calculada na hora (finalizador do splitmix64)
+// em vez de tabelada: não ocupa memória nem depende do tamanho do tabuleiro.
+// Célula escondida vale 0, então o tabuleiro novo tem hash 0.
+uint64_t chave_zobrist(size_t idx, unsigned estado) {
+    if (estado == 0) return 0;
+    return misturar64(((uint64_t)idx << 2 | estado) * 0x9e3779b97f4a7c15u);
+}
 
-        if (TEM_BANDEIRA(CELULA_EM(t, nx, ny)))
-            num_minas -= 1;
+// Toda escrita do estado visível de uma célula do jogo passa por aqui: troca a chave antiga pela nova
+// em O(1) e mantém os bitboards.
+void escrever_celula(Tabuleiro *t, size_t x, size_t y, Celula valor) {
+    size_t idx = y * t->largura + x;
+    Celula *cel = &CELULA_EM(t, x, y);
+    if (ESTADO_VISIVEL(*cel) != ESTADO_VISIVEL(valor)) {
+        t->hash ^= chave_zobrist(idx, ESTADO_VISIVEL(*cel)) ^ chave_zobrist(idx, ESTADO_VISIVEL(valor));
+        bits_escrever(t, t->bits_bandeira, x, y, TEM_BANDEIRA(valor));
+        bits_escrever(t, t->bits_revelada, x, y, ESTA_REVELADA(valor));
+        if (t->visivel) t->visivel[idx] = VISIVEL_BOT(valor);
+        t->linhas_mudadas[y >> 6] |= 1ull << (y & 63);
     }
+    *cel = valor;
+}
 
-    bool acertou_mina = false;
+// Hash recalculado do zero, para conferir o incremental.
+uint64_t hash_completo(const Tabuleiro *t) {
+    uint64_t h = 0;
+    for (size_t y = 0, i = 0; y < t->altura; y++)
+        for (size_t x = 0; x < t->largura; x++, i++)
+            h ^= chave_zobrist(i, ESTADO_VISIVEL(CELULA_EM(t, x, y)));
+    return h;
+}
 
-    // Se bandeiras suficientes, revela vizinhos
-    if (num_minas <= 0) {
-        for (size_t i = 0; i < 8; i++) {
-            size_t nx = x + direcoes[i][0];
-            size_t ny = y + direcoes[i][1];
+// --- VARREDURAS DO TABULEIRO INTEIRO (SWAR) ---
 
-            if (nx >= t->largura || ny >= t->altura)
-                continue;
-            
-            Celula cel = CELULA_EM(t, nx, ny);
+/*
+ * Passadas pelo tabuleiro todo, 8 células por vez numa palavra de 64 bits: cada byte da palavra
+ * é uma célula (little-endian: a célula k é o byte k), e as operações lógicas e as somas que não
+ * passam de 255 por byte valem para as 8 de uma vez. As passadas andam por trechos contíguos da
+ * memória: a linha inteira no layout de linhas, a linha de um ladrilho com -DLADRILHOS.
+ */
+#define BYTES_UM 0x0101010101010101ull
+#define BYTES_COM_BIT(desloc) (BYTES_UM << (desloc))  // o bit 'desloc' das 8 células
+#define BYTES_NUMERO (BYTES_UM * MASCARA_MINAS)       // o número de minas das 8 células
+#define PALAVRAS_POR_SOMA 255                         // somas por byte antes de esvaziar
 
-            if (!TEM_BANDEIRA(cel) && !ESTA_REVELADA(cel)) {
-                // Cada revelação abre seu próprio lote de undo
-                revelar_celula(t, nx, ny);
+uint64_t ler_palavra(const uint8_t *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
 
-                if (!acertou_mina && EH_MINA(CELULA_EM(t, nx, ny)))
-                    acertou_mina = true;
-            }
-        }
-    }
+void gravar_palavra(uint8_t *p, uint64_t w) {
+    memcpy(p, &w, sizeof(w));
+}
 
-    return acertou_mina;
+// Soma dos 8 bytes de 'w'.
+size_t somar_bytes(uint64_t w) {
+    w = (w & 0x00ff00ff00ff00ffull) + ((w >> 8) & 0x00ff00ff00ff00ffull);
+    return (size_t)((w * 0x0001000100010001ull) >> 48);
 }
 
-//Revela todo o tabuleiro (Fim de jogo).
-void revelar_tabuleiro(Tabuleiro *tab) {
-    for (size_t y = 0; y < tab->altura; y++) {
-        for (size_t x = 0; x < tab->largura; x++) {
-             DEFINIR_REVELADA(CELULA_EM(tab, x, y), true);
-        }
-    }
+// Junta os 8 bytes de 'w' (cada um 0 ou 1) num byte: o byte k vira o bit k.
+unsigned juntar_bits(uint64_t w) {
+    return (unsigned)((w * 0x0102040810204080ull) >> 56);
 }
 
-//Verifica condição de vitória.
-bool verificar_vitoria(Tabuleiro *tab) {
+// Quantas células a partir da coluna x, na mesma linha, estão seguidas na memória.
+size_t trecho_contiguo(const Tabuleiro *t, size_t x) {
+    size_t n = CELULAS_CONTIGUAS(t, x);
+    return n < t->largura - x ? n : t->largura - x;
+}
+
+// Liga na linha y do bitboard os bits de todas as colunas do tabuleiro (as guardas ficam zeradas).
+void bits_ligar_linha(const Tabuleiro *t, uint64_t *bits, size_t y) {
+    uint64_t *linha = LINHA_DE_BITS(t, bits, y);
+    for (size_t p = GUARDA_BITS, fim = GUARDA_BITS + t->largura; p < fim; ) {
+        unsigned b = p & 63;
+        size_t qtd = fim - p < 64 - b ? fim - p : 64 - b;
+        linha[p >> 6] |= (qtd == 64 ? ~0ull : (1ull << qtd) - 1) << b;
+        p += qtd;
+    }
+}
+
+typedef struct {
+    size_t reveladas, bandeiras, minas;
+} ContagemCelulas;
+
+// Acumula os bits de revelada, bandeira e mina de n células: cada byte de 'somas' conta as
+// suas células, até PALAVRAS_POR_SOMA palavras por vez.
+void contar_trecho(const Celula *p, size_t n, ContagemCelulas *c) {
+    size_t i = 0;
+    while (i + 8 <= n) {
+        uint64_t reveladas = 0, bandeiras = 0, minas = 0;
+        for (size_t k = 0; k < PALAVRAS_POR_SOMA && i + 8 <= n; k++, i += 8) {
+            uint64_t w = ler_palavra(p + i);
+            reveladas += (w >> DESLOC_REVELADA) & BYTES_UM;
+            bandeiras += (w >> DESLOC_BANDEIRA) & BYTES_UM;
+            minas += (w >> DESLOC_MINA) & BYTES_UM;
+        }
+        c->reveladas += somar_bytes(reveladas);
+        c->bandeiras += somar_bytes(bandeiras);
+        c->minas += somar_bytes(minas);
+    }
+    for (; i < n; i++) {
+        c->reveladas += ESTA_REVELADA(p[i]);
+        c->bandeiras += TEM_BANDEIRA(p[i]);
+        c->minas += EH_MINA(p[i]);
+    }
+}
+
+// Quantas células estão reveladas, com bandeira e com mina.
+ContagemCelulas contar_celulas(const Tabuleiro *t) {
+    ContagemCelulas c = {0};
+    for (size_t y = 0; y < t->altura; y++)
+        for (size_t x = 0, n; x < t->largura; x += n) {
+            n = trecho_contiguo(t, x);
+            contar_trecho(&CELULA_EM(t, x, y), n, &c);
+        }
+    return c;
+}
+
+/*
+ * Números de uma linha inteira a partir só das minas: as minas das linhas y-1, y e y+1 viram
+ * bytes 0/1 em buffers com uma casa de guarda de cada lado, a soma das três sai em somas de
+ * palavras, e a da janela 3x3 em mais duas, com o buffer deslocado de uma casa. Nenhum byte passa
+ * de 9, então as 8 somas de uma palavra nunca se misturam. Vale para a grade quadrada e para o
+ * toro (as guardas e as linhas de fora dão a volta); hex e 3D seguem por somar_vizinhos.
+ */
+typedef struct {
+    size_t tamanho;     // bytes de cada buffer: largura + 2 guardas, com folga para ler de 8 em 8
+    uint8_t *minas[3];  // linhas y-1, y e y+1 (a coluna x fica na casa x + 1)
+    uint8_t *vertical;  // soma das três
+    uint8_t *numeros;   // números da linha y (a coluna x na casa x)
+    uint8_t *memoria;   // os cinco buffers (minas[] gira de linha em linha)
+    size_t capacidade;  // tamanho para o qual 'memoria' foi alocada
+} PassadaNumeros;
+
+// Buffers de cada thread, reaproveitados: validar depois de cada movimento não pode pagar um
+// malloc, que depois de liberar milhões de nós de undo leva dezenas de ms consolidando a memória.
+static _Thread_local PassadaNumeros passada_local = {0};
+
+bool numeros_em_lote(const Tabuleiro *t) {
+    return t->topologia == TOPOLOGIA_QUADRADA || t->topologia == TOPOLOGIA_TORO;
+}
+
+// Prepara os buffers da thread para a largura de 't' (NULL = sem memória).
+PassadaNumeros *passada_iniciar(const Tabuleiro *t) {
+    PassadaNumeros *pn = &passada_local;
+    pn->tamanho = ((t->largura + 2 + 7) & ~(size_t)7) + 8;
+    if (pn->tamanho > pn->capacidade) {
+        free(pn->memoria);
+        pn->memoria = malloc(5 * pn->tamanho);
+        pn->capacidade = pn->memoria ? pn->tamanho : 0;
+        if (!pn->memoria) return NULL;
+    }
+    memset(pn->memoria, 0, 5 * pn->tamanho);
+    for (size_t i = 0; i < 3; i++) pn->minas[i] = pn->memoria + i * pn->tamanho;
+    pn->vertical = pn->memoria + 3 * pn->tamanho;
+    pn->numeros = pn->memoria + 4 * pn->tamanho;
+    return pn;
+}
+
+// Copia para 'destino' as minas da linha y (y fora do tabuleiro: vazia, ou a do outro lado no toro).
+void passada_extrair_minas(const Tabuleiro *t, size_t y, uint8_t *destino) {
+    bool toro = t->topologia == TOPOLOGIA_TORO;
+    if (y >= t->altura) {
+        if (!toro) {
+            memset(destino, 0, t->largura + 2);
+            return;
+        }
+        y = y == SIZE_MAX ? t->altura - 1 : 0;
+    }
+    for (size_t x = 0, n; x < t->largura; x += n) {
+        const Celula *p = &CELULA_EM(t, x, y);
+        n = trecho_contiguo(t, x);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            gravar_palavra(destino + 1 + x + i, (ler_palavra(p + i) >> DESLOC_MINA) & BYTES_UM);
+        for (; i < n; i++) destino[1 + x + i] = EH_MINA(p[i]);
+    }
+    destino[0] = toro ? destino[t->largura] : 0;
+    destino[t->largura + 1] = toro ? destino[1] : 0;
+}
+
+// Põe nos buffers as minas das linhas y - 1 e y: a passada segue em passada_linha(pn, t, y).
+void passada_posicionar(PassadaNumeros *pn, const Tabuleiro *t, size_t y) {
+    passada_extrair_minas(t, y - 1, pn->minas[1]);
+    passada_extrair_minas(t, y, pn->minas[2]);
+}
+
+// Deixa em pn->numeros os números da linha y. As linhas vêm em ordem, a partir da 0 (ou da
+// linha dada a passada_posicionar).
+void passada_linha(PassadaNumeros *pn, const Tabuleiro *t, size_t y) {
+    if (y == 0) passada_posicionar(pn, t, 0);
+    uint8_t *velha = pn->minas[0];
+    pn->minas[0] = pn->minas[1];
+    pn->minas[1] = pn->minas[2];
+    pn->minas[2] = velha;
+    passada_extrair_minas(t, y + 1, pn->minas[2]);
+
+    // Laços de bytes sem dependência: o -O3 os leva para registradores SSE (16 casas por instrução)
+    const uint8_t *restrict cima = pn->minas[0], *restrict meio = pn->minas[1], *restrict baixo = pn->minas[2];
+    uint8_t *restrict vertical = pn->vertical, *restrict numeros = pn->numeros;
+    size_t largura = t->largura;  // fora de 't': escrever bytes poderia mudar t->largura para o compilador
+    for (size_t i = 0; i < largura + 2; i++) vertical[i] = (uint8_t)(cima[i] + meio[i] + baixo[i]);
+    // A janela 3x3 menos a própria célula (a vertical do meio inclui a mina dela)
+    for (size_t i = 0; i < largura; i++)
+        numeros[i] = (uint8_t)(vertical[i] + vertical[i + 1] + vertical[i + 2] - meio[i + 1]);
+}
+
+// Número que a célula (x, y) deveria ter, contando as minas em volta uma a uma.
+unsigned contar_minas_vizinhas(const Tabuleiro *t, size_t x, size_t y) {
+    size_t vx[MAX_VIZINHOS], vy[MAX_VIZINHOS];
+    unsigned n = listar_vizinhos(t, x, y, vx, vy), minas = 0;
+    for (unsigned j = 0; j < n; j++) minas += EH_MINA(CELULA_EM(t, vx[j], vy[j]));
+    return minas;
+}
+
+// --validar: aplicar_movimento confere o tabuleiro inteiro depois de cada movimento
+static bool validar_jogadas = false;
+
+/*
+ * Confere o tabuleiro inteiro: o número de cada célula contra as minas em volta, o total de
+ * minas, celulas_reveladas e os dois bitboards contra as células. Escreve a primeira diferença
+ * em stderr. Na grade quadrada e no toro são duas leituras das células de 8 em 8 (bem abaixo de
+ * 1 ms por milhão de células); hex e 3D recontam célula a célula.
+ */
+bool validar_tabuleiro(const Tabuleiro *t) {
+    bool em_lote = numeros_em_lote(t);
+    PassadaNumeros *pn = em_lote ? passada_iniciar(t) : NULL;
+    if (em_lote && !pn) {
+        fprintf(stderr, "ERRO: sem memória para validar o tabuleiro\n");
+        return false;
+    }
+
+    ContagemCelulas c = {0};
+    bool certo = true;
+    for (size_t y = 0; y < t->altura && certo; y++) {
+        if (em_lote) passada_linha(pn, t, y);
+        const uint64_t *reveladas = LINHA_DE_BITS(t, t->bits_revelada, y);
+        const uint64_t *bandeiras = LINHA_DE_BITS(t, t->bits_bandeira, y);
+
+        for (size_t x = 0, n; x < t->largura && certo; x += n) {
+            const Celula *p = &CELULA_EM(t, x, y);
+            n = trecho_contiguo(t, x);
+
+            size_t i = 0;
+#ifdef __SSE2__
+            // Blocos de 64 células em registradores de 16: o movemask junta o bit 7 das 16 (revelada);
+            // somar o registrador a ele mesmo sobe a bandeira e depois a mina para o bit 7
+            while (em_lote && i + 64 <= n) {
+                __m128i errados = _mm_setzero_si128();
+                uint64_t bits_r = 0, bits_b = 0, bits_m = 0;
+                for (unsigned k = 0; k < 4; k++) {
+                    __m128i v = _mm_loadu_si128((const __m128i *)(p + i + 16 * k));
+                    __m128i numeros = _mm_loadu_si128((const __m128i *)(pn->numeros + x + i + 16 * k));
+                    errados = _mm_or_si128(errados, _mm_xor_si128(_mm_and_si128(v, _mm_set1_epi8(MASCARA_MINAS)), numeros));
+                    bits_r |= (uint64_t)(unsigned)_mm_movemask_epi8(v) << (16 * k);
+                    v = _mm_add_epi8(v, v);
+                    bits_b |= (uint64_t)(unsigned)_mm_movemask_epi8(v) << (16 * k);
+                    v = _mm_add_epi8(v, v);
+                    bits_m |= (uint64_t)(unsigned)_mm_movemask_epi8(v) << (16 * k);
+                }
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(errados, _mm_setzero_si128())) != 0xffff ||
+                    bits_r != bits_a_partir(reveladas, x + i + GUARDA_BITS) ||
+                    bits_b != bits_a_partir(bandeiras, x + i + GUARDA_BITS))
+                    break;
+                c.reveladas += (size_t)__builtin_popcountll(bits_r);
+                c.bandeiras += (size_t)__builtin_popcountll(bits_b);
+                c.minas += (size_t)__builtin_popcountll(bits_m);
+                i += 64;
+            }
+#endif
+            // Blocos de até 64 células de 8 em 8 (o que sobrou, ou tudo sem SSE2): números comparados
+            // por palavra, e os bits de revelada e bandeira juntados para comparar com o bitboard
+            while (em_lote && i + 8 <= n) {
+                size_t palavras = (n - i) / 8 < 8 ? (n - i) / 8 : 8;
+                uint64_t errados = 0, soma_r = 0, soma_b = 0, soma_m = 0, bits_r = 0, bits_b = 0;
+                for (size_t k = 0; k < palavras; k++) {
+                    uint64_t w = ler_palavra(p + i + 8 * k);
+                    uint64_t r = (w >> DESLOC_REVELADA) & BYTES_UM, b = (w >> DESLOC_BANDEIRA) & BYTES_UM;
+                    errados |= (w & BYTES_NUMERO) ^ ler_palavra(pn->numeros + x + i + 8 * k);
+                    soma_r += r;
+                    soma_b += b;
+                    soma_m += (w >> DESLOC_MINA) & BYTES_UM;
+                    bits_r |= (uint64_t)juntar_bits(r) << (8 * k);
+                    bits_b |= (uint64_t)juntar_bits(b) << (8 * k);
+                }
+                uint64_t mascara = palavras == 8 ? ~0ull : (1ull << (8 * palavras)) - 1;
+                if (errados || bits_r != (bits_a_partir(reveladas, x + i + GUARDA_BITS) & mascara) ||
+                    bits_b != (bits_a_partir(bandeiras, x + i + GUARDA_BITS) & mascara))
+                    break;
+                c.reveladas += somar_bytes(soma_r);
+                c.bandeiras += somar_bytes(soma_b);
+                c.minas += somar_bytes(soma_m);
+                i += 8 * palavras;
+            }
+
+            // O resto do trecho (o bloco com diferença, ou tudo no hex e no 3D) célula a célula
+            for (; i < n; i++) {
+                size_t cx = x + i;
+                c.reveladas += ESTA_REVELADA(p[i]);
+                c.bandeiras += TEM_BANDEIRA(p[i]);
+                c.minas += EH_MINA(p[i]);
+                unsigned esperado = em_lote ? pn->numeros[cx] : contar_minas_vizinhas(t, cx, y);
+                const char *erro = NULL;
+                if (NUM_MINAS(p[i]) != esperado) erro = "número errado";
+                else if (ESTA_REVELADA(p[i]) != ((bits_a_partir(reveladas, cx + GUARDA_BITS) & 1) == 1))
+                    erro = "bitboard de reveladas diferente";
+                else if (TEM_BANDEIRA(p[i]) != ((bits_a_partir(bandeiras, cx + GUARDA_BITS) & 1) == 1))
+                    erro = "bitboard de bandeiras diferente";
+                if (!erro) continue;
+                fprintf(stderr, "ERRO: célula (%zu, %zu): %s (célula 0x%02x, %u minas em volta)\n",
+                        y, cx, erro, p[i], esperado);
+                certo = false;
+                break;
+            }
+        }
+    }
+    if (!certo) return false;
+
+    if (c.minas != t->qtd_minas) {
+        fprintf(stderr, "ERRO: %zu minas no tabuleiro, esperadas %zu\n", c.minas, t->qtd_minas);
+        return false;
+    }
+    if (c.reveladas != t->celulas_reveladas) {
+        fprintf(stderr, "ERRO: %zu células reveladas, celulas_reveladas diz %zu\n",
+                c.reveladas, t->celulas_reveladas);
+        return false;
+    }
+    for (size_t y = 0; t->visivel && y < t->altura; y++) {
+        for (size_t x = 0; x < t->largura; x++) {
+            if (t->visivel[y * t->largura + x] == VISIVEL_BOT(CELULA_EM(t, x, y))) continue;
+            fprintf(stderr, "ERRO: célula (%zu, %zu): estado visível dos bots diferente\n", y, x);
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- MEMÓRIA DAS CÉLULAS (MMAP, PÁGINAS GRANDES E FAIXAS POR CPU) ---
+
+/*
+ * A partir de MIN_BYTES_MMAP as células ganham um mmap próprio, alinhado a 2 MiB e com páginas
+ * grandes: por madvise (THP, o padrão) ou reservadas (--paginas hugetlb, que volta para THP se o
+ * sistema não reservou nenhuma). Uma página de 2 MiB ocupa na TLB o lugar de 512 de 4 KiB, e o
+ * sorteio das minas, que salta pelo tabuleiro inteiro, deixa de errar a TLB a cada mina.
+ * O tabuleiro é dividido em faixas de linhas, uma por CPU permitida, e a faixa i é sempre da
+ * thread presa à i-ésima CPU: quem toca a página primeiro (e por isso a recebe no seu nó NUMA)
+ * é quem depois calcula os números dela. Abaixo do limite, ou com --paginas normais, fica o
+ * realloc de sempre.
+ */
+#define MIN_BYTES_MMAP     (2u << 20)
+#define TAM_PAGINA_GRANDE  (2u << 20)
+#define TAM_PAGINA         4096
+#define MAX_FAIXAS         64
+#define MIN_BYTES_FAIXA    (1u << 20)  // faixa menor que isso não paga a thread
+
+typedef enum {
+    PAGINAS_NORMAIS,  // realloc, sem faixas
+    PAGINAS_THP,      // mmap + madvise(MADV_HUGEPAGE)
+    PAGINAS_HUGETLB,  // mmap(MAP_HUGETLB), páginas reservadas em vm.nr_hugepages
+    QTD_MODOS_PAGINAS
+} ModoPaginas;
+
+const char *const nomes_paginas[QTD_MODOS_PAGINAS] = { "normais", "thp", "hugetlb" };
+static ModoPaginas modo_paginas = PAGINAS_THP;
+
+// CPUs da máscara de afinidade do processo, lidas uma vez (a pré-geração também gera tabuleiros)
+static int cpus_faixas[MAX_FAIXAS];
+static size_t qtd_cpus_faixas;
+static pthread_once_t cpus_lidas = PTHREAD_ONCE_INIT;
+
+void ler_cpus_permitidas(void) {
+    unsigned long mascara[16] = {0};
+    const size_t bits = 8 * sizeof(unsigned long);
+    long bytes = syscall(SYS_sched_getaffinity, 0, sizeof(mascara), mascara);
+    for (size_t cpu = 0; bytes > 0 && cpu < (size_t)bytes * 8 && qtd_cpus_faixas < MAX_FAIXAS; cpu++)
+        if ((mascara[cpu / bits] >> (cpu % bits)) & 1) cpus_faixas[qtd_cpus_faixas++] = (int)cpu;
+    if (qtd_cpus_faixas == 0) {
+        cpus_faixas[0] = -1;
+        qtd_cpus_faixas = 1;
+    }
+}
+
+// Prende a thread atual na CPU (-1 = deixa como está).
+void prender_na_cpu(int cpu) {
+    if (cpu < 0) return;
+    unsigned long mascara[16] = {0};
+    const size_t bits = 8 * sizeof(unsigned long);
+    mascara[(size_t)cpu / bits] = 1ul << ((size_t)cpu % bits);
+    syscall(SYS_sched_setaffinity, 0, sizeof(mascara), mascara);
+}
+
+typedef struct Faixa {
+    Tabuleiro *t;
+    size_t y0, y1;                  // linhas [y0, y1); y0 é múltiplo de 8 (um ladrilho)
+    int cpu;
+    void (*tarefa)(struct Faixa *f);
+    void *ctx;
+    void *saida;                    // o que a tarefa deixa para quem chamou juntar
+} Faixa;
+
+// Em quantas faixas 't' se divide: uma por CPU, nenhuma menor que MIN_BYTES_FAIXA ou que 8
+// linhas. O mesmo tabuleiro sempre dá as mesmas faixas, presas nas mesmas CPUs.
+size_t qtd_faixas(const Tabuleiro *t) {
+    pthread_once(&cpus_lidas, ler_cpus_permitidas);
+    size_t qtd = qtd_cpus_faixas;
+    if (qtd > CELULAS_ALOCADAS(t) / MIN_BYTES_FAIXA) qtd = CELULAS_ALOCADAS(t) / MIN_BYTES_FAIXA;
+    if (qtd > t->altura / 8) qtd = t->altura / 8;
+    return qtd ? qtd : 1;
+}
+
+void *trabalhador_faixa(void *arg) {
+    Faixa *f = arg;
+    prender_na_cpu(f->cpu);
+    f->tarefa(f);
+    // A thread acaba aqui: os buffers da passada dela também
+    free(passada_local.memoria);
+    passada_local = (PassadaNumeros){0};
+    return NULL;
+}
+
+// Roda 'tarefa' em cada faixa de 't', a faixa i numa thread presa à i-ésima CPU. Com uma faixa
+// só (ou se a thread não sobe) ela roda em quem chamou. Devolve quantas faixas ficaram em 'f'.
+size_t rodar_em_faixas(Tabuleiro *t, void (*tarefa)(Faixa *), void *ctx, Faixa f[MAX_FAIXAS]) {
+    size_t qtd = qtd_faixas(t);
+    for (size_t i = 0; i < qtd; i++) {
+        f[i] = (Faixa){ .t = t, .cpu = cpus_faixas[i], .tarefa = tarefa, .ctx = ctx };
+        f[i].y0 = (t->altura * i / qtd) & ~(size_t)7;
+        f[i].y1 = i + 1 == qtd ? t->altura : (t->altura * (i + 1) / qtd) & ~(size_t)7;
+    }
+    if (qtd == 1) {
+        tarefa(&f[0]);
+        return 1;
+    }
+
+    pthread_t threads[MAX_FAIXAS];
+    bool criada[MAX_FAIXAS];
+    for (size_t i = 0; i < qtd; i++)
+        criada[i] = pthread_create(&threads[i], NULL, trabalhador_faixa, &f[i]) == 0;
+    for (size_t i = 0; i < qtd; i++) {
+        if (criada[i]) pthread_join(threads[i], NULL);
+        else tarefa(&f[i]);
+    }
+    return qtd;
+}
+
+// Primeiro toque das células da faixa. Página nova já vem zerada do kernel: um byte por página
+// basta para ela nascer no nó desta CPU. Memória reaproveitada de outro tabuleiro é zerada inteira.
+void tocar_faixa(Faixa *f) {
+    Tabuleiro *t = f->t;
+    size_t inicio = INDICE_CELULA(t, 0, f->y0);
+    size_t fim = f->y1 == t->altura ? CELULAS_ALOCADAS(t) : INDICE_CELULA(t, 0, f->y1);
+    if (!*(const bool *)f->ctx) {
+        memset(t->celulas + inicio, 0, fim - inicio);
+        return;
+    }
+    for (size_t i = inicio; i < fim; i += TAM_PAGINA) t->celulas[i] = 0;
+}
+
+// mmap de 'bytes' (múltiplo de 2 MiB) alinhado a 2 MiB, com as páginas grandes de --paginas.
+Celula *mapear_celulas(size_t bytes) {
+    if (modo_paginas == PAGINAS_HUGETLB) {
+        void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return p;
+        static atomic_bool avisado = false;
+        if (!atomic_exchange(&avisado, true))
+            fprintf(stderr, "Sem páginas grandes reservadas (vm.nr_hugepages): usando THP\n");
+    }
+
+    // Pede 2 MiB a mais para poder alinhar e devolve as pontas
+    uint8_t *p = mmap(NULL, bytes + TAM_PAGINA_GRANDE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+    size_t antes = (TAM_PAGINA_GRANDE - (uintptr_t)p % TAM_PAGINA_GRANDE) % TAM_PAGINA_GRANDE;
+    if (antes) munmap(p, antes);
+    munmap(p + antes + bytes, TAM_PAGINA_GRANDE - antes);
+    madvise(p + antes, bytes, MADV_HUGEPAGE);
+    return p + antes;
+}
+
+// Devolve a memória das células para o sistema (munmap ou free).
+void liberar_celulas(Tabuleiro *t) {
+    if (!t->celulas) return;
+    t->estat.liberacoes++;
+    if (t->bytes_mapeados) munmap(t->celulas, t->bytes_mapeados);
+    else free(t->celulas);
+    t->celulas = NULL;
+    t->bytes_mapeados = 0;
+}
+
+// Deixa CELULAS_ALOCADAS(t) células zeradas em t->celulas, reaproveitando a memória da partida
+// anterior quando o tamanho bate. Devolve false sem memória.
+bool preparar_celulas(Tabuleiro *t) {
+    size_t bytes = CELULAS_ALOCADAS(t) * sizeof(Celula);
+    size_t mapeados = (bytes + TAM_PAGINA_GRANDE - 1) & ~(size_t)(TAM_PAGINA_GRANDE - 1);
+    if (modo_paginas == PAGINAS_NORMAIS || bytes < MIN_BYTES_MMAP) mapeados = 0;
+
+    if (!mapeados) {
+        if (t->bytes_mapeados) liberar_celulas(t);
+        if (!t->celulas) t->estat.alocacoes++;
+        Celula *novas = realloc(t->celulas, bytes);
+        if (!novas) return false;
+        t->celulas = novas;
+        memset(t->celulas, 0, bytes);
+        return true;
+    }
+
+    bool nova = t->bytes_mapeados != mapeados;
+    if (nova) {
+        liberar_celulas(t);
+        t->celulas = mapear_celulas(mapeados);
+        if (!t->celulas) return false;
+        t->bytes_mapeados = mapeados;
+        t->estat.alocacoes++;
+    }
+    Faixa faixas[MAX_FAIXAS];
+    rodar_em_faixas(t, tocar_faixa, &nova, faixas);
+    return true;
+}
+
+// Faltas de página do processo até agora (menores + maiores), para os relatórios.
+uint64_t faltas_de_pagina(void) {
+    struct rusage uso;
+    if (getrusage(RUSAGE_SELF, &uso) != 0) return 0;
+    return (uint64_t)uso.ru_minflt + (uint64_t)uso.ru_majflt;
+}
+
+// KiB do processo em páginas grandes de verdade (THP concedidas + hugetlb), ou 0 se não dá para saber.
+size_t kib_paginas_grandes(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return 0;
+    char linha[128];
+    size_t total = 0, kib;
+    while (fgets(linha, sizeof(linha), f))
+        if (sscanf(linha, "AnonHugePages: %zu kB", &kib) == 1 || sscanf(linha, "Private_Hugetlb: %zu kB", &kib) == 1)
+            total += kib;
+    fclose(f);
+    return total;
+}
+
+// --- IMPLEMENTAÇÃO DAS ESTRUTURAS DE DADOS ---
+
+// Adiciona coordenada à Lista Dupla de bandeiras.
+void lista_dupla_adicionar(Tabuleiro *t, size_t x, size_t y) {
+    NoListaDupla *no = alocar(t, sizeof(NoListaDupla)); //aloca memoria para um nó da lista e retorna um ponteiro 
+    no->x = x; //armazena coords. x no campo 'x' do novo nó
+    no->y = y; //armazena coords. y no campo 'y' do novo nó
+    no->proximo = t->inicio_bandeiras; // faz ponteiro do novo nó apontar para o que está no começo da lista
+    no->anterior = NULL; // não existe nó anterior ao primeiro
+
+    if (t->inicio_bandeiras != NULL) {
+        t->inicio_bandeiras->anterior = no;
+    }
+    t->inicio_bandeiras = no;
+    t->qtd_bandeiras++;
+}
+
+// Remove coordenada da Lista Dupla de bandeiras.
+void lista_dupla_remover(Tabuleiro *t, size_t x, size_t y) {
+    NoListaDupla *atual = t->inicio_bandeiras;
+    while (atual != NULL) {
+        if (atual->x == x && atual->y == y) {
+            if (atual->anterior){ atual->anterior->proximo = atual->proximo; }
+            if (atual->proximo) { atual->proximo->anterior = atual->anterior; }
+            if (atual == t->inicio_bandeiras){
+                t->inicio_bandeiras = atual->proximo;
+            }
+            liberar(t, atual);
+            t->qtd_bandeiras--;
+            return;
+        }
+        atual = atual->proximo;
+    }
+}
+
+// Tira o nó do topo da pilha de undo, mantendo o fundo e os contadores em dia.
+NoPilha *desempilhar_no(Tabuleiro *t) {
+    NoPilha *n = t->pilha_desfazer;
+    if (!n) return NULL;
+
+    t->pilha_desfazer = n->proximo;
+    if (t->pilha_desfazer) t->pilha_desfazer->anterior = NULL;
+    else t->fundo_desfazer = NULL;
+
+    t->bytes_desfazer -= sizeof(NoPilha);
+    if (n->inicio_lote) t->lotes_desfazer--;
+    return n;
+}
+
+// Desfaz a última jogada (reverte um lote inteiro).
+bool pilha_desfazer(Tabuleiro *t) {
+    if (t->pilha_desfazer == NULL) return false;
+
+    uint64_t inicio = agora_ns();
+    size_t restauradas = 0;
+
+    NoPilha *n = t->pilha_desfazer;
+
+    // Se topo é marcador e nada depois dele → nada a desfazer
+    if (n->inicio_lote && n->proximo == NULL)
+        return false;
+
+    // Remove marcador do topo (se for o caso)
+    if (n->inicio_lote) {
+        liberar(t, desempilhar_no(t));
+        n = t->pilha_desfazer;
+    }
+
+    // Agora desfaz até encontrar um marcador
+    while (n && !n->inicio_lote) {
+
+        Celula *cel = &CELULA_EM(t, n->x, n->y);
+
+        // estatísticas
+        if (ESTA_REVELADA(*cel) && !ESTA_REVELADA(n->valor_antigo))
+            t->celulas_reveladas--;
+        restauradas++;
+
+        // bandeira que muda volta para (ou sai da) lista
+        if (TEM_BANDEIRA(*cel) != TEM_BANDEIRA(n->valor_antigo)) {
+            if (TEM_BANDEIRA(n->valor_antigo)) lista_dupla_adicionar(t, n->x, n->y);
+            else lista_dupla_remover(t, n->x, n->y);
+        }
+
+        // restaurar célula
+        escrever_celula(t, n->x, n->y, n->valor_antigo);
+
+        // próximo item
+        liberar(t, desempilhar_no(t));
+        n = t->pilha_desfazer;
+    }
+
+    // remover o marcador
+    if (n && n->inicio_lote) {
+        liberar(t, desempilhar_no(t));
+    }
+
+    registrar_tempo(t, OP_DESFAZER, inicio, restauradas);
+    return true;
+}
+
+// Descarta o lote mais antigo pelo fundo da pilha: o marcador do fundo e as células acima dele.
+void descartar_lote_mais_antigo(Tabuleiro *t) {
+    NoPilha *n = t->fundo_desfazer;
+
+    do {
+        NoPilha *acima = n->anterior;
+        if (n->inicio_lote) t->lotes_desfazer--;
+        t->bytes_desfazer -= sizeof(NoPilha);
+        liberar(t, n);
+        n = acima;
+    } while (n && !n->inicio_lote);
+
+    t->fundo_desfazer = n;
+    if (n) n->proximo = NULL;
+    else t->pilha_desfazer = NULL;
+
+    t->lotes_descartados++;
+}
+
+// Memória do histórico, que é o que --desfazer-bytes limita: a pilha de undo mais a linha do
+// tempo (jogadas e checkpoints).
+size_t bytes_historico(const Tabuleiro *t) {
+    const LinhaDoTempo *l = &t->linha;
+    return t->bytes_desfazer + l->bytes_checkpoints + l->capacidade_jogadas * sizeof(Jogada);
+}
+
+// Mantém a pilha dentro do limite de lotes/bytes. O lote do topo (em andamento) nunca é descartado.
+void aplicar_limite_desfazer(Tabuleiro *t) {
+    while (t->lotes_desfazer > 1 &&
+           ((t->limite_lotes && t->lotes_desfazer > t->limite_lotes) ||
+            (t->limite_bytes && bytes_historico(t) > t->limite_bytes))) {
+        descartar_lote_mais_antigo(t);
+    }
+}
+
+// Põe um nó no topo da pilha de undo.
+void empilhar_no(Tabuleiro *t, NoPilha *novo) {
+    novo->anterior = NULL;
+    novo->proximo = t->pilha_desfazer;  // empilha
+    if (t->pilha_desfazer) t->pilha_desfazer->anterior = novo;
+    else t->fundo_desfazer = novo;
+    t->pilha_desfazer = novo;
+
+    t->bytes_desfazer += sizeof(NoPilha);
+    if (novo->inicio_lote) t->lotes_desfazer++;
+    aplicar_limite_desfazer(t);
+}
+
+//Guarda jogada antiga na Pilha do Undo
+void empilhar_undo(Tabuleiro *t, size_t x, size_t y, Celula valor_antigo, bool inicio_lote)
+{
+    NoPilha *novo = alocar(t, sizeof(NoPilha));
+    if (!novo) return;
+
+    novo->x = x;
+    novo->y = y;
+    novo->valor_antigo = valor_antigo;
+    novo->inicio_lote = inicio_lote;
+
+    empilhar_no(t, novo);
+}
+
+//Inicia um nó que inicia um lote das celulas reveladas
+void empilhar_inicio_lote(Tabuleiro *t) {
+    NoPilha *n = alocar(t, sizeof(NoPilha));
+    n->inicio_lote = true;
+    empilhar_no(t, n);
+    t->lotes_criados++;
+}
+
+// Solta a fila da revelação pendente sem mexer nas células (tabuleiro recomeçando ou indo embora).
+void descartar_revelacao(Tabuleiro *t) {
+    while (t->revelacao.inicio) {
+        NoFila *n = t->revelacao.inicio;
+        t->revelacao.inicio = n->proximo;
+        liberar(t, n);
+    }
+    t->revelacao = (RevelacaoPendente){0};
+}
+
+//Funcionalidade da bandeira
+void alternar_bandeira(Tabuleiro *t, size_t x, size_t y) {
+    Celula *cel = &CELULA_EM(t, x, y);
+
+    // Não pode alternar bandeira se a célula já está revelada
+    if (ESTA_REVELADA(*cel)) return;
+
+    uint64_t inicio = agora_ns();
+
+    // Cada bandeira é uma jogada: um lote com a célula antiga
+    empilhar_inicio_lote(t);
+    empilhar_undo(t, x, y, *cel, false);
+
+    Celula novo = *cel;
+    if (TEM_BANDEIRA(*cel)) {
+        // Remove bandeira da lista
+        lista_dupla_remover(t, x, y);
+        DEFINIR_BANDEIRA(novo, false);
+    } else {
+        // Coloca bandeira na lista
+        lista_dupla_adicionar(t, x, y);
+        DEFINIR_BANDEIRA(novo, true);
+    }
+    escrever_celula(t, x, y, novo);
+
+    registrar_tempo(t, OP_BANDEIRA, inicio, 1);
+}
+
+// --- LÓGICA DO JOGO ---
+
+// Lê input do usuário removendo newline. Devolve false no fim da entrada, quando não veio nada;
+// uma última linha sem newline ainda é devolvida e o fim só aparece na leitura seguinte.
+bool ler_entrada(char *buf, int tamanho) {
+    uint64_t inicio = agora_ns();
+    fflush(stdout);  // o prompt precisa sair mesmo quando o stdout não é de linha (thread de desenho)
+    bool leu = fgets(buf, tamanho, stdin) != NULL;
+    if (leu) {
+        buf[strcspn(buf, "\n")] = 0;
+    } else {
+        buf[0] = 0;
+    }
+    trace_span("esperar_entrada", inicio, "bytes", strlen(buf));
+    return leu;
+}
+
+// Próximo número do gerador do tabuleiro (splitmix64).
+uint64_t aleatorio(Tabuleiro *t) {
+    uint64_t z = (t->estado_aleatorio += 0x9e3779b97f4a7c15u);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+// Soma 'delta' ao número de minas vizinhas das células em volta de (x, y).
+// O número de uma mina nunca é lido, então não há teste de mina aqui.
+void somar_vizinhos(Tabuleiro *t, size_t x, size_t y, int delta) {
+    Celula *cel = &CELULA_EM(t, x, y);
+
+    // Outras topologias: a tabela de deslocamentos no miolo, a lista de vizinhos nas bordas
+    if (t->topologia != TOPOLOGIA_QUADRADA) {
+        if (no_miolo(t, x, y)) {
+            const ptrdiff_t *desloc = t->viz.desloc[y & 1];
+            for (unsigned j = 0; j < t->viz.qtd; j++) cel[desloc[j]] += delta;
+            return;
+        }
+        size_t vx[MAX_VIZINHOS], vy[MAX_VIZINHOS];
+        unsigned n = listar_vizinhos(t, x, y, vx, vy);
+        for (unsigned j = 0; j < n; j++) CELULA_EM(t, vx[j], vy[j]) += delta;
+        return;
+    }
+
+    // No miolo do tabuleiro os 8 vizinhos existem e dispensam o teste de borda
+    // (com ladrilhos, também precisam estar no mesmo ladrilho para o passo vertical valer)
+    bool miolo = x > 0 && y > 0 && x + 1 < t->largura && y + 1 < t->altura;
+#ifdef LADRILHOS
+    miolo = miolo && ((x + 1) & 7) > 1 && ((y + 1) & 7) > 1;
+#endif
+    if (miolo) {
+        Celula *cima = cel - PASSO_VERTICAL(t), *baixo = cel + PASSO_VERTICAL(t);
+        cima[-1] += delta;  cima[0] += delta;  cima[1] += delta;
+        cel[-1] += delta;                      cel[1] += delta;
+        baixo[-1] += delta; baixo[0] += delta; baixo[1] += delta;
+        return;
+    }
+    for (size_t j = 0; j < 8; j++) {
+        size_t nx = x + direcoes[j][0];
+        size_t ny = y + direcoes[j][1];
+        if (nx >= t->largura || ny >= t->altura) continue;
+        CELULA_EM(t, nx, ny) += delta;
+    }
+}
+
+// Refaz o número de minas vizinhas de todas as células a partir das minas (depois de sortear ou
+// carregar as minas de uma vez; o número de cada mina também conta, como em somar_vizinhos).
+// Grava os números 'numeros' (um byte por coluna) na linha y, preservando os outros bits.
+void gravar_numeros_linha(Tabuleiro *t, size_t y, const uint8_t *numeros) {
+    for (size_t x = 0, n; x < t->largura; x += n) {
+        Celula *p = &CELULA_EM(t, x, y);
+        n = trecho_contiguo(t, x);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            gravar_palavra(p + i, (ler_palavra(p + i) & ~BYTES_NUMERO) | ler_palavra(numeros + x + i));
+        for (; i < n; i++) p[i] = (Celula)((p[i] & ~MASCARA_MINAS) | numeros[x + i]);
+    }
+}
+
+// Números da faixa numa passada só. A primeira e a última linha são lidas pelas faixas vizinhas,
+// então, com mais de uma faixa, elas ficam em f->saida e quem chamou grava depois de todas.
+void recalcular_faixa(Faixa *f) {
+    Tabuleiro *t = f->t;
+    PassadaNumeros *pn = passada_iniciar(t);
+    bool guardar_bordas = *(const bool *)f->ctx;
+    uint8_t *bordas = guardar_bordas ? malloc(2 * t->largura) : NULL;
+    if (!pn || (guardar_bordas && !bordas)) {
+        perror("ERRO: malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    if (f->y0 > 0) passada_posicionar(pn, t, f->y0);
+    for (size_t y = f->y0; y < f->y1; y++) {
+        passada_linha(pn, t, y);
+        if (bordas && (y == f->y0 || y + 1 == f->y1))
+            memcpy(bordas + (y == f->y0 ? 0 : t->largura), pn->numeros, t->largura);
+        else
+            gravar_numeros_linha(t, y, pn->numeros);
+    }
+    f->saida = bordas;
+}
+
+void recalcular_numeros(Tabuleiro *t) {
+    if (!numeros_em_lote(t)) {
+        for (size_t y = 0; y < t->altura; y++)
+            for (size_t x = 0; x < t->largura; x++) CELULA_EM(t, x, y) &= (Celula)~MASCARA_MINAS;
+        for (size_t y = 0; y < t->altura; y++)
+            for (size_t x = 0; x < t->largura; x++)
+                if (EH_MINA(CELULA_EM(t, x, y))) somar_vizinhos(t, x, y, 1);
+        return;
+    }
+
+    // Cada faixa na CPU que a tocou primeiro (ver preparar_celulas)
+    Faixa faixas[MAX_FAIXAS];
+    bool guardar_bordas = qtd_faixas(t) > 1;
+    size_t qtd = rodar_em_faixas(t, recalcular_faixa, &guardar_bordas, faixas);
+    for (size_t i = 0; i < qtd; i++) {
+        uint8_t *bordas = faixas[i].saida;
+        if (!bordas) continue;
+        gravar_numeros_linha(t, faixas[i].y0, bordas);
+        gravar_numeros_linha(t, faixas[i].y1 - 1, bordas + t->largura);
+        free(bordas);
+    }
+}
+
+// Índice aleatório em [0, total): multiplica em vez de dividir (32 bits aleatórios * total) >> 32.
+size_t celula_aleatoria(Tabuleiro *t, size_t total) {
+    return (size_t)(((aleatorio(t) >> 32) * total) >> 32);
+}
+
+// Área protegida do primeiro clique: o 3x3 em volta de (x0, y0), ou só a célula se não sobrar
+// espaço para as minas. area = {x_min, x_max, y_min, y_max}.
+void calcular_area_protegida(const Tabuleiro *t, size_t x0, size_t y0, size_t area[4]) {
+    area[0] = x0 > 0 ? x0 - 1 : 0;
+    area[1] = x0 + 1 < t->largura ? x0 + 1 : x0;
+    area[2] = y0 > 0 ? y0 - 1 : 0;
+    area[3] = y0 + 1 < t->altura ? y0 + 1 : y0;
+    if (t->largura * t->altura - (area[1] - area[0] + 1) * (area[3] - area[2] + 1) < t->qtd_minas) {
+        area[0] = area[1] = x0;
+        area[2] = area[3] = y0;
+    }
+}
+
+bool dentro_da_area(const size_t area[4], size_t x, size_t y) {
+    return x >= area[0] && x <= area[1] && y >= area[2] && y <= area[3];
+}
+
+// Sorteia qtd_minas minas fora de 'area' (NULL = tabuleiro todo) e soma os números em volta.
+// Com muitas minas, uma passada no fim (recalcular_numeros) sai mais barata que somar_vizinhos
+// espalhado pela memória a cada mina.
+void distribuir_minas(Tabuleiro *t, const size_t *area) {
+    size_t total = t->largura * t->altura;
+    bool lote = numeros_em_lote(t) && t->qtd_minas >= total / MINAS_POR_CELULA_LOTE;
+    for (size_t i = 0; i < t->qtd_minas; i++) {
+        size_t x, y;
+        do {
+            size_t idx = celula_aleatoria(t, total);
+            x = idx % t->largura;
+            y = idx / t->largura;
+        } while (EH_MINA(CELULA_EM(t, x, y)) || (area && dentro_da_area(area, x, y)));
+
+        DEFINIR_MINA(CELULA_EM(t, x, y), true);
+        if (!lote) somar_vizinhos(t, x, y, 1);
+    }
+    if (lote) recalcular_numeros(t);
+}
+
+// Inicializa o tabuleiro e distribui minas.
+void iniciar_jogo(Tabuleiro *t) {
+    uint64_t inicio = agora_ns();
+    t->celulas_reveladas = 0;
+    t->inicio_bandeiras = NULL;
+    t->qtd_bandeiras = 0;
+    t->pilha_desfazer = NULL;
+    t->fundo_desfazer = NULL;
+    t->lotes_desfazer = 0;
+    t->bytes_desfazer = 0;
+    t->lotes_descartados = 0;
+    t->lotes_criados = 0;
+    t->estado_aleatorio = t->semente;
+    descartar_revelacao(t);
+
+    if (!preparar_celulas(t)) {
+        perror("ERRO: malloc");
+        exit(EXIT_FAILURE);
+    }
+    t->hash = 0;
+    bits_alocar(t);
+    montar_vizinhanca(t);
+
+    distribuir_minas(t, NULL);
+    t->primeiro_clique_pendente = true;
+    t->jogada_protecao = SIZE_MAX;
+    t->candidatos_sem_chute = 0;
+
+    registrar_tempo(t, OP_GERAR, inicio, t->largura * t->altura);
+}
+
+// Troca a mina de (x, y) por uma célula livre sorteada fora das 'qtd' células protegidas.
+void mover_mina_para_fora(Tabuleiro *t, size_t x, size_t y, const size_t *px, const size_t *py, size_t qtd) {
+    size_t total = t->largura * t->altura, nx, ny;
+    bool protegida;
+    do {
+        size_t idx = celula_aleatoria(t, total);
+        nx = idx % t->largura;
+        ny = idx / t->largura;
+        protegida = false;
+        for (size_t i = 0; i < qtd && !protegida; i++) protegida = px[i] == nx && py[i] == ny;
+    } while (EH_MINA(CELULA_EM(t, nx, ny)) || protegida);
+
+    DEFINIR_MINA(CELULA_EM(t, x, y), false);
+    somar_vizinhos(t, x, y, -1);
+    DEFINIR_MINA(CELULA_EM(t, nx, ny), true);
+    somar_vizinhos(t, nx, ny, 1);
+}
+
+// Primeiro revelar: tira as minas da célula (x0, y0) e dos vizinhos, levando cada uma para
+// uma célula livre fora dessa área. Só os números em volta das minas movidas são refeitos.
+void proteger_primeiro_clique(Tabuleiro *t, size_t x0, size_t y0) {
+    uint64_t inicio = agora_ns();
+    size_t total = t->largura * t->altura;
+    if (t->qtd_minas >= total) return;  // tabuleiro só de minas: não há o que proteger
+
+    // Fora da grade quadrada a área é a vizinhança da topologia, não um retângulo
+    if (t->topologia != TOPOLOGIA_QUADRADA) {
+        size_t px[MAX_VIZINHOS + 1], py[MAX_VIZINHOS + 1];
+        size_t qtd = listar_vizinhos(t, x0, y0, px, py), movidas = 0;
+        px[qtd] = x0;
+        py[qtd++] = y0;
+        if (total - qtd < t->qtd_minas) {
+            px[0] = x0;
+            py[0] = y0;
+            qtd = 1;
+        }
+        for (size_t i = 0; i < qtd; i++) {
+            if (!EH_MINA(CELULA_EM(t, px[i], py[i]))) continue;
+            mover_mina_para_fora(t, px[i], py[i], px, py, qtd);
+            movidas++;
+        }
+        trace_span("proteger_primeiro_clique", inicio, "minas_movidas", movidas);
+        return;
+    }
+
+    size_t area[4];
+    calcular_area_protegida(t, x0, y0, area);
+
+    size_t movidas = 0;
+    for (size_t y = area[2]; y <= area[3]; y++) {
+        for (size_t x = area[0]; x <= area[1]; x++) {
+            if (!EH_MINA(CELULA_EM(t, x, y))) continue;
+
+            size_t nx, ny;
+            do {
+                size_t idx = celula_aleatoria(t, total);
+                nx = idx % t->largura;
+                ny = idx / t->largura;
+            } while (EH_MINA(CELULA_EM(t, nx, ny)) || dentro_da_area(area, nx, ny));
+
+            DEFINIR_MINA(CELULA_EM(t, x, y), false);
+            somar_vizinhos(t, x, y, -1);
+            DEFINIR_MINA(CELULA_EM(t, nx, ny), true);
+            somar_vizinhos(t, nx, ny, 1);
+            movidas++;
+        }
+    }
+
+    trace_span("proteger_primeiro_clique", inicio, "minas_movidas", movidas);
+}
+
+// --- GERADOR SEM CHUTE ---
+
+// Resolvedor determinístico sobre um tabuleiro de rascunho. Usa os próprios bits da célula:
+// REVELADA = aberta pela lógica, BANDEIRA = mina deduzida. Só faz deduções certas, então um
+// tabuleiro que ele termina nunca exige chute.
+typedef struct {
+    Tabuleiro r;        // rascunho: mesmas dimensões, células próprias
+    size_t *fila;       // células a reexaminar (anel; cada célula entra no máximo uma vez)
+    uint8_t *na_fila;
+    size_t inicio_fila, qtd_fila;
+    size_t *pilha;      // aberturas em cascata
+    size_t reveladas, bandeiras;
+} Resolvedor;
+
+bool resolvedor_criar(Resolvedor *s, const Tabuleiro *t) {
+    size_t total = t->largura * t->altura;
+    *s = (Resolvedor){0};
+    s->r.largura = t->largura;
+    s->r.altura = t->altura;
+    s->r.qtd_minas = t->qtd_minas;
+    s->r.celulas = malloc(CELULAS_ALOCADAS(&s->r) * sizeof(Celula));
+    s->fila = malloc(total * sizeof(size_t));
+    s->na_fila = malloc(total);
+    s->pilha = malloc(total * sizeof(size_t));
+    bits_alocar(&s->r);
+    return s->r.celulas && s->fila && s->na_fila && s->pilha;
+}
+
+void resolvedor_liberar(Resolvedor *s) {
+    free(s->r.celulas);
+    free(s->r.bits_bandeira);
+    free(s->r.bits_revelada);
+    free(s->r.linhas_mudadas);
+    free(s->fila);
+    free(s->na_fila);
+    free(s->pilha);
+}
+
+// Coloca a célula e seus vizinhos na fila de reexame.
+void resolvedor_avisar_vizinhos(Resolvedor *s, size_t x, size_t y) {
+    size_t total = s->r.largura * s->r.altura;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            size_t nx = x + dx, ny = y + dy;
+            if (nx >= s->r.largura || ny >= s->r.altura) continue;
+            size_t idx = ny * s->r.largura + nx;
+            if (s->na_fila[idx] || !ESTA_REVELADA(CELULA_EM(&s->r, nx, ny))) continue;
+            s->na_fila[idx] = 1;
+            s->fila[(s->inicio_fila + s->qtd_fila++) % total] = idx;
+        }
+    }
+}
+
+// Abre uma célula segura; zeros abrem os vizinhos em cascata.
+void resolvedor_abrir(Resolvedor *s, size_t x, size_t y) {
+    Celula *c = &CELULA_EM(&s->r, x, y);
+    if (ESTA_REVELADA(*c) || TEM_BANDEIRA(*c)) return;
+
+    size_t topo = 0;
+    DEFINIR_REVELADA(*c, true);
+    bits_escrever(&s->r, s->r.bits_revelada, x, y, true);
+    s->pilha[topo++] = y * s->r.largura + x;
+
+    while (topo > 0) {
+        size_t idx = s->pilha[--topo];
+        size_t cx = idx % s->r.largura, cy = idx / s->r.largura;
+        s->reveladas++;
+        resolvedor_avisar_vizinhos(s, cx, cy);
+        if (NUM_MINAS(CELULA_EM(&s->r, cx, cy)) != 0) continue;
+
+        for (size_t j = 0; j < 8; j++) {
+            size_t nx = cx + direcoes[j][0];
+            size_t ny = cy + direcoes[j][1];
+            if (nx >= s->r.largura || ny >= s->r.altura) continue;
+            Celula *v = &CELULA_EM(&s->r, nx, ny);
+            if (ESTA_REVELADA(*v) || TEM_BANDEIRA(*v)) continue;
+            DEFINIR_REVELADA(*v, true);
+            bits_escrever(&s->r, s->r.bits_revelada, nx, ny, true);
+            s->pilha[topo++] = ny * s->r.largura + nx;
+        }
+    }
+}
+
+void resolvedor_marcar(Resolvedor *s, size_t x, size_t y) {
+    Celula *c = &CELULA_EM(&s->r, x, y);
+    if (TEM_BANDEIRA(*c)) return;
+    DEFINIR_BANDEIRA(*c, true);
+    bits_escrever(&s->r, s->r.bits_bandeira, x, y, true);
+    s->bandeiras++;
+    resolvedor_avisar_vizinhos(s, x, y);
+}
+
+// Vizinhos ainda desconhecidos de um número (índices em 'lista') e quantas minas faltam entre eles.
+size_t resolvedor_incognitas(const Resolvedor *s, size_t x, size_t y, size_t lista[8], int *faltam) {
+    size_t qtd = 0;
+    int marcadas = 0;
+    for (size_t j = 0; j < 8; j++) {
+        size_t nx = x + direcoes[j][0];
+        size_t ny = y + direcoes[j][1];
+        if (nx >= s->r.largura || ny >= s->r.altura) continue;
+        Celula v = CELULA_EM(&s->r, nx, ny);
+        if (TEM_BANDEIRA(v)) marcadas++;
+        else if (!ESTA_REVELADA(v)) lista[qtd++] = ny * s->r.largura + nx;
+    }
+    *faltam = (int)NUM_MINAS(CELULA_EM(&s->r, x, y)) - marcadas;
+    return qtd;
+}
+
+bool lista_contem(const size_t *lista, size_t qtd, size_t valor) {
+    for (size_t i = 0; i < qtd; i++)
+        if (lista[i] == valor) return true;
+    return false;
+}
+
+// Aplica a 'diferenca' a dedução: abre todas (seguras) ou marca todas (minas).
+void resolvedor_aplicar(Resolvedor *s, const size_t *lista, size_t qtd, bool minas) {
+    for (size_t i = 0; i < qtd; i++) {
+        size_t x = lista[i] % s->r.largura, y = lista[i] / s->r.largura;
+        if (minas) resolvedor_marcar(s, x, y);
+        else resolvedor_abrir(s, x, y);
+    }
+}
+
+// Incógnitas em volta de (x, y) contadas pelos bitboards, sem montar a lista.
+size_t resolvedor_qtd_incognitas(const Resolvedor *s, size_t x, size_t y, unsigned *marcadas) {
+    *marcadas = contar_vizinhos_bits(&s->r, s->r.bits_bandeira, x, y);
+    return vizinhos_no_tabuleiro(&s->r, x, y) - contar_vizinhos_bits(&s->r, s->r.bits_revelada, x, y) - *marcadas;
+}
+
+// Bloco 3x3 centrado na casa k de uma janela 5x5 (cortado nas bordas da janela).
+uint32_t mascara_3x3(unsigned k) {
+    uint32_t linha = ((7u << (k % 5)) >> 1) & 31;
+    uint32_t meio = linha << (5 * (k / 5));
+    return (meio | meio << 5 | meio >> 5) & 0x1ffffff;
+}
+
+// Examina um número revelado. Regras: número satisfeito, número saturado e subconjunto
+// (as incógnitas de A contidas nas de B decidem a diferença B \ A). Tudo é decidido sobre
+// máscaras da janela 5x5 em volta de A; listas de índices só são montadas para aplicar.
+bool resolvedor_examinar(Resolvedor *s, size_t idx) {
+    size_t x = idx % s->r.largura, y = idx / s->r.largura;
+    uint32_t reveladas = janela_5x5(&s->r, s->r.bits_revelada, x, y);
+    uint32_t marcadas = janela_5x5(&s->r, s->r.bits_bandeira, x, y);
+    uint32_t incognitas = ~(reveladas | marcadas) & janela_5x5_dentro(&s->r, x, y);
+
+    // A maioria dos números já está resolvida: sem incógnitas, nada a fazer
+    uint32_t vizinhos_a = mascara_3x3(12) & ~(1u << 12);
+    uint32_t inc_a = incognitas & vizinhos_a;
+    if (inc_a == 0) return false;
+    size_t qtd_a = (size_t)__builtin_popcount(inc_a);
+    int faltam_a = (int)NUM_MINAS(CELULA_EM(&s->r, x, y)) - __builtin_popcount(marcadas & vizinhos_a);
+
+    size_t a[8];
+    if (faltam_a == 0 || faltam_a == (int)qtd_a) {
+        resolvedor_incognitas(s, x, y, a, &faltam_a);
+        resolvedor_aplicar(s, a, qtd_a, faltam_a != 0);
+        return true;
+    }
+
+    // Números que podem dividir incógnitas com este estão a até 2 casas. As incógnitas de
+    // A estão todas na janela, então A ⊆ B se decide na janela mesmo que B passe dela.
+    for (unsigned k = 0; k < 25; k++) {
+        if (k == 12 || !(reveladas >> k & 1)) continue;
+        if (inc_a & ~(incognitas & mascara_3x3(k))) continue;
+
+        size_t bx = x + k % 5 - 2, by = y + k / 5 - 2;
+        unsigned marcadas_b;
+        size_t qtd_b = resolvedor_qtd_incognitas(s, bx, by, &marcadas_b);
+        if (qtd_b <= qtd_a) continue;
+        int faltam_b = (int)NUM_MINAS(CELULA_EM(&s->r, bx, by)) - (int)marcadas_b;
+        size_t qtd_dif = qtd_b - qtd_a;
+        if (faltam_b != faltam_a && faltam_b - faltam_a != (int)qtd_dif) continue;
+
+        size_t b[8], diferenca[8], n = 0;
+        resolvedor_incognitas(s, bx, by, b, &faltam_b);
+        resolvedor_incognitas(s, x, y, a, &faltam_a);
+        for (size_t i = 0; i < qtd_b; i++)
+            if (!lista_contem(a, qtd_a, b[i])) diferenca[n++] = b[i];
+        resolvedor_aplicar(s, diferenca, n, faltam_b != faltam_a);
+        return true;
+    }
+    return false;
+}
+
+// Tenta resolver o rascunho a partir do clique em (x0, y0) sem nenhum chute.
+bool resolvedor_resolver(Resolvedor *s, size_t x0, size_t y0) {
+    size_t total = s->r.largura * s->r.altura;
+    size_t seguras = total - s->r.qtd_minas;
+    s->inicio_fila = s->qtd_fila = 0;
+    s->reveladas = s->bandeiras = 0;
+    memset(s->na_fila, 0, total);
+    bits_zerar(&s->r);
+
+    resolvedor_abrir(s, x0, y0);
+    for (;;) {
+        while (s->qtd_fila > 0 && s->reveladas < seguras) {
+            size_t idx = s->fila[s->inicio_fila];
+            s->inicio_fila = (s->inicio_fila + 1) % total;
+            s->qtd_fila--;
+            s->na_fila[idx] = 0;
+            // Um número que deduziu algo volta à fila pelos vizinhos que mudaram
+            resolvedor_examinar(s, idx);
+        }
+        if (s->reveladas == seguras) return true;
+
+        // Contagem global: sem minas restantes, todo o resto é seguro
+        if (s->bandeiras != s->r.qtd_minas) return false;
+        for (size_t y = 0; y < s->r.altura; y++)
+            for (size_t x = 0; x < s->r.largura; x++)
+                if (!ESTA_REVELADA(CELULA_EM(&s->r, x, y)) && !TEM_BANDEIRA(CELULA_EM(&s->r, x, y)))
+                    resolvedor_abrir(s, x, y);
+    }
+}
+
+// Candidato 'indice': sorteio próprio (derivado da base) com a área do clique livre.
+void gerar_candidato(Tabuleiro *r, uint64_t base, size_t indice, const size_t area[4]) {
+    memset(r->celulas, 0, CELULAS_ALOCADAS(r) * sizeof(Celula));
+    r->estado_aleatorio = base ^ (indice * 0xd1b54a32d192ed03u);
+    distribuir_minas(r, area);
+}
+
+// Busca compartilhada entre as threads. Cada uma pega o próximo índice; o menor índice que
+// resolve vence, então o tabuleiro escolhido não depende de quantas threads rodaram.
+typedef struct {
+    const Tabuleiro *t;
+    size_t x0, y0;
+    size_t area[4];
+    uint64_t base;
+    atomic_size_t proximo;
+    atomic_size_t melhor;      // menor candidato resolvido até agora
+    atomic_size_t avaliados;
+} BuscaSemChute;
+
+void *trabalhador_sem_chute(void *arg) {
+    BuscaSemChute *b = arg;
+    Resolvedor s;
+    if (!resolvedor_criar(&s, b->t)) {
+        resolvedor_liberar(&s);
+        return NULL;
+    }
+
+    for (;;) {
+        size_t i = atomic_fetch_add(&b->proximo, 1);
+        if (i >= atomic_load(&b->melhor)) break;
+
+        gerar_candidato(&s.r, b->base, i, b->area);
+        atomic_fetch_add_explicit(&b->avaliados, 1, memory_order_relaxed);
+        if (!resolvedor_resolver(&s, b->x0, b->y0)) continue;
+
+        size_t atual = atomic_load(&b->melhor);
+        while (i < atual && !atomic_compare_exchange_weak(&b->melhor, &atual, i))
+            ;
+    }
+
+    resolvedor_liberar(&s);
+    return NULL;
+}
+
+// Quantas threads o gerador usa (uma por núcleo, no máximo 64).
+size_t threads_do_gerador(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > 64) n = 64;
+    return (size_t)n;
+}
+
+// Troca o tabuleiro por um que se resolve sem chute a partir de (x0, y0).
+// Devolve false se nenhum candidato serviu (o tabuleiro atual fica como está).
+bool gerar_sem_chute(Tabuleiro *t, size_t x0, size_t y0) {
+    if (t->qtd_minas >= t->largura * t->altura) return false;
+
+    uint64_t inicio = agora_ns();
+    BuscaSemChute b = { .t = t, .x0 = x0, .y0 = y0, .base = t->estado_aleatorio };
+    calcular_area_protegida(t, x0, y0, b.area);
+    atomic_init(&b.proximo, 0);
+    atomic_init(&b.melhor, LIMITE_CANDIDATOS_SEM_CHUTE);
+    atomic_init(&b.avaliados, 0);
+
+    // A thread atual também trabalha; as outras entram se houver mais núcleos
+    size_t qtd_threads = threads_do_gerador();
+    pthread_t threads[64];
+    size_t criadas = 0;
+    for (size_t i = 1; i < qtd_threads; i++)
+        if (pthread_create(&threads[criadas], NULL, trabalhador_sem_chute, &b) == 0) criadas++;
+    trabalhador_sem_chute(&b);
+    for (size_t i = 0; i < criadas; i++)
+        pthread_join(threads[i], NULL);
+
+    size_t melhor = atomic_load(&b.melhor);
+    trace_span("gerar_sem_chute", inicio, "candidatos_avaliados", atomic_load(&b.avaliados));
+    if (melhor >= LIMITE_CANDIDATOS_SEM_CHUTE) return false;
+
+    // Refaz o vencedor direto no tabuleiro do jogo; bandeiras postas antes do clique continuam
+    gerar_candidato(t, b.base, melhor, b.area);
+    for (NoListaDupla *n = t->inicio_bandeiras; n; n = n->proximo)
+        DEFINIR_BANDEIRA(CELULA_EM(t, n->x, n->y), true);
+    t->candidatos_sem_chute = melhor + 1;
+    t->ns_sem_chute = agora_ns() - inicio;
+    registrar_tempo(t, OP_SEM_CHUTE, inicio, melhor + 1);
+    return true;
+}
+
+// Prepara o tabuleiro para o primeiro revelar em (x, y): sem chute, ou só tirando as minas de perto.
+void preparar_primeiro_clique(Tabuleiro *t, size_t x, size_t y) {
+    t->primeiro_clique_pendente = false;
+    t->jogada_protecao = t->linha.posicao;
+    // O gerador sem chute usa o resolvedor da grade quadrada
+    if (t->sem_chute && t->topologia == TOPOLOGIA_QUADRADA && gerar_sem_chute(t, x, y)) return;
+    proteger_primeiro_clique(t, x, y);
+}
+
+// --- DESENHO DA TELA ---
+
+// Garante espaço para mais 'extra' bytes no quadro.
+void quadro_reservar(Quadro *q, size_t extra) {
+    if (q->tamanho + extra <= q->capacidade) return;
+
+    size_t nova = q->capacidade ? q->capacidade : 4096;
+    while (nova < q->tamanho + extra) nova *= 2;
+
+    q->dados = realloc(q->dados, nova);
+    if (!q->dados) {
+        perror("ERRO: realloc");
+        exit(EXIT_FAILURE);
+    }
+    q->capacidade = nova;
+}
+
+// Acrescenta texto formatado (estilo printf) ao quadro.
+void quadro_anexar(Quadro *q, const char *formato, ...) {
+    va_list args;
+    va_start(args, formato);
+    int n = vsnprintf(NULL, 0, formato, args);
+    va_end(args);
+    if (n <= 0) return;
+
+    quadro_reservar(q, (size_t)n + 1);
+    va_start(args, formato);
+    vsnprintf(q->dados + q->tamanho, (size_t)n + 1, formato, args);
+    va_end(args);
+    q->tamanho += (size_t)n;
+}
+
+// Acrescenta 'n' vezes o caractere c ao quadro.
+void quadro_repetir(Quadro *q, char c, size_t n) {
+    quadro_reservar(q, n);
+    memset(q->dados + q->tamanho, c, n);
+    q->tamanho += n;
+}
+
+// Escreve 'tamanho' bytes no descritor, tratando escritas parciais.
+void escrever_tudo(int fd, const char *dados, size_t tamanho) {
+    size_t enviado = 0;
+    while (enviado < tamanho) {
+        ssize_t n = write(fd, dados + enviado, tamanho - enviado);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        enviado += (size_t)n;
+    }
+}
+
+// Escreve todo o quadro no descritor e esvazia o quadro.
+void quadro_enviar(Quadro *q, int fd) {
+    escrever_tudo(fd, q->dados, q->tamanho);
+    q->tamanho = 0;
+}
+
+// Escreve a célula colorida em 'destino' (mínimo TAM_MAX_CELULA bytes) e devolve o tamanho.
+// 'destaque' inverte as cores, usado para mostrar o cursor do modo teclado.
+size_t formatar_celula(char *destino, Celula c, bool destaque) {
+    static const char *const cores_numeros[] = {
+        "", "\x1b[94m", "\x1b[32m", "\x1b[91m", "\x1b[34m",
+        "\x1b[31m", "\x1b[36m", "\x1b[30m", "\x1b[90m",
+    };
+    char *p = destino;
+
+    // Macro local para copiar literais sem passar por printf
+    #define ESCREVER(texto) do { \
+        memcpy(p, (texto), sizeof(texto) - 1); \
+        p += sizeof(texto) - 1; \
+    } while (0)
+
+    ESCREVER("\x1b[1m");
+    if (destaque) ESCREVER("\x1b[7m");
+
+    if (ESTA_REVELADA(c)) {
+        ESCREVER("\x1b[47m"); // Fundo claro
+
+        if (EH_MINA(c)) {
+            ESCREVER("\x1b[31m#");
+        } else if (NUM_MINAS(c) != 0) {
+            // Acima de 9 (só no 3D) o número vira letra: A = 10 ... Q = 26
+            uint8_t num = NUM_MINAS(c);
+            const char *cor = cores_numeros[num <= 8 ? num : 1 + (num - 1) % 8];
+            size_t n = strlen(cor);
+            memcpy(p, cor, n);
+            p += n;
+            *p++ = (char)(num <= 9 ? '0' + num : 'A' + num - 10);
+        } else {
+            *p++ = ' ';
+        }
+
+    } else {
+        ESCREVER("\x1b[100m");
+        if (TEM_BANDEIRA(c)) {
+            ESCREVER("\x1b[91m!");
+        } else {
+            ESCREVER("\x1b[37m.");
+        }
+    }
+
+    ESCREVER(" \x1b[0m");
+    #undef ESCREVER
+
+    return (size_t)(p - destino);
+}
+
+// Acrescenta uma célula colorida ao quadro.
+void desenhar_celula(Quadro *q, Celula c, bool destaque) {
+    quadro_reservar(q, TAM_MAX_CELULA);
+    q->tamanho += formatar_celula(q->dados + q->tamanho, c, destaque);
+}
+
+//Desenha o tabuleiro completo no quadro. Se 'cursor' não for NULL, destaca aquela célula.
+//No hex as linhas ímpares saem meia célula à direita; no 3D uma linha separa as camadas.
+void desenhar_tabuleiro(Quadro *q, Tabuleiro *t, const size_t cursor[2]) {
+    bool hex = t->topologia == TOPOLOGIA_HEX;
+    size_t altura_camada = t->camadas > 1 ? t->altura_camada : t->altura;
+    size_t largura_borda = t->largura * 2 + 1 + hex;
+
+    quadro_anexar(q, "   X ");
+    for (size_t i = 0; i < t->largura; i++) {
+        size_t unidade = i % 10;
+        quadro_anexar(q, "%zu%c", unidade, " |"[unidade == 9]);
+    }
+    quadro_anexar(q, "\n Y\x1b[1;40;37m +");
+    quadro_repetir(q, '-', largura_borda);
+    quadro_anexar(q, "+ \x1b[0m\n");
+
+    for (size_t y = 0; y < t->altura; y++) {
+        if (y > 0 && y % altura_camada == 0) {
+            quadro_anexar(q, "  \x1b[1;40;37m +");
+            quadro_repetir(q, '-', largura_borda);
+            quadro_anexar(q, "+ \x1b[0m camada %zu\n", y / altura_camada);
+        }
+        quadro_anexar(q, "%2zu\x1b[1;40;37m |\x1b[%dm ",
+               y,
+               ESTA_REVELADA(CELULA_EM(t, 0, y)) ? 47 : 100
+        );
+        if (hex && (y & 1)) quadro_anexar(q, " ");
+
+        for (size_t x = 0; x < t->largura; x++) {
+            bool destaque = cursor && cursor[0] == x && cursor[1] == y;
+            desenhar_celula(q, CELULA_EM(t, x, y), destaque);
+        }
+
+        if (hex && !(y & 1)) quadro_anexar(q, "\x1b[40m ");
+        quadro_anexar(q, "\x1b[1;40;37m| \x1b[0m\n");
+    }
+
+    quadro_anexar(q, "  \x1b[1;40;37m +");
+    quadro_repetir(q, '-', largura_borda);
+    quadro_anexar(q, "+ \n\x1b[0m");
+}
+
+// Posição (contando de 1) da primeira célula no terminal, conforme desenhar_tabuleiro
+#define LINHA_PRIMEIRA_CELULA  3
+#define COLUNA_PRIMEIRA_CELULA 6
+
+// Linha do terminal da célula (x, y): no 3D cada camada tem uma linha separadora antes.
+size_t linha_da_celula(const Tabuleiro *t, size_t y) {
+    return LINHA_PRIMEIRA_CELULA + y + (t->camadas > 1 ? y / t->altura_camada : 0);
+}
+
+// Coluna do terminal da célula (x, y): no hex as linhas ímpares andam meia célula.
+size_t coluna_da_celula(const Tabuleiro *t, size_t x, size_t y) {
+    return COLUNA_PRIMEIRA_CELULA + 2 * x + (t->topologia == TOPOLOGIA_HEX && (y & 1));
+}
+
+// Redesenha só a célula (x, y) de uma tela já desenhada por desenhar_tabuleiro.
+void desenhar_celula_em(Quadro *q, const Tabuleiro *t, size_t x, size_t y, Celula c, bool destaque) {
+    quadro_anexar(q, "\x1b[%zu;%zuH", linha_da_celula(t, y), coluna_da_celula(t, x, y));
+    desenhar_celula(q, c, destaque);
+
+    // O espaço antes da primeira coluna acompanha a cor dela
+    if (x == 0) {
+        quadro_anexar(q, "\x1b[%zu;%dH\x1b[1;%dm%s\x1b[0m",
+                      linha_da_celula(t, y),
+                      COLUNA_PRIMEIRA_CELULA - 1,
+                      ESTA_REVELADA(c) ? 47 : 100,
+                      coluna_da_celula(t, 0, y) > COLUNA_PRIMEIRA_CELULA ? "  " : " ");
+    }
+}
+
+// Números do rodapé, copiados do tabuleiro. Formatar custa microssegundos de vsnprintf; quem só
+// publica um quadro (transmissao_publicar) copia os números e deixa o texto para outra thread.
+typedef struct {
+    size_t bandeiras;
+    size_t lotes_desfazer, bytes_desfazer, limite_lotes, limite_bytes, lotes_descartados;
+    size_t posicao, qtd_jogadas, checkpoints, bytes_checkpoints;
+    size_t candidatos_sem_chute;
+    uint64_t ns_sem_chute;
+} ContadoresRodape;
+
+ContadoresRodape contadores_rodape(const Tabuleiro *t) {
+    const LinhaDoTempo *l = &t->linha;
+    return (ContadoresRodape){
+        .bandeiras = t->qtd_bandeiras,
+        .lotes_desfazer = t->lotes_desfazer, .bytes_desfazer = t->bytes_desfazer,
+        .limite_lotes = t->limite_lotes, .limite_bytes = t->limite_bytes,
+        .lotes_descartados = t->lotes_descartados,
+        .posicao = l->posicao, .qtd_jogadas = l->qtd_jogadas,
+        .checkpoints = l->qtd_checkpoints - l->checkpoints_afinados, .bytes_checkpoints = l->bytes_checkpoints,
+        .candidatos_sem_chute = t->candidatos_sem_chute, .ns_sem_chute = t->ns_sem_chute,
+    };
+}
+
+void formatar_info_desfazer(Quadro *q, const ContadoresRodape *c) {
+    quadro_anexar(q, "Desfazer disponível: %zu jogadas (%.1f KiB)",
+                  c->lotes_desfazer, c->bytes_desfazer / 1024.0);
+    if (c->limite_lotes) quadro_anexar(q, " | limite %zu jogadas", c->limite_lotes);
+    if (c->limite_bytes) quadro_anexar(q, " | limite %.1f KiB", c->limite_bytes / 1024.0);
+    if (c->lotes_descartados) quadro_anexar(q, " | %zu descartadas", c->lotes_descartados);
+    quadro_anexar(q, "\n");
+
+    quadro_anexar(q, "Linha do tempo: jogada %zu de %zu | %zu checkpoints (%.1f KiB)\n",
+                  c->posicao, c->qtd_jogadas, c->checkpoints, c->bytes_checkpoints / 1024.0);
+}
+
+void formatar_rodape(Quadro *q, const ContadoresRodape *c) {
+    quadro_anexar(q, "--- Informações ---\n");
+    quadro_anexar(q, "Jogadas Feitas: %zu | Bandeiras Ativas: %zu\n",
+           c->posicao,
+           c->bandeiras
+    );
+    formatar_info_desfazer(q, c);
+    if (c->candidatos_sem_chute)
+        quadro_anexar(q, "Sem chute: tabuleiro do candidato %zu (%.1f ms)\n",
+                      c->candidatos_sem_chute, c->ns_sem_chute / 1e6);
+}
+
+// Linha do HUD com quantas jogadas ainda podem ser desfeitas e o limite da pilha.
+void desenhar_info_desfazer(Quadro *q, Tabuleiro *t) {
+    ContadoresRodape c = contadores_rodape(t);
+    formatar_info_desfazer(q, &c);
+}
+
+// Informações abaixo do tabuleiro (bandeiras, undo, linha do tempo, sem chute).
+void desenhar_rodape(Quadro *q, Tabuleiro *t) {
+    ContadoresRodape c = contadores_rodape(t);
+    formatar_rodape(q, &c);
+}
+
+// --- THREAD DE DESENHO (TRIPLO BUFFER) ---
+
+/*
+ * Com a saída num terminal, o loop de comandos não escreve mais a tela: atualizar_tela copia o
+ * estado visível para um quadro imutável e o publica num triplo buffer, e a thread de desenho
+ * formata e escreve. O texto comum (printf) vai para um stdout trocado (fopencookie) que só
+ * anexa numa fila em memória, sem limite; a thread pega a fila inteira de uma vez e a escreve
+ * na mesma ordem. Cada publicação deixa na fila um byte marcador, e a thread só desenha no
+ * marcador do quadro mais novo: se o terminal ficou para trás, os quadros intermediários são
+ * pulados. O motor nunca espera pela escrita, só pela trava da fila, que a thread segura o
+ * tempo de trocar dois ponteiros.
+ */
+#define MARCADOR_QUADRO '\0'   // nunca aparece no texto do jogo
+#define QUADRO_NOVO     4u      // bit em 'meio': o quadro do meio ainda não foi pego
+
+// Estado visível de uma atualização, copiado do tabuleiro; a thread só lê.
+typedef struct {
+    uint64_t numero;           // ordem de publicação (1, 2, 3...)
+    size_t largura, altura;
+    Topologia topologia;       // o desenho muda no hex e no 3D
+    size_t camadas, altura_camada;
+    Celula *celulas;           // no mesmo layout do tabuleiro (CELULA_EM)
+    size_t capacidade;
+    Quadro rodape;             // informações já formatadas
+    ContadoresRodape contadores; // transmissão: os números do rodapé, que a thread formata
+} QuadroTela;
+
+typedef struct {
+    QuadroTela quadros[3];
+    _Atomic unsigned meio;     // índice do quadro do meio | QUADRO_NOVO
+    unsigned escrita;          // só o loop de comandos mexe
+    unsigned leitura;          // só a thread de desenho mexe
+    // Texto impresso e marcadores, na ordem, esperando a thread
+    pthread_mutex_t trava;
+    pthread_cond_t tem_texto;
+    Quadro fila;
+    bool fechando;             // renderizador_encerrar: a thread sai quando a fila esvaziar
+    FILE *stdout_original;
+    int terminal;
+    pthread_t thread;
+    bool ativa;
+    uint64_t publicados;
+    // Escritos só pela thread; lidos depois do join
+    uint64_t desenhados, pulados, bytes_escritos, maximo_escrita_ns;
+} Renderizador;
+
+static Renderizador renderizador = {0};
+
+// Escrita do stdout trocado: anexa na fila e acorda a thread. Nunca bloqueia no terminal.
+ssize_t renderizador_anexar_texto(void *cookie, const char *dados, size_t tamanho) {
+    Renderizador *r = cookie;
+    pthread_mutex_lock(&r->trava);
+    quadro_reservar(&r->fila, tamanho);
+    memcpy(r->fila.dados + r->fila.tamanho, dados, tamanho);
+    r->fila.tamanho += tamanho;
+    pthread_cond_signal(&r->tem_texto);
+    pthread_mutex_unlock(&r->trava);
+    return (ssize_t)tamanho;
+}
+
+void *trabalhador_desenho(void *arg) {
+    Renderizador *r = arg;
+    Quadro saida = {0}, texto = {0};
+    uint64_t marcadores = 0;
+
+    for (;;) {
+        // Troca a fila inteira por um buffer vazio e escreve fora da trava
+        pthread_mutex_lock(&r->trava);
+        while (r->fila.tamanho == 0 && !r->fechando) pthread_cond_wait(&r->tem_texto, &r->trava);
+        Quadro pronto = r->fila;
+        r->fila = texto;
+        r->fila.tamanho = 0;
+        texto = pronto;
+        pthread_mutex_unlock(&r->trava);
+        if (texto.tamanho == 0) break;
+
+        char *p = texto.dados, *fim = texto.dados + texto.tamanho;
+        while (p < fim) {
+            char *marcador = memchr(p, MARCADOR_QUADRO, (size_t)(fim - p));
+            char *fim_texto = marcador ? marcador : fim;
+            escrever_tudo(r->terminal, p, (size_t)(fim_texto - p));
+            r->bytes_escritos += (size_t)(fim_texto - p);
+            if (!marcador) break;
+            p = marcador + 1;
+            marcadores++;
+
+            // Pega o quadro mais novo; se ele já é de um marcador adiante, este fica para trás
+            if (atomic_load(&r->meio) & QUADRO_NOVO)
+                r->leitura = atomic_exchange(&r->meio, r->leitura) & 3;
+            QuadroTela *f = &r->quadros[r->leitura];
+            if (f->numero != marcadores) {
+                r->pulados++;
+                continue;
+            }
+
+            Tabuleiro vista = {.largura = f->largura, .altura = f->altura, .celulas = f->celulas,
+                               .topologia = f->topologia, .camadas = f->camadas,
+                               .altura_camada = f->altura_camada};
+            quadro_anexar(&saida, "\x1b[H\x1b[2J");
+            desenhar_tabuleiro(&saida, &vista, NULL);
+            quadro_reservar(&saida, f->rodape.tamanho);
+            memcpy(saida.dados + saida.tamanho, f->rodape.dados, f->rodape.tamanho);
+            saida.tamanho += f->rodape.tamanho;
+
+            uint64_t inicio = agora_ns();
+            r->bytes_escritos += saida.tamanho;
+            quadro_enviar(&saida, r->terminal);
+            uint64_t duracao = agora_ns() - inicio;
+            trace_registrar("escrever_quadro", inicio, duracao, "quadro", f->numero);
+            if (duracao > r->maximo_escrita_ns) r->maximo_escrita_ns = duracao;
+            r->desenhados++;
+        }
+    }
+    free(saida.dados);
+    free(texto.dados);
+    return NULL;
+}
+
+// Troca o stdout por uma fila esvaziada pela thread de desenho. Só vale para terminal: arquivo
+// e pipe continuam recebendo cada tela, na ordem, como antes.
+void renderizador_iniciar(Renderizador *r) {
+    if (!isatty(STDOUT_FILENO)) return;
+
+    fflush(stdout);
+    *r = (Renderizador){.meio = 1, .escrita = 0, .leitura = 2, .terminal = STDOUT_FILENO};
+    pthread_mutex_init(&r->trava, NULL);
+    pthread_cond_init(&r->tem_texto, NULL);
+    FILE *texto = fopencookie(r, "w", (cookie_io_functions_t){ .write = renderizador_anexar_texto });
+    if (!texto || pthread_create(&r->thread, NULL, trabalhador_desenho, r) != 0) {
+        if (texto) fclose(texto);
+        pthread_mutex_destroy(&r->trava);
+        pthread_cond_destroy(&r->tem_texto);
+        return;
+    }
+    r->stdout_original = stdout;
+    stdout = texto;
+    r->ativa = true;
+}
+
+// Devolve o stdout ao terminal depois que a thread escreveu tudo o que estava na fila.
+void renderizador_encerrar(void) {
+    Renderizador *r = &renderizador;
+    if (!r->ativa) return;
+    r->ativa = false;
+
+    fclose(stdout);
+    stdout = r->stdout_original;
+    pthread_mutex_lock(&r->trava);
+    r->fechando = true;
+    pthread_cond_signal(&r->tem_texto);
+    pthread_mutex_unlock(&r->trava);
+    pthread_join(r->thread, NULL);
+
+    free(r->fila.dados);
+    pthread_mutex_destroy(&r->trava);
+    pthread_cond_destroy(&r->tem_texto);
+    for (size_t i = 0; i < 3; i++) {
+        free(r->quadros[i].celulas);
+        free(r->quadros[i].rodape.dados);
+    }
+
+    if (r->publicados)
+        printf("Tela: %llu quadros, %llu desenhados, %llu pulados pelo terminal lento, "
+               "%.1f KiB escritos, escrita máx %.2f ms\n",
+               (unsigned long long)r->publicados, (unsigned long long)r->desenhados,
+               (unsigned long long)r->pulados, r->bytes_escritos / 1024.0,
+               r->maximo_escrita_ns / 1e6);
+}
+
+// Copia o estado visível do tabuleiro para o quadro. Devolve quantos bytes foram copiados.
+size_t copiar_quadro_tela(QuadroTela *f, Tabuleiro *t) {
+    size_t n = CELULAS_ALOCADAS(t);
+    if (n > f->capacidade) {
+        f->celulas = realloc(f->celulas, n);
+        if (!f->celulas) {
+            perror("ERRO: realloc");
+            exit(EXIT_FAILURE);
+        }
+        f->capacidade = n;
+    }
+    memcpy(f->celulas, t->celulas, n);
+    f->largura = t->largura;
+    f->altura = t->altura;
+    f->topologia = t->topologia;
+    f->camadas = t->camadas;
+    f->altura_camada = t->altura_camada;
+    f->rodape.tamanho = 0;
+    desenhar_rodape(&f->rodape, t);
+    return n + f->rodape.tamanho;
+}
+
+// Copia o estado visível para o quadro de escrita, publica e deixa o marcador no texto.
+// Devolve quantos bytes foram copiados.
+size_t renderizador_publicar(Renderizador *r, Tabuleiro *t) {
+    QuadroTela *f = &r->quadros[r->escrita];
+    size_t bytes = copiar_quadro_tela(f, t);
+    f->numero = ++r->publicados;
+    r->escrita = atomic_exchange(&r->meio, r->escrita | QUADRO_NOVO) & 3;
+
+    // O texto já impresso vai antes do quadro; o marcador diz onde ele entra
+    fflush(stdout);
+    char marcador = MARCADOR_QUADRO;
+    renderizador_anexar_texto(r, &marcador, 1);
+    return bytes;
+}
+
+// --- ESPECTADORES (UM QUADRO CODIFICADO, VÁRIOS SOCKETS) ---
+
+/*
+ * --espectadores CAMINHO abre um socket Unix onde vários terminais acompanham a partida ao vivo
+ * (--assistir CAMINHO, ou nc -U). O loop de comandos só copia o estado visível para um triplo
+ * buffer, como faz para a thread de desenho, mas só as linhas que mudaram desde a última vez
+ * que aquele quadro foi escrito (Tabuleiro.linhas_mudadas). A thread de transmissão compara o quadro novo com o
+ * último que codificou e escreve uma vez só o que mudou: posição do cursor mais a célula, o
+ * mesmo texto que o modo teclado usa, e o rodapé. Esse texto vira um bloco com contagem de
+ * referências que entra na fila de todos os espectadores; cada um recebe os blocos da sua fila
+ * num writev que aponta direto para eles, sem cópia por espectador.
+ * Quem deixa a fila encher perde as diferenças pendentes e recebe o próximo quadro inteiro; quem
+ * passa TEMPO_MAX_ESPECTADOR_NS sem aceitar um byte é desconectado. O jogador nunca espera.
+ */
+#define MAX_ESPECTADORES        1024
+#define FILA_ESPECTADOR         16      // blocos na fila antes de pular para o quadro inteiro
+#define TEMPO_MAX_ESPECTADOR_NS 5000000000ull
+#define PRIORIDADE_TRANSMISSAO  10      // nice da thread de transmissão
+#define TEMPO_DESPEDIDA_NS      1000000000ull
+
+// Texto codificado uma vez e compartilhado pelas filas. Só a thread de transmissão mexe nas
+// referências, então elas não precisam ser atômicas.
+typedef struct {
+    size_t referencias;
+    Quadro texto;
+} BlocoTransmissao;
+
+typedef struct {
+    int fd;
+    BlocoTransmissao *fila[FILA_ESPECTADOR];   // circular
+    size_t inicio_fila, qtd_fila;
+    size_t enviado;             // bytes do primeiro bloco da fila que já saíram
+    bool precisa_inteiro;       // o próximo bloco tem que ser um quadro inteiro
+    uint64_t ultimo_progresso_ns;
+} Espectador;
+
+typedef struct {
+    QuadroTela quadros[3];
+    _Atomic unsigned meio;      // índice do quadro do meio | QUADRO_NOVO
+    unsigned escrita;           // só o loop de comandos mexe
+    unsigned leitura;           // só a thread de transmissão mexe
+    int socket;
+    int acordar[2];             // pipe que tira a thread do poll quando há quadro novo
+    atomic_bool aviso_pendente; // já há um byte no pipe que a thread ainda não consumiu
+    const char *caminho;
+    pthread_t thread;
+    bool ativa;
+    atomic_bool parar;
+    uint64_t publicados, maximo_publicar_ns;
+    // Só do loop de comandos: as linhas que cada quadro ainda não copiou do tabuleiro
+    uint64_t *linhas_atrasadas[3];
+    size_t palavras_atrasadas;
+    // Só da thread de transmissão (lidos depois do join)
+    QuadroTela codificado;      // último estado codificado: a base da próxima diferença
+    BlocoTransmissao *inteiro;  // quadro inteiro de 'codificado', feito quando alguém precisa
+    Espectador *espectadores[MAX_ESPECTADORES];
+    size_t qtd_espectadores;
+    uint64_t conexoes, maximo_juntos, diferencas, inteiros, bytes_codificados, bytes_enviados,
+             chamadas_writev, ressincronizados, derrubados;
+} Transmissor;
+
+static Transmissor transmissor = {0};
+
+bool endereco_unix(struct sockaddr_un *end, const char *caminho) {
+    memset(end, 0, sizeof(*end));
+    end->sun_family = AF_UNIX;
+    if (strlen(caminho) >= sizeof(end->sun_path)) {
+        fprintf(stderr, "ERRO: caminho do socket longo demais\n");
+        return false;
+    }
+    strcpy(end->sun_path, caminho);
+    return true;
+}
+
+// Bloco vazio com a referência de quem o criou.
+BlocoTransmissao *bloco_criar(void) {
+    BlocoTransmissao *b = calloc(1, sizeof(BlocoTransmissao));
+    if (!b) {
+        perror("ERRO: calloc");
+        exit(EXIT_FAILURE);
+    }
+    b->referencias = 1;
+    return b;
+}
+
+void bloco_soltar(BlocoTransmissao *b) {
+    if (--b->referencias) return;
+    free(b->texto.dados);
+    free(b);
+}
+
+void espectador_enfileirar(Espectador *e, BlocoTransmissao *b) {
+    if (e->qtd_fila == 0) e->ultimo_progresso_ns = agora_ns();
+    e->fila[(e->inicio_fila + e->qtd_fila++) % FILA_ESPECTADOR] = b;
+    b->referencias++;
+}
+
+// Larga a fila e pede um quadro inteiro. Um bloco que já saiu pela metade fica: cortá-lo
+// deixaria uma sequência de escape partida no terminal do espectador.
+void espectador_ressincronizar(Espectador *e) {
+    size_t fica = e->enviado > 0;
+    for (size_t i = fica; i < e->qtd_fila; i++)
+        bloco_soltar(e->fila[(e->inicio_fila + i) % FILA_ESPECTADOR]);
+    e->qtd_fila = fica;
+    e->precisa_inteiro = true;
+}
+
+// Fecha o espectador i; o último da lista ocupa o lugar dele.
+void espectador_fechar(Transmissor *tr, size_t i) {
+    Espectador *e = tr->espectadores[i];
+    e->enviado = 0;
+    espectador_ressincronizar(e);
+    close(e->fd);
+    free(e);
+    tr->espectadores[i] = tr->espectadores[--tr->qtd_espectadores];
+}
+
+// Manda o que o socket aceitar da fila num writev só. Devolve false se a conexão caiu.
+bool espectador_enviar(Transmissor *tr, Espectador *e) {
+    if (e->qtd_fila == 0) return true;
+
+    struct iovec partes[FILA_ESPECTADOR];
+    for (size_t i = 0; i < e->qtd_fila; i++) {
+        Quadro *q = &e->fila[(e->inicio_fila + i) % FILA_ESPECTADOR]->texto;
+        size_t pulo = i == 0 ? e->enviado : 0;
+        partes[i] = (struct iovec){ .iov_base = q->dados + pulo, .iov_len = q->tamanho - pulo };
+    }
+    ssize_t n = writev(e->fd, partes, (int)e->qtd_fila);
+    tr->chamadas_writev++;
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+
+    tr->bytes_enviados += (size_t)n;
+    e->ultimo_progresso_ns = agora_ns();
+    size_t resto = (size_t)n + e->enviado;
+    while (e->qtd_fila) {
+        BlocoTransmissao *b = e->fila[e->inicio_fila];
+        if (resto < b->texto.tamanho) break;
+        resto -= b->texto.tamanho;
+        bloco_soltar(b);
+        e->inicio_fila = (e->inicio_fila + 1) % FILA_ESPECTADOR;
+        e->qtd_fila--;
+    }
+    e->enviado = resto;
+    return true;
+}
+
+// Tabuleiro só para desenhar: aponta para as células do quadro.
+Tabuleiro vista_do_quadro(const QuadroTela *f) {
+    return (Tabuleiro){.largura = f->largura, .altura = f->altura, .celulas = f->celulas,
+                       .topologia = f->topologia, .camadas = f->camadas,
+                       .altura_camada = f->altura_camada};
+}
+
+// Quadro inteiro do último estado codificado; um só para todos que precisarem dele.
+BlocoTransmissao *transmissao_inteiro(Transmissor *tr) {
+    if (tr->inteiro) return tr->inteiro;
+
+    BlocoTransmissao *b = bloco_criar();
+    Tabuleiro vista = vista_do_quadro(&tr->codificado);
+    quadro_anexar(&b->texto, "\x1b[H\x1b[2J");
+    desenhar_tabuleiro(&b->texto, &vista, NULL);
+    quadro_reservar(&b->texto, tr->codificado.rodape.tamanho);
+    memcpy(b->texto.dados + b->texto.tamanho, tr->codificado.rodape.dados, tr->codificado.rodape.tamanho);
+    b->texto.tamanho += tr->codificado.rodape.tamanho;
+
+    tr->inteiros++;
+    tr->bytes_codificados += b->texto.tamanho;
+    tr->inteiro = b;
+    return b;
+}
+
+// Codifica o que mudou de 'codificado' para 'f' e guarda 'f' como a nova base. Devolve NULL se
+// nada visível mudou; se o tabuleiro é outro (partida nova), todos recebem um quadro inteiro.
+BlocoTransmissao *transmissao_diferenca(Transmissor *tr, const QuadroTela *f) {
+    QuadroTela *base = &tr->codificado;
+    bool mesmo_tabuleiro = base->numero && base->largura == f->largura && base->altura == f->altura &&
+                           base->topologia == f->topologia && base->camadas == f->camadas;
+    BlocoTransmissao *b = NULL;
+
+    // No mesmo tabuleiro a base passa a ser 'f' trecho a trecho, só onde ela mudou
+    if (mesmo_tabuleiro) {
+        b = bloco_criar();
+        Tabuleiro antes = vista_do_quadro(base), depois = vista_do_quadro(f);
+        for (size_t y = 0; y < f->altura; y++) {
+            for (size_t x = 0, n; x < f->largura; x += n) {
+                n = trecho_contiguo(&depois, x);
+                Celula *a = &CELULA_EM(&antes, x, y);
+                const Celula *d = &CELULA_EM(&depois, x, y);
+                if (memcmp(a, d, n) == 0) continue;
+                for (size_t i = 0; i < n; i++)
+                    if (a[i] != d[i]) desenhar_celula_em(&b->texto, &depois, x + i, y, d[i], false);
+                memcpy(a, d, n);
+            }
+        }
+        bool rodape_mudou = f->rodape.tamanho != base->rodape.tamanho ||
+                            memcmp(f->rodape.dados, base->rodape.dados, f->rodape.tamanho) != 0;
+        if (b->texto.tamanho || rodape_mudou) {
+            quadro_anexar(&b->texto, "\x1b[%zu;1H\x1b[J", linha_da_celula(&depois, f->altura - 1) + 2);
+            quadro_reservar(&b->texto, f->rodape.tamanho);
+            memcpy(b->texto.dados + b->texto.tamanho, f->rodape.dados, f->rodape.tamanho);
+            b->texto.tamanho += f->rodape.tamanho;
+            tr->diferencas++;
+            tr->bytes_codificados += b->texto.tamanho;
+        } else {
+            bloco_soltar(b);
+            b = NULL;
+        }
+    }
+
+    // Partida nova: a base passa a ser 'f' inteiro
+    size_t n = CELULAS_ALOCADAS(f);
+    if (!mesmo_tabuleiro && n > base->capacidade) {
+        base->celulas = realloc(base->celulas, n);
+        if (!base->celulas) {
+            perror("ERRO: realloc");
+            exit(EXIT_FAILURE);
+        }
+        base->capacidade = n;
+    }
+    if (!mesmo_tabuleiro) memcpy(base->celulas, f->celulas, n);
+    base->numero = f->numero;
+    base->largura = f->largura;
+    base->altura = f->altura;
+    base->topologia = f->topologia;
+    base->camadas = f->camadas;
+    base->altura_camada = f->altura_camada;
+    base->rodape.tamanho = 0;
+    quadro_reservar(&base->rodape, f->rodape.tamanho);
+    memcpy(base->rodape.dados, f->rodape.dados, f->rodape.tamanho);
+    base->rodape.tamanho = f->rodape.tamanho;
+
+    if (tr->inteiro) {
+        bloco_soltar(tr->inteiro);
+        tr->inteiro = NULL;
+    }
+    if (!mesmo_tabuleiro)
+        for (size_t i = 0; i < tr->qtd_espectadores; i++) espectador_ressincronizar(tr->espectadores[i]);
+    return b;
+}
+
+// Aceita quem estiver esperando no socket; cada um começa pedindo um quadro inteiro.
+void transmissao_aceitar(Transmissor *tr) {
+    int fd;
+    while ((fd = accept(tr->socket, NULL, NULL)) >= 0) {
+        Espectador *e = tr->qtd_espectadores < MAX_ESPECTADORES ? calloc(1, sizeof(Espectador)) : NULL;
+        if (!e) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        e->fd = fd;
+        e->precisa_inteiro = true;
+        tr->espectadores[tr->qtd_espectadores++] = e;
+        tr->conexoes++;
+        if (tr->qtd_espectadores > tr->maximo_juntos) tr->maximo_juntos = tr->qtd_espectadores;
+    }
+}
+
+void *trabalhador_transmissao(void *arg) {
+    Transmissor *tr = arg;
+    struct pollfd *fds = malloc((2 + MAX_ESPECTADORES) * sizeof(struct pollfd));
+    if (!fds) return NULL;
+
+    // Espectador é o último da fila pela CPU: no Linux o nice vale por thread
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), PRIORIDADE_TRANSMISSAO);
+
+    uint64_t prazo = 0;
+    for (;;) {
+        fds[0] = (struct pollfd){ .fd = tr->socket, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = tr->acordar[0], .events = POLLIN };
+        for (size_t i = 0; i < tr->qtd_espectadores; i++) {
+            Espectador *e = tr->espectadores[i];
+            fds[2 + i] = (struct pollfd){ .fd = e->fd, .events = POLLIN | (e->qtd_fila ? POLLOUT : 0) };
+        }
+        if (poll(fds, 2 + tr->qtd_espectadores, 1000) < 0 && errno != EINTR) break;
+
+        // Espectadores não mandam nada: o que chegar é descartado, e fim de arquivo é saída.
+        // De trás para frente, porque fechar traz o último para o lugar do que saiu.
+        for (size_t i = tr->qtd_espectadores; i-- > 0; ) {
+            if (!(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            char lixo[256];
+            ssize_t n = read(tr->espectadores[i]->fd, lixo, sizeof(lixo));
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) espectador_fechar(tr, i);
+        }
+        if (fds[0].revents & POLLIN) transmissao_aceitar(tr);
+        if (fds[1].revents & POLLIN) {
+            char lixo[256];
+            atomic_store(&tr->aviso_pendente, false);
+            while (read(tr->acordar[0], lixo, sizeof(lixo)) > 0) {}
+        }
+
+        // Quadro novo: a mesma diferença vai para todos que estão em dia
+        if (atomic_load(&tr->meio) & QUADRO_NOVO) {
+            tr->leitura = atomic_exchange(&tr->meio, tr->leitura) & 3;
+            QuadroTela *f = &tr->quadros[tr->leitura];
+            f->rodape.tamanho = 0;
+            formatar_rodape(&f->rodape, &f->contadores);
+            BlocoTransmissao *b = transmissao_diferenca(tr, f);
+            for (size_t i = 0; b && i < tr->qtd_espectadores; i++) {
+                Espectador *e = tr->espectadores[i];
+                if (e->precisa_inteiro) continue;
+                if (e->qtd_fila == FILA_ESPECTADOR) {
+                    espectador_ressincronizar(e);
+                    tr->ressincronizados++;
+                } else {
+                    espectador_enfileirar(e, b);
+                }
+            }
+            if (b) bloco_soltar(b);
+        }
+
+        uint64_t agora = agora_ns();
+        for (size_t i = tr->qtd_espectadores; i-- > 0; ) {
+            Espectador *e = tr->espectadores[i];
+            if (e->precisa_inteiro && tr->codificado.numero && e->qtd_fila < FILA_ESPECTADOR) {
+                espectador_enfileirar(e, transmissao_inteiro(tr));
+                e->precisa_inteiro = false;
+            }
+            if (!espectador_enviar(tr, e)) {
+                espectador_fechar(tr, i);
+            } else if (e->qtd_fila && agora > e->ultimo_progresso_ns + TEMPO_MAX_ESPECTADOR_NS) {
+                espectador_fechar(tr, i);
+                tr->derrubados++;
+            }
+        }
+
+        // No fim do jogo, quem ainda tem fila ganha TEMPO_DESPEDIDA_NS para receber o último quadro
+        if (atomic_load(&tr->parar)) {
+            if (!prazo) prazo = agora + TEMPO_DESPEDIDA_NS;
+            bool pendente = false;
+            for (size_t i = 0; i < tr->qtd_espectadores; i++) pendente |= tr->espectadores[i]->qtd_fila > 0;
+            if (!pendente || agora > prazo) break;
+        }
+    }
+
+    while (tr->qtd_espectadores) espectador_fechar(tr, tr->qtd_espectadores - 1);
+    if (tr->inteiro) bloco_soltar(tr->inteiro);
+    free(fds);
+    return NULL;
+}
+
+// --espectadores CAMINHO: abre o socket e a thread de transmissão.
+bool transmissao_iniciar(Transmissor *tr, const char *caminho) {
+    struct sockaddr_un end;
+    if (!endereco_unix(&end, caminho)) return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(caminho);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&end, sizeof(end)) < 0 || listen(fd, SOMAXCONN) < 0 ||
+        pipe(tr->acordar) != 0) {
+        perror("ERRO: espectadores");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(tr->acordar[0], F_SETFL, fcntl(tr->acordar[0], F_GETFL) | O_NONBLOCK);
+    fcntl(tr->acordar[1], F_SETFL, fcntl(tr->acordar[1], F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+
+    tr->socket = fd;
+    tr->caminho = caminho;
+    tr->meio = 1;
+    tr->escrita = 0;
+    tr->leitura = 2;
+    if (pthread_create(&tr->thread, NULL, trabalhador_transmissao, tr) != 0) {
+        perror("ERRO: thread de transmissão");
+        close(fd);
+        close(tr->acordar[0]);
+        close(tr->acordar[1]);
+        unlink(caminho);
+        return false;
+    }
+    tr->ativa = true;
+    return true;
+}
+
+// Copia para o quadro só as linhas ligadas em 'linhas' (as outras ele já tem).
+void copiar_linhas_quadro(QuadroTela *f, Tabuleiro *t, const uint64_t *linhas) {
+    Tabuleiro destino = vista_do_quadro(f);
+    for (size_t w = 0; w < (t->altura + 63) / 64; w++) {
+        for (uint64_t m = linhas[w]; m; m &= m - 1) {
+            size_t y = w * 64 + (size_t)__builtin_ctzll(m);
+            if (y >= t->altura) break;
+            for (size_t x = 0, n; x < t->largura; x += n) {
+                n = trecho_contiguo(t, x);
+                memcpy(&CELULA_EM(&destino, x, y), &CELULA_EM(t, x, y), n);
+            }
+        }
+    }
+}
+
+// Publica o estado visível para os espectadores: as linhas que o quadro de escrita ainda não
+// tem, os números do rodapé e um byte no pipe, nada mais. O tabuleiro inteiro só é copiado
+// quando o quadro é de outra partida.
+void transmissao_publicar(Transmissor *tr, Tabuleiro *t) {
+    if (!tr->ativa || !t->celulas) return;
+
+    uint64_t inicio = agora_ns();
+    size_t palavras = (t->altura + 63) / 64;
+    if (palavras > tr->palavras_atrasadas) {
+        // Palavras novas: linhas que nenhum quadro viu
+        for (size_t i = 0; i < 3; i++) {
+            tr->linhas_atrasadas[i] = realloc(tr->linhas_atrasadas[i], palavras * sizeof(uint64_t));
+            if (!tr->linhas_atrasadas[i]) {
+                perror("ERRO: realloc");
+                exit(EXIT_FAILURE);
+            }
+            memset(tr->linhas_atrasadas[i] + tr->palavras_atrasadas, 0xff,
+                   (palavras - tr->palavras_atrasadas) * sizeof(uint64_t));
+        }
+        tr->palavras_atrasadas = palavras;
+    }
+
+    // O que mudou desde a última publicação falta nos três quadros
+    for (size_t w = 0; w < palavras; w++) {
+        for (size_t i = 0; i < 3; i++) tr->linhas_atrasadas[i][w] |= t->linhas_mudadas[w];
+        t->linhas_mudadas[w] = 0;
+    }
+    QuadroTela *f = &tr->quadros[tr->escrita];
+    uint64_t *atrasadas = tr->linhas_atrasadas[tr->escrita];
+    if (f->numero && f->largura == t->largura && f->altura == t->altura &&
+        f->topologia == t->topologia && f->camadas == t->camadas)
+        copiar_linhas_quadro(f, t, atrasadas);
+    else
+        copiar_quadro_tela(f, t);
+    memset(atrasadas, 0, palavras * sizeof(uint64_t));
+    f->contadores = contadores_rodape(t);
+    f->numero = ++tr->publicados;
+    tr->escrita = atomic_exchange(&tr->meio, tr->escrita | QUADRO_NOVO) & 3;
+
+    // Só acorda a thread se ela ainda não tem aviso: quadros seguidos custam uma escrita só
+    char aviso = 0;
+    if (!atomic_exchange(&tr->aviso_pendente, true) && write(tr->acordar[1], &aviso, 1) < 0 && errno != EAGAIN)
+        perror("ERRO: aviso de transmissão");
+
+    uint64_t duracao = agora_ns() - inicio;
+    if (duracao > tr->maximo_publicar_ns) tr->maximo_publicar_ns = duracao;
+}
+
+void transmissao_encerrar(void) {
+    Transmissor *tr = &transmissor;
+    if (!tr->ativa) return;
+    tr->ativa = false;
+
+    atomic_store(&tr->parar, true);
+    char aviso = 0;
+    if (write(tr->acordar[1], &aviso, 1) < 0) {}
+    pthread_join(tr->thread, NULL);
+    close(tr->socket);
+    close(tr->acordar[0]);
+    close(tr->acordar[1]);
+    unlink(tr->caminho);
+    for (size_t i = 0; i < 3; i++) {
+        free(tr->quadros[i].celulas);
+        free(tr->quadros[i].rodape.dados);
+    }
+    free(tr->codificado.celulas);
+    free(tr->codificado.rodape.dados);
+    for (size_t i = 0; i < 3; i++) free(tr->linhas_atrasadas[i]);
+
+    printf("Espectadores: %llu conexões (máx %llu juntas) | %llu quadros publicados, publicar máx %.3f ms\n"
+           "             %llu diferenças e %llu quadros inteiros codificados (%.1f KiB) | "
+           "%.1f KiB enviados em %llu writev | %llu ressincronizados, %llu derrubados\n",
+           (unsigned long long)tr->conexoes, (unsigned long long)tr->maximo_juntos,
+           (unsigned long long)tr->publicados, tr->maximo_publicar_ns / 1e6,
+           (unsigned long long)tr->diferencas, (unsigned long long)tr->inteiros,
+           tr->bytes_codificados / 1024.0, tr->bytes_enviados / 1024.0,
+           (unsigned long long)tr->chamadas_writev, (unsigned long long)tr->ressincronizados,
+           (unsigned long long)tr->derrubados);
+}
+
+// --assistir CAMINHO: copia a transmissão para o terminal até o jogo fechar o socket.
+int assistir(const char *caminho) {
+    struct sockaddr_un end;
+    if (!endereco_unix(&end, caminho)) return EXIT_FAILURE;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&end, sizeof(end)) < 0) {
+        perror("ERRO: conectar");
+        return EXIT_FAILURE;
+    }
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        escrever_tudo(STDOUT_FILENO, buf, (size_t)n);
+    }
+    close(fd);
+    printf("\x1b[0m\nTransmissão encerrada.\n");
+    return EXIT_SUCCESS;
+}
+
+// Quadro reaproveitado entre atualizações para não alocar a cada tela
+static Quadro quadro_tela = {0};
+
+//Limpa a tela e redesenha interface com informações
+void atualizar_tela(Tabuleiro *t) {
+    uint64_t inicio = agora_ns();
+    transmissao_publicar(&transmissor, t);
+    if (renderizador.ativa) {
+        registrar_tempo(t, OP_DESENHAR, inicio, renderizador_publicar(&renderizador, t));
+        return;
+    }
+
+    Quadro *q = &quadro_tela;
+    quadro_anexar(q, "\x1b[H\x1b[2J");
+    desenhar_tabuleiro(q, t, NULL);
+    desenhar_rodape(q, t);
+
+    // Mantém a ordem com o que já foi escrito via printf
+    fflush(stdout);
+    size_t bytes = q->tamanho;
+    quadro_enviar(q, STDOUT_FILENO);
+    registrar_tempo(t, OP_DESENHAR, inicio, bytes);
+}
+
+//Verifica condição de vitória.
+bool verificar_vitoria(Tabuleiro *tab) {
     size_t total_seguras = (tab->largura * tab->altura) - tab->qtd_minas;
-    return celulas_reveladas == total_seguras;
+    return tab->celulas_reveladas == total_seguras;
+}
+
+/*
+ * Revelação em fatias. Revelar é uma BFS que pode parar no meio: comecar_revelar abre o lote de
+ * undo e semeia a fila, avancar_revelacao anda com ela até esvaziar ou a fatia acabar, e
+ * concluir_revelar fecha a jogada.
+ * A fila fica em t->revelacao entre as fatias, então o front end pode desenhar e ler teclas no
+ * meio de uma inundação grande. Contadores, hash e bitboards andam célula a célula, então o
+ * tabuleiro está sempre consistente; só o resultado (mina, vitória) espera a BFS terminar.
+ */
+
+//Abre (x, y) no lote de undo que já está aberto; se for vazia, a célula entra na fila da BFS
+void semear_revelacao(Tabuleiro *t, size_t x, size_t y) {
+    RevelacaoPendente *rp = &t->revelacao;
+    Celula cel = CELULA_EM(t, x, y);
+
+    empilhar_undo(t, x, y, cel, false);
+
+    Celula revelada = cel;
+    DEFINIR_REVELADA(revelada, true);
+    escrever_celula(t, x, y, revelada);
+    t->celulas_reveladas++;
+    if (EH_MINA(cel)) rp->acertou_mina = true;
+
+    // Se clicou em número ou mina, não expande
+    if (NUM_MINAS(cel) != 0 || EH_MINA(cel)) return;
+
+    NoFila *novo = alocar(t, sizeof(NoFila));
+    novo->x = x;
+    novo->y = y;
+    novo->proximo = NULL;
+    if (rp->fim) rp->fim->proximo = novo; else rp->inicio = novo;
+    rp->fim = novo;
+
+    // A primeira onda são as sementes
+    rp->fim_onda = novo;
+    rp->inicio_onda = trace_ativo ? agora_ns() : 0;
+    rp->reveladas_onda = t->celulas_reveladas;
+}
+
+//Anda a BFS pendente até a fila esvaziar ou a fatia acabar: 'max_celulas' reveladas ou 'max_ns'
+//de relógio (0 = sem limite). O relógio só é lido a cada 64 nós. Devolve true se a fila esvaziou.
+bool avancar_revelacao(Tabuleiro *t, size_t max_celulas, uint64_t max_ns) {
+    RevelacaoPendente *rp = &t->revelacao;
+    uint64_t comeco = agora_ns();
+    size_t reveladas_fatia = t->celulas_reveladas;
+
+    // A fila vive em variáveis locais durante a fatia e volta para 'rp' no fim
+    NoFila *inicio = rp->inicio, *fim = rp->fim, *fim_onda = rp->fim_onda;
+    #define ENFILEIRAR(px, py) do { \
+        NoFila *novo = alocar(t, sizeof(NoFila)); \
+        novo->x = (px); \
+        novo->y = (py); \
+        novo->proximo = NULL; \
+        if (fim) fim->proximo = novo; else inicio = novo; \
+        fim = novo; \
+    } while(0)
+
+    // BFS
+    for (unsigned nos = 1; inicio; nos++) {
+        if (t->celulas_reveladas - reveladas_fatia >= max_celulas) break;
+        if (max_ns && nos % 64 == 0 && agora_ns() - comeco >= max_ns) break;
+
+        NoFila *atual = inicio;
+        inicio = inicio->proximo;
+        if (!inicio) fim = NULL;
+
+        size_t cx = atual->x;
+        size_t cy = atual->y;
+        bool fecha_onda = atual == fim_onda;
+        liberar(t, atual);
+
+        // Na grade quadrada (o caso quente) os vizinhos saem direto de 'direcoes', sem a lista
+        size_t vx[MAX_VIZINHOS], vy[MAX_VIZINHOS];
+        bool quadrada = t->topologia == TOPOLOGIA_QUADRADA;
+        unsigned qtd_vizinhos = quadrada ? 8 : listar_vizinhos(t, cx, cy, vx, vy);
+        for (unsigned j = 0; j < qtd_vizinhos; j++) {
+            size_t nx = quadrada ? cx + direcoes[j][0] : vx[j];
+            size_t ny = quadrada ? cy + direcoes[j][1] : vy[j];
+
+            if (nx >= t->largura || ny >= t->altura) continue;
+
+            Celula *prox = &CELULA_EM(t, nx, ny);
+
+            if (ESTA_REVELADA(*prox) || TEM_BANDEIRA(*prox)) continue;
+
+            // Undo: continuação do lote
+            empilhar_undo(t, nx, ny, *prox, false);
+
+            Celula revelada = *prox;
+            DEFINIR_REVELADA(revelada, true);
+            escrever_celula(t, nx, ny, revelada);
+            t->celulas_reveladas++;
+
+            // Só expande células vazias
+            if (NUM_MINAS(*prox) == 0 && !EH_MINA(*prox)) {
+                ENFILEIRAR(nx, ny);
+            }
+        }
+
+        if (fecha_onda && trace_ativo) {
+            trace_span("onda_bfs", rp->inicio_onda, "celulas", t->celulas_reveladas - rp->reveladas_onda);
+            fim_onda = fim;
+            rp->inicio_onda = agora_ns();
+            rp->reveladas_onda = t->celulas_reveladas;
+        }
+    }
+
+    #undef ENFILEIRAR
+
+    rp->inicio = inicio;
+    rp->fim = fim;
+    rp->fim_onda = fim_onda;
+    rp->ns_gastos += agora_ns() - comeco;
+    return inicio == NULL;
+}
+
+//Começa a revelar (x, y), ou ao redor dela se já está revelada: abre o lote e semeia a BFS, sem
+//andar com ela. Devolve false se não há o que revelar (bandeira, ou acorde que não bate).
+bool comecar_revelar(Tabuleiro *t, size_t x, size_t y) {
+    RevelacaoPendente *rp = &t->revelacao;
+    Celula atual = CELULA_EM(t, x, y);
+    if (TEM_BANDEIRA(atual)) return false;
+
+    *rp = (RevelacaoPendente){ .x = x, .y = y, .x_fim = x, .y_fim = y, .protecao = t->primeiro_clique_pendente };
+
+    if (!ESTA_REVELADA(atual)) {
+        if (t->primeiro_clique_pendente) preparar_primeiro_clique(t, x, y);
+
+        uint64_t inicio = agora_ns();
+        rp->op = OP_REVELAR;
+        rp->reveladas_antes = t->celulas_reveladas;
+        empilhar_inicio_lote(t);
+        semear_revelacao(t, x, y);
+        rp->ativa = true;
+        rp->ns_gastos = agora_ns() - inicio;
+        return true;
+    }
+
+    // Acorde: se as bandeiras em volta batem com o número, revela os vizinhos
+    uint64_t inicio = agora_ns();
+    rp->op = OP_ACORDE;
+    rp->reveladas_antes = t->celulas_reveladas;
+
+    size_t vx[MAX_VIZINHOS], vy[MAX_VIZINHOS];
+    unsigned qtd_vizinhos = listar_vizinhos(t, x, y, vx, vy);
+
+    // Bandeiras em volta contadas no bitboard: um popcount em vez de 8 leituras (a grade
+    // quadrada é a única em que a vizinhança é o 3x3 dos bitboards)
+    unsigned bandeiras = 0;
+    if (t->topologia == TOPOLOGIA_QUADRADA)
+        bandeiras = contar_vizinhos_bits(t, t->bits_bandeira, x, y);
+    else
+        for (unsigned i = 0; i < qtd_vizinhos; i++) bandeiras += TEM_BANDEIRA(CELULA_EM(t, vx[i], vy[i]));
+
+    if (bandeiras == NUM_MINAS(atual)) {
+        for (unsigned i = 0; i < qtd_vizinhos; i++) {
+            Celula cel = CELULA_EM(t, vx[i], vy[i]);
+            if (TEM_BANDEIRA(cel) || ESTA_REVELADA(cel)) continue;
+
+            // O acorde inteiro é um lote só, aberto quando há algo para revelar
+            if (!rp->ativa) {
+                empilhar_inicio_lote(t);
+                rp->ativa = true;
+            }
+            semear_revelacao(t, vx[i], vy[i]);
+        }
+    }
+
+    if (!rp->ativa) {
+        registrar_tempo(t, OP_ACORDE, inicio, 0);
+        return false;
+    }
+    rp->ns_gastos = agora_ns() - inicio;
+    return true;
+}
+
+//Começa a revelar o retângulo (x, y)-(x_fim, y_fim): as células escondidas e sem bandeira dele são
+//as sementes de uma BFS só, num lote só, então aberturas que se encostam são inundadas uma vez.
+//A proteção do primeiro clique vale para (x, y). Devolve false se não há o que revelar.
+bool comecar_revelar_area(Tabuleiro *t, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    RevelacaoPendente *rp = &t->revelacao;
+    bool tem_escondida = false;
+    for (size_t cy = y; cy <= y_fim && !tem_escondida; cy++)
+        for (size_t cx = x; cx <= x_fim && !tem_escondida; cx += 64)
+            tem_escondida = bits_da_area(t, cx, x_fim, cy, false) != 0;
+    if (!tem_escondida) return false;
+
+    *rp = (RevelacaoPendente){ .x = x, .y = y, .x_fim = x_fim, .y_fim = y_fim,
+                               .protecao = t->primeiro_clique_pendente };
+    if (t->primeiro_clique_pendente) preparar_primeiro_clique(t, x, y);
+
+    uint64_t inicio = agora_ns();
+    rp->op = OP_REVELAR;
+    rp->reveladas_antes = t->celulas_reveladas;
+    empilhar_inicio_lote(t);
+    for (size_t cy = y; cy <= y_fim; cy++) {
+        for (size_t cx = x; cx <= x_fim; cx += 64) {
+            for (uint64_t b = bits_da_area(t, cx, x_fim, cy, false); b; b &= b - 1)
+                semear_revelacao(t, cx + (size_t)__builtin_ctzll(b), cy);
+        }
+    }
+    rp->ativa = true;
+    rp->ns_gastos = agora_ns() - inicio;
+    return true;
+}
+
+//Fecha a revelação cuja fila esvaziou: registra o tempo das fatias e diz como o jogo ficou.
+ResultadoJogada concluir_revelar(Tabuleiro *t) {
+    RevelacaoPendente *rp = &t->revelacao;
+    registrar_tempo(t, rp->op, agora_ns() - rp->ns_gastos, t->celulas_reveladas - rp->reveladas_antes);
+
+    bool acertou_mina = rp->acertou_mina;
+    *rp = (RevelacaoPendente){0};
+
+    if (acertou_mina) return JOGADA_MINA;
+    if (verificar_vitoria(t)) return JOGADA_VITORIA;
+    return JOGADA_FEITA;
+}
+
+//Revela todo o tabuleiro (Fim de jogo). Liga o bit de revelada de 8 em 8 células; só as que
+//ainda estavam escondidas passam pelo hash, e os bitboards de reveladas ficam cheios de uma vez.
+void revelar_tabuleiro(Tabuleiro *tab) {
+    for (size_t y = 0; y < tab->altura; y++) {
+        for (size_t x = 0, n; x < tab->largura; x += n) {
+            Celula *p = &CELULA_EM(tab, x, y);
+            size_t idx = y * tab->largura + x, i = 0;
+            n = trecho_contiguo(tab, x);
+            for (; i + 8 <= n; i += 8) {
+                uint64_t w = ler_palavra(p + i), novas = ~w & BYTES_COM_BIT(DESLOC_REVELADA);
+                if (!novas) continue;
+                gravar_palavra(p + i, w | novas);
+                for (; novas; novas &= novas - 1) {
+                    size_t k = (size_t)__builtin_ctzll(novas) >> 3;
+                    unsigned antes = (unsigned)(w >> (8 * k + DESLOC_BANDEIRA)) & 1;  // escondida: só a bandeira
+                    tab->hash ^= chave_zobrist(idx + i + k, antes) ^ chave_zobrist(idx + i + k, antes | 2);
+                }
+            }
+            for (; i < n; i++) {
+                if (ESTA_REVELADA(p[i])) continue;
+                unsigned antes = ESTADO_VISIVEL(p[i]);
+                p[i] |= 1 << DESLOC_REVELADA;
+                tab->hash ^= chave_zobrist(idx + i, antes) ^ chave_zobrist(idx + i, antes | 2);
+            }
+        }
+        bits_ligar_linha(tab, tab->bits_revelada, y);
+        tab->linhas_mudadas[y >> 6] |= 1ull << (y & 63);
+        if (tab->visivel)
+            for (size_t x = 0; x < tab->largura; x++) tab->visivel[y * tab->largura + x] = VISIVEL_BOT(CELULA_EM(tab, x, y));
+    }
+}
+
+//Revela a célula, ou revela ao redor se ela já estiver revelada, de uma vez, e diz como o jogo ficou.
+ResultadoJogada aplicar_revelar(Tabuleiro *t, size_t x, size_t y) {
+    if (!comecar_revelar(t, x, y)) return JOGADA_NADA;
+    avancar_revelacao(t, SIZE_MAX, 0);
+    return concluir_revelar(t);
+}
+
+//Revela uma célula escondida como uma jogada própria (um lote de undo)
+void revelar_celula(Tabuleiro *t, size_t x, size_t y) {
+    if (ESTA_REVELADA(CELULA_EM(t, x, y))) return;
+    aplicar_revelar(t, x, y);
+}
+
+/*
+ * Tokenizador do modo de linhas, dirigido por tabelas e sem alocar: uma tabela diz a classe de
+ * cada byte, outra diz os argumentos de cada comando. Um intervalo é "N", "N-M" ou "*" (a linha
+ * ou coluna inteira); revelar e bandeira com intervalo viram uma jogada em área.
+ */
+typedef enum {
+    CLASSE_OUTRO,
+    CLASSE_ESPACO,
+    CLASSE_DIGITO,
+    CLASSE_LETRA,
+    CLASSE_HIFEN,
+    CLASSE_ASTERISCO,
+} ClasseCaractere;
+
+typedef enum {
+    TOKEN_FIM,
+    TOKEN_PALAVRA,
+    TOKEN_NUMERO,
+    TOKEN_HIFEN,
+    TOKEN_ASTERISCO,
+    TOKEN_INVALIDO,
+} TipoToken;
+
+typedef struct {
+    TipoToken tipo;
+    const char *inicio;
+    size_t tamanho;
+    size_t valor;    // TOKEN_NUMERO
+} Token;
+
+static const uint8_t classe_caractere[256] = {
+    [' '] = CLASSE_ESPACO, ['\t'] = CLASSE_ESPACO, ['\r'] = CLASSE_ESPACO,
+    ['0'] = CLASSE_DIGITO, ['1'] = CLASSE_DIGITO, ['2'] = CLASSE_DIGITO, ['3'] = CLASSE_DIGITO,
+    ['4'] = CLASSE_DIGITO, ['5'] = CLASSE_DIGITO, ['6'] = CLASSE_DIGITO, ['7'] = CLASSE_DIGITO,
+    ['8'] = CLASSE_DIGITO, ['9'] = CLASSE_DIGITO,
+    ['a'] = CLASSE_LETRA, ['b'] = CLASSE_LETRA, ['c'] = CLASSE_LETRA, ['d'] = CLASSE_LETRA,
+    ['e'] = CLASSE_LETRA, ['f'] = CLASSE_LETRA, ['g'] = CLASSE_LETRA, ['h'] = CLASSE_LETRA,
+    ['i'] = CLASSE_LETRA, ['j'] = CLASSE_LETRA, ['k'] = CLASSE_LETRA, ['l'] = CLASSE_LETRA,
+    ['m'] = CLASSE_LETRA, ['n'] = CLASSE_LETRA, ['o'] = CLASSE_LETRA, ['p'] = CLASSE_LETRA,
+    ['q'] = CLASSE_LETRA, ['r'] = CLASSE_LETRA, ['s'] = CLASSE_LETRA, ['t'] = CLASSE_LETRA,
+    ['u'] = CLASSE_LETRA, ['v'] = CLASSE_LETRA, ['w'] = CLASSE_LETRA, ['x'] = CLASSE_LETRA,
+    ['y'] = CLASSE_LETRA, ['z'] = CLASSE_LETRA,
+    ['A'] = CLASSE_LETRA, ['B'] = CLASSE_LETRA, ['C'] = CLASSE_LETRA, ['D'] = CLASSE_LETRA,
+    ['E'] = CLASSE_LETRA, ['F'] = CLASSE_LETRA, ['G'] = CLASSE_LETRA, ['H'] = CLASSE_LETRA,
+    ['I'] = CLASSE_LETRA, ['J'] = CLASSE_LETRA, ['K'] = CLASSE_LETRA, ['L'] = CLASSE_LETRA,
+    ['M'] = CLASSE_LETRA, ['N'] = CLASSE_LETRA, ['O'] = CLASSE_LETRA, ['P'] = CLASSE_LETRA,
+    ['Q'] = CLASSE_LETRA, ['R'] = CLASSE_LETRA, ['S'] = CLASSE_LETRA, ['T'] = CLASSE_LETRA,
+    ['U'] = CLASSE_LETRA, ['V'] = CLASSE_LETRA, ['W'] = CLASSE_LETRA, ['X'] = CLASSE_LETRA,
+    ['Y'] = CLASSE_LETRA, ['Z'] = CLASSE_LETRA,
+    ['-'] = CLASSE_HIFEN, ['*'] = CLASSE_ASTERISCO,
+};
+
+// Argumentos que cada comando espera depois do nome
+typedef enum {
+    ARGS_NENHUM,
+    ARGS_NUMERO,     // ir N
+    ARGS_ARQUIVO,    // o resto da linha
+    ARGS_AREA,       // intervalo de linhas [intervalo de colunas]
+} ArgumentosComando;
+
+typedef struct {
+    const char *nome;
+    TipoComando tipo;
+    ArgumentosComando argumentos;
+} DefinicaoComando;
+
+static const DefinicaoComando definicoes_comandos[] = {
+    { "r",        CMD_REVELAR,          ARGS_AREA },
+    { "b",        CMD_BANDEIRA,         ARGS_AREA },
+    { "l",        CMD_LIMPAR,           ARGS_AREA },
+    { "d",        CMD_DESFAZER,         ARGS_NENHUM },
+    { "rf",       CMD_REFAZER,          ARGS_NENHUM },
+    { "ir",       CMD_IR,               ARGS_NUMERO },
+    { "lb",       CMD_LISTAR_BANDEIRAS, ARGS_NENHUM },
+    { "stats",    CMD_ESTATISTICAS,     ARGS_NENHUM },
+    { "melhor",   CMD_MELHOR,           ARGS_NENHUM },
+    { "salvar",   CMD_SALVAR,           ARGS_ARQUIVO },
+    { "carregar", CMD_CARREGAR,         ARGS_ARQUIVO },
+    { "ajuda",    CMD_AJUDA,            ARGS_NENHUM },
+    { "sair",     CMD_SAIR,             ARGS_NENHUM },
+};
+
+// Lê o próximo token a partir de *p e avança *p para depois dele.
+Token proximo_token(const char **p) {
+    const unsigned char *c = (const unsigned char *)*p;
+    while (classe_caractere[*c] == CLASSE_ESPACO) c++;
+
+    Token tok = { .inicio = (const char *)c, .tipo = TOKEN_INVALIDO };
+    switch (*c ? classe_caractere[*c] : CLASSE_ESPACO) {
+        case CLASSE_ESPACO:  // só chega aqui no '\0'
+            tok.tipo = TOKEN_FIM;
+            break;
+        case CLASSE_LETRA:
+            while (classe_caractere[*c] == CLASSE_LETRA) c++;
+            tok.tipo = TOKEN_PALAVRA;
+            break;
+        case CLASSE_DIGITO:
+            tok.tipo = TOKEN_NUMERO;
+            for (; classe_caractere[*c] == CLASSE_DIGITO; c++) {
+                if (tok.valor > (SIZE_MAX - 9) / 10) tok.tipo = TOKEN_INVALIDO;  // estouraria
+                tok.valor = tok.valor * 10 + (size_t)(*c - '0');
+            }
+            break;
+        case CLASSE_HIFEN:
+            tok.tipo = TOKEN_HIFEN;
+            c++;
+            break;
+        case CLASSE_ASTERISCO:
+            tok.tipo = TOKEN_ASTERISCO;
+            c++;
+            break;
+        default:
+            c++;
+            break;
+    }
+    tok.tamanho = (size_t)((const char *)c - tok.inicio);
+    *p = (const char *)c;
+    return tok;
+}
+
+// Lê um intervalo ("N", "N-M" ou "*", que vira 0-SIZE_MAX) a partir de 'tok'. 'em_area' fica
+// ligado se não era um número só.
+bool ler_intervalo(const char **p, Token tok, size_t *inicio, size_t *fim, bool *em_area) {
+    if (tok.tipo == TOKEN_ASTERISCO) {
+        *inicio = 0;
+        *fim = SIZE_MAX;
+        *em_area = true;
+        return true;
+    }
+    if (tok.tipo != TOKEN_NUMERO) return false;
+    *inicio = *fim = tok.valor;
+
+    const char *depois = *p;
+    if (proximo_token(&depois).tipo != TOKEN_HIFEN) return true;
+    Token ultimo = proximo_token(&depois);
+    if (ultimo.tipo != TOKEN_NUMERO || ultimo.valor < tok.valor) return false;
+    *fim = ultimo.valor;
+    *em_area = true;
+    *p = depois;
+    return true;
+}
+
+//Interpreta uma linha digitada no modo de linhas.
+Comando interpretar_comando(const char *buf) {
+    Comando cmd = { .tipo = CMD_INVALIDO };
+    const char *p = buf;
+
+    Token nome = proximo_token(&p);
+    if (nome.tipo != TOKEN_PALAVRA) return cmd;
+    const DefinicaoComando *def = NULL;
+    for (size_t i = 0; i < sizeof(definicoes_comandos) / sizeof(definicoes_comandos[0]); i++) {
+        if (strlen(definicoes_comandos[i].nome) == nome.tamanho &&
+            memcmp(definicoes_comandos[i].nome, nome.inicio, nome.tamanho) == 0) {
+            def = &definicoes_comandos[i];
+            break;
+        }
+    }
+    if (!def) return cmd;
+
+    switch (def->argumentos) {
+        case ARGS_NENHUM:
+            break;
+
+        case ARGS_NUMERO: {
+            Token n = proximo_token(&p);
+            if (n.tipo != TOKEN_NUMERO) return cmd;
+            cmd.x = n.valor;
+            break;
+        }
+
+        case ARGS_ARQUIVO:
+            // O nome do arquivo é o resto da linha, sem passar pelo tokenizador
+            while (classe_caractere[(unsigned char)*p] == CLASSE_ESPACO) p++;
+            if (p == nome.inicio + nome.tamanho || !*p) return cmd;
+            cmd.arquivo = p;
+            cmd.tipo = def->tipo;
+            return cmd;
+
+        case ARGS_AREA: {
+            // Sem o intervalo das colunas, vale a linha inteira
+            if (!ler_intervalo(&p, proximo_token(&p), &cmd.y, &cmd.y_fim, &cmd.area)) return cmd;
+            Token colunas = proximo_token(&p);
+            if (colunas.tipo == TOKEN_FIM) {
+                cmd.x = 0;
+                cmd.x_fim = SIZE_MAX;
+                cmd.area = true;
+                cmd.tipo = def->tipo;
+                return cmd;
+            }
+            if (!ler_intervalo(&p, colunas, &cmd.x, &cmd.x_fim, &cmd.area)) return cmd;
+            // Limpar não tem versão de uma célula: é sempre em área
+            if (def->tipo == CMD_LIMPAR) cmd.area = true;
+            break;
+        }
+    }
+
+    if (proximo_token(&p).tipo == TOKEN_FIM) cmd.tipo = def->tipo;
+    return cmd;
+}
+
+//Executa revelar/acorde/bandeira no motor, sem mexer na linha do tempo.
+ResultadoJogada executar_movimento(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y) {
+    switch (tipo) {
+        case MOV_REVELAR:
+        case MOV_ACORDE:
+            return aplicar_revelar(t, x, y);
+
+        case MOV_BANDEIRA:
+            if (ESTA_REVELADA(CELULA_EM(t, x, y))) return JOGADA_NADA;
+            alternar_bandeira(t, x, y);
+            return JOGADA_FEITA;
+
+        default:
+            return JOGADA_NADA;
+    }
+}
+
+//Executa um movimento em área (MOV_*_AREA) no retângulo (x, y)-(x_fim, y_fim), inclusive, num lote
+//de undo só. As bandeiras só mudam onde precisam: pôr não mexe nas que já estão, tirar não mexe
+//nas células sem bandeira.
+ResultadoJogada executar_area(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    if (tipo == MOV_REVELAR_AREA) {
+        if (!comecar_revelar_area(t, x, y, x_fim, y_fim)) return JOGADA_NADA;
+        avancar_revelacao(t, SIZE_MAX, 0);
+        return concluir_revelar(t);
+    }
+
+    uint64_t inicio = agora_ns();
+    bool por = tipo == MOV_BANDEIRA_AREA;
+    size_t mudadas = 0;
+    for (size_t cy = y; cy <= y_fim; cy++) {
+        for (size_t cx = x; cx <= x_fim; cx += 64) {
+            for (uint64_t b = bits_da_area(t, cx, x_fim, cy, !por); b; b &= b - 1) {
+                size_t nx = cx + (size_t)__builtin_ctzll(b);
+                Celula cel = CELULA_EM(t, nx, cy);
+                if (!mudadas++) empilhar_inicio_lote(t);
+                empilhar_undo(t, nx, cy, cel, false);
+                if (por) lista_dupla_adicionar(t, nx, cy);
+                else lista_dupla_remover(t, nx, cy);
+                DEFINIR_BANDEIRA(cel, por);
+                escrever_celula(t, nx, cy, cel);
+            }
+        }
+    }
+    registrar_tempo(t, OP_BANDEIRA, inicio, mudadas);
+    return mudadas ? JOGADA_FEITA : JOGADA_NADA;
+}
+
+// --- LINHA DO TEMPO (REFAZER E CHECKPOINTS) ---
+
+// Escreve um varint em 'destino' (7 bits por byte) e devolve quantos bytes usou.
+size_t escrever_varint_memoria(unsigned char *destino, uint64_t valor) {
+    size_t n = 0;
+    do {
+        destino[n] = valor & 0x7f;
+        valor >>= 7;
+        if (valor) destino[n] |= 0x80;
+        n++;
+    } while (valor);
+    return n;
+}
+
+// Tira um checkpoint do tabuleiro como está agora.
+void tirar_checkpoint(Tabuleiro *t, Checkpoint *c) {
+    size_t total = CELULAS_ALOCADAS(t);  // na ordem da memória: o checkpoint nunca sai do processo
+
+    // RLE: no pior caso cada célula vira 2 bytes
+    unsigned char *buf = alocar(t, 2 * total + 16);
+    if (!buf) {
+        perror("ERRO: malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < total; ) {
+        size_t repeticoes = 1;
+        while (i + repeticoes < total && t->celulas[i + repeticoes] == t->celulas[i]) repeticoes++;
+        n += escrever_varint_memoria(buf + n, repeticoes);
+        buf[n++] = t->celulas[i];
+        i += repeticoes;
+    }
+    c->celulas = realloc(buf, n);
+    if (!c->celulas) c->celulas = buf;
+    c->tamanho = n;
+
+    c->celulas_reveladas = t->celulas_reveladas;
+    c->estado_aleatorio = t->estado_aleatorio;
+    c->primeiro_clique_pendente = t->primeiro_clique_pendente;
+    c->hash = t->hash;
+
+    // Bandeiras na ordem da lista (do início para o fim)
+    c->qtd_bandeiras = 0;
+    for (NoListaDupla *b = t->inicio_bandeiras; b; b = b->proximo) c->qtd_bandeiras++;
+    c->bandeiras = c->qtd_bandeiras ? alocar(t, 2 * c->qtd_bandeiras * sizeof(size_t)) : NULL;
+    size_t i = 0;
+    for (NoListaDupla *b = t->inicio_bandeiras; b; b = b->proximo) {
+        c->bandeiras[i++] = b->x;
+        c->bandeiras[i++] = b->y;
+    }
+}
+
+void liberar_checkpoint(Tabuleiro *t, Checkpoint *c) {
+    liberar(t, c->celulas);
+    liberar(t, c->bandeiras);
+    *c = (Checkpoint){0};
+}
+
+size_t bytes_checkpoint(const Checkpoint *c) {
+    return c->tamanho + 2 * c->qtd_bandeiras * sizeof(size_t);
+}
+
+// Checkpoint de onde se chega à jogada 'destino': o último tirado antes dela que não foi afinado.
+size_t checkpoint_para(const LinhaDoTempo *l, size_t destino) {
+    size_t k = destino / INTERVALO_CHECKPOINT;
+    if (k >= l->qtd_checkpoints) k = l->qtd_checkpoints - 1;
+    return k <= l->checkpoints_afinados ? 0 : k;
+}
+
+// Volta o tabuleiro para o checkpoint 'k'. A pilha de undo recomeça vazia a partir dele.
+void restaurar_checkpoint(Tabuleiro *t, size_t k) {
+    LinhaDoTempo *l = &t->linha;
+    const Checkpoint *c = &l->checkpoints[k];
+
+    while (t->pilha_desfazer)
+        liberar(t, desempilhar_no(t));
+    while (t->inicio_bandeiras)
+        lista_dupla_remover(t, t->inicio_bandeiras->x, t->inicio_bandeiras->y);
+
+    const unsigned char *p = c->celulas, *fim = c->celulas + c->tamanho;
+    size_t i = 0;
+    while (p < fim) {
+        uint64_t repeticoes = 0;
+        for (unsigned desloc = 0; ; desloc += 7) {
+            unsigned char b = *p++;
+            repeticoes |= (uint64_t)(b & 0x7f) << desloc;
+            if (!(b & 0x80)) break;
+        }
+        memset(t->celulas + i, *p++, repeticoes);
+        i += repeticoes;
+    }
+
+    // A lista insere no início, então reconstrói de trás para frente
+    for (size_t b = c->qtd_bandeiras; b-- > 0; )
+        lista_dupla_adicionar(t, c->bandeiras[2 * b], c->bandeiras[2 * b + 1]);
+
+    t->celulas_reveladas = c->celulas_reveladas;
+    t->estado_aleatorio = c->estado_aleatorio;
+    t->primeiro_clique_pendente = c->primeiro_clique_pendente;
+    t->hash = c->hash;
+    bits_reconstruir(t);
+    if (c->primeiro_clique_pendente) t->jogada_protecao = SIZE_MAX;
+    l->posicao = k * INTERVALO_CHECKPOINT;
+}
+
+// Com o histórico acima de --desfazer-bytes, corta primeiro a pilha de undo (até o lote do topo)
+// e depois afina os checkpoints, dos mais antigos para os mais novos. O 0, de onde toda jogada
+// pode ser refeita, e o último ficam sempre; pular para perto de um afinado refaz a partir do 0.
+void aplicar_limite_linha(Tabuleiro *t) {
+    LinhaDoTempo *l = &t->linha;
+    aplicar_limite_desfazer(t);
+    while (t->limite_bytes && bytes_historico(t) > t->limite_bytes &&
+           l->checkpoints_afinados + 2 < l->qtd_checkpoints) {
+        Checkpoint *c = &l->checkpoints[++l->checkpoints_afinados];
+        l->bytes_checkpoints -= bytes_checkpoint(c);
+        liberar_checkpoint(t, c);
+    }
+}
+
+// Tira o checkpoint da posição atual se ela cai no intervalo e ainda não tem um.
+void checkpoint_se_preciso(Tabuleiro *t) {
+    LinhaDoTempo *l = &t->linha;
+    if (l->posicao % INTERVALO_CHECKPOINT != 0) return;
+    if (l->posicao / INTERVALO_CHECKPOINT != l->qtd_checkpoints) return;
+
+    if (l->qtd_checkpoints == l->capacidade_checkpoints) {
+        l->capacidade_checkpoints = l->capacidade_checkpoints ? 2 * l->capacidade_checkpoints : 16;
+        l->checkpoints = realloc(l->checkpoints, l->capacidade_checkpoints * sizeof(Checkpoint));
+        if (!l->checkpoints) {
+            perror("ERRO: realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    Checkpoint *c = &l->checkpoints[l->qtd_checkpoints++];
+    tirar_checkpoint(t, c);
+    l->bytes_checkpoints += bytes_checkpoint(c);
+    aplicar_limite_linha(t);
+}
+
+// Acrescenta uma jogada nova. Se havia jogadas desfeitas depois da posição, elas deixam de existir.
+// (x_fim, y_fim) é o outro canto das jogadas em área; nas outras, a própria célula.
+void linha_registrar_area(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    LinhaDoTempo *l = &t->linha;
+
+    if (l->posicao < l->qtd_jogadas) {
+        l->qtd_jogadas = l->posicao;
+        size_t manter = l->posicao / INTERVALO_CHECKPOINT + 1;
+        while (l->qtd_checkpoints > manter) {
+            Checkpoint *c = &l->checkpoints[--l->qtd_checkpoints];
+            l->bytes_checkpoints -= bytes_checkpoint(c);
+            liberar_checkpoint(t, c);
+        }
+        if (l->checkpoints_afinados >= l->qtd_checkpoints)
+            l->checkpoints_afinados = l->qtd_checkpoints ? l->qtd_checkpoints - 1 : 0;
+    }
+
+    if (l->qtd_jogadas == l->capacidade_jogadas) {
+        l->capacidade_jogadas = l->capacidade_jogadas ? 2 * l->capacidade_jogadas : 64;
+        l->jogadas = realloc(l->jogadas, l->capacidade_jogadas * sizeof(Jogada));
+        if (!l->jogadas) {
+            perror("ERRO: realloc");
+            exit(EXIT_FAILURE);
+        }
+        aplicar_limite_linha(t);
+    }
+
+    l->jogadas[l->qtd_jogadas++] = (Jogada){ .tipo = tipo, .x = (uint32_t)x, .y = (uint32_t)y,
+                                             .x_fim = (uint32_t)x_fim, .y_fim = (uint32_t)y_fim };
+    l->posicao = l->qtd_jogadas;
+    checkpoint_se_preciso(t);
+}
+
+void linha_registrar(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y) {
+    linha_registrar_area(t, tipo, x, y, x, y);
+}
+
+// Reaplica a próxima jogada desfeita.
+ResultadoJogada refazer_jogada(Tabuleiro *t) {
+    LinhaDoTempo *l = &t->linha;
+    if (l->posicao >= l->qtd_jogadas) return JOGADA_NADA;
+
+    const Jogada *j = &l->jogadas[l->posicao];
+    ResultadoJogada r = MOVIMENTO_EM_AREA(j->tipo) ? executar_area(t, j->tipo, j->x, j->y, j->x_fim, j->y_fim)
+                                                   : executar_movimento(t, j->tipo, j->x, j->y);
+    l->posicao++;
+    checkpoint_se_preciso(t);
+    return r;
+}
+
+// Como o jogo está: mina revelada, vitória ou em andamento.
+ResultadoJogada situacao_do_jogo(Tabuleiro *t) {
+    for (size_t i = 0; i < CELULAS_ALOCADAS(t); i++)
+        if (ESTA_REVELADA(t->celulas[i]) && EH_MINA(t->celulas[i])) return JOGADA_MINA;
+    return verificar_vitoria(t) ? JOGADA_VITORIA : JOGADA_FEITA;
+}
+
+// Pula para a jogada 'destino': um checkpoint restaurado e no máximo INTERVALO_CHECKPOINT jogadas reaplicadas.
+ResultadoJogada ir_para_jogada(Tabuleiro *t, size_t destino) {
+    LinhaDoTempo *l = &t->linha;
+    if (destino > l->qtd_jogadas || destino == l->posicao || l->qtd_checkpoints == 0)
+        return JOGADA_NADA;
+
+    uint64_t inicio = agora_ns();
+    size_t k = checkpoint_para(l, destino);
+
+    // Para frente, a partir de uma posição depois do checkpoint, basta reaplicar
+    if (destino < l->posicao || l->posicao < k * INTERVALO_CHECKPOINT)
+        restaurar_checkpoint(t, k);
+
+    size_t reaplicadas = destino - l->posicao;
+    while (l->posicao < destino)
+        refazer_jogada(t);
+
+    trace_span("ir_para_jogada", inicio, "jogadas_reaplicadas", reaplicadas);
+    return situacao_do_jogo(t);
+}
+
+// Volta uma jogada: pela pilha de undo se ela ainda tem o lote, senão pela linha do tempo.
+ResultadoJogada desfazer_jogada(Tabuleiro *t) {
+    LinhaDoTempo *l = &t->linha;
+    if (l->posicao == 0) return JOGADA_NADA;
+
+    // A pilha não desfaz a troca de minas do primeiro clique: essa jogada volta pelo checkpoint
+    if (l->posicao - 1 != t->jogada_protecao && t->lotes_desfazer > 0 && pilha_desfazer(t)) {
+        l->posicao--;
+        return JOGADA_FEITA;
+    }
+    return ir_para_jogada(t, l->posicao - 1);
+}
+
+void liberar_linha_do_tempo(Tabuleiro *t) {
+    LinhaDoTempo *l = &t->linha;
+    for (size_t k = 0; k < l->qtd_checkpoints; k++)
+        liberar_checkpoint(t, &l->checkpoints[k]);
+    free(l->checkpoints);
+    free(l->jogadas);
+    *l = (LinhaDoTempo){0};
+}
+
+// --validar: para no primeiro movimento que deixa o tabuleiro inconsistente (abort deixa o core)
+void validar_movimento(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y) {
+    if (validar_jogadas && !validar_tabuleiro(t)) {
+        fprintf(stderr, "ERRO: tabuleiro inconsistente depois do movimento %d em (%zu, %zu), jogada %zu\n",
+                (int)tipo, y, x, t->linha.posicao);
+        abort();
+    }
+}
+
+//Anda a revelação pendente por mais uma fatia (ver comecar_movimento). Quando a fila esvazia, a
+//jogada entra na linha do tempo e o resultado final sai; antes disso, JOGADA_EM_ANDAMENTO.
+ResultadoJogada continuar_movimento(Tabuleiro *t, size_t max_celulas, uint64_t max_ns) {
+    RevelacaoPendente *rp = &t->revelacao;
+    if (!rp->ativa) return JOGADA_NADA;
+    if (!avancar_revelacao(t, max_celulas, max_ns)) return JOGADA_EM_ANDAMENTO;
+
+    TipoMovimento tipo = (TipoMovimento)rp->tipo;
+    size_t x = rp->x, y = rp->y, x_fim = rp->x_fim, y_fim = rp->y_fim;
+    ResultadoJogada r = concluir_revelar(t);
+    linha_registrar_area(t, tipo, x, y, x_fim, y_fim);
+    validar_movimento(t, tipo, x, y);
+    return r;
+}
+
+//Aplica um movimento, com revelar limitado a uma fatia ('max_celulas' células ou 'max_ns' de
+//relógio, 0 = sem limite). Se a fatia acabar antes da BFS, devolve JOGADA_EM_ANDAMENTO: a jogada
+//fica em t->revelacao e o front end segue com continuar_movimento ou desiste com cancelar_movimento.
+//Um movimento novo termina antes a revelação pendente, então desfazer e a linha do tempo nunca a
+//veem pela metade.
+ResultadoJogada comecar_movimento(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y,
+                                  size_t max_celulas, uint64_t max_ns) {
+    if (t->revelacao.ativa) continuar_movimento(t, SIZE_MAX, 0);
+
+    ResultadoJogada r;
+    switch (tipo) {
+        case MOV_DESFAZER:
+            r = desfazer_jogada(t);
+            break;
+
+        case MOV_REFAZER:
+            r = refazer_jogada(t);
+            break;
+
+        case MOV_IR:
+            r = ir_para_jogada(t, x);
+            break;
+
+        case MOV_REVELAR:
+        case MOV_ACORDE:
+            // O estado inicial é o checkpoint 0
+            checkpoint_se_preciso(t);
+
+            // Só entra na linha do tempo o que abriu um lote de undo (mudou o tabuleiro)
+            if (!comecar_revelar(t, x, y)) {
+                r = JOGADA_NADA;
+                break;
+            }
+            t->revelacao.tipo = tipo;
+            return continuar_movimento(t, max_celulas, max_ns);
+
+        default: {
+            checkpoint_se_preciso(t);
+
+            size_t lotes_antes = t->lotes_criados;
+            r = executar_movimento(t, tipo, x, y);
+            if (t->lotes_criados == lotes_antes) r = JOGADA_NADA;
+            else linha_registrar(t, tipo, x, y);
+        }
+    }
+
+    validar_movimento(t, tipo, x, y);
+    return r;
+}
+
+//Desiste da revelação pendente: o tabuleiro volta para antes da jogada, que não entra na linha
+//do tempo. O lote dela está no topo da pilha; a troca de minas do primeiro clique volta pelo checkpoint.
+void cancelar_movimento(Tabuleiro *t) {
+    RevelacaoPendente *rp = &t->revelacao;
+    if (!rp->ativa) return;
+
+    bool protecao = rp->protecao;
+    descartar_revelacao(t);
+
+    if (protecao || !pilha_desfazer(t)) {
+        LinhaDoTempo *l = &t->linha;
+        size_t destino = l->posicao;
+        restaurar_checkpoint(t, checkpoint_para(l, destino));
+        while (l->posicao < destino)
+            refazer_jogada(t);
+    }
+    validar_movimento(t, MOV_DESFAZER, 0, 0);
+}
+
+//Aplica um movimento qualquer ao tabuleiro, de uma vez. É a entrada única do motor, usada pelo jogo e pelo replay.
+ResultadoJogada aplicar_movimento(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y) {
+    return comecar_movimento(t, tipo, x, y, SIZE_MAX, 0);
+}
+
+//Como aplicar_movimento, para os movimentos em área: o retângulo (x, y)-(x_fim, y_fim) inteiro é
+//uma jogada só na linha do tempo, e revelar faz uma inundação só para todas as células dele.
+ResultadoJogada aplicar_area(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    if (t->revelacao.ativa) continuar_movimento(t, SIZE_MAX, 0);
+    checkpoint_se_preciso(t);
+
+    if (tipo == MOV_REVELAR_AREA) {
+        if (comecar_revelar_area(t, x, y, x_fim, y_fim)) {
+            t->revelacao.tipo = tipo;
+            return continuar_movimento(t, SIZE_MAX, 0);
+        }
+        validar_movimento(t, tipo, x, y);
+        return JOGADA_NADA;
+    }
+
+    ResultadoJogada r = executar_area(t, tipo, x, y, x_fim, y_fim);
+    if (r != JOGADA_NADA) linha_registrar_area(t, tipo, x, y, x_fim, y_fim);
+    validar_movimento(t, tipo, x, y);
+    return r;
+}
+
+//Lista todas as bandeiras usando a lista duplamente encadeada.
+void listar_bandeiras(Tabuleiro *tab) {
+    printf("Células com Bandeira: ");
+    NoListaDupla *atual = tab->inicio_bandeiras;
+    if (!atual) printf("(Nenhuma)");
+
+    while (atual) {
+        printf("[%zu, %zu] ", atual->x, atual->y);
+        atual = atual->proximo;
+    }
+
+    printf("\nPressione Enter...");
+    char tmp[10];
+    ler_entrada(tmp, 10);
+}
+
+// Escreve uma duração com a unidade mais legível (ns, µs, ms ou s).
+void formatar_duracao(char *destino, size_t tamanho, uint64_t ns) {
+    if (ns < 1000)             snprintf(destino, tamanho, "%llu ns", (unsigned long long)ns);
+    else if (ns < 1000000)     snprintf(destino, tamanho, "%.1f µs", ns / 1e3);
+    else if (ns < 1000000000u) snprintf(destino, tamanho, "%.2f ms", ns / 1e6);
+    else                       snprintf(destino, tamanho, "%.2f s", ns / 1e9);
+}
+
+// Bytes a mais que o texto UTF-8 ocupa além das colunas que aparecem (para alinhar com printf).
+int bytes_extras_utf8(const char *texto) {
+    int extras = 0;
+    for (; *texto; texto++)
+        if (((unsigned char)*texto & 0xc0) == 0x80) extras++;
+    return extras;
+}
+
+//Imprime p50, p99 e máximo de cada operação, o volume processado e as alocações.
+void imprimir_estatisticas(Tabuleiro *t) {
+    static const char *const nomes[QTD_OPERACOES] = {
+        "geração", "revelar", "acorde", "desfazer", "bandeira", "desenho", "entrada", "sem chute",
+    };
+    static const char *const unidades[QTD_OPERACOES] = {
+        "células", "células", "células", "células", "células", "bytes", "bytes", "candidatos",
+    };
+
+    printf("--- Estatísticas ---\n");
+    printf("%-*s %8s %10s %10s %*s  %s\n",
+           10 + bytes_extras_utf8("operação"), "operação", "qtd", "p50", "p99",
+           10 + bytes_extras_utf8("máx"), "máx", "volume");
+
+    for (size_t op = 0; op < QTD_OPERACOES; op++) {
+        const Histograma *h = &t->estat.operacoes[op];
+        if (h->quantidade == 0) continue;
+
+        char p50[16], p99[16], maximo[16];
+        formatar_duracao(p50, sizeof(p50), percentil_histograma(h, 50));
+        formatar_duracao(p99, sizeof(p99), percentil_histograma(h, 99));
+        formatar_duracao(maximo, sizeof(maximo), h->maximo_ns);
+
+        printf("%-*s %8llu %*s %*s %*s  %llu %s (%.0f %s/s)\n",
+               10 + bytes_extras_utf8(nomes[op]), nomes[op],
+               (unsigned long long)h->quantidade,
+               10 + bytes_extras_utf8(p50), p50,
+               10 + bytes_extras_utf8(p99), p99,
+               10 + bytes_extras_utf8(maximo), maximo,
+               (unsigned long long)h->unidades, unidades[op],
+               h->total_ns ? h->unidades / (h->total_ns / 1e9) : 0.0, unidades[op]);
+    }
+
+    printf("Alocações: %llu | Liberações: %llu | Vivas: %llu\n",
+           (unsigned long long)t->estat.alocacoes,
+           (unsigned long long)t->estat.liberacoes,
+           (unsigned long long)(t->estat.alocacoes - t->estat.liberacoes));
+    printf("Células: %s | Em páginas grandes: %zu KiB | Faltas de página do processo: %llu\n",
+           t->bytes_mapeados ? "mmap" : "realloc", kib_paginas_grandes(),
+           (unsigned long long)faltas_de_pagina());
+}
+
+//Libera toda a memória usada pelo jogo.
+void liberar_memoria_jogo(Tabuleiro *tab) {
+    // Só libera os nós: não adianta restaurar células de um tabuleiro que vai embora
+    while (tab->pilha_desfazer)
+        liberar(tab, desempilhar_no(tab));
+    descartar_revelacao(tab);
+
+    while(tab->inicio_bandeiras)
+        lista_dupla_remover(tab, tab->inicio_bandeiras->x, tab->inicio_bandeiras->y);
+
+    liberar_linha_do_tempo(tab);
+
+    liberar_celulas(tab);
+    free(tab->bits_bandeira);
+    free(tab->bits_revelada);
+    free(tab->visivel);
+    free(tab->linhas_mudadas);
+    tab->bits_bandeira = tab->bits_revelada = NULL;
+    tab->visivel = NULL;
+    tab->linhas_mudadas = NULL;
+}
+
+// --- BUSCA DO JOGO ÓTIMO (TABULEIROS PEQUENOS E FINAIS) ---
+
+/*
+ * Calcula a jogada com a maior chance de vitória. O modelo tem até 64 células escondidas
+ * (um bit cada) e a lista de todas as configurações de minas que batem com o que está visível,
+ * todas com o mesmo peso. Valor de um estado = máximo, entre as células, da média dos valores
+ * dos estados que cada revelar pode produzir (mina = derrota).
+ * Podas: célula certamente segura é jogada sem comparar (revelar informação grátis nunca piora),
+ * mina certa nunca é candidata, simetrias do tabuleiro que preservam o estado deixam só um
+ * representante por órbita, e candidatos são testados do menor risco para o maior com corte
+ * pelo teto (1 - risco) contra o melhor já achado.
+ */
+#define MAX_CELULAS_BUSCA    64
+#define LIMITE_CONFIGURACOES (1u << 22)
+#define MEMORIA_RAIZES       ((size_t)256 << 20)  // primeiro clique: configurações alocadas ao mesmo tempo
+#define BITS_TABELA_TRANSP   20
+
+// Entrada da tabela de transposição, sem trava: guarda chave ^ valor, então uma escrita
+// rasgada entre duas threads não confere na leitura e vira só uma perda de cache.
+typedef struct {
+    _Atomic uint64_t chave_xor_valor;
+    _Atomic uint64_t valor;     // bits do double
+} EntradaTransposicao;
+
+typedef struct {
+    size_t n;                                   // células no modelo
+    uint64_t tudo;
+    uint64_t vizinhos[MAX_CELULAS_BUSCA];       // vizinhos de cada bit dentro do modelo
+    size_t x[MAX_CELULAS_BUSCA], y[MAX_CELULAS_BUSCA];
+    size_t minas;
+
+    // Permutações dos bits pelas simetrias do tabuleiro (só quando o modelo é o tabuleiro todo)
+    size_t qtd_simetrias;
+    uint8_t simetria[7][MAX_CELULAS_BUSCA];
+
+    EntradaTransposicao *tabela;
+    atomic_size_t nos;
+    atomic_size_t acertos_tabela;
+} ModeloBusca;
+
+size_t numero_no_modelo(const ModeloBusca *m, uint64_t config, size_t j) {
+    return (size_t)__builtin_popcountll(config & m->vizinhos[j]);
+}
+
+// Parte da chave que vem dos números mostrados pelas células 'abertas'. É um XOR por célula,
+// então cada revelar só soma as células novas.
+uint64_t chave_numeros(const ModeloBusca *m, uint64_t abertas, uint64_t config) {
+    uint64_t h = 0;
+    for (uint64_t r = abertas; r; r &= r - 1) {
+        size_t j = (size_t)__builtin_ctzll(r);
+        h ^= misturar64(((uint64_t)j << 8 | numero_no_modelo(m, config, j)) + 0x632be59bd9b4e019u);
+    }
+    return h;
+}
+
+// Chave do estado: células abertas e os números que elas mostram.
+uint64_t chave_estado(uint64_t abertas, uint64_t numeros) {
+    return misturar64(abertas) ^ numeros;
+}
+
+// Abre 'c' (segura em 'config') com a cascata dos zeros e devolve as novas células abertas.
+uint64_t abrir_no_modelo(const ModeloBusca *m, uint64_t abertas, uint64_t config, size_t c) {
+    uint64_t novas = 0, pendentes = 1ull << c;
+    while (pendentes) {
+        size_t j = (size_t)__builtin_ctzll(pendentes);
+        pendentes &= pendentes - 1;
+        novas |= 1ull << j;
+        if (numero_no_modelo(m, config, j) == 0)
+            pendentes |= m->vizinhos[j] & ~(abertas | novas);
+    }
+    return abertas | novas;
+}
+
+// Tira dos candidatos as células que uma simetria do estado leva para um índice menor.
+uint64_t filtrar_simetrias(const ModeloBusca *m, uint64_t abertas, uint64_t config, uint64_t candidatos) {
+    for (size_t g = 0; g < m->qtd_simetrias; g++) {
+        const uint8_t *p = m->simetria[g];
+        bool preserva = true;
+        for (uint64_t r = abertas; r && preserva; r &= r - 1) {
+            size_t j = (size_t)__builtin_ctzll(r);
+            preserva = ((abertas >> p[j]) & 1) &&
+                       numero_no_modelo(m, config, j) == numero_no_modelo(m, config, p[j]);
+        }
+        if (!preserva) continue;
+
+        for (uint64_t r = candidatos; r; r &= r - 1) {
+            size_t c = (size_t)__builtin_ctzll(r);
+            if (p[c] < c) candidatos &= ~(1ull << c);
+        }
+    }
+    return candidatos;
+}
+
+typedef struct {
+    uint64_t chave;     // resultado que o jogador vê depois do revelar
+    uint64_t abertas;
+    uint64_t numeros;
+    uint64_t config;
+} Desfecho;
+
+int comparar_desfechos(const void *a, const void *b) {
+    uint64_t ca = ((const Desfecho *)a)->chave, cb = ((const Desfecho *)b)->chave;
+    return (ca > cb) - (ca < cb);
+}
+
+double valor_estado(ModeloBusca *m, uint64_t abertas, uint64_t numeros, const uint64_t *configs, size_t qtd);
+
+// Chance de vencer revelando 'c': as configurações são separadas pelo que o jogador veria.
+double valor_jogada(ModeloBusca *m, uint64_t abertas, uint64_t numeros,
+                    const uint64_t *configs, size_t qtd, size_t c) {
+    Desfecho *d = malloc(qtd * sizeof(Desfecho));
+    uint64_t *grupo = malloc(qtd * sizeof(uint64_t));
+    if (!d || !grupo) {
+        perror("ERRO: malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t vivos = 0;
+    for (size_t i = 0; i < qtd; i++) {
+        if ((configs[i] >> c) & 1) continue;  // mina: derrota
+        uint64_t novas = abrir_no_modelo(m, abertas, configs[i], c);
+        uint64_t h = numeros ^ chave_numeros(m, novas & ~abertas, configs[i]);
+        d[vivos++] = (Desfecho){ chave_estado(novas, h), novas, h, configs[i] };
+    }
+    qsort(d, vivos, sizeof(Desfecho), comparar_desfechos);
+
+    double soma = 0;
+    for (size_t i = 0; i < vivos; ) {
+        size_t n = 0;
+        for (size_t k = i; k < vivos && d[k].chave == d[i].chave; k++)
+            grupo[n++] = d[k].config;
+        soma += n * valor_estado(m, d[i].abertas, d[i].numeros, grupo, n);
+        i += n;
+    }
+
+    free(d);
+    free(grupo);
+    return soma / qtd;
+}
+
+double valor_estado(ModeloBusca *m, uint64_t abertas, uint64_t numeros, const uint64_t *configs, size_t qtd) {
+    uint64_t escondidas = m->tudo & ~abertas;
+    if ((size_t)__builtin_popcountll(escondidas) == m->minas) return 1.0;  // só sobraram minas
+    if (qtd == 1) return 1.0;  // uma configuração só: o jogador já sabe onde está cada mina
+    atomic_fetch_add_explicit(&m->nos, 1, memory_order_relaxed);
+
+    uint64_t chave = chave_estado(abertas, numeros);
+    EntradaTransposicao *e = &m->tabela[chave & ((1u << BITS_TABELA_TRANSP) - 1)];
+    uint64_t bits = atomic_load_explicit(&e->valor, memory_order_relaxed);
+    if ((atomic_load_explicit(&e->chave_xor_valor, memory_order_relaxed) ^ bits) == chave) {
+        atomic_fetch_add_explicit(&m->acertos_tabela, 1, memory_order_relaxed);
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    uint64_t em_todas = ~0ull, em_alguma = 0;
+    for (size_t i = 0; i < qtd; i++) {
+        em_todas &= configs[i];
+        em_alguma |= configs[i];
+    }
+
+    double melhor = 0;
+    uint64_t seguras = escondidas & ~em_alguma;
+    if (seguras) {
+        melhor = valor_jogada(m, abertas, numeros, configs, qtd, (size_t)__builtin_ctzll(seguras));
+    } else {
+        uint64_t candidatos = filtrar_simetrias(m, abertas, configs[0], escondidas & ~em_todas);
+
+        // Risco de cada candidato = em quantas configurações ele é mina
+        size_t risco[MAX_CELULAS_BUSCA] = {0}, ordem[MAX_CELULAS_BUSCA], qtd_cand = 0;
+        for (size_t i = 0; i < qtd; i++)
+            for (uint64_t r = configs[i] & candidatos; r; r &= r - 1)
+                risco[__builtin_ctzll(r)]++;
+        for (uint64_t r = candidatos; r; r &= r - 1) {
+            size_t c = (size_t)__builtin_ctzll(r), k = qtd_cand++;
+            while (k > 0 && risco[ordem[k - 1]] > risco[c]) {
+                ordem[k] = ordem[k - 1];
+                k--;
+            }
+            ordem[k] = c;
+        }
+
+        for (size_t k = 0; k < qtd_cand; k++) {
+            // Nem vencendo sempre que sobrevive este candidato passaria o melhor
+            if ((double)(qtd - risco[ordem[k]]) / qtd <= melhor) break;
+            double v = valor_jogada(m, abertas, numeros, configs, qtd, ordem[k]);
+            if (v > melhor) melhor = v;
+        }
+    }
+
+    memcpy(&bits, &melhor, sizeof(bits));
+    atomic_store_explicit(&e->valor, bits, memory_order_relaxed);
+    atomic_store_explicit(&e->chave_xor_valor, chave ^ bits, memory_order_relaxed);
+    return melhor;
+}
+
+// Quantas combinações de 'k' entre 'n' (SIZE_MAX se não couber).
+size_t combinacoes(size_t n, size_t k) {
+    if (k > n) return 0;
+    if (k > n - k) k = n - k;
+    size_t c = 1;
+    for (size_t i = 1; i <= k; i++) {
+        // c * (n - k + i) é sempre múltiplo de i
+        if (c > SIZE_MAX / (n - k + i)) return SIZE_MAX;
+        c = c * (n - k + i) / i;
+    }
+    return c;
+}
+
+// Combinações de 'k' bits de 'livres' em 'saida' (até 'limite'). Devolve quantas gerou, ou SIZE_MAX se passou.
+size_t enumerar_combinacoes(uint64_t livres, size_t k, uint64_t *saida, size_t limite) {
+    size_t pos[MAX_CELULAS_BUSCA], n = 0, qtd = 0;
+    for (uint64_t r = livres; r; r &= r - 1) pos[n++] = (size_t)__builtin_ctzll(r);
+    if (k > n) return 0;
+
+    // Índices escolhidos em ordem crescente, avançando como um odômetro
+    size_t idx[MAX_CELULAS_BUSCA];
+    for (size_t i = 0; i < k; i++) idx[i] = i;
+    for (;;) {
+        if (qtd == limite) return SIZE_MAX;
+        uint64_t c = 0;
+        for (size_t i = 0; i < k; i++) c |= 1ull << pos[idx[i]];
+        saida[qtd++] = c;
+
+        size_t i = k;
+        while (i > 0 && idx[i - 1] == n - k + i - 1) i--;
+        if (i == 0) return qtd;
+        idx[i - 1]++;
+        for (size_t j = i; j < k; j++) idx[j] = idx[j - 1] + 1;
+    }
+}
+
+// Executa tarefa(ctx, i) para i em [0, qtd) em até 'max_threads' threads (a atual incluída).
+typedef struct {
+    void (*tarefa)(void *ctx, size_t i);
+    void *ctx;
+    size_t qtd;
+    atomic_size_t proxima;
+} PoolTarefas;
+
+void *trabalhador_pool(void *arg) {
+    PoolTarefas *p = arg;
+    for (size_t i; (i = atomic_fetch_add(&p->proxima, 1)) < p->qtd; )
+        p->tarefa(p->ctx, i);
+    return NULL;
+}
+
+void executar_em_paralelo(size_t qtd, void (*tarefa)(void *ctx, size_t i), void *ctx, size_t max_threads) {
+    PoolTarefas p = { .tarefa = tarefa, .ctx = ctx, .qtd = qtd };
+    atomic_init(&p.proxima, 0);
+
+    size_t qtd_threads = threads_do_gerador();
+    if (qtd_threads > max_threads) qtd_threads = max_threads;
+    if (qtd_threads > qtd) qtd_threads = qtd ? qtd : 1;
+    pthread_t threads[64];
+    size_t criadas = 0;
+    for (size_t i = 1; i < qtd_threads; i++)
+        if (pthread_create(&threads[criadas], NULL, trabalhador_pool, &p) == 0) criadas++;
+    trabalhador_pool(&p);
+    for (size_t i = 0; i < criadas; i++)
+        pthread_join(threads[i], NULL);
+}
+
+// Jogadas da raiz, avaliadas uma por tarefa do pool.
+typedef struct {
+    ModeloBusca *m;
+    const uint64_t *configs;    // NULL: primeiro clique, cada tarefa sorteia as suas
+    size_t qtd;
+    size_t candidatos[MAX_CELULAS_BUSCA];
+    double valores[MAX_CELULAS_BUSCA];
+    size_t configs_avaliadas[MAX_CELULAS_BUSCA];
+    size_t largura, altura;     // primeiro clique: o tabuleiro todo é o modelo
+} RaizBusca;
+
+void avaliar_raiz(void *ctx, size_t i) {
+    RaizBusca *r = ctx;
+    size_t c = r->candidatos[i];
+
+    if (r->configs) {
+        r->valores[i] = valor_jogada(r->m, 0, 0, r->configs, r->qtd, c);
+        r->configs_avaliadas[i] = r->qtd;
+        return;
+    }
+
+    // Primeiro clique: as minas nunca ficam na área protegida em volta dele
+    Tabuleiro dims = { .largura = r->largura, .altura = r->altura, .qtd_minas = r->m->minas };
+    size_t area[4];
+    calcular_area_protegida(&dims, r->m->x[c], r->m->y[c], area);
+    uint64_t livres = 0;
+    for (size_t j = 0; j < r->m->n; j++)
+        if (!dentro_da_area(area, r->m->x[j], r->m->y[j])) livres |= 1ull << j;
+
+    // Só o que esta jogada precisa; buscar_raiz limita quantas rodam juntas
+    size_t total = combinacoes((size_t)__builtin_popcountll(livres), r->m->minas);
+    uint64_t *configs = total <= LIMITE_CONFIGURACOES ? malloc((total ? total : 1) * sizeof(uint64_t)) : NULL;
+    size_t qtd = configs ? enumerar_combinacoes(livres, r->m->minas, configs, total) : SIZE_MAX;
+    r->configs_avaliadas[i] = qtd;
+    r->valores[i] = (qtd == SIZE_MAX || qtd == 0) ? -1 : valor_jogada(r->m, 0, 0, configs, qtd, c);
+    free(configs);
+}
+
+// Modelo com o tabuleiro inteiro, com as simetrias do retângulo (ou do quadrado).
+void modelo_tabuleiro_inteiro(ModeloBusca *m, size_t largura, size_t altura, size_t minas) {
+    m->n = largura * altura;
+    m->tudo = m->n == 64 ? ~0ull : (1ull << m->n) - 1;
+    m->minas = minas;
+    for (size_t j = 0; j < m->n; j++) {
+        m->x[j] = j % largura;
+        m->y[j] = j / largura;
+        m->vizinhos[j] = 0;
+        for (size_t d = 0; d < 8; d++) {
+            size_t nx = m->x[j] + direcoes[d][0], ny = m->y[j] + direcoes[d][1];
+            if (nx < largura && ny < altura) m->vizinhos[j] |= 1ull << (ny * largura + nx);
+        }
+    }
+
+    // Espelhos e rotação de 180°; no quadrado também as transpostas e as rotações de 90°
+    size_t qtd = largura == altura ? 7 : 3;
+    for (size_t g = 0; g < qtd; g++) {
+        for (size_t j = 0; j < m->n; j++) {
+            size_t x = m->x[j], y = m->y[j], mx = largura - 1 - x, my = altura - 1 - y, nx, ny;
+            switch (g) {
+                case 0:  nx = mx; ny = y;  break;
+                case 1:  nx = x;  ny = my; break;
+                case 2:  nx = mx; ny = my; break;
+                case 3:  nx = y;  ny = x;  break;
+                case 4:  nx = my; ny = mx; break;
+                case 5:  nx = my; ny = x;  break;
+                default: nx = y;  ny = mx; break;
+            }
+            m->simetria[g][j] = (uint8_t)(ny * largura + nx);
+        }
+    }
+    m->qtd_simetrias = qtd;
+}
+
+bool preparar_busca(ModeloBusca *m) {
+    m->tabela = calloc((size_t)1 << BITS_TABELA_TRANSP, sizeof(EntradaTransposicao));
+    atomic_init(&m->nos, 0);
+    atomic_init(&m->acertos_tabela, 0);
+    return m->tabela != NULL;
+}
+
+// Busca em todas as jogadas da raiz em paralelo; devolve o índice da melhor em r->candidatos.
+// No primeiro clique cada tarefa aloca as suas configurações (no pior caso as das n - 1 células
+// fora do clique), então as threads são limitadas para caber em MEMORIA_RAIZES.
+size_t buscar_raiz(RaizBusca *r, size_t qtd_candidatos) {
+    size_t max_threads = SIZE_MAX;
+    if (!r->configs) {
+        size_t por_tarefa = combinacoes(r->m->n - 1, r->m->minas);
+        if (por_tarefa > LIMITE_CONFIGURACOES) por_tarefa = LIMITE_CONFIGURACOES;
+        max_threads = MEMORIA_RAIZES / ((por_tarefa ? por_tarefa : 1) * sizeof(uint64_t));
+        if (max_threads == 0) max_threads = 1;
+    }
+    executar_em_paralelo(qtd_candidatos, avaliar_raiz, r, max_threads);
+    size_t melhor = 0;
+    for (size_t i = 1; i < qtd_candidatos; i++)
+        if (r->valores[i] > r->valores[melhor]) melhor = i;
+    return melhor;
+}
+
+// Primeiro clique: os candidatos são os representantes das órbitas do tabuleiro vazio.
+size_t candidatos_primeiro_clique(const ModeloBusca *m, size_t *saida) {
+    uint64_t cand = filtrar_simetrias(m, 0, 0, m->tudo);
+    size_t n = 0;
+    for (uint64_t r = cand; r; r &= r - 1) saida[n++] = (size_t)__builtin_ctzll(r);
+    return n;
+}
+
+// Monta o modelo com as células escondidas de uma partida em andamento e lista as
+// configurações que batem com os números visíveis. Devolve false se não couber.
+typedef struct {
+    const ModeloBusca *m;
+    uint64_t mascaras[8 * MAX_CELULAS_BUSCA];  // escondidas em volta de cada número da fronteira
+    size_t exigidas[8 * MAX_CELULAS_BUSCA];
+    size_t qtd_restricoes;
+    size_t fronteira;           // bits [0, fronteira) tocam algum número; o resto é miolo
+    uint64_t *saida;
+    size_t qtd, limite;
+} Enumeracao;
+
+bool restricoes_possiveis(const Enumeracao *e, uint64_t config, uint64_t definidas) {
+    for (size_t k = 0; k < e->qtd_restricoes; k++) {
+        size_t ja = (size_t)__builtin_popcountll(config & e->mascaras[k]);
+        size_t livres = (size_t)__builtin_popcountll(e->mascaras[k] & ~definidas);
+        if (ja > e->exigidas[k] || ja + livres < e->exigidas[k]) return false;
+    }
+    return true;
+}
+
+void enumerar_fronteira(Enumeracao *e, size_t i, uint64_t config, size_t usadas) {
+    if (e->qtd == SIZE_MAX || usadas > e->m->minas) return;
+    uint64_t definidas = i == 64 ? ~0ull : (1ull << i) - 1;
+    if (!restricoes_possiveis(e, config, definidas)) return;
+
+    if (i == e->fronteira) {
+        // Miolo: qualquer combinação com as minas que faltam
+        uint64_t miolo = e->m->tudo & ~definidas;
+        size_t faltam = e->m->minas - usadas;
+        if (faltam > (size_t)__builtin_popcountll(miolo)) return;
+        size_t n = enumerar_combinacoes(miolo, faltam, e->saida + e->qtd, e->limite - e->qtd);
+        if (n == SIZE_MAX) {
+            e->qtd = SIZE_MAX;
+            return;
+        }
+        for (size_t k = 0; k < n; k++) e->saida[e->qtd + k] |= config;
+        e->qtd += n;
+        return;
+    }
+
+    enumerar_fronteira(e, i + 1, config, usadas);
+    enumerar_fronteira(e, i + 1, config | 1ull << i, usadas + 1);
+}
+
+bool modelo_da_partida(Tabuleiro *t, ModeloBusca *m, uint64_t *configs, size_t *qtd) {
+    size_t ordem[MAX_CELULAS_BUSCA], n = 0;
+    size_t *bit = malloc(t->largura * t->altura * sizeof(size_t));
+    if (!bit) return false;
+
+    Enumeracao e = { .m = m, .saida = configs, .limite = LIMITE_CONFIGURACOES };
+
+    // Uma mina revelada (partida perdida) não é restrição nem falta no modelo; os números em
+    // volta dela a descontam
+    size_t minas_reveladas = 0;
+    for (size_t i = 0; i < t->largura * t->altura; i++) {
+        Celula cel = CELULA_EM(t, i % t->largura, i / t->largura);
+        if (ESTA_REVELADA(cel) && EH_MINA(cel)) minas_reveladas++;
+    }
+
+    // Fronteira primeiro, depois o miolo
+    for (int passo = 0; passo < 2; passo++) {
+        for (size_t i = 0; i < t->largura * t->altura; i++) {
+            size_t x = i % t->largura, y = i / t->largura;
+            if (ESTA_REVELADA(CELULA_EM(t, x, y))) continue;
+            bool fronteira = false;
+            for (size_t d = 0; d < 8 && !fronteira; d++) {
+                size_t nx = x + direcoes[d][0], ny = y + direcoes[d][1];
+                fronteira = nx < t->largura && ny < t->altura && ESTA_REVELADA(CELULA_EM(t, nx, ny)) &&
+                            !EH_MINA(CELULA_EM(t, nx, ny));
+            }
+            if (fronteira != (passo == 0)) continue;
+            if (n == MAX_CELULAS_BUSCA) {
+                free(bit);
+                return false;
+            }
+            bit[i] = n;
+            ordem[n++] = i;
+        }
+        if (passo == 0) e.fronteira = n;
+    }
+
+    m->n = n;
+    m->tudo = n == 64 ? ~0ull : (1ull << n) - 1;
+    m->minas = t->qtd_minas - minas_reveladas;
+    m->qtd_simetrias = 0;  // as células do modelo não formam um retângulo
+    for (size_t j = 0; j < n; j++) {
+        m->x[j] = ordem[j] % t->largura;
+        m->y[j] = ordem[j] / t->largura;
+        m->vizinhos[j] = 0;
+        for (size_t d = 0; d < 8; d++) {
+            size_t nx = m->x[j] + direcoes[d][0], ny = m->y[j] + direcoes[d][1];
+            if (nx < t->largura && ny < t->altura && !ESTA_REVELADA(CELULA_EM(t, nx, ny)))
+                m->vizinhos[j] |= 1ull << bit[ny * t->largura + nx];
+        }
+    }
+
+    // Restrições: cada número revelado com escondidas em volta
+    for (size_t i = 0; i < t->largura * t->altura; i++) {
+        size_t x = i % t->largura, y = i / t->largura;
+        if (!ESTA_REVELADA(CELULA_EM(t, x, y)) || EH_MINA(CELULA_EM(t, x, y))) continue;
+        uint64_t mascara = 0;
+        size_t vistas = 0;      // minas reveladas em volta já contam no número
+        for (size_t d = 0; d < 8; d++) {
+            size_t nx = x + direcoes[d][0], ny = y + direcoes[d][1];
+            if (nx >= t->largura || ny >= t->altura) continue;
+            Celula viz = CELULA_EM(t, nx, ny);
+            if (!ESTA_REVELADA(viz)) mascara |= 1ull << bit[ny * t->largura + nx];
+            else if (EH_MINA(viz)) vistas++;
+        }
+        if (!mascara) continue;
+        e.mascaras[e.qtd_restricoes] = mascara;
+        e.exigidas[e.qtd_restricoes++] = NUM_MINAS(CELULA_EM(t, x, y)) - vistas;
+    }
+    free(bit);
+
+    enumerar_fronteira(&e, 0, 0, 0);
+    *qtd = e.qtd;
+    return e.qtd != SIZE_MAX && e.qtd > 0;
+}
+
+// Estatísticas da busca numa linha.
+void imprimir_resumo_busca(ModeloBusca *m, size_t configuracoes, uint64_t inicio) {
+    printf("%zu configurações, %zu nós, %zu acertos na tabela, %.1f ms, %zu threads\n",
+           configuracoes, atomic_load(&m->nos), atomic_load(&m->acertos_tabela),
+           (agora_ns() - inicio) / 1e6, threads_do_gerador());
+}
+
+// Comando 'melhor': a jogada com maior chance de vitória na posição atual.
+void imprimir_melhor_jogada(Tabuleiro *t) {
+    if (t->topologia != TOPOLOGIA_QUADRADA) {
+        printf("A busca só conhece a grade quadrada (topologia atual: %s).\n",
+               nomes_topologia[t->topologia]);
+        return;
+    }
+    uint64_t inicio = agora_ns();
+    ModeloBusca *m = calloc(1, sizeof(ModeloBusca));
+    RaizBusca *r = calloc(1, sizeof(RaizBusca));
+    uint64_t *configs = malloc(LIMITE_CONFIGURACOES * sizeof(uint64_t));
+    if (!m || !r || !configs || !preparar_busca(m)) {
+        printf("Sem memória para a busca.\n");
+        goto fim;
+    }
+    r->m = m;
+
+    size_t qtd_candidatos = 0, configuracoes = 0;
+    if (t->primeiro_clique_pendente) {
+        if (t->largura * t->altura > MAX_CELULAS_BUSCA) {
+            printf("O primeiro clique é sempre seguro; a busca funciona a partir dele "
+                   "(ou desde o início em tabuleiros de até %d células).\n", MAX_CELULAS_BUSCA);
+            goto fim;
+        }
+        modelo_tabuleiro_inteiro(m, t->largura, t->altura, t->qtd_minas);
+        r->largura = t->largura;
+        r->altura = t->altura;
+        qtd_candidatos = candidatos_primeiro_clique(m, r->candidatos);
+    } else {
+        if (!modelo_da_partida(t, m, configs, &configuracoes)) {
+            printf("Posição grande demais para a busca (até %d células escondidas e %u configurações).\n",
+                   MAX_CELULAS_BUSCA, LIMITE_CONFIGURACOES);
+            goto fim;
+        }
+        r->configs = configs;
+        r->qtd = configuracoes;
+
+        uint64_t em_todas = ~0ull, em_alguma = 0;
+        for (size_t i = 0; i < configuracoes; i++) {
+            em_todas &= configs[i];
+            em_alguma |= configs[i];
+        }
+        uint64_t candidatos = m->tudo & ~em_alguma;
+        if (candidatos) candidatos &= -candidatos;  // já tem uma segura: ela basta
+        else candidatos = m->tudo & ~em_todas;
+        for (uint64_t b = candidatos; b; b &= b - 1)
+            r->candidatos[qtd_candidatos++] = (size_t)__builtin_ctzll(b);
+    }
+
+    size_t melhor = buscar_raiz(r, qtd_candidatos);
+    if (r->valores[melhor] < 0) {
+        printf("Configurações demais para a busca (limite %u).\n", LIMITE_CONFIGURACOES);
+        goto fim;
+    }
+    if (t->primeiro_clique_pendente) configuracoes = r->configs_avaliadas[melhor];
+
+    size_t c = r->candidatos[melhor];
+    printf("Melhor jogada: r %zu %zu (chance de vencer %.2f%%)\n", m->y[c], m->x[c], 100 * r->valores[melhor]);
+    imprimir_resumo_busca(m, configuracoes, inicio);
+
+fim:
+    if (m) free(m->tabela);
+    free(m);
+    free(r);
+    free(configs);
+}
+
+// --resolver LxAxM: chance de vencer com jogo perfeito a partir de cada primeiro clique.
+int resolver_tabuleiro(const char *especificacao) {
+    size_t largura, altura, minas;
+    if (sscanf(especificacao, "%zux%zux%zu", &largura, &altura, &minas) != 3 ||
+        largura == 0 || altura == 0 || largura > MAX_CELULAS_BUSCA / altura ||
+        minas >= largura * altura) {
+        fprintf(stderr, "ERRO: use --resolver LxAxM com no máximo %d células (ex.: 5x5x4)\n",
+                MAX_CELULAS_BUSCA);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t inicio = agora_ns();
+    ModeloBusca *m = calloc(1, sizeof(ModeloBusca));
+    RaizBusca *r = calloc(1, sizeof(RaizBusca));
+    if (!m || !r || !preparar_busca(m)) {
+        fprintf(stderr, "ERRO: sem memória para a busca\n");
+        return EXIT_FAILURE;
+    }
+    modelo_tabuleiro_inteiro(m, largura, altura, minas);
+    r->m = m;
+    r->largura = largura;
+    r->altura = altura;
+    size_t qtd = candidatos_primeiro_clique(m, r->candidatos);
+    size_t melhor = buscar_raiz(r, qtd);
+
+    // Cada célula mostra o valor do representante da sua órbita
+    printf("Chance de vencer (%%) por primeiro clique, %zux%zu com %zu minas:\n", largura, altura, minas);
+    for (size_t y = 0; y < altura; y++) {
+        for (size_t x = 0; x < largura; x++) {
+            size_t j = y * largura + x, rep = j;
+            for (size_t g = 0; g < m->qtd_simetrias; g++)
+                if (m->simetria[g][j] < rep) rep = m->simetria[g][j];
+            size_t i = 0;
+            while (r->candidatos[i] != rep) i++;
+            if (r->valores[i] < 0) printf("    --");
+            else printf(" %6.2f", 100 * r->valores[i]);
+        }
+        printf("\n");
+    }
+
+    int status = EXIT_SUCCESS;
+    if (r->valores[melhor] < 0) {
+        fprintf(stderr, "ERRO: configurações demais (limite %u)\n", LIMITE_CONFIGURACOES);
+        status = EXIT_FAILURE;
+    } else {
+        size_t c = r->candidatos[melhor];
+        printf("Melhor primeiro clique: r %zu %zu (%.4f%%)\n", m->y[c], m->x[c], 100 * r->valores[melhor]);
+        size_t configuracoes = 0;
+        for (size_t i = 0; i < qtd; i++)
+            if (r->valores[i] >= 0) configuracoes += r->configs_avaliadas[i];
+        imprimir_resumo_busca(m, configuracoes, inicio);
+    }
+
+    free(m->tabela);
+    free(m);
+    free(r);
+    return status;
+}
+
+// --- REPLAY (GRAVAÇÃO BINÁRIA DAS PARTIDAS) ---
+
+/*
+ * Formato do arquivo, uma partida atrás da outra:
+ *   cabeçalho:  "CMR4" semente largura altura qtd_minas limite_lotes limite_bytes opcoes [camadas]
+ *               (números em varint; opcoes: bit 0 = sem chute, bits 1-2 = topologia;
+ *               camadas só no 3D)
+ *   movimento:  tipo(1 byte) delta_us [x y [x_fim y_fim]]    (x, y só para revelar/bandeira/acorde;
+ *                                                             x_fim, y_fim só nos movimentos em área)
+ *   fim:        0x7f delta_us hash                           (hash Zobrist depois do último movimento)
+ * delta_us é o tempo desde o registro anterior, em microssegundos.
+ * Um cabeçalho novo começa com 'C', que nunca é um tipo de movimento.
+ */
+#define REPLAY_MAGICO "CMR4"
+#define REPLAY_OPCAO_SEM_CHUTE 1
+#define REPLAY_DESLOC_TOPOLOGIA 1
+#define REPLAY_HASH 0x7f
+#define REPLAY_TAM_MAGICO 4
+
+typedef struct {
+    FILE *arquivo;
+    uint64_t ultimo_ns;  // momento do último registro gravado
+    bool partida_aberta; // já gravou o cabeçalho e ainda não o hash final
+    uint64_t hash;       // hash do tabuleiro depois do último movimento gravado
+} GravadorReplay;
+
+// Gravador da sessão atual (arquivo NULL = não grava)
+static GravadorReplay gravador = {0};
+
+// Escreve um inteiro sem sinal em varint (7 bits por byte, bit alto = continua).
+void escrever_varint(FILE *f, uint64_t valor) {
+    unsigned char buf[10];
+    size_t n = 0;
+    do {
+        buf[n] = valor & 0x7f;
+        valor >>= 7;
+        if (valor) buf[n] |= 0x80;
+        n++;
+    } while (valor);
+    fwrite(buf, 1, n, f);
+}
+
+// Lê um varint de [*p, fim). Devolve false se o arquivo acabou no meio do número.
+bool ler_varint(const unsigned char **p, const unsigned char *fim, uint64_t *valor) {
+    uint64_t v = 0;
+    for (unsigned desloc = 0; *p < fim && desloc < 64; desloc += 7) {
+        unsigned char b = *(*p)++;
+        v |= (uint64_t)(b & 0x7f) << desloc;
+        if (!(b & 0x80)) {
+            *valor = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Abre (ou cria) o arquivo de replay da sessão.
+bool gravador_abrir(GravadorReplay *g, const char *caminho) {
+    g->arquivo = fopen(caminho, "wb");
+    if (!g->arquivo) {
+        perror("ERRO: replay");
+        return false;
+    }
+    return true;
+}
+
+// Grava o cabeçalho de uma partida que acabou de começar.
+void gravador_iniciar_partida(GravadorReplay *g, Tabuleiro *t) {
+    if (!g->arquivo) return;
+
+    fwrite(REPLAY_MAGICO, 1, REPLAY_TAM_MAGICO, g->arquivo);
+    escrever_varint(g->arquivo, t->semente);
+    escrever_varint(g->arquivo, t->largura);
+    escrever_varint(g->arquivo, t->altura);
+    escrever_varint(g->arquivo, t->qtd_minas);
+    // O limite do undo muda o resultado de 'd', então faz parte da partida
+    escrever_varint(g->arquivo, t->limite_lotes);
+    escrever_varint(g->arquivo, t->limite_bytes);
+    escrever_varint(g->arquivo, (t->sem_chute ? REPLAY_OPCAO_SEM_CHUTE : 0) |
+                                (unsigned)t->topologia << REPLAY_DESLOC_TOPOLOGIA);
+    if (t->topologia == TOPOLOGIA_3D) escrever_varint(g->arquivo, t->camadas);
+    fflush(g->arquivo);
+    g->ultimo_ns = agora_ns();
+    g->partida_aberta = true;
+    g->hash = t->hash;
+}
+
+// Grava um movimento com o tempo desde o anterior.
+// Partida carregada de um snapshot não tem cabeçalho no replay: seus movimentos ficam de fora.
+void gravador_registrar_area(GravadorReplay *g, TipoMovimento tipo, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    if (!g->arquivo || !g->partida_aberta) return;
+
+    uint64_t agora = agora_ns();
+    fputc(tipo, g->arquivo);
+    escrever_varint(g->arquivo, (agora - g->ultimo_ns) / 1000);
+    if (tipo != MOV_DESFAZER && tipo != MOV_REFAZER) {
+        escrever_varint(g->arquivo, x);
+        escrever_varint(g->arquivo, y);
+    }
+    if (MOVIMENTO_EM_AREA(tipo)) {
+        escrever_varint(g->arquivo, x_fim);
+        escrever_varint(g->arquivo, y_fim);
+    }
+    // Sem buffer pendente: um replay de partida que travou continua completo
+    fflush(g->arquivo);
+    g->ultimo_ns = agora;
+}
+
+void gravador_registrar(GravadorReplay *g, TipoMovimento tipo, size_t x, size_t y) {
+    gravador_registrar_area(g, tipo, x, y, x, y);
+}
+
+// Fecha a partida com o hash final: a reprodução confere se chegou no mesmo estado.
+void gravador_finalizar_partida(GravadorReplay *g) {
+    if (!g->arquivo || !g->partida_aberta) return;
+
+    uint64_t agora = agora_ns();
+    fputc(REPLAY_HASH, g->arquivo);
+    escrever_varint(g->arquivo, (agora - g->ultimo_ns) / 1000);
+    escrever_varint(g->arquivo, g->hash);
+    fflush(g->arquivo);
+    g->ultimo_ns = agora;
+    g->partida_aberta = false;
+}
+
+void gravador_fechar(GravadorReplay *g) {
+    gravador_finalizar_partida(g);
+    if (g->arquivo) fclose(g->arquivo);
+    g->arquivo = NULL;
+}
+
+//Continua a revelação em fatias do jogador; ela só vai para o replay quando termina.
+ResultadoJogada continuar_jogada(Tabuleiro *t, size_t max_celulas, uint64_t max_ns) {
+    RevelacaoPendente *rp = &t->revelacao;
+    if (!rp->ativa) return JOGADA_NADA;
+
+    TipoMovimento tipo = (TipoMovimento)rp->tipo;
+    size_t x = rp->x, y = rp->y, x_fim = rp->x_fim, y_fim = rp->y_fim;
+    ResultadoJogada r = continuar_movimento(t, max_celulas, max_ns);
+    if (r != JOGADA_EM_ANDAMENTO) {
+        gravador_registrar_area(&gravador, tipo, x, y, x_fim, y_fim);
+        gravador.hash = t->hash;
+    }
+    return r;
+}
+
+//Faz um movimento do jogador: grava no replay (se ligado) e aplica no motor.
+ResultadoJogada jogar(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y) {
+    // A revelação pendente vai para o replay antes do movimento que a interrompe
+    if (t->revelacao.ativa) continuar_jogada(t, SIZE_MAX, 0);
+    gravador_registrar(&gravador, tipo, x, y);
+    ResultadoJogada r = aplicar_movimento(t, tipo, x, y);
+    gravador.hash = t->hash;
+    return r;
+}
+
+//Como jogar, para os movimentos em área (ver aplicar_area).
+ResultadoJogada jogar_area(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    if (t->revelacao.ativa) continuar_jogada(t, SIZE_MAX, 0);
+    gravador_registrar_area(&gravador, tipo, x, y, x_fim, y_fim);
+    ResultadoJogada r = aplicar_area(t, tipo, x, y, x_fim, y_fim);
+    gravador.hash = t->hash;
+    return r;
+}
+
+//Como jogar, mas revelar anda só uma fatia (ver comecar_movimento); o resto vem de continuar_jogada.
+ResultadoJogada jogar_em_fatias(Tabuleiro *t, TipoMovimento tipo, size_t x, size_t y,
+                                size_t max_celulas, uint64_t max_ns) {
+    if (tipo != MOV_REVELAR && tipo != MOV_ACORDE) return jogar(t, tipo, x, y);
+    if (t->revelacao.ativa) continuar_jogada(t, SIZE_MAX, 0);
+
+    ResultadoJogada r = comecar_movimento(t, tipo, x, y, max_celulas, max_ns);
+    if (r != JOGADA_EM_ANDAMENTO) {
+        gravador_registrar(&gravador, tipo, x, y);
+        gravador.hash = t->hash;
+    }
+    return r;
+}
+
+// Lê o arquivo inteiro para a memória.
+unsigned char *ler_arquivo(const char *caminho, size_t *tamanho) {
+    FILE *f = fopen(caminho, "rb");
+    if (!f) {
+        perror("ERRO: replay");
+        return NULL;
+    }
+
+    size_t capacidade = 1 << 16;
+    unsigned char *dados = malloc(capacidade);
+    *tamanho = 0;
+
+    while (dados) {
+        *tamanho += fread(dados + *tamanho, 1, capacidade - *tamanho, f);
+        if (*tamanho < capacidade) break;
+        capacidade *= 2;
+        unsigned char *maior = realloc(dados, capacidade);
+        if (!maior) free(dados);
+        dados = maior;
+    }
+
+    fclose(f);
+    if (!dados) perror("ERRO: malloc");
+    return dados;
+}
+
+// Espera até 'alvo_ns' no relógio monotônico (reprodução em tempo real).
+void esperar_ate(uint64_t alvo_ns) {
+    uint64_t agora = agora_ns();
+    if (alvo_ns <= agora) return;
+
+    struct timespec ts = {
+        .tv_sec  = (time_t)((alvo_ns - agora) / 1000000000u),
+        .tv_nsec = (long)((alvo_ns - agora) % 1000000000u),
+    };
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * Reproduz todas as partidas do arquivo chamando o motor diretamente, sem interpretar texto.
+ * Com 'tempo_real' respeita os intervalos gravados e desenha cada movimento.
+ * 'repeticoes' roda o arquivo várias vezes (útil para medir o motor).
+ */
+int reproduzir_replay(const char *caminho, bool tempo_real, size_t repeticoes) {
+    size_t tamanho;
+    unsigned char *dados = ler_arquivo(caminho, &tamanho);
+    if (!dados) return EXIT_FAILURE;
+
+    Tabuleiro t = {0};
+    size_t total_movimentos = 0, partidas = 0;
+    int status = EXIT_SUCCESS;
+    uint64_t inicio = agora_ns();
+
+    for (size_t rep = 0; rep < repeticoes && status == EXIT_SUCCESS; rep++) {
+        const unsigned char *p = dados, *fim = dados + tamanho;
+
+        while (p < fim) {
+            uint64_t semente, largura, altura, minas, limite_lotes, limite_bytes, opcoes, camadas = 1;
+            if ((size_t)(fim - p) < REPLAY_TAM_MAGICO ||
+                memcmp(p, REPLAY_MAGICO, REPLAY_TAM_MAGICO) != 0) {
+                fprintf(stderr, "ERRO: replay corrompido (cabeçalho esperado no byte %zu)\n",
+                        (size_t)(p - dados));
+                status = EXIT_FAILURE;
+                break;
+            }
+            p += REPLAY_TAM_MAGICO;
+
+            if (!ler_varint(&p, fim, &semente) || !ler_varint(&p, fim, &largura) ||
+                !ler_varint(&p, fim, &altura) || !ler_varint(&p, fim, &minas) ||
+                !ler_varint(&p, fim, &limite_lotes) || !ler_varint(&p, fim, &limite_bytes) ||
+                !ler_varint(&p, fim, &opcoes) ||
+                (((opcoes >> REPLAY_DESLOC_TOPOLOGIA) & 3) == TOPOLOGIA_3D && !ler_varint(&p, fim, &camadas)) ||
+                largura == 0 || altura == 0 || largura > SIZE_MAX / altura || minas >= largura * altura ||
+                !topologia_valida((Topologia)((opcoes >> REPLAY_DESLOC_TOPOLOGIA) & 3), largura, altura, camadas)) {
+                fprintf(stderr, "ERRO: replay corrompido (cabeçalho inválido)\n");
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            t.largura = largura;
+            t.altura = altura;
+            t.qtd_minas = minas;
+            t.semente = semente;
+            t.limite_lotes = limite_lotes;
+            t.limite_bytes = limite_bytes;
+            t.sem_chute = opcoes & REPLAY_OPCAO_SEM_CHUTE;
+            t.topologia = (Topologia)((opcoes >> REPLAY_DESLOC_TOPOLOGIA) & 3);
+            t.camadas = camadas;
+            iniciar_jogo(&t);
+
+            size_t movimentos = 0;
+            ResultadoJogada resultado = JOGADA_NADA;
+            uint64_t hash_final = t.hash;
+            bool conferido = false;
+            uint64_t relogio = agora_ns();
+            if (tempo_real) atualizar_tela(&t);
+
+            // Movimentos até o próximo cabeçalho
+            while (p < fim && *p != (unsigned char)REPLAY_MAGICO[0]) {
+                TipoMovimento tipo = (TipoMovimento)*p++;
+                uint64_t delta_us, x = 0, y = 0, x_fim = 0, y_fim = 0;
+
+                bool ok = ler_varint(&p, fim, &delta_us);
+                if (tipo == REPLAY_HASH) {
+                    uint64_t hash_gravado;
+                    if (!ok || !ler_varint(&p, fim, &hash_gravado)) {
+                        fprintf(stderr, "ERRO: replay corrompido (hash incompleto)\n");
+                        status = EXIT_FAILURE;
+                        break;
+                    }
+                    // Comparar 64 bits substitui comparar o tabuleiro inteiro
+                    if (hash_gravado != hash_final) {
+                        fprintf(stderr, "ERRO: partida %zu divergiu do replay (hash %016llx, esperado %016llx)\n",
+                                partidas + 1, (unsigned long long)hash_final,
+                                (unsigned long long)hash_gravado);
+                        status = EXIT_FAILURE;
+                        break;
+                    }
+                    conferido = true;
+                    continue;
+                }
+
+                if (ok && tipo != MOV_DESFAZER && tipo != MOV_REFAZER)
+                    ok = ler_varint(&p, fim, &x) && ler_varint(&p, fim, &y);
+                if (ok && MOVIMENTO_EM_AREA(tipo))
+                    ok = ler_varint(&p, fim, &x_fim) && ler_varint(&p, fim, &y_fim) &&
+                         x <= x_fim && y <= y_fim && x_fim < t.largura && y_fim < t.altura;
+                // MOV_IR guarda o número da jogada em x, sem limite de tabuleiro
+                if (!ok || tipo < MOV_REVELAR || tipo > MOV_LIMPAR_AREA ||
+                    (tipo != MOV_IR && (x >= t.largura || y >= t.altura))) {
+                    fprintf(stderr, "ERRO: replay corrompido (movimento inválido no byte %zu)\n",
+                            (size_t)(p - dados));
+                    status = EXIT_FAILURE;
+                    break;
+                }
+
+                if (tempo_real) {
+                    relogio += delta_us * 1000;
+                    esperar_ate(relogio);
+                }
+
+                ResultadoJogada r = MOVIMENTO_EM_AREA(tipo) ? aplicar_area(&t, tipo, x, y, x_fim, y_fim)
+                                                            : aplicar_movimento(&t, tipo, x, y);
+                if (r != JOGADA_NADA) resultado = r;
+                hash_final = t.hash;
+                movimentos++;
+
+                if (tempo_real) {
+                    if (r == JOGADA_MINA) revelar_tabuleiro(&t);
+                    atualizar_tela(&t);
+                }
+            }
+
+            partidas++;
+            total_movimentos += movimentos;
+
+            // O incremental tem que bater com o hash refeito do zero
+            if (status == EXIT_SUCCESS && t.hash != hash_completo(&t)) {
+                fprintf(stderr, "ERRO: hash incremental inconsistente na partida %zu\n", partidas);
+                status = EXIT_FAILURE;
+            }
+
+            if (rep == 0) {
+                printf("Partida %zu: semente %llu, %llux%llu com %llu minas, %zu movimentos -> %s, hash %016llx%s\n",
+                       partidas,
+                       (unsigned long long)semente,
+                       (unsigned long long)largura, (unsigned long long)altura,
+                       (unsigned long long)minas,
+                       movimentos,
+                       resultado == JOGADA_MINA    ? "derrota" :
+                       resultado == JOGADA_VITORIA ? "vitória" : "não terminou",
+                       (unsigned long long)hash_final,
+                       conferido ? " (conferido)" : "");
+            }
+            liberar_memoria_jogo(&t);
+            if (status != EXIT_SUCCESS) break;
+        }
+    }
+
+    double segundos = (agora_ns() - inicio) / 1e9;
+    printf("%zu partidas, %zu movimentos em %.3f s (%.0f movimentos/s)\n",
+           partidas, total_movimentos, segundos,
+           segundos > 0 ? total_movimentos / segundos : 0.0);
+    imprimir_estatisticas(&t);
+
+    free(dados);
+    return status;
+}
+
+// --- SALVAR E CARREGAR SESSÃO (SNAPSHOT) ---
+
+/*
+ * Snapshot da sessão inteira, para continuar depois de fechar o jogo (ou de uma queda):
+ *   cabeçalho:  "CMS1" largura altura qtd_minas semente estado_aleatorio opcoes [camadas]
+ *               [x y do 1º clique]
+ *               candidatos_sem_chute ns_sem_chute jogada_protecao+1 celulas_reveladas hash
+ *               limite_lotes limite_bytes lotes_descartados lotes_criados
+ *   minas:      1 bit por célula; omitido quando a semente (e o 1º clique) refazem o tabuleiro
+ *   visível:    2 bits por célula (bandeira, revelada), 4 células por byte
+ *   bandeiras:  qtd e índices na ordem da lista
+ *   undo:       qtd de nós e, do fundo ao topo, índice << 1 | início_lote [valor antigo]
+ *   linha:      qtd posicao, (tipo x y [x_fim y_fim]) por jogada (o outro canto só nas jogadas em área)
+ *   estatísticas: por operação, totais e baldes não vazios (balde valor); alocações, liberações
+ * Números em varint. Dos checkpoints só vai o 0, e nem ele: é o tabuleiro recém-sorteado, que a
+ * semente refaz. Os outros voltam sozinhos na primeira vez que ir_para_jogada passar por eles.
+ * O arquivo é gravado num temporário e renomeado: uma queda no meio deixa o snapshot anterior inteiro.
+ */
+#define SNAPSHOT_MAGICO "CMS1"
+#define SNAPSHOT_MINAS_DA_SEMENTE  1
+#define SNAPSHOT_PRIMEIRO_CLIQUE   2   // primeiro_clique_pendente
+#define SNAPSHOT_SEM_CHUTE         4
+#define SNAPSHOT_PROTEGIDO         8   // as minas saíram do 3x3 do 1º clique (x y no cabeçalho)
+#define SNAPSHOT_CHECKPOINT        16  // a linha do tempo já tinha o checkpoint 0
+#define SNAPSHOT_DESLOC_TOPOLOGIA  5   // bits 5-6: Topologia (no 3D, camadas vem logo depois)
+
+void snapshot_varint(Quadro *q, uint64_t valor) {
+    quadro_reservar(q, 10);
+    q->tamanho += escrever_varint_memoria((unsigned char *)q->dados + q->tamanho, valor);
+}
+
+void snapshot_bytes(Quadro *q, const void *dados, size_t n) {
+    quadro_reservar(q, n);
+    memcpy(q->dados + q->tamanho, dados, n);
+    q->tamanho += n;
+}
+
+bool salvar_sessao(Tabuleiro *t, const char *caminho) {
+    uint64_t inicio = agora_ns();
+    size_t total = t->largura * t->altura;
+    LinhaDoTempo *l = &t->linha;
+    Quadro q = {0};
+    quadro_reservar(&q, total / 4 + total / 8 + 4096);
+
+    // A semente refaz as minas se o tabuleiro não foi trocado pelo gerador sem chute;
+    // a proteção do 1º clique é refeita a partir da jogada que a causou
+    bool protegido = !t->primeiro_clique_pendente && t->jogada_protecao < l->qtd_jogadas;
+    bool da_semente = t->candidatos_sem_chute == 0 && (t->primeiro_clique_pendente || protegido);
+    unsigned opcoes = (da_semente ? SNAPSHOT_MINAS_DA_SEMENTE : 0) |
+                      (t->primeiro_clique_pendente ? SNAPSHOT_PRIMEIRO_CLIQUE : 0) |
+                      (t->sem_chute ? SNAPSHOT_SEM_CHUTE : 0) |
+                      (protegido ? SNAPSHOT_PROTEGIDO : 0) |
+                      (l->qtd_checkpoints ? SNAPSHOT_CHECKPOINT : 0) |
+                      (unsigned)t->topologia << SNAPSHOT_DESLOC_TOPOLOGIA;
+
+    snapshot_bytes(&q, SNAPSHOT_MAGICO, 4);
+    uint64_t cabecalho[] = { t->largura, t->altura, t->qtd_minas, t->semente, t->estado_aleatorio, opcoes };
+    for (size_t i = 0; i < sizeof(cabecalho) / sizeof(cabecalho[0]); i++) snapshot_varint(&q, cabecalho[i]);
+    if (t->topologia == TOPOLOGIA_3D) snapshot_varint(&q, t->camadas);
+    if (protegido) {
+        snapshot_varint(&q, l->jogadas[t->jogada_protecao].x);
+        snapshot_varint(&q, l->jogadas[t->jogada_protecao].y);
+    }
+    uint64_t estado[] = {
+        t->candidatos_sem_chute, t->ns_sem_chute, t->jogada_protecao + 1, t->celulas_reveladas, t->hash,
+        t->limite_lotes, t->limite_bytes, t->lotes_descartados, t->lotes_criados,
+    };
+    for (size_t i = 0; i < sizeof(estado) / sizeof(estado[0]); i++) snapshot_varint(&q, estado[i]);
+
+    // Células: bitmap das minas (se preciso) e 2 bits do estado visível
+    if (!da_semente) {
+        quadro_reservar(&q, (total + 7) / 8);
+        unsigned char *p = (unsigned char *)q.dados + q.tamanho;
+        memset(p, 0, (total + 7) / 8);
+        for (size_t y = 0, i = 0; y < t->altura; y++)
+            for (size_t x = 0; x < t->largura; x++, i++)
+                p[i / 8] |= EH_MINA(CELULA_EM(t, x, y)) << (i % 8);
+        q.tamanho += (total + 7) / 8;
+    }
+    quadro_reservar(&q, (total + 3) / 4);
+    unsigned char *p = (unsigned char *)q.dados + q.tamanho;
+    memset(p, 0, (total + 3) / 4);
+    for (size_t y = 0, i = 0; y < t->altura; y++)
+        for (size_t x = 0; x < t->largura; x++, i++)
+            p[i / 4] |= ESTADO_VISIVEL(CELULA_EM(t, x, y)) << (2 * (i % 4));
+    q.tamanho += (total + 3) / 4;
+
+    size_t qtd = 0;
+    for (NoListaDupla *b = t->inicio_bandeiras; b; b = b->proximo) qtd++;
+    snapshot_varint(&q, qtd);
+    for (NoListaDupla *b = t->inicio_bandeiras; b; b = b->proximo)
+        snapshot_varint(&q, b->y * t->largura + b->x);
+
+    snapshot_varint(&q, t->bytes_desfazer / sizeof(NoPilha));
+    for (NoPilha *n = t->fundo_desfazer; n; n = n->anterior) {
+        if (n->inicio_lote) {
+            snapshot_varint(&q, 1);
+            continue;
+        }
+        snapshot_varint(&q, (n->y * t->largura + n->x) << 1);
+        snapshot_bytes(&q, &n->valor_antigo, 1);
+    }
+
+    snapshot_varint(&q, l->qtd_jogadas);
+    snapshot_varint(&q, l->posicao);
+    for (size_t i = 0; i < l->qtd_jogadas; i++) {
+        snapshot_bytes(&q, &l->jogadas[i].tipo, 1);
+        snapshot_varint(&q, l->jogadas[i].x);
+        snapshot_varint(&q, l->jogadas[i].y);
+        if (MOVIMENTO_EM_AREA(l->jogadas[i].tipo)) {
+            snapshot_varint(&q, l->jogadas[i].x_fim);
+            snapshot_varint(&q, l->jogadas[i].y_fim);
+        }
+    }
+
+    for (size_t op = 0; op < QTD_OPERACOES; op++) {
+        const Histograma *h = &t->estat.operacoes[op];
+        snapshot_varint(&q, h->quantidade);
+        snapshot_varint(&q, h->total_ns);
+        snapshot_varint(&q, h->maximo_ns);
+        snapshot_varint(&q, h->unidades);
+        size_t usados = 0;
+        for (size_t b = 0; b < QTD_BALDES_HISTOGRAMA; b++) usados += h->baldes[b] != 0;
+        snapshot_varint(&q, usados);
+        for (size_t b = 0; b < QTD_BALDES_HISTOGRAMA; b++) {
+            if (!h->baldes[b]) continue;
+            snapshot_varint(&q, b);
+            snapshot_varint(&q, h->baldes[b]);
+        }
+    }
+    snapshot_varint(&q, t->estat.alocacoes);
+    snapshot_varint(&q, t->estat.liberacoes);
+
+    // Temporário + rename: o snapshot antigo só some quando o novo está completo
+    char temporario[4096];
+    snprintf(temporario, sizeof(temporario), "%s.tmp", caminho);
+    FILE *f = fopen(temporario, "wb");
+    bool ok = f && fwrite(q.dados, 1, q.tamanho, f) == q.tamanho;
+    if (f && fclose(f) != 0) ok = false;
+    if (ok && rename(temporario, caminho) != 0) ok = false;
+    if (!ok) {
+        perror("ERRO: salvar");
+        remove(temporario);
+    } else {
+        printf("Sessão salva em %s (%.1f KB, %.2f ms).\n", caminho, q.tamanho / 1024.0, (agora_ns() - inicio) / 1e6);
+    }
+    free(q.dados);
+    return ok;
+}
+
+// Monta a sessão do snapshot em 'novo' (zerado). Devolve false se o arquivo está truncado ou incoerente.
+bool ler_snapshot(Tabuleiro *novo, const unsigned char *p, const unsigned char *fim) {
+    #define LER(destino) do { \
+        uint64_t v_; \
+        if (!ler_varint(&p, fim, &v_)) return false; \
+        (destino) = v_; \
+    } while (0)
+
+    if ((size_t)(fim - p) < 4 || memcmp(p, SNAPSHOT_MAGICO, 4) != 0) return false;
+    p += 4;
+
+    uint64_t opcoes, px = 0, py = 0, protecao;
+    LER(novo->largura);
+    LER(novo->altura);
+    LER(novo->qtd_minas);
+    LER(novo->semente);
+    LER(novo->estado_aleatorio);
+    LER(opcoes);
+    novo->topologia = (Topologia)((opcoes >> SNAPSHOT_DESLOC_TOPOLOGIA) & 3);
+    novo->camadas = 1;
+    if (novo->topologia == TOPOLOGIA_3D) LER(novo->camadas);
+    size_t total = novo->largura * novo->altura;
+    if (novo->largura == 0 || novo->altura == 0 || total / novo->largura != novo->altura ||
+        total > ((size_t)1 << 40) || novo->qtd_minas >= total ||
+        !topologia_valida(novo->topologia, novo->largura, novo->altura, novo->camadas))
+        return false;
+    montar_vizinhanca(novo);
+    if (opcoes & SNAPSHOT_PROTEGIDO) {
+        LER(px);
+        LER(py);
+        if (px >= novo->largura || py >= novo->altura) return false;
+    }
+    LER(novo->candidatos_sem_chute);
+    LER(novo->ns_sem_chute);
+    LER(protecao);
+    size_t reveladas;
+    uint64_t hash;
+    LER(reveladas);
+    LER(hash);
+    LER(novo->limite_lotes);
+    LER(novo->limite_bytes);
+    LER(novo->lotes_descartados);
+    size_t lotes_criados;
+    LER(lotes_criados);
+    novo->sem_chute = opcoes & SNAPSHOT_SEM_CHUTE;
+    novo->jogada_protecao = protecao - 1;
+
+    if (!preparar_celulas(novo)) return false;
+
+    // O mesmo sorteio de iniciar_jogo: dá o checkpoint 0 e, quase sempre, as minas da partida
+    uint64_t estado = novo->estado_aleatorio;
+    novo->estado_aleatorio = novo->semente;
+    distribuir_minas(novo, NULL);
+    LinhaDoTempo *l = &novo->linha;
+    if (opcoes & SNAPSHOT_CHECKPOINT) {
+        l->checkpoints = calloc(1, sizeof(Checkpoint));
+        if (!l->checkpoints) return false;
+        l->capacidade_checkpoints = l->qtd_checkpoints = 1;
+        novo->primeiro_clique_pendente = true;
+        tirar_checkpoint(novo, &l->checkpoints[0]);
+        l->bytes_checkpoints = l->checkpoints[0].tamanho;
+    }
+    novo->primeiro_clique_pendente = opcoes & SNAPSHOT_PRIMEIRO_CLIQUE;
+
+    // Minas: a proteção do 1º clique refeita, ou o bitmap quando o tabuleiro veio do gerador sem chute
+    if (opcoes & SNAPSHOT_MINAS_DA_SEMENTE) {
+        if (opcoes & SNAPSHOT_PROTEGIDO) proteger_primeiro_clique(novo, px, py);
+    } else {
+        memset(novo->celulas, 0, CELULAS_ALOCADAS(novo));
+        if ((size_t)(fim - p) < (total + 7) / 8) return false;
+        for (size_t y = 0, i = 0; y < novo->altura; y++) {
+            for (size_t x = 0; x < novo->largura; x++, i++) {
+                if ((p[i / 8] >> (i % 8)) & 1) DEFINIR_MINA(CELULA_EM(novo, x, y), true);
+            }
+        }
+        recalcular_numeros(novo);
+        p += (total + 7) / 8;
+    }
+    novo->estado_aleatorio = estado;
+
+    // Estado visível: confere a contagem de reveladas e o hash com o cabeçalho
+    if ((size_t)(fim - p) < (total + 3) / 4) return false;
+    for (size_t y = 0, i = 0; y < novo->altura; y++) {
+        for (size_t x = 0; x < novo->largura; x++, i++) {
+            unsigned visivel = (p[i / 4] >> (2 * (i % 4))) & 0x3;
+            CELULA_EM(novo, x, y) |= visivel << DESLOC_BANDEIRA;
+        }
+    }
+    p += (total + 3) / 4;
+    novo->celulas_reveladas = contar_celulas(novo).reveladas;
+    bits_reconstruir(novo);
+    novo->hash = hash_completo(novo);
+    if (novo->celulas_reveladas != reveladas || novo->hash != hash) return false;
+
+    // Bandeiras: a lista insere no início, então entra de trás para frente
+    size_t qtd;
+    LER(qtd);
+    if (qtd > total) return false;
+    size_t *indices = malloc((qtd ? qtd : 1) * sizeof(size_t));
+    if (!indices) return false;
+    for (size_t i = 0; i < qtd; i++) {
+        uint64_t v;
+        if (!ler_varint(&p, fim, &v) || v >= total) {
+            free(indices);
+            return false;
+        }
+        indices[i] = v;
+    }
+    for (size_t i = qtd; i-- > 0; )
+        lista_dupla_adicionar(novo, indices[i] % novo->largura, indices[i] / novo->largura);
+    free(indices);
+
+    // Undo, do fundo ao topo
+    LER(qtd);
+    for (size_t i = 0; i < qtd; i++) {
+        uint64_t v;
+        LER(v);
+        if ((v >> 1) >= total || (!(v & 1) && p >= fim)) return false;
+        NoPilha *n = alocar(novo, sizeof(NoPilha));
+        if (!n) return false;
+        n->x = (v >> 1) % novo->largura;
+        n->y = (v >> 1) / novo->largura;
+        n->inicio_lote = v & 1;
+        n->valor_antigo = n->inicio_lote ? 0 : *p++;
+        empilhar_no(novo, n);
+    }
+    novo->lotes_criados = lotes_criados;
+
+    // Linha do tempo
+    LER(qtd);
+    LER(l->posicao);
+    if (qtd > (size_t)(fim - p) || l->posicao > qtd) return false;
+    l->jogadas = malloc((qtd ? qtd : 1) * sizeof(Jogada));
+    if (!l->jogadas) return false;
+    l->capacidade_jogadas = qtd;
+    for (l->qtd_jogadas = 0; l->qtd_jogadas < qtd; l->qtd_jogadas++) {
+        Jogada *j = &l->jogadas[l->qtd_jogadas];
+        if (p >= fim) return false;
+        j->tipo = *p++;
+        // As coordenadas da jogada são de 32 bits: confere em 64 antes de guardar
+        uint64_t x, y, x_fim, y_fim;
+        LER(x);
+        LER(y);
+        if (x >= novo->largura || y >= novo->altura) return false;
+        x_fim = x;
+        y_fim = y;
+        if (MOVIMENTO_EM_AREA(j->tipo)) {
+            LER(x_fim);
+            LER(y_fim);
+            if (x_fim < x || y_fim < y || x_fim >= novo->largura || y_fim >= novo->altura)
+                return false;
+        }
+        if (x_fim > UINT32_MAX || y_fim > UINT32_MAX) return false;
+        j->x = (uint32_t)x;
+        j->y = (uint32_t)y;
+        j->x_fim = (uint32_t)x_fim;
+        j->y_fim = (uint32_t)y_fim;
+    }
+
+    for (size_t op = 0; op < QTD_OPERACOES; op++) {
+        Histograma *h = &novo->estat.operacoes[op];
+        LER(h->quantidade);
+        LER(h->total_ns);
+        LER(h->maximo_ns);
+        LER(h->unidades);
+        LER(qtd);
+        for (size_t i = 0; i < qtd; i++) {
+            size_t b;
+            LER(b);
+            if (b >= QTD_BALDES_HISTOGRAMA) return false;
+            LER(h->baldes[b]);
+        }
+    }
+    uint64_t alocacoes, liberacoes;
+    LER(alocacoes);
+    LER(liberacoes);
+    // Os objetos vivos foram recriados acima: a contagem volta a ser a da sessão salva
+    novo->estat.alocacoes = alocacoes;
+    novo->estat.liberacoes = liberacoes;
+    return p == fim;
+
+    #undef LER
+}
+
+// Troca a sessão atual pela do snapshot. Se o arquivo não serve, a sessão atual fica como está.
+bool carregar_sessao(Tabuleiro *t, const char *caminho) {
+    uint64_t inicio = agora_ns();
+    size_t tamanho;
+    unsigned char *dados = ler_arquivo(caminho, &tamanho);
+    if (!dados) return false;
+
+    Tabuleiro novo = {0};
+    bool ok = ler_snapshot(&novo, dados, dados + tamanho);
+    free(dados);
+    if (!ok) {
+        fprintf(stderr, "ERRO: snapshot inválido ou incompleto: %s\n", caminho);
+        liberar_memoria_jogo(&novo);
+        return false;
+    }
+
+    liberar_memoria_jogo(t);
+    *t = novo;
+    printf("Sessão carregada de %s (jogada %zu de %zu, %.2f ms).\n",
+           caminho, t->linha.posicao, t->linha.qtd_jogadas, (agora_ns() - inicio) / 1e6);
+    return true;
+}
+
+// --- SERVIDOR DE PARTIDAS (SOCKET UNIX) ---
+
+/*
+ * Protocolo em linhas, uma resposta por requisição e na mesma ordem:
+ *   novo L A M [SEMENTE]   -> ok ID
+ *   r ID y x | b ID y x    -> ok ID RESULTADO REVELADAS HASH
+ *   d ID | rf ID           -> ok ID RESULTADO REVELADAS HASH
+ *   ver ID                 -> ok ID LINHA/LINHA/...   ('.' escondida, 'F' bandeira, '*' mina, '0'-'8')
+ *   fim ID                 -> ok ID
+ * Erros: "erro MOTIVO". RESULTADO: nada, feita, mina ou vitoria.
+ * Cada conexão é entregue a uma thread só e suas partidas vivem nela (afinidade de sessão):
+ * nenhum Tabuleiro é tocado por duas threads, então não há trava no caminho das jogadas.
+ */
+#define MAX_TRABALHADORES     64
+#define TAM_LEITURA_SERVIDOR  65536
+#define MAX_LADO_SERVIDOR     1024
+// Respostas presas acima disto: a conexão para de ler até o cliente consumir o que já tem
+#define LIMITE_SAIDA_SERVIDOR (1u << 20)
+
+typedef struct {
+    int fd;
+    char *entrada;              // bytes lidos e ainda não atendidos (linha incompleta ou saída cheia)
+    size_t tamanho_entrada;
+    Quadro saida;               // respostas esperando o socket aceitar
+    size_t enviado;
+    Tabuleiro **sessoes;        // ID = índice; NULL = partida encerrada
+    size_t qtd_sessoes;
+    size_t capacidade_sessoes;
+} Conexao;
+
+// Contadores do servidor, somados por todas as threads
+static atomic_size_t servidor_sessoes_criadas;
+static atomic_size_t servidor_sessoes_ativas;
+static atomic_size_t servidor_jogadas;
+static atomic_size_t servidor_conexoes;
+static volatile sig_atomic_t servidor_parar = 0;
+
+void servidor_sinal(int sinal) {
+    (void)sinal;
+    servidor_parar = 1;
+}
+
+const char *nome_resultado(ResultadoJogada r) {
+    switch (r) {
+        case JOGADA_FEITA:   return "feita";
+        case JOGADA_MINA:    return "mina";
+        case JOGADA_VITORIA: return "vitoria";
+        default:             return "nada";
+    }
+}
+
+void encerrar_sessao(Conexao *c, size_t id) {
+    Tabuleiro *t = c->sessoes[id];
+    liberar_memoria_jogo(t);
+    free(t);
+    c->sessoes[id] = NULL;
+    atomic_fetch_sub_explicit(&servidor_sessoes_ativas, 1, memory_order_relaxed);
+}
+
+void fechar_conexao(Conexao *c) {
+    for (size_t id = 0; id < c->qtd_sessoes; id++)
+        if (c->sessoes[id]) encerrar_sessao(c, id);
+    close(c->fd);
+    free(c->sessoes);
+    free(c->entrada);
+    free(c->saida.dados);
+    free(c);
+    atomic_fetch_sub_explicit(&servidor_conexoes, 1, memory_order_relaxed);
+}
+
+// Cria uma partida na conexão e devolve o ID.
+size_t criar_sessao(Conexao *c, size_t largura, size_t altura, size_t minas, uint64_t semente) {
+    if (c->qtd_sessoes == c->capacidade_sessoes) {
+        c->capacidade_sessoes = c->capacidade_sessoes ? 2 * c->capacidade_sessoes : 16;
+        c->sessoes = realloc(c->sessoes, c->capacidade_sessoes * sizeof(Tabuleiro *));
+        if (!c->sessoes) {
+            perror("ERRO: realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    Tabuleiro *t = calloc(1, sizeof(Tabuleiro));
+    if (!t) {
+        perror("ERRO: calloc");
+        exit(EXIT_FAILURE);
+    }
+    t->largura = largura;
+    t->altura = altura;
+    t->qtd_minas = minas;
+    t->semente = semente;
+    iniciar_jogo(t);
+
+    c->sessoes[c->qtd_sessoes] = t;
+    atomic_fetch_add_explicit(&servidor_sessoes_criadas, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&servidor_sessoes_ativas, 1, memory_order_relaxed);
+    return c->qtd_sessoes++;
+}
+
+// Atende uma linha do cliente e escreve a resposta em c->saida.
+void atender_linha(Conexao *c, const char *linha) {
+    char cmd[8];
+    size_t id, a, b, m;
+    unsigned long long semente;
+    int lidos = sscanf(linha, "%7s %zu %zu %zu", cmd, &id, &a, &b);
+    if (lidos < 1) {
+        quadro_anexar(&c->saida, "erro linha vazia\n");
+        return;
+    }
+
+    if (strcmp(cmd, "novo") == 0) {
+        int n = sscanf(linha, "novo %zu %zu %zu %llu", &a, &b, &m, &semente);
+        if (n < 3 || a == 0 || b == 0 || a > MAX_LADO_SERVIDOR || b > MAX_LADO_SERVIDOR || m >= a * b) {
+            quadro_anexar(&c->saida, "erro uso: novo L A M [SEMENTE]\n");
+            return;
+        }
+        if (n < 4) semente = misturar64(atomic_load(&servidor_sessoes_criadas) + (uint64_t)agora_ns());
+        quadro_anexar(&c->saida, "ok %zu\n", criar_sessao(c, a, b, m, semente));
+        return;
+    }
+
+    // O comando é conferido antes da sessão: "xyz 1" é comando desconhecido
+    TipoMovimento tipo = MOV_REVELAR;
+    bool fim = strcmp(cmd, "fim") == 0, ver = strcmp(cmd, "ver") == 0;
+    if (strcmp(cmd, "b") == 0)       tipo = MOV_BANDEIRA;
+    else if (strcmp(cmd, "d") == 0)  tipo = MOV_DESFAZER;
+    else if (strcmp(cmd, "rf") == 0) tipo = MOV_REFAZER;
+    else if (!fim && !ver && strcmp(cmd, "r") != 0) {
+        quadro_anexar(&c->saida, "erro comando desconhecido\n");
+        return;
+    }
+
+    if (lidos < 2 || id >= c->qtd_sessoes || !c->sessoes[id]) {
+        quadro_anexar(&c->saida, "erro sessão inexistente\n");
+        return;
+    }
+    Tabuleiro *t = c->sessoes[id];
+
+    if (fim) {
+        encerrar_sessao(c, id);
+        quadro_anexar(&c->saida, "ok %zu\n", id);
+        return;
+    }
+
+    if (ver) {
+        quadro_anexar(&c->saida, "ok %zu ", id);
+        quadro_reservar(&c->saida, t->largura * t->altura + t->altura + 1);
+        char *p = c->saida.dados + c->saida.tamanho;
+        for (size_t y = 0; y < t->altura; y++) {
+            if (y) *p++ = '/';
+            for (size_t x = 0; x < t->largura; x++) {
+                Celula cel = CELULA_EM(t, x, y);
+                *p++ = TEM_BANDEIRA(cel)   ? 'F' :
+                       !ESTA_REVELADA(cel) ? '.' :
+                       EH_MINA(cel)        ? '*' : (char)('0' + NUM_MINAS(cel));
+            }
+        }
+        *p++ = '\n';
+        c->saida.tamanho = (size_t)(p - c->saida.dados);
+        return;
+    }
+
+    // r/b recebem linha e coluna, como no jogo
+    size_t x = 0, y = 0;
+    if (tipo == MOV_REVELAR || tipo == MOV_BANDEIRA) {
+        if (lidos < 4 || b >= t->largura || a >= t->altura) {
+            quadro_anexar(&c->saida, "erro coordenadas inválidas\n");
+            return;
+        }
+        y = a;
+        x = b;
+        if (tipo == MOV_REVELAR && ESTA_REVELADA(CELULA_EM(t, x, y))) tipo = MOV_ACORDE;
+    }
+
+    ResultadoJogada r = aplicar_movimento(t, tipo, x, y);
+    atomic_fetch_add_explicit(&servidor_jogadas, 1, memory_order_relaxed);
+    quadro_anexar(&c->saida, "ok %zu %s %zu %016llx\n", id, nome_resultado(r),
+                  t->celulas_reveladas, (unsigned long long)t->hash);
+}
+
+// Atende as linhas completas já lidas enquanto as respostas presas cabem no limite; o resto
+// fica em c->entrada para quando a saída esvaziar.
+void atender_pendentes(Conexao *c) {
+    char *inicio = c->entrada, *fim = c->entrada + c->tamanho_entrada, *nl;
+    while (c->saida.tamanho < LIMITE_SAIDA_SERVIDOR && (nl = memchr(inicio, '\n', (size_t)(fim - inicio)))) {
+        *nl = '\0';
+        if (nl > inicio && nl[-1] == '\r') nl[-1] = '\0';
+        atender_linha(c, inicio);
+        inicio = nl + 1;
+    }
+    c->tamanho_entrada = (size_t)(fim - inicio);
+    memmove(c->entrada, inicio, c->tamanho_entrada);
+}
+
+// Lê o que chegou e atende as linhas completas. Devolve false se a conexão acabou.
+bool conexao_ler(Conexao *c) {
+    // Saída cheia: nada é lido até conexao_escrever esvaziá-la (o epoll nem avisa de leitura)
+    if (c->saida.tamanho >= LIMITE_SAIDA_SERVIDOR) return true;
+
+    // Linha maior que o buffer inteiro: o cliente não segue o protocolo
+    if (c->tamanho_entrada == TAM_LEITURA_SERVIDOR) return false;
+
+    ssize_t n = read(c->fd, c->entrada + c->tamanho_entrada, TAM_LEITURA_SERVIDOR - c->tamanho_entrada);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+    c->tamanho_entrada += (size_t)n;
+    atender_pendentes(c);
+    return true;
+}
+
+// Manda o que der das respostas pendentes e, com a saída vazia, volta às linhas que esperavam
+// por ela. Devolve false se o socket quebrou.
+bool conexao_escrever(Conexao *c) {
+    do {
+        while (c->enviado < c->saida.tamanho) {
+            ssize_t n = write(c->fd, c->saida.dados + c->enviado, c->saida.tamanho - c->enviado);
+            if (n < 0) return errno == EAGAIN || errno == EINTR;
+            c->enviado += (size_t)n;
+        }
+        c->saida.tamanho = c->enviado = 0;
+        atender_pendentes(c);
+    } while (c->saida.tamanho);
+    return true;
+}
+
+void *trabalhador_servidor(void *arg) {
+    int ep = *(int *)arg;
+    struct epoll_event eventos[64];
+
+    for (;;) {
+        int n = epoll_wait(ep, eventos, 64, -1);
+        for (int i = 0; i < n; i++) {
+            Conexao *c = eventos[i].data.ptr;
+            bool viva = true;
+            if (eventos[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) viva = conexao_ler(c);
+            if (viva) viva = conexao_escrever(c);
+            if (!viva) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                fechar_conexao(c);
+                continue;
+            }
+
+            // Só pede aviso de escrita enquanto houver resposta presa, e de leitura enquanto a
+            // saída não passa do limite: um cliente que não lê as respostas não enche a memória
+            struct epoll_event ev = {
+                .events = (c->saida.tamanho < LIMITE_SAIDA_SERVIDOR ? EPOLLIN : 0) | (c->saida.tamanho ? EPOLLOUT : 0),
+                .data.ptr = c,
+            };
+            epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+        }
+    }
+    return NULL;
+}
+
+// --servidor CAMINHO: atende partidas até receber SIGINT/SIGTERM.
+int servir(const char *caminho) {
+    struct sockaddr_un end;
+    if (!endereco_unix(&end, caminho)) return EXIT_FAILURE;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(caminho);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&end, sizeof(end)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("ERRO: socket");
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, servidor_sinal);
+    signal(SIGTERM, servidor_sinal);
+
+    // Uma thread com seu próprio epoll por núcleo
+    size_t qtd = threads_do_gerador();
+    static int epolls[MAX_TRABALHADORES];
+    for (size_t i = 0; i < qtd; i++) {
+        pthread_t th;
+        epolls[i] = epoll_create1(0);
+        if (epolls[i] < 0 || pthread_create(&th, NULL, trabalhador_servidor, &epolls[i]) != 0) {
+            perror("ERRO: trabalhador");
+            return EXIT_FAILURE;
+        }
+        pthread_detach(th);
+    }
+    printf("Servindo em %s com %zu threads (Ctrl-C encerra)\n", caminho, qtd);
+    fflush(stdout);
+
+    size_t proximo = 0, sessoes_antes = 0, jogadas_antes = 0;
+    uint64_t relatorio = agora_ns(), inicio = relatorio;
+    while (!servidor_parar) {
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        if (poll(&p, 1, 1000) > 0) {
+            int cliente = accept(fd, NULL, NULL);
+            if (cliente >= 0) {
+                fcntl(cliente, F_SETFL, fcntl(cliente, F_GETFL) | O_NONBLOCK);
+                Conexao *c = calloc(1, sizeof(Conexao));
+                char *entrada = malloc(TAM_LEITURA_SERVIDOR);
+                if (!c || !entrada) {
+                    // Sem memória para mais uma conexão: recusa esta e segue atendendo as outras
+                    perror("ERRO: conexão");
+                    free(c);
+                    free(entrada);
+                    close(cliente);
+                    continue;
+                }
+                c->fd = cliente;
+                c->entrada = entrada;
+                atomic_fetch_add_explicit(&servidor_conexoes, 1, memory_order_relaxed);
+
+                // Distribui as conexões em rodízio; daqui em diante só essa thread mexe nela
+                struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+                epoll_ctl(epolls[proximo++ % qtd], EPOLL_CTL_ADD, cliente, &ev);
+            }
+        }
+
+        uint64_t agora = agora_ns();
+        if (agora - relatorio >= 1000000000u) {
+            size_t sessoes = atomic_load(&servidor_sessoes_criadas), jogadas = atomic_load(&servidor_jogadas);
+            double s = (agora - relatorio) / 1e9;
+            if (sessoes != sessoes_antes || jogadas != jogadas_antes)
+                printf("%.0f sessões/s, %.0f jogadas/s | %zu sessões ativas, %zu conexões\n",
+                       (sessoes - sessoes_antes) / s, (jogadas - jogadas_antes) / s,
+                       atomic_load(&servidor_sessoes_ativas), atomic_load(&servidor_conexoes));
+            fflush(stdout);
+            sessoes_antes = sessoes;
+            jogadas_antes = jogadas;
+            relatorio = agora;
+        }
+    }
+
+    double total = (agora_ns() - inicio) / 1e9;
+    printf("\nEncerrado: %zu sessões e %zu jogadas em %.1f s\n",
+           atomic_load(&servidor_sessoes_criadas), atomic_load(&servidor_jogadas), total);
+    close(fd);
+    unlink(caminho);
+    return EXIT_SUCCESS;
+}
+
+// --- CLIENTE DE CARGA ---
+
+typedef struct {
+    int fd;
+    char buf[TAM_LEITURA_SERVIDOR];
+    size_t inicio, fim;
+} Leitor;
+
+// Lê a próxima linha (sem o '\n') em 'linha'. Devolve false se a conexão caiu.
+bool ler_linha(Leitor *l, char *linha, size_t max) {
+    for (;;) {
+        char *nl = memchr(l->buf + l->inicio, '\n', l->fim - l->inicio);
+        if (nl) {
+            size_t n = (size_t)(nl - (l->buf + l->inicio));
+            if (n >= max) n = max - 1;
+            memcpy(linha, l->buf + l->inicio, n);
+            linha[n] = '\0';
+            l->inicio = (size_t)(nl - l->buf) + 1;
+            return true;
+        }
+        memmove(l->buf, l->buf + l->inicio, l->fim - l->inicio);
+        l->fim -= l->inicio;
+        l->inicio = 0;
+        ssize_t r = read(l->fd, l->buf + l->fim, sizeof(l->buf) - l->fim);
+        if (r <= 0) return false;
+        l->fim += (size_t)r;
+    }
+}
+
+typedef struct {
+    const char *caminho;
+    size_t sessoes;
+    size_t indice;
+    size_t jogadas, vitorias, derrotas;
+    bool erro;
+} ClienteCarga;
+
+// Uma conexão: abre as sessões e joga em rodadas (uma jogada por sessão viva por escrita).
+void *rodar_cliente_carga(void *arg) {
+    ClienteCarga *cli = arg;
+    struct sockaddr_un end;
+    Leitor *l = malloc(sizeof(Leitor));
+    Quadro q = {0};
+    size_t *vivas = malloc(cli->sessoes * sizeof(size_t));
+    char linha[256];
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!l || !vivas || !endereco_unix(&end, cli->caminho) ||
+        fd < 0 || connect(fd, (struct sockaddr *)&end, sizeof(end)) < 0) {
+        perror("ERRO: conectar");
+        cli->erro = true;
+        goto fim;
+    }
+    l->fd = fd;
+    l->inicio = l->fim = 0;
+
+    for (size_t s = 0; s < cli->sessoes; s++)
+        quadro_anexar(&q, "novo 16 16 40 %zu\n", cli->indice * cli->sessoes + s);
+    quadro_enviar(&q, fd);
+    for (size_t s = 0; s < cli->sessoes; s++) {
+        if (!ler_linha(l, linha, sizeof(linha)) || sscanf(linha, "ok %zu", &vivas[s]) != 1) {
+            cli->erro = true;
+            goto fim;
+        }
+    }
+
+    // Cliques sorteados até cada partida acabar (ou 400 jogadas)
+    uint64_t estado = misturar64(cli->indice + 1);
+    size_t qtd_vivas = cli->sessoes;
+    for (size_t rodada = 0; rodada < 400 && qtd_vivas > 0; rodada++) {
+        for (size_t s = 0; s < qtd_vivas; s++) {
+            uint64_t z = misturar64(estado += 0x9e3779b97f4a7c15u);
+            quadro_anexar(&q, "r %zu %u %u\n", vivas[s], (unsigned)(z % 16), (unsigned)((z >> 32) % 16));
+        }
+        quadro_enviar(&q, fd);
+
+        size_t restantes = 0, encerradas = 0;
+        for (size_t s = 0; s < qtd_vivas; s++) {
+            char resultado[16];
+            size_t id;
+            if (!ler_linha(l, linha, sizeof(linha)) ||
+                sscanf(linha, "ok %zu %15s", &id, resultado) != 2) {
+                cli->erro = true;
+                goto fim;
+            }
+            cli->jogadas++;
+            if (strcmp(resultado, "mina") == 0 || strcmp(resultado, "vitoria") == 0) {
+                if (resultado[0] == 'm') cli->derrotas++;
+                else cli->vitorias++;
+                quadro_anexar(&q, "fim %zu\n", id);
+                encerradas++;
+            } else {
+                vivas[restantes++] = id;
+            }
+        }
+        quadro_enviar(&q, fd);
+        for (size_t s = 0; s < encerradas; s++)
+            ler_linha(l, linha, sizeof(linha));
+        qtd_vivas = restantes;
+    }
+
+fim:
+    if (fd >= 0) close(fd);
+    free(q.dados);
+    free(vivas);
+    free(l);
+    return NULL;
+}
+
+// --carga CAMINHO: N conexões com M partidas cada contra um servidor local.
+int rodar_carga(const char *caminho, size_t conexoes, size_t sessoes) {
+    ClienteCarga *clientes = calloc(conexoes, sizeof(ClienteCarga));
+    pthread_t *threads = calloc(conexoes, sizeof(pthread_t));
+    if (!clientes || !threads) return EXIT_FAILURE;
+
+    uint64_t inicio = agora_ns();
+    for (size_t i = 0; i < conexoes; i++) {
+        clientes[i] = (ClienteCarga){ .caminho = caminho, .sessoes = sessoes, .indice = i };
+        pthread_create(&threads[i], NULL, rodar_cliente_carga, &clientes[i]);
+    }
+
+    size_t jogadas = 0, vitorias = 0, derrotas = 0, erros = 0;
+    for (size_t i = 0; i < conexoes; i++) {
+        pthread_join(threads[i], NULL);
+        jogadas += clientes[i].jogadas;
+        vitorias += clientes[i].vitorias;
+        derrotas += clientes[i].derrotas;
+        erros += clientes[i].erro;
+    }
+    double s = (agora_ns() - inicio) / 1e9;
+
+    printf("%zu conexões x %zu partidas: %zu jogadas em %.3f s\n", conexoes, sessoes, jogadas, s);
+    printf("%.0f sessões/s, %.0f jogadas/s | %zu vitórias, %zu derrotas, %zu conexões com erro\n",
+           conexoes * sessoes / s, jogadas / s, vitorias, derrotas, erros);
+    free(clientes);
+    free(threads);
+    return erros ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// --- PARTIDA COOPERATIVA (VÁRIAS THREADS NO MESMO TABULEIRO) ---
+
+/*
+ * Vários jogadores (threads) agem no mesmo Tabuleiro sem trava. Cada célula muda por CAS no
+ * próprio byte: quem liga o bit de revelada é o único dono daquela revelação, então duas
+ * inundações que se encontram não revelam nada duas vezes, só param uma na borda da outra.
+ * A contagem de reveladas fica em fatias (uma por jogador) e o hash Zobrist aceita XOR
+ * atômico porque a ordem das trocas não importa. O undo é de cada jogador: desfazer apaga só
+ * o que ele revelou ou marcou. As minas têm de estar fixas antes (sem proteção do 1º clique).
+ */
+#define FATIAS_CONTADOR 64
+
+// Uma fatia por linha de cache: jogadores somando ao mesmo tempo não disputam a mesma linha
+typedef struct {
+    _Alignas(64) atomic_size_t valor;
+} FatiaContador;
+
+typedef struct {
+    FatiaContador reveladas[FATIAS_CONTADOR];
+    Tabuleiro *t;
+    // Minas reveladas agora: o undo de um jogador tira só a dele, a de outro continua valendo
+    atomic_size_t minas_reveladas;
+} PartidaCooperativa;
+
+// O que uma troca do undo cooperativo fez na célula (os 2 bits de baixo da troca)
+enum { TROCA_REVELOU = 0, TROCA_TIROU_BANDEIRA = 2, TROCA_POS_BANDEIRA = 3 };
+
+typedef struct {
+    PartidaCooperativa *p;
+    size_t fatia;
+
+    // Fronteira da inundação (pilha de índices, só desta thread)
+    size_t *pilha;
+    size_t capacidade_pilha;
+
+    // Undo do jogador: cada troca é índice << 2 | TROCA_*, e onde começa cada lote
+    size_t *trocas;
+    size_t qtd_trocas, capacidade_trocas;
+    size_t *lotes;
+    size_t qtd_lotes, capacidade_lotes;
+} Jogador;
+
+// Cresce um vetor dinâmico de size_t para caber mais um elemento.
+void garantir_espaco(size_t **vetor, size_t *capacidade, size_t qtd) {
+    if (qtd < *capacidade) return;
+    *capacidade = *capacidade ? 2 * *capacidade : 256;
+    *vetor = realloc(*vetor, *capacidade * sizeof(size_t));
+    if (!*vetor) {
+        perror("ERRO: realloc");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// As somas nas fatias e estas leituras são seq_cst: quem soma por último vê todas as outras
+// somas, então a vitória nunca passa sem ninguém a notar.
+size_t total_reveladas_cooperativa(PartidaCooperativa *p) {
+    size_t total = 0;
+    for (size_t i = 0; i < FATIAS_CONTADOR; i++)
+        total += atomic_load_explicit(&p->reveladas[i].valor, memory_order_seq_cst);
+    return total;
+}
+
+// Troca o byte da célula 'idx' ligando ou desligando 'bit'. Falha se a célula já está como
+// pedido ou se 'proibido' está ligado nela. Em caso de sucesso devolve o valor antigo em *antes.
+bool trocar_bit_celula(PartidaCooperativa *p, size_t idx, unsigned bit, bool ligar, Celula proibido, Celula *antes) {
+    size_t x = idx % p->t->largura, y = idx / p->t->largura;
+    Celula *cel = &CELULA_EM(p->t, x, y);
+    Celula antigo = __atomic_load_n(cel, __ATOMIC_RELAXED), novo;
+    do {
+        if ((antigo & proibido) || (((antigo >> bit) & 0x1) == ligar)) return false;
+        novo = antigo;
+        if (bit == DESLOC_REVELADA) DEFINIR_REVELADA(novo, ligar);
+        else DEFINIR_BANDEIRA(novo, ligar);
+    } while (!__atomic_compare_exchange_n(cel, &antigo, novo, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    __atomic_fetch_xor(&p->t->hash, chave_zobrist(idx, ESTADO_VISIVEL(antigo)) ^ chave_zobrist(idx, ESTADO_VISIVEL(novo)),
+                       __ATOMIC_RELAXED);
+    // Só quem ganhou o CAS troca este bit, então basta um XOR atômico na palavra do bitboard
+    uint64_t *bits = bit == DESLOC_REVELADA ? p->t->bits_revelada : p->t->bits_bandeira;
+    __atomic_fetch_xor(LINHA_DE_BITS(p->t, bits, y) + ((x + GUARDA_BITS) >> 6), 1ull << ((x + GUARDA_BITS) & 63), __ATOMIC_RELAXED);
+    *antes = antigo;
+    return true;
+}
+
+void registrar_troca(Jogador *j, size_t idx, unsigned troca) {
+    garantir_espaco(&j->trocas, &j->capacidade_trocas, j->qtd_trocas);
+    j->trocas[j->qtd_trocas++] = idx << 2 | troca;
+}
+
+void abrir_lote_jogador(Jogador *j) {
+    garantir_espaco(&j->lotes, &j->capacidade_lotes, j->qtd_lotes);
+    j->lotes[j->qtd_lotes++] = j->qtd_trocas;
+}
+
+ResultadoJogada revelar_cooperativo(Jogador *j, size_t x, size_t y) {
+    PartidaCooperativa *p = j->p;
+    Tabuleiro *t = p->t;
+    size_t topo = 0, reveladas = 0;
+    size_t lote = j->qtd_lotes;
+    abrir_lote_jogador(j);
+
+    garantir_espaco(&j->pilha, &j->capacidade_pilha, 0);
+    j->pilha[topo++] = y * t->largura + x;
+    while (topo) {
+        size_t idx = j->pilha[--topo];
+        Celula antes;
+        if (!trocar_bit_celula(p, idx, DESLOC_REVELADA, true, 1 << DESLOC_BANDEIRA, &antes)) continue;
+        registrar_troca(j, idx, TROCA_REVELOU);
+        reveladas++;
+
+        if (EH_MINA(antes)) {
+            atomic_fetch_add_explicit(&p->minas_reveladas, 1, memory_order_relaxed);
+            continue;
+        }
+        if (NUM_MINAS(antes) != 0) continue;
+
+        size_t cx = idx % t->largura, cy = idx / t->largura;
+        for (size_t d = 0; d < 8; d++) {
+            size_t nx = cx + direcoes[d][0];
+            size_t ny = cy + direcoes[d][1];
+            if (nx >= t->largura || ny >= t->altura) continue;
+
+            // Leitura sem trava só para não empilhar à toa; quem decide é o CAS
+            size_t vizinho = ny * t->largura + nx;
+            if (__atomic_load_n(&CELULA_EM(t, nx, ny), __ATOMIC_RELAXED) >> DESLOC_BANDEIRA) continue;
+            garantir_espaco(&j->pilha, &j->capacidade_pilha, topo);
+            j->pilha[topo++] = vizinho;
+        }
+    }
+
+    if (reveladas == 0) {
+        j->qtd_lotes = lote;  // outro jogador chegou antes: não há o que desfazer
+        return JOGADA_NADA;
+    }
+    atomic_fetch_add_explicit(&p->reveladas[j->fatia].valor, reveladas, memory_order_seq_cst);
+    if (atomic_load_explicit(&p->minas_reveladas, memory_order_relaxed) > 0) return JOGADA_MINA;
+    if (total_reveladas_cooperativa(p) == t->largura * t->altura - t->qtd_minas) return JOGADA_VITORIA;
+    return JOGADA_FEITA;
+}
+
+ResultadoJogada alternar_bandeira_cooperativa(Jogador *j, size_t x, size_t y) {
+    size_t idx = y * j->p->t->largura + x;
+    Celula antes = __atomic_load_n(&CELULA_EM(j->p->t, x, y), __ATOMIC_RELAXED);
+    if (!trocar_bit_celula(j->p, idx, DESLOC_BANDEIRA, !TEM_BANDEIRA(antes), 1 << DESLOC_REVELADA, &antes))
+        return JOGADA_NADA;
+    abrir_lote_jogador(j);
+    registrar_troca(j, idx, TEM_BANDEIRA(antes) ? TROCA_TIROU_BANDEIRA : TROCA_POS_BANDEIRA);
+    return JOGADA_FEITA;
+}
+
+// Desfaz a última jogada deste jogador. Uma bandeira só volta se ainda está como ele a deixou:
+// o CAS parte do valor que ele escreveu, então a troca de outro jogador depois fica como está.
+bool desfazer_cooperativo(Jogador *j) {
+    if (j->qtd_lotes == 0) return false;
+    size_t inicio = j->lotes[--j->qtd_lotes], escondidas = 0;
+
+    for (size_t i = j->qtd_trocas; i-- > inicio; ) {
+        size_t idx = j->trocas[i] >> 2;
+        unsigned troca = j->trocas[i] & 3;
+        Celula antes;
+        if (troca != TROCA_REVELOU) {
+            // Falha sem mexer se a bandeira já não é a que este jogador deixou
+            trocar_bit_celula(j->p, idx, DESLOC_BANDEIRA, troca == TROCA_TIROU_BANDEIRA, 1 << DESLOC_REVELADA, &antes);
+        } else if (trocar_bit_celula(j->p, idx, DESLOC_REVELADA, false, 0, &antes)) {
+            if (EH_MINA(antes)) atomic_fetch_sub_explicit(&j->p->minas_reveladas, 1, memory_order_relaxed);
+            escondidas++;
+        }
+    }
+    j->qtd_trocas = inicio;
+    atomic_fetch_sub_explicit(&j->p->reveladas[j->fatia].valor, escondidas, memory_order_seq_cst);
+    return true;
+}
+
+void liberar_jogador(Jogador *j) {
+    free(j->pilha);
+    free(j->trocas);
+    free(j->lotes);
+}
+
+// --- BENCH COOPERATIVO (--coop N) ---
+
+#define LADO_BENCH_COOP   2048
+#define FAIXA_BENCH_COOP  16    // linhas por tarefa: as inundações atravessam as faixas e disputam células
+
+typedef struct {
+    Jogador jogador;
+    atomic_size_t *proxima_faixa;
+    size_t cliques;
+} TarefaCooperativa;
+
+// Cada jogador pega faixas de linhas e clica em toda célula segura ainda escondida
+void *jogar_cooperativo(void *arg) {
+    TarefaCooperativa *tarefa = arg;
+    Tabuleiro *t = tarefa->jogador.p->t;
+    size_t faixas = (t->altura + FAIXA_BENCH_COOP - 1) / FAIXA_BENCH_COOP;
+
+    for (size_t f; (f = atomic_fetch_add(tarefa->proxima_faixa, 1)) < faixas; ) {
+        for (size_t y = f * FAIXA_BENCH_COOP; y < t->altura && y < (f + 1) * FAIXA_BENCH_COOP; y++) {
+            for (size_t x = 0; x < t->largura; x++) {
+                Celula c = __atomic_load_n(&CELULA_EM(t, x, y), __ATOMIC_RELAXED);
+                if (ESTA_REVELADA(c) || EH_MINA(c)) continue;
+                if (revelar_cooperativo(&tarefa->jogador, x, y) != JOGADA_NADA) tarefa->cliques++;
+            }
+        }
+    }
+    return NULL;
+}
+
+void *desfazer_tudo_cooperativo(void *arg) {
+    TarefaCooperativa *tarefa = arg;
+    while (desfazer_cooperativo(&tarefa->jogador)) {}
+    return NULL;
+}
+
+// Roda 'qtd' jogadores em threads próprias até 'funcao' terminar em todos. Devolve o tempo em ns.
+uint64_t rodar_jogadores(TarefaCooperativa *tarefas, size_t qtd, void *(*funcao)(void *)) {
+    pthread_t threads[FATIAS_CONTADOR];
+    uint64_t inicio = agora_ns();
+    for (size_t i = 0; i < qtd; i++)
+        pthread_create(&threads[i], NULL, funcao, &tarefas[i]);
+    for (size_t i = 0; i < qtd; i++)
+        pthread_join(threads[i], NULL);
+    return agora_ns() - inicio;
+}
+
+// Limpa o tabuleiro inteiro com 1, 2, 4... até 'max_jogadores' threads e confere se nenhuma
+// revelação se perdeu ou contou em dobro; depois cada jogador desfaz tudo o que fez.
+int bench_cooperativo(size_t max_jogadores, uint64_t semente) {
+    if (max_jogadores == 0 || max_jogadores > FATIAS_CONTADOR) {
+        fprintf(stderr, "ERRO: --coop aceita de 1 a %d jogadores\n", FATIAS_CONTADOR);
+        return EXIT_FAILURE;
+    }
+
+    Tabuleiro t = { .largura = LADO_BENCH_COOP, .altura = LADO_BENCH_COOP, .semente = semente };
+    t.qtd_minas = t.largura * t.altura * 15 / 100;
+    size_t seguras = t.largura * t.altura - t.qtd_minas;
+    PartidaCooperativa *p = aligned_alloc(_Alignof(PartidaCooperativa), sizeof(PartidaCooperativa));
+    TarefaCooperativa tarefas[FATIAS_CONTADOR];
+    bool ok = true;
+    double base = 0;
+
+    printf("Tabuleiro %zux%zu com %zu minas, %zu células seguras\n", t.largura, t.altura, t.qtd_minas, seguras);
+    for (size_t qtd = 1; qtd <= max_jogadores; qtd = qtd < max_jogadores && 2 * qtd > max_jogadores ? max_jogadores : 2 * qtd) {
+        iniciar_jogo(&t);
+        t.primeiro_clique_pendente = false;
+        for (size_t i = 0; i < FATIAS_CONTADOR; i++) atomic_init(&p->reveladas[i].valor, 0);
+        atomic_init(&p->minas_reveladas, 0);
+        p->t = &t;
+
+        atomic_size_t proxima_faixa;
+        atomic_init(&proxima_faixa, 0);
+        for (size_t i = 0; i < qtd; i++)
+            tarefas[i] = (TarefaCooperativa){ .jogador = { .p = p, .fatia = i }, .proxima_faixa = &proxima_faixa };
+
+        uint64_t ns = rodar_jogadores(tarefas, qtd, jogar_cooperativo);
+
+        // Conferência: contador, soma dos undos por jogador, varredura das células e hash
+        size_t total = total_reveladas_cooperativa(p), trocas = 0, cliques = 0, varridas = 0;
+        for (size_t i = 0; i < qtd; i++) {
+            trocas += tarefas[i].jogador.qtd_trocas;
+            cliques += tarefas[i].cliques;
+        }
+        for (size_t i = 0; i < CELULAS_ALOCADAS(&t); i++)
+            varridas += ESTA_REVELADA(t.celulas[i]);
+        bool certo = total == seguras && trocas == seguras && varridas == seguras && t.hash == hash_completo(&t);
+
+        uint64_t ns_desfazer = rodar_jogadores(tarefas, qtd, desfazer_tudo_cooperativo);
+        certo = certo && total_reveladas_cooperativa(p) == 0 && t.hash == 0;
+        for (size_t i = 0; i < qtd; i++)
+            liberar_jogador(&tarefas[i].jogador);
+
+        double mcel = seguras / (ns / 1e3);
+        if (qtd == 1) base = mcel;
+        printf("%2zu jogadores: %8.1f ms, %6.1f Mcélulas/s (%.2fx), %zu cliques, desfazer %.1f ms  %s\n",
+               qtd, ns / 1e6, mcel, mcel / base, cliques, ns_desfazer / 1e6, certo ? "ok" : "ERRADO");
+        ok = ok && certo;
+    }
+
+    liberar_memoria_jogo(&t);
+    free(p);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// --- BENCHMARK DO LAYOUT (--bench) ---
+
+#define LADO_BENCH 2048
+#define LARGURA_ROTULO_BENCH 12   // "revelar tudo", o rótulo mais longo
+
+// Contador de faltas de cache do processo (perf_event_open). Devolve -1 se o kernel não deixar.
+int abrir_contador_cache(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = PERF_COUNT_HW_CACHE_MISSES;
+    a.disabled = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+typedef struct {
+    int fd;
+    uint64_t inicio_ns;
+    uint64_t faltas_pagina;
+} Medicao;
+
+void medicao_iniciar(Medicao *m) {
+    if (m->fd >= 0) {
+        ioctl(m->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    m->faltas_pagina = faltas_de_pagina();
+    m->inicio_ns = agora_ns();
+}
+
+void medicao_imprimir(Medicao *m, const char *nome, size_t celulas) {
+    uint64_t ns = agora_ns() - m->inicio_ns;
+    uint64_t faltas = 0;
+    if (m->fd >= 0) {
+        ioctl(m->fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(m->fd, &faltas, sizeof(faltas)) != sizeof(faltas)) faltas = 0;
+    }
+
+    printf("%-*s %9.2f ms  %6.2f ns/célula  %8llu faltas de página", LARGURA_ROTULO_BENCH + bytes_extras_utf8(nome), nome,
+           ns / 1e6, (double)ns / celulas, (unsigned long long)(faltas_de_pagina() - m->faltas_pagina));
+    if (m->fd >= 0) printf("  %11llu faltas de cache (%.3f/célula)", (unsigned long long)faltas, (double)faltas / celulas);
+    printf("\n");
+}
+
+// Geração e inundação num tabuleiro grande, no layout desta compilação (make ladrilhos = 8x8).
+int rodar_bench(uint64_t semente, Topologia topologia, size_t camadas, size_t lado) {
+    Tabuleiro t = { .largura = lado, .altura = lado, .semente = semente,
+                    .topologia = topologia, .camadas = camadas };
+    size_t total = t.largura * t.altura;
+    if (!topologia_valida(topologia, t.largura, t.altura, camadas)) {
+        fprintf(stderr, "ERRO: %zu camadas não dividem as %zu linhas do bench\n", camadas, t.altura);
+        return EXIT_FAILURE;
+    }
+    Medicao m = { .fd = abrir_contador_cache() };
+
+    printf("Layout: %s | tabuleiro %zux%zu | topologia %s | páginas %s, %zu faixa(s)\n", NOME_LAYOUT,
+           t.largura, t.altura, nomes_topologia[topologia], nomes_paginas[modo_paginas], qtd_faixas(&t));
+    if (m.fd < 0) printf("(contador de faltas de cache indisponível: só tempos)\n");
+
+    // Geração densa: cada mina soma 1 nos 8 vizinhos (três linhas do tabuleiro)
+    t.qtd_minas = total * 20 / 100;
+    medicao_iniciar(&m);
+    iniciar_jogo(&t);
+    medicao_imprimir(&m, "geração", total);
+    printf("%-*s %zu KiB das células em páginas grandes\n", LARGURA_ROTULO_BENCH, "", kib_paginas_grandes());
+
+    // Inundação: poucas minas, um clique no meio abre quase tudo
+    t.qtd_minas = total / 200;
+    iniciar_jogo(&t);
+    t.primeiro_clique_pendente = false;
+    size_t x = t.largura / 2, y = t.altura / 2;
+    while (NUM_MINAS(CELULA_EM(&t, x, y)) || EH_MINA(CELULA_EM(&t, x, y))) x++;
+    medicao_iniciar(&m);
+    revelar_celula(&t, x, y);
+    medicao_imprimir(&m, "inundação", t.celulas_reveladas);
+    uint64_t hash_inundacao = t.hash;
+
+    // Desfazer percorre a mesma área na ordem inversa
+    size_t reveladas = t.celulas_reveladas;
+    medicao_iniciar(&m);
+    pilha_desfazer(&t);
+    medicao_imprimir(&m, "desfazer", reveladas);
+
+    // A mesma inundação em fatias de 1 ms: a maior fatia é quanto um quadro do front end espera
+    size_t fatias = 0;
+    uint64_t maior_fatia = 0;
+    medicao_iniciar(&m);
+    comecar_revelar(&t, x, y);
+    for (bool terminou = false; !terminou; fatias++) {
+        uint64_t inicio = agora_ns();
+        terminou = avancar_revelacao(&t, SIZE_MAX, 1000000);
+        if (agora_ns() - inicio > maior_fatia) maior_fatia = agora_ns() - inicio;
+    }
+    concluir_revelar(&t);
+    medicao_imprimir(&m, "em fatias", t.celulas_reveladas);
+    printf("%-*s %zu fatias, a maior com %.3f ms\n", LARGURA_ROTULO_BENCH, "", fatias, maior_fatia / 1e6);
+    bool fatias_batem = t.hash == hash_inundacao && t.celulas_reveladas == reveladas;
+    pilha_desfazer(&t);
+
+    // Varreduras do tabuleiro inteiro, 8 células por palavra
+    medicao_iniciar(&m);
+    bool valido = validar_tabuleiro(&t);
+    medicao_imprimir(&m, "validar", total);
+    medicao_iniciar(&m);
+    ContagemCelulas c = contar_celulas(&t);
+    medicao_imprimir(&m, "contar", total);
+    medicao_iniciar(&m);
+    revelar_tabuleiro(&t);
+    medicao_imprimir(&m, "revelar tudo", total);
+    if (!valido || !fatias_batem || c.minas != t.qtd_minas || t.hash != hash_completo(&t)) {
+        fprintf(stderr, "ERRO: varreduras do bench não conferem\n");
+        liberar_memoria_jogo(&t);
+        return EXIT_FAILURE;
+    }
+
+    if (m.fd >= 0) close(m.fd);
+    liberar_memoria_jogo(&t);
+    return EXIT_SUCCESS;
+}
+
+// --- BENCH DOS ESPECTADORES (--bench-espectadores N) ---
+
+#define LADO_BENCH_ESPECTADORES    256
+#define JOGADAS_BENCH_ESPECTADORES 4000
+
+typedef struct {
+    const char *caminho;
+    bool parado;                // conecta e nunca lê: o espectador lento
+    atomic_bool *conectado;
+    size_t bytes;
+} LeitorTransmissao;
+
+// Um espectador do bench: lê (ou não) até o jogo fechar a transmissão.
+void *ler_transmissao(void *arg) {
+    LeitorTransmissao *l = arg;
+    struct sockaddr_un end;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || !endereco_unix(&end, l->caminho) || connect(fd, (struct sockaddr *)&end, sizeof(end)) < 0) {
+        if (fd >= 0) close(fd);
+        atomic_store(l->conectado, true);
+        return NULL;
+    }
+    atomic_store(l->conectado, true);
+
+    char buf[65536];
+    ssize_t n;
+    if (l->parado) {
+        // Não lê nada até o fim da transmissão
+        while (!atomic_load(&transmissor.parar)) usleep(10000);
+    } else {
+        while ((n = read(fd, buf, sizeof(buf))) > 0) l->bytes += (size_t)n;
+    }
+    close(fd);
+    return NULL;
+}
+
+// Joga a mesma sequência de jogadas publicando cada tela e mede o laço do jogador.
+Histograma jogar_bench_espectadores(uint64_t semente) {
+    Tabuleiro t = { .largura = LADO_BENCH_ESPECTADORES, .altura = LADO_BENCH_ESPECTADORES,
+                    .semente = semente };
+    t.qtd_minas = t.largura * t.altura * 15 / 100;
+    iniciar_jogo(&t);
+    Histograma h = {0};
+    uint64_t estado = misturar64(semente);
+
+    for (size_t j = 0; j < JOGADAS_BENCH_ESPECTADORES; j++) {
+        uint64_t z = misturar64(estado += 0x9e3779b97f4a7c15u);
+        size_t x = z % t.largura, y = (z >> 32) % t.altura;
+        uint64_t inicio = agora_ns();
+
+        // Mina conhecida vira bandeira, o resto é revelado; de vez em quando desfaz
+        if (j % 16 == 15)                                   jogar(&t, MOV_DESFAZER, 0, 0);
+        else if (EH_MINA(CELULA_EM(&t, x, y)) && !t.primeiro_clique_pendente) jogar(&t, MOV_BANDEIRA, x, y);
+        else if (!TEM_BANDEIRA(CELULA_EM(&t, x, y)))       jogar(&t, MOV_REVELAR, x, y);
+        transmissao_publicar(&transmissor, &t);
+
+        uint64_t duracao = agora_ns() - inicio;
+        h.baldes[balde_histograma(duracao)]++;
+        h.quantidade++;
+        h.total_ns += duracao;
+        if (duracao > h.maximo_ns) h.maximo_ns = duracao;
+    }
+    liberar_memoria_jogo(&t);
+    return h;
+}
+
+void imprimir_bench_espectadores(const char *nome, const Histograma *h) {
+    char p50[16], p99[16], maximo[16];
+    formatar_duracao(p50, sizeof(p50), percentil_histograma(h, 50));
+    formatar_duracao(p99, sizeof(p99), percentil_histograma(h, 99));
+    formatar_duracao(maximo, sizeof(maximo), h->maximo_ns);
+    printf("%-*s média %7.2f µs | p50 %s | p99 %s | máx %s\n", 22 + bytes_extras_utf8(nome), nome,
+           h->total_ns / 1e3 / h->quantidade, p50, p99, maximo);
+}
+
+// Liga os espectadores [de, ate) e espera todos conectarem.
+void conectar_leitores(LeitorTransmissao *leitores, pthread_t *threads, atomic_bool *conectados,
+                       size_t de, size_t ate) {
+    for (size_t i = de; i < ate; i++)
+        pthread_create(&threads[i], NULL, ler_transmissao, &leitores[i]);
+    for (size_t i = de; i < ate; i++)
+        while (!atomic_load(&conectados[i])) usleep(1000);
+}
+
+// --bench-espectadores N: a mesma partida sem transmissão, com 1 espectador e com N (um parado).
+int bench_espectadores(size_t qtd, uint64_t semente) {
+    if (qtd < 2 || qtd > MAX_ESPECTADORES) {
+        fprintf(stderr, "ERRO: --bench-espectadores aceita de 2 a %d espectadores\n", MAX_ESPECTADORES);
+        return EXIT_FAILURE;
+    }
+    char caminho[64];
+    snprintf(caminho, sizeof(caminho), "/tmp/minecweeper-bench-%d.sock", (int)getpid());
+    LeitorTransmissao *leitores = calloc(qtd, sizeof(LeitorTransmissao));
+    pthread_t *threads = calloc(qtd, sizeof(pthread_t));
+    atomic_bool *conectados = calloc(qtd, sizeof(atomic_bool));
+    if (!leitores || !threads || !conectados) return EXIT_FAILURE;
+    for (size_t i = 0; i < qtd; i++) {
+        atomic_init(&conectados[i], false);
+        leitores[i] = (LeitorTransmissao){ .caminho = caminho, .parado = i == qtd - 1, .conectado = &conectados[i] };
+    }
+
+    printf("Tabuleiro %dx%d, %d jogadas, cada uma publicada para os espectadores\n",
+           LADO_BENCH_ESPECTADORES, LADO_BENCH_ESPECTADORES, JOGADAS_BENCH_ESPECTADORES);
+    Histograma h = jogar_bench_espectadores(semente);
+    imprimir_bench_espectadores("sem transmissão:", &h);
+
+    if (!transmissao_iniciar(&transmissor, caminho)) return EXIT_FAILURE;
+    conectar_leitores(leitores, threads, conectados, 0, 1);
+    h = jogar_bench_espectadores(semente);
+    imprimir_bench_espectadores("1 espectador:", &h);
+
+    conectar_leitores(leitores, threads, conectados, 1, qtd);
+    h = jogar_bench_espectadores(semente);
+    char nome[48];
+    snprintf(nome, sizeof(nome), "%zu espectadores:", qtd);
+    imprimir_bench_espectadores(nome, &h);
+
+    transmissao_encerrar();
+    size_t bytes = 0;
+    for (size_t i = 0; i < qtd; i++) {
+        pthread_join(threads[i], NULL);
+        bytes += leitores[i].bytes;
+    }
+    printf("Lido pelos espectadores: %.1f KiB\n", bytes / 1024.0);
+    free(leitores);
+    free(threads);
+    free(conectados);
+    return EXIT_SUCCESS;
+}
+
+// --- MODO TECLADO (TERMINAL CRU) ---
+
+// Célula desenhada na coluna/linha relativas à primeira célula. false = fora do tabuleiro ou
+// numa linha separadora.
+bool celula_na_tela(const Tabuleiro *t, size_t coluna, size_t linha, size_t *x, size_t *y) {
+    if (t->camadas > 1) {
+        size_t bloco = t->altura_camada + 1, resto = linha % bloco;
+        if (resto == t->altura_camada) return false;
+        linha = linha / bloco * t->altura_camada + resto;
+    }
+    size_t recuo = t->topologia == TOPOLOGIA_HEX && (linha & 1);
+    if (coluna < recuo || (coluna - recuo) / 2 >= t->largura || linha >= t->altura) return false;
+    *x = (coluna - recuo) / 2;
+    *y = linha;
+    return true;
+}
+
+//Eventos reconhecidos na entrada crua do terminal
+typedef enum {
+    EVENTO_NENHUM,
+    EVENTO_MOVER,      // setas ou hjkl
+    EVENTO_REVELAR,    // espaço, r, Enter ou clique esquerdo
+    EVENTO_BANDEIRA,   // b, f ou clique direito
+    EVENTO_ACORDE,     // c ou clique do meio: revela ao redor
+    EVENTO_DESFAZER,   // d ou u
+    EVENTO_REFAZER,    // U ou Ctrl-R
+    EVENTO_CANCELAR,   // x ou Esc sozinho: desiste da revelação em andamento
+    EVENTO_SAIR,       // q ou Ctrl-C
+} TipoEvento;
+
+typedef struct {
+    TipoEvento tipo;
+    int dx, dy;        // deslocamento do cursor (EVENTO_MOVER)
+    bool do_mouse;     // veio de um clique: x, y são a coluna e a linha relativas à primeira célula
+    size_t x, y;
+} Evento;
+
+// Quanto tempo de relógio cada quadro dá para a revelação em andamento (--fatia; 0 = de uma vez)
+static uint64_t fatia_revelar_ns = 4000000;
+
+typedef struct {
+    size_t cursor[2];          // x, y do cursor
+    size_t cursor_tela[2];     // onde o cursor foi desenhado no último quadro
+    Celula *celulas_tela;      // cópia do que está desenhado no terminal (linha a linha)
+    bool redesenhar_tudo;
+    const char *mensagem;
+    char progresso[96];        // mensagem da revelação em andamento
+
+    // Bytes lidos que ainda não formaram um evento completo
+    char pendente[TAM_BUFFER_TECLADO];
+    size_t qtd_pendente;
+
+    // Latência entre a chegada da tecla e o fim da escrita do quadro
+    uint64_t latencia_ultima_ns;
+    uint64_t latencia_maxima_ns;
+    uint64_t latencia_total_ns;
+    size_t quadros;
+} EstadoTeclado;
+
+static struct termios termios_original;
+static bool terminal_cru = false;
+
+// Volta o terminal ao modo normal (linha a linha, com eco) e desliga o mouse.
+void restaurar_terminal(void) {
+    if (!terminal_cru) return;
+
+    static const char desligar[] = "\x1b[?1006l\x1b[?1000l\x1b[?25h";
+    if (write(STDOUT_FILENO, desligar, sizeof(desligar) - 1) < 0) {
+        // nada a fazer: o terminal já pode ter sido fechado
+    }
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &termios_original);
+    terminal_cru = false;
+}
+
+// Coloca o terminal em modo cru (tecla a tecla, sem eco) e liga cliques do mouse em SGR 1006.
+bool ativar_terminal_cru(void) {
+    static bool restauracao_registrada = false;
+
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &termios_original) != 0)
+        return false;
+
+    struct termios cru = termios_original;
+    cru.c_iflag &= ~(tcflag_t)(IXON | ICRNL);
+    cru.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG | IEXTEN);
+    cru.c_cc[VMIN] = 1;
+    cru.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &cru) != 0) return false;
+
+    terminal_cru = true;
+    if (!restauracao_registrada) {
+        atexit(restaurar_terminal);
+        restauracao_registrada = true;
+    }
+
+    static const char ligar[] = "\x1b[?1000h\x1b[?1006h\x1b[?25l";
+    if (write(STDOUT_FILENO, ligar, sizeof(ligar) - 1) < 0) {
+        restaurar_terminal();
+        return false;
+    }
+    return true;
+}
+
+// Traduz o primeiro evento de 'buf'. Devolve quantos bytes consumiu, ou 0 se a sequência está incompleta.
+size_t decodificar_evento(const char *buf, size_t n, Evento *ev) {
+    *ev = (Evento){0};
+    if (n == 0) return 0;
+
+    if (buf[0] != '\x1b') {
+        switch (buf[0]) {
+            case 'h': ev->tipo = EVENTO_MOVER; ev->dx = -1; break;
+            case 'l': ev->tipo = EVENTO_MOVER; ev->dx = 1;  break;
+            case 'k': ev->tipo = EVENTO_MOVER; ev->dy = -1; break;
+            case 'j': ev->tipo = EVENTO_MOVER; ev->dy = 1;  break;
+            case ' ': case 'r': case '\r': case '\n':
+                ev->tipo = EVENTO_REVELAR; break;
+            case 'b': case 'f':
+                ev->tipo = EVENTO_BANDEIRA; break;
+            case 'c':
+                ev->tipo = EVENTO_ACORDE; break;
+            case 'd': case 'u':
+                ev->tipo = EVENTO_DESFAZER; break;
+            case 'U': case 0x12:
+                ev->tipo = EVENTO_REFAZER; break;
+            case 'x':
+                ev->tipo = EVENTO_CANCELAR; break;
+            case 'q': case 0x03:
+                ev->tipo = EVENTO_SAIR; break;
+        }
+        return 1;
+    }
+
+    // Sequências de escape: ESC [ ... A-D (setas), ESC O A-D e ESC [ < b ; x ; y M/m (mouse SGR 1006)
+    if (n < 2) return 0;
+    if (buf[1] != '[' && buf[1] != 'O') return 1; // ESC solto: ignora
+
+    if (n < 3) return 0;
+    char final = buf[2];
+    size_t i = 2;
+
+    if (buf[1] == '[' && buf[2] == '<') {
+        unsigned valores[3] = {0};
+        size_t campo = 0;
+
+        for (i = 3; i < n; i++) {
+            char c = buf[i];
+            if (c >= '0' && c <= '9') {
+                valores[campo] = valores[campo] * 10 + (unsigned)(c - '0');
+            } else if (c == ';' && campo < 2) {
+                campo++;
+            } else {
+                break;
+            }
+        }
+        if (i == n) return 0;
+
+        // Só interessa o aperto ('M') de um botão, sem movimento (32) nem roda (64)
+        if (buf[i] == 'M' && campo == 2 && (valores[0] & (32 | 64)) == 0 &&
+            valores[1] >= COLUNA_PRIMEIRA_CELULA && valores[2] >= LINHA_PRIMEIRA_CELULA) {
+            ev->do_mouse = true;
+            ev->x = valores[1] - COLUNA_PRIMEIRA_CELULA;
+            ev->y = valores[2] - LINHA_PRIMEIRA_CELULA;
+
+            switch (valores[0] & 3) {
+                case 0: ev->tipo = EVENTO_REVELAR;  break;
+                case 1: ev->tipo = EVENTO_ACORDE;   break;
+                case 2: ev->tipo = EVENTO_BANDEIRA; break;
+            }
+        }
+        return i + 1;
+    }
+
+    // Pula parâmetros numéricos (ex.: ESC [ 1 ; 5 A) até o byte final
+    if (buf[1] == '[') {
+        while (i < n && buf[i] >= 0x30 && buf[i] <= 0x3f) i++;
+        if (i == n) return 0;
+        final = buf[i];
+    }
+
+    switch (final) {
+        case 'A': ev->tipo = EVENTO_MOVER; ev->dy = -1; break;
+        case 'B': ev->tipo = EVENTO_MOVER; ev->dy = 1;  break;
+        case 'C': ev->tipo = EVENTO_MOVER; ev->dx = 1;  break;
+        case 'D': ev->tipo = EVENTO_MOVER; ev->dx = -1; break;
+    }
+    return i + 1;
+}
+
+// Aplica um evento ao tabuleiro, na posição do cursor (ou do clique).
+// Com uma revelação em andamento só o cursor anda: desfazer ou cancelar desistem dela e o resto é ignorado.
+ResultadoJogada aplicar_evento(Tabuleiro *t, EstadoTeclado *e, const Evento *ev) {
+    if (ev->do_mouse && !celula_na_tela(t, ev->x, ev->y, &e->cursor[0], &e->cursor[1]))
+        return JOGADA_NADA;
+
+    size_t x = e->cursor[0];
+    size_t y = e->cursor[1];
+
+    if (t->revelacao.ativa && ev->tipo != EVENTO_MOVER && ev->tipo != EVENTO_SAIR) {
+        if (ev->tipo != EVENTO_DESFAZER && ev->tipo != EVENTO_CANCELAR) return JOGADA_NADA;
+        cancelar_movimento(t);
+        return JOGADA_FEITA;
+    }
+
+    switch (ev->tipo) {
+        case EVENTO_MOVER:
+            if ((ev->dx > 0 && x + 1 < t->largura) || (ev->dx < 0 && x > 0))
+                e->cursor[0] = x + ev->dx;
+            if ((ev->dy > 0 && y + 1 < t->altura) || (ev->dy < 0 && y > 0))
+                e->cursor[1] = y + ev->dy;
+            return JOGADA_NADA;
+
+        case EVENTO_REVELAR:
+            return jogar_em_fatias(t, ESTA_REVELADA(CELULA_EM(t, x, y)) ? MOV_ACORDE : MOV_REVELAR, x, y,
+                                   SIZE_MAX, fatia_revelar_ns);
+
+        case EVENTO_ACORDE:
+            if (!ESTA_REVELADA(CELULA_EM(t, x, y))) return JOGADA_NADA;
+            return jogar_em_fatias(t, MOV_ACORDE, x, y, SIZE_MAX, fatia_revelar_ns);
+
+        case EVENTO_BANDEIRA:
+            return jogar(t, MOV_BANDEIRA, x, y);
+
+        case EVENTO_DESFAZER:
+            return jogar(t, MOV_DESFAZER, 0, 0);
+
+        case EVENTO_REFAZER:
+            return jogar(t, MOV_REFAZER, 0, 0);
+
+        case EVENTO_SAIR:
+            return JOGADA_SAIR;
+
+        default:
+            return JOGADA_NADA;
+    }
+}
+
+// Desenha o quadro do modo teclado. Fora o primeiro quadro, só reescreve as células que mudaram.
+void desenhar_teclado(Tabuleiro *t, EstadoTeclado *e) {
+    uint64_t inicio = agora_ns();
+    Quadro *q = &quadro_tela;
+
+    if (e->redesenhar_tudo) {
+        quadro_anexar(q, "\x1b[H\x1b[2J");
+        desenhar_tabuleiro(q, t, e->cursor);
+        for (size_t y = 0; y < t->altura; y++)
+            for (size_t x = 0; x < t->largura; x++)
+                e->celulas_tela[y * t->largura + x] = CELULA_EM(t, x, y);
+        e->redesenhar_tudo = false;
+    } else {
+        for (size_t y = 0; y < t->altura; y++) {
+            for (size_t x = 0; x < t->largura; x++) {
+                Celula c = CELULA_EM(t, x, y);
+                bool no_cursor = x == e->cursor[0] && y == e->cursor[1];
+                bool era_cursor = x == e->cursor_tela[0] && y == e->cursor_tela[1];
+
+                if (c == e->celulas_tela[y * t->largura + x] && no_cursor == era_cursor)
+                    continue;
+
+                e->celulas_tela[y * t->largura + x] = c;
+                desenhar_celula_em(q, t, x, y, c, no_cursor);
+            }
+        }
+    }
+    e->cursor_tela[0] = e->cursor[0];
+    e->cursor_tela[1] = e->cursor[1];
+
+    // Informações abaixo do tabuleiro (sempre reescritas, são poucas linhas)
+    quadro_anexar(q, "\x1b[%zu;1H\x1b[J", linha_da_celula(t, t->altura - 1) + 2);
+    quadro_anexar(q, "--- Informações ---\n"
+                     "Cursor: y=%zu x=%zu | Latência tecla->tela: %.3f ms (máx %.3f ms, média %.3f ms)\n"
+                     "setas/hjkl mover | espaço revelar | b bandeira | c revelar ao redor | d desfazer | x cancelar | q sair\n",
+                  e->cursor[1], e->cursor[0],
+                  e->latencia_ultima_ns / 1e6,
+                  e->latencia_maxima_ns / 1e6,
+                  e->quadros ? e->latencia_total_ns / 1e6 / e->quadros : 0.0);
+    desenhar_info_desfazer(q, t);
+    if (e->mensagem) quadro_anexar(q, "%s\n", e->mensagem);
+
+    size_t bytes = q->tamanho;
+    quadro_enviar(q, STDOUT_FILENO);
+    transmissao_publicar(&transmissor, t);
+    registrar_tempo(t, OP_DESENHAR, inicio, bytes);
 }
 
-//Lista todas as bandeiras usando a lista duplamente encadeada.
-void listar_bandeiras(Tabuleiro *tab) {
-    printf("Células com Bandeira: ");
-    NoListaDupla *atual = tab->inicio_bandeiras;
-    if (!atual) printf("(Nenhuma)");
+// Laço de jogo do modo teclado. Devolve JOGADA_NADA se o terminal não aceita o modo cru.
+ResultadoJogada jogar_com_teclado(Tabuleiro *t) {
+    EstadoTeclado e = {0};
+    e.celulas_tela = malloc(t->largura * t->altura * sizeof(Celula));
+    if (!e.celulas_tela) return JOGADA_NADA;
 
-    while (atual) {
-        printf("[%zu, %zu] ", atual->x, atual->y);
-        atual = atual->proximo;
+    fflush(stdout);
+    if (!ativar_terminal_cru()) {
+        free(e.celulas_tela);
+        return JOGADA_NADA;
     }
 
-    printf("\nPressione Enter...");
-    char tmp[10];
-    ler_entrada(tmp, 10);
-}
+    e.redesenhar_tudo = true;
+    desenhar_teclado(t, &e);
 
-//Libera toda a memória usada pelo jogo.
-void liberar_memoria_jogo(Tabuleiro *tab) {
-    while(pilha_desfazer(tab)); 
+    ResultadoJogada resultado = JOGADA_NADA;
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
 
-    while(tab->inicio_bandeiras)
-        lista_dupla_remover(tab, tab->inicio_bandeiras->x, tab->inicio_bandeiras->y);
+    while (resultado != JOGADA_MINA && resultado != JOGADA_VITORIA && resultado != JOGADA_SAIR) {
+        // Com uma revelação em andamento não espera tecla: cada volta é uma fatia e um quadro
+        bool revelando = t->revelacao.ativa;
+        uint64_t inicio_espera = agora_ns();
+        int prontos = poll(&pfd, 1, revelando ? 0 : -1);
+        if (prontos < 0 || (prontos == 0 && !revelando)) continue;
+        uint64_t inicio = agora_ns();
+        trace_registrar("esperar_entrada", inicio_espera, inicio - inicio_espera, NULL, 0);
+
+        // Junta tudo o que já chegou antes de desenhar: um quadro por lote de teclas
+        while (prontos > 0) {
+            ssize_t n = read(STDIN_FILENO, e.pendente + e.qtd_pendente,
+                             sizeof(e.pendente) - e.qtd_pendente);
+            if (n <= 0) {
+                resultado = JOGADA_SAIR;
+                break;
+            }
+            e.qtd_pendente += (size_t)n;
+            prontos = e.qtd_pendente < sizeof(e.pendente) ? poll(&pfd, 1, 0) : 0;
+        }
+
+        // Decodifica o lote inteiro antes de aplicar (no máximo um evento por byte)
+        uint64_t inicio_entrada = agora_ns();
+        Evento eventos[TAM_BUFFER_TECLADO];
+        size_t qtd_eventos = 0, usado = 0;
+        while (usado < e.qtd_pendente) {
+            size_t n = decodificar_evento(e.pendente + usado, e.qtd_pendente - usado,
+                                          &eventos[qtd_eventos]);
+            if (n == 0) break;
+            usado += n;
+            qtd_eventos++;
+        }
+        // Esc sozinho no fim da leitura é a tecla, não o começo de uma sequência
+        if (revelando && usado + 1 == e.qtd_pendente && e.pendente[usado] == '\x1b') {
+            eventos[qtd_eventos++] = (Evento){ .tipo = EVENTO_CANCELAR };
+            usado++;
+        }
+        registrar_tempo(t, OP_ENTRADA, inicio_entrada, usado);
+
+        for (size_t i = 0; i < qtd_eventos && resultado != JOGADA_SAIR; i++) {
+            ResultadoJogada r = aplicar_evento(t, &e, &eventos[i]);
+            if (r != JOGADA_NADA) {
+                resultado = r;
+                e.mensagem = NULL;
+            }
+            if (r == JOGADA_MINA || r == JOGADA_VITORIA || r == JOGADA_SAIR) break;
+        }
+
+        // Guarda o pedaço incompleto; se o buffer lotou sem formar evento, descarta
+        if (usado == 0 && e.qtd_pendente == sizeof(e.pendente)) usado = e.qtd_pendente;
+        memmove(e.pendente, e.pendente + usado, e.qtd_pendente - usado);
+        e.qtd_pendente -= usado;
+
+        // Mais uma fatia da revelação que já vinha de antes (a que começou agora já andou a dela)
+        if (revelando && t->revelacao.ativa && resultado != JOGADA_SAIR) {
+            ResultadoJogada r = continuar_jogada(t, SIZE_MAX, fatia_revelar_ns);
+            if (r != JOGADA_EM_ANDAMENTO) {
+                resultado = r;
+                e.mensagem = NULL;
+            }
+        }
+        if (t->revelacao.ativa) {
+            snprintf(e.progresso, sizeof(e.progresso), "Revelando... %zu células (x ou Esc cancela)",
+                     t->celulas_reveladas - t->revelacao.reveladas_antes);
+            e.mensagem = e.progresso;
+        }
+
+        if (resultado == JOGADA_MINA) {
+            revelar_tabuleiro(t);
+            e.mensagem = "\x1b[31mBOOM! Você acertou uma mina!\x1b[0m Pressione uma tecla...";
+        } else if (resultado == JOGADA_VITORIA) {
+            e.mensagem = "\x1b[32mPARABÉNS! Você limpou o campo!\x1b[0m Pressione uma tecla...";
+        }
+
+        desenhar_teclado(t, &e);
+
+        e.latencia_ultima_ns = agora_ns() - inicio;
+        e.latencia_total_ns += e.latencia_ultima_ns;
+        if (e.latencia_ultima_ns > e.latencia_maxima_ns)
+            e.latencia_maxima_ns = e.latencia_ultima_ns;
+        e.quadros++;
+    }
 
-    if (tab->celulas) {
-        free(tab->celulas);
-        tab->celulas = NULL;
+    // Saiu no meio de uma revelação: ela não chegou a ser jogada
+    cancelar_movimento(t);
+
+    // Espera o jogador ver o fim da partida antes de voltar ao modo de linhas
+    if (resultado != JOGADA_SAIR) {
+        char tecla;
+        if (read(STDIN_FILENO, &tecla, 1) < 0) {
+            // fim da entrada: segue adiante
+        }
     }
+
+    restaurar_terminal();
+    free(e.celulas_tela);
+
+    printf("Latência tecla->tela: máx %.3f ms, média %.3f ms em %zu quadros\n",
+           e.latencia_maxima_ns / 1e6,
+           e.quadros ? e.latencia_total_ns / 1e6 / e.quadros : 0.0,
+           e.quadros);
+    return resultado;
 }
 
 //Imprimir menu
-void imprimir_menu(void) {
+void imprimir_menu(Topologia topologia, size_t camadas) {
     printf("\x1b[H\x1b[2J"); // Limpar tela
     printf("**** Campo Minado ****\n"
            "(F)ácil   - 9x9, 10 minas\n"
            "(M)édio   - 16x16, 40 minas\n"
            "(D)ifícil - 30x16, 99 minas\n"
-           "Escolha a dificuldade (digite 'ajuda' ou 'sair'):\n");
+           "(P)ersonalizado - P L A M: largura, altura e minas (ex.: P 200 100 3000)\n");
+    if (topologia == TOPOLOGIA_3D)
+        printf("Topologia 3d com %zu camadas: a altura e as minas acima valem por camada "
+               "(no P, M é o total)\n", camadas);
+    else if (topologia != TOPOLOGIA_QUADRADA)
+        printf("Topologia %s\n", nomes_topologia[topologia]);
+    printf("Escolha a dificuldade (digite 'ajuda' ou 'sair'):\n");
 }
 
 //Imprimir ajuda
@@ -516,29 +6897,964 @@ void imprimir_menu_ajuda(void) {
     printf("\nComandos:\n"
            "r y x  : revelar célula (y=linha, x=coluna)\n"
            "b y x  : marcar/desmarcar bandeira\n"
+           "r/b/l Y [X] : revelar, pôr bandeiras ou limpar bandeiras numa área, numa jogada só;\n"
+           "         Y e X são N, N-M ou * (tudo), sem X a linha inteira (ex.: r 0-15 0-29, l *)\n"
            "d      : desfazer última jogada\n"
+           "rf     : refazer jogada desfeita\n"
+           "ir N   : pular para a jogada N (0 = início)\n"
            "lb     : listar bandeiras\n"
+           "stats  : tempos das operações e alocações\n"
+           "melhor : jogada com maior chance de vencer (finais e tabuleiros pequenos, só na grade quadrada)\n"
+           "salvar ARQ   : grava a sessão inteira em ARQ\n"
+           "carregar ARQ : continua a sessão gravada em ARQ\n"
            "ajuda  : mostrar ajuda\n"
            "sair   : encerrar jogo\n"
+           "\nModo teclado (iniciar com -t):\n"
+           "setas/hjkl : mover o cursor\n"
+           "espaço     : revelar (clique esquerdo)\n"
+           "b          : marcar/desmarcar bandeira (clique direito)\n"
+           "c          : revelar ao redor (clique do meio)\n"
+           "d          : desfazer | U : refazer | q : sair\n"
+           "x ou Esc   : cancelar a revelação em andamento (tabuleiros grandes revelam aos poucos)\n"
+           "\nContagens acima de 9 (hex e 3d) aparecem como letras: A = 10, B = 11 ... Q = 26\n"
            "Pressione Enter...");
     char tmp[10];
     ler_entrada(tmp, 10);
 }
 
+// Lê um inteiro decimal sem sinal do começo de 'texto' e aponta 'fim' para o que sobrou.
+// Devolve false se não começa com dígito (nada de sinal ou espaço) ou se não cabe em 64 bits.
+bool ler_inteiro(const char *texto, char **fim, uint64_t *valor) {
+    if (*texto < '0' || *texto > '9') return false;
+    errno = 0;
+    unsigned long long v = strtoull(texto, fim, 10);
+    if (errno == ERANGE) return false;
+    *valor = v;
+    return true;
+}
+
+// Valor numérico da opção argv[i - 1], lido de argv[i] (até 'maximo'); lixo no fim ou estouro
+// encerra o programa com erro.
+uint64_t ler_numero_opcao(char **argv, int i, uint64_t maximo) {
+    char *fim;
+    uint64_t valor;
+    if (!ler_inteiro(argv[i], &fim, &valor) || *fim != '\0' || valor > maximo) {
+        fprintf(stderr, "ERRO: %s espera um número de 0 a %llu (recebeu '%s')\n",
+                argv[i - 1], (unsigned long long)maximo, argv[i]);
+        exit(EXIT_FAILURE);
+    }
+    return valor;
+}
+
+// Lê um tamanho em bytes com sufixo opcional K, M ou G (ex.: 64M) da opção argv[i - 1].
+size_t ler_tamanho(char **argv, int i) {
+    char *fim;
+    uint64_t valor;
+    unsigned desloc = 0;
+    bool ok = ler_inteiro(argv[i], &fim, &valor);
+    if (ok) {
+        switch (*fim) {
+            case 'G': case 'g': desloc = 30; fim++; break;
+            case 'M': case 'm': desloc = 20; fim++; break;
+            case 'K': case 'k': desloc = 10; fim++; break;
+        }
+        ok = *fim == '\0' && valor <= (SIZE_MAX >> desloc);
+    }
+    if (!ok) {
+        fprintf(stderr, "ERRO: %s espera um tamanho em bytes, com K, M ou G opcional (recebeu '%s')\n",
+                argv[i - 1], argv[i]);
+        exit(EXIT_FAILURE);
+    }
+    return (size_t)(valor << desloc);
+}
+
+//Imprimir as opções de linha de comando
+void imprimir_uso(const char *programa) {
+    fprintf(stderr,
+            "Uso: %s [opções]\n"
+            "  -t, --teclado          joga com setas/mouse em vez de digitar coordenadas\n"
+            "  -s, --semente N        semente da primeira partida (as seguintes usam N+1, N+2...)\n"
+            "  -g, --gravar ARQ       grava as partidas em ARQ (replay binário)\n"
+            "  -p, --reproduzir ARQ   reproduz as partidas de ARQ e sai\n"
+            "      --tempo-real       na reprodução, respeita os tempos gravados e desenha a tela\n"
+            "      --repetir N        na reprodução, roda o arquivo N vezes (medição)\n"
+            "      --trace ARQ        grava um trace JSON (Chrome/Perfetto) da sessão ao sair\n"
+            "      --desfazer-lotes N limita o undo às N últimas jogadas\n"
+            "      --desfazer-bytes N limita a memória do undo e da linha do tempo (aceita K, M, G)\n"
+            "      --sem-chute        só gera tabuleiros que se resolvem sem chutar a partir do 1º clique\n"
+            "      --resolver LxAxM   chance de vencer com jogo perfeito em cada 1º clique e sai\n"
+            "      --servidor SOCK    atende partidas por um socket Unix (protocolo em linhas)\n"
+            "      --carga SOCK       teste de carga contra um servidor local e sai\n"
+            "      --conexoes N       na carga, quantas conexões (padrão 4)\n"
+            "      --sessoes N        na carga, partidas por conexão (padrão 250)\n"
+            "      --espectadores SOCK transmite a partida num socket Unix para quem quiser assistir\n"
+            "      --assistir SOCK    acompanha a partida transmitida em SOCK e sai quando ela acaba\n"
+            "      --bench-espectadores N mede o laço do jogador com N espectadores ligados e sai\n"
+            "  -c, --continuar ARQ    continua a sessão salva em ARQ (comando salvar)\n"
+            "      --bench            mede geração e inundação num tabuleiro grande e sai\n"
+            "      --lado N           no --bench, lado do tabuleiro (padrão 2048)\n"
+            "      --coop N           mede N jogadores revelando o mesmo tabuleiro ao mesmo tempo e sai\n"
+            "      --analisar N       CSV com 3BV, aberturas e números de N tabuleiros (sementes -s, -s+1...) e sai\n"
+            "      --bot ARQ.so       roda o bot da biblioteca (ver bot.h) e mede cada decisão, e sai\n"
+            "      --partidas N       no --bot, quantas partidas (sementes -s, -s+1...; padrão 100)\n"
+            "      --dificuldade X    na análise e no --bot, F, M (padrão), D ou LxAxM\n"
+            "      --topologia NOME   quadrada (padrão), toro (bordas emendadas), hex ou 3d\n"
+            "      --camadas N        no 3d, quantas camadas empilhadas (padrão 3)\n"
+            "      --validar          confere o tabuleiro inteiro depois de cada movimento (aborta se errado)\n"
+            "      --paginas MODO     células de tabuleiros grandes: thp (padrão), hugetlb ou normais\n"
+            "      --fatia US         no modo teclado, revela no máximo US µs por quadro (padrão 4000, 0 = tudo)\n",
+            programa);
+}
+
+// --- PRÉ-GERAÇÃO DE TABULEIROS (THREAD DE FUNDO) ---
+
+/*
+ * Enquanto o jogador está no menu ou na pergunta "Jogar novamente?", uma thread de fundo deixa
+ * pronto o próximo tabuleiro de cada dificuldade (e do último tamanho personalizado), já com a
+ * semente que a próxima partida vai usar, e libera a memória das partidas que acabaram. Escolher
+ * a dificuldade vira uma troca de ponteiros; sem a thread, tudo volta a ser feito na hora.
+ */
+#define QTD_VAGAS_PREGERACAO 4  // F, M, D e o último personalizado
+#define VAGA_PERSONALIZADA   3
+#define MAX_LADO_PERSONALIZADO 10000
+
+// Largura, altura e minas de F, M e D (índice = vaga)
+static const size_t dificuldades[3][3] = {{9, 9, 10}, {16, 16, 40}, {30, 16, 99}};
+
+typedef struct {
+    size_t largura, altura, qtd_minas;  // largura 0 = vaga sem pedido
+    uint64_t semente;
+    bool pronto;                        // 'tab' foi gerado com exatamente esses parâmetros
+    Tabuleiro tab;                      // enquanto a vaga está sendo gerada, só a thread mexe aqui
+} VagaPregeracao;
+
+typedef struct PartidaDescartada {
+    Tabuleiro tab;
+    struct PartidaDescartada *proxima;
+} PartidaDescartada;
+
+typedef struct {
+    pthread_mutex_t trava;
+    pthread_cond_t sinal;
+    pthread_t thread;
+    bool ativa;                         // a thread subiu (senão tudo é feito na thread principal)
+    bool encerrar;
+    int gerando;                        // vaga em geração agora (-1 = nenhuma)
+    VagaPregeracao vagas[QTD_VAGAS_PREGERACAO];
+    Topologia topologia;                // topologia e camadas de todas as vagas (as da sessão)
+    size_t camadas;
+    PartidaDescartada *descartadas;     // partidas esperando para serem liberadas
+    Estatisticas estat;                 // alocações liberadas pela thread, ainda não somadas à sessão
+} PreGerador;
+
+static PreGerador pregerador = {0};
+
+void *trabalhador_pregeracao(void *arg) {
+    PreGerador *g = arg;
+    pthread_mutex_lock(&g->trava);
+    for (;;) {
+        // Liberar vem antes: devolve memória para a geração que vem depois
+        if (g->descartadas) {
+            PartidaDescartada *d = g->descartadas;
+            g->descartadas = d->proxima;
+            pthread_mutex_unlock(&g->trava);
+            liberar_memoria_jogo(&d->tab);
+            pthread_mutex_lock(&g->trava);
+            somar_estatisticas(&g->estat, &d->tab.estat);
+            free(d);
+            continue;
+        }
+        if (g->encerrar) break;
+
+        int v = 0;
+        while (v < QTD_VAGAS_PREGERACAO && (g->vagas[v].largura == 0 || g->vagas[v].pronto)) v++;
+        if (v == QTD_VAGAS_PREGERACAO) {
+            pthread_cond_wait(&g->sinal, &g->trava);
+            continue;
+        }
+
+        VagaPregeracao *vaga = &g->vagas[v];
+        VagaPregeracao pedido = *vaga;
+        g->gerando = v;
+        pthread_mutex_unlock(&g->trava);
+
+        // Só a geração que for usada deve aparecer nos tempos da sessão
+        Tabuleiro *t = &vaga->tab;
+        memset(t->estat.operacoes, 0, sizeof(t->estat.operacoes));
+        t->largura = pedido.largura;
+        t->altura = pedido.altura;
+        t->qtd_minas = pedido.qtd_minas;
+        t->semente = pedido.semente;
+        t->topologia = g->topologia;
+        t->camadas = g->camadas;
+        iniciar_jogo(t);
+
+        pthread_mutex_lock(&g->trava);
+        // O pedido pode ter mudado (nova semente) durante a geração: aí a vaga fica para refazer
+        vaga->pronto = vaga->largura == pedido.largura && vaga->altura == pedido.altura &&
+                       vaga->qtd_minas == pedido.qtd_minas && vaga->semente == pedido.semente;
+        g->gerando = -1;
+        pthread_cond_broadcast(&g->sinal);
+    }
+    pthread_mutex_unlock(&g->trava);
+    // Os buffers da passada que iniciar_jogo usou nesta thread (como em trabalhador_faixa)
+    free(passada_local.memoria);
+    passada_local = (PassadaNumeros){0};
+    return NULL;
+}
+
+// As vagas F, M e D já nascem pedidas; no 3D a altura e as minas delas valem por camada.
+void pregeracao_iniciar(PreGerador *g, Topologia topologia, size_t camadas) {
+    *g = (PreGerador){.gerando = -1, .topologia = topologia, .camadas = camadas};
+    for (size_t v = 0; v < 3; v++) {
+        g->vagas[v].largura = dificuldades[v][0];
+        g->vagas[v].altura = dificuldades[v][1] * camadas;
+        g->vagas[v].qtd_minas = dificuldades[v][2] * camadas;
+    }
+    pthread_mutex_init(&g->trava, NULL);
+    pthread_cond_init(&g->sinal, NULL);
+    g->ativa = pthread_create(&g->thread, NULL, trabalhador_pregeracao, g) == 0;
+}
+
+// Pede que todas as vagas fiquem prontas com 'semente' (a da próxima partida).
+void pregeracao_pedir(PreGerador *g, uint64_t semente) {
+    if (!g->ativa) return;
+    pthread_mutex_lock(&g->trava);
+    for (size_t v = 0; v < QTD_VAGAS_PREGERACAO; v++) {
+        if (g->vagas[v].semente == semente) continue;
+        g->vagas[v].semente = semente;
+        g->vagas[v].pronto = false;
+    }
+    pthread_cond_signal(&g->sinal);
+    pthread_mutex_unlock(&g->trava);
+}
+
+// Entrega a partida de 't' para a thread liberar; 't' fica só com as configurações e as
+// estatísticas da sessão.
+void pregeracao_descartar(PreGerador *g, Tabuleiro *t) {
+    PartidaDescartada *d = g->ativa ? malloc(sizeof(*d)) : NULL;
+    if (!d) {
+        liberar_memoria_jogo(t);
+        return;
+    }
+    d->tab = *t;
+    d->tab.estat = (Estatisticas){0};
+
+    // Nada do que foi entregue pode ficar em 't': com o bytes_mapeados antigo, preparar_celulas
+    // acharia que o mmap do mesmo tamanho ainda está lá (ou daria munmap num ponteiro de realloc)
+    t->celulas = NULL;
+    t->bytes_mapeados = 0;
+    t->inicio_bandeiras = NULL;
+    t->qtd_bandeiras = 0;
+    t->pilha_desfazer = t->fundo_desfazer = NULL;
+    t->lotes_desfazer = t->bytes_desfazer = 0;
+    t->linha = (LinhaDoTempo){0};
+    t->bits_bandeira = t->bits_revelada = t->linhas_mudadas = NULL;
+    t->visivel = NULL;
+    t->revelacao = (RevelacaoPendente){0};
+
+    pthread_mutex_lock(&g->trava);
+    d->proxima = g->descartadas;
+    g->descartadas = d;
+    pthread_cond_signal(&g->sinal);
+    pthread_mutex_unlock(&g->trava);
+}
+
+// Soma às estatísticas de 't' as liberações que a thread já fez.
+void pregeracao_recolher(PreGerador *g, Tabuleiro *t) {
+    if (!g->ativa) return;
+    pthread_mutex_lock(&g->trava);
+    somar_estatisticas(&t->estat, &g->estat);
+    g->estat = (Estatisticas){0};
+    pthread_mutex_unlock(&g->trava);
+}
+
+// Começa em 't' a partida de largura, altura, minas e semente já definidos em 't': usa o tabuleiro
+// da vaga 'v' se ele foi gerado com esses parâmetros, senão gera agora. A vaga passa a guardar
+// esse tamanho (é assim que o personalizado é lembrado).
+void pregeracao_pegar(PreGerador *g, Tabuleiro *t, size_t v) {
+    if (t->celulas) pregeracao_descartar(g, t);
+    if (!g->ativa) {
+        iniciar_jogo(t);
+        return;
+    }
+
+    pthread_mutex_lock(&g->trava);
+    // Se a vaga está no meio da geração, esperar o fim sai mais barato que começar de novo
+    while (g->gerando == (int)v)
+        pthread_cond_wait(&g->sinal, &g->trava);
+
+    VagaPregeracao *vaga = &g->vagas[v];
+    bool pronto = vaga->pronto && vaga->largura == t->largura && vaga->altura == t->altura &&
+                  vaga->qtd_minas == t->qtd_minas && vaga->semente == t->semente &&
+                  g->topologia == t->topologia && g->camadas == t->camadas;
+    Tabuleiro novo = vaga->tab;
+    if (pronto) vaga->tab = (Tabuleiro){0};
+    vaga->largura = t->largura;
+    vaga->altura = t->altura;
+    vaga->qtd_minas = t->qtd_minas;
+    vaga->pronto = false;
+    pthread_mutex_unlock(&g->trava);
+    pregeracao_recolher(g, t);
+
+    if (!pronto) {
+        iniciar_jogo(t);
+        return;
+    }
+
+    // O que é da sessão fica; o resto vem do tabuleiro pronto
+    somar_estatisticas(&t->estat, &novo.estat);
+    novo.estat = t->estat;
+    novo.limite_lotes = t->limite_lotes;
+    novo.limite_bytes = t->limite_bytes;
+    novo.sem_chute = t->sem_chute;
+    *t = novo;
+}
+
+// Para a thread (depois de liberar o que estava na fila) e soma o que ela fez às estatísticas de 't'.
+void pregeracao_encerrar(PreGerador *g, Tabuleiro *t) {
+    if (!g->ativa) return;
+    pthread_mutex_lock(&g->trava);
+    g->encerrar = true;
+    pthread_cond_signal(&g->sinal);
+    pthread_mutex_unlock(&g->trava);
+    pthread_join(g->thread, NULL);
+    g->ativa = false;
+
+    for (size_t v = 0; v < QTD_VAGAS_PREGERACAO; v++) {
+        Tabuleiro *tab = &g->vagas[v].tab;
+        liberar_memoria_jogo(tab);
+        // Gerações que ninguém usou não entram nos tempos, só nas alocações
+        memset(tab->estat.operacoes, 0, sizeof(tab->estat.operacoes));
+        somar_estatisticas(&t->estat, &tab->estat);
+    }
+    somar_estatisticas(&t->estat, &g->estat);
+    pthread_mutex_destroy(&g->trava);
+    pthread_cond_destroy(&g->sinal);
+}
+
+// --- ANÁLISE DE TABULEIROS EM MASSA (--analisar) ---
+
+/*
+ * --analisar N gera N tabuleiros com iniciar_jogo, das sementes S, S+1, ... (-s S), e escreve
+ * no stdout uma linha CSV de métricas por tabuleiro, como saem do gerador (antes do primeiro
+ * clique mover minas):
+ *   3BV: cliques mínimos para limpar o campo sem bandeiras = aberturas + números isolados
+ *   aberturas: regiões de zeros ligadas; o tamanho conta a borda de números que elas abrem
+ *   números isolados: fora de toda abertura, cada um custa um clique
+ *   n0..n8+: quantas células livres têm cada número (o 3D junta 8 ou mais na última coluna)
+ * Cada thread tem o seu Tabuleiro e o seu rascunho, reaproveitados de um tabuleiro para o
+ * outro, e pega blocos de sementes de um contador. Os blocos saem na ordem das sementes, então
+ * o CSV é o mesmo com qualquer número de threads. O resumo vai para o stderr.
+ */
+#define BLOCO_ANALISE        4096   // sementes por bloco de trabalho
+#define COLUNAS_HISTOGRAMA   9      // n0 .. n7 e n8+
+#define TAM_LINHA_ANALISE    512    // folga para uma linha de CSV
+
+typedef struct {
+    size_t bbbv, aberturas, maior_abertura, celulas_abertas, isolados;
+    size_t histograma[COLUNAS_HISTOGRAMA];
+} MetricasTabuleiro;
+
+typedef struct {
+    size_t largura, altura, qtd_minas, camadas;
+    Topologia topologia;
+    uint64_t semente, quantidade;
+    atomic_uint_fast64_t proximo_bloco;
+    pthread_mutex_t trava;
+    pthread_cond_t vez;
+    uint64_t bloco_da_vez;      // próximo bloco a ir para o stdout (protegido pela trava)
+} LoteAnalise;
+
+typedef struct {
+    LoteAnalise *lote;
+    Tabuleiro t;
+    uint32_t *marcas;           // por índice de célula: última abertura que passou por ela
+    size_t *pilha;              // pares (x, y) da busca de cada abertura
+    size_t capacidade;
+    Quadro csv;
+    // Totais desta thread, somados no fim
+    uint64_t tabuleiros, soma_3bv, soma_aberturas, soma_isolados, soma_abertas;
+    size_t minimo_3bv, maximo_3bv;
+    uint64_t histograma[COLUNAS_HISTOGRAMA];
+} TrabalhadorAnalise;
+
+// Escreve v em decimal a partir de p e devolve o fim.
+char *escrever_decimal(char *p, uint64_t v) {
+    char digitos[20];
+    size_t n = 0;
+    do {
+        digitos[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = digitos[--n];
+    return p;
+}
+
+// Mede o tabuleiro atual do trabalhador. As aberturas são achadas por busca em profundidade a
+// partir de cada zero ainda não visitado; fora da grade quadrada os vizinhos vêm de
+// listar_vizinhos.
+void medir_tabuleiro(TrabalhadorAnalise *w, MetricasTabuleiro *m) {
+    const Tabuleiro *t = &w->t;
+    size_t n = CELULAS_ALOCADAS(t);
+    if (n > w->capacidade) {
+        w->marcas = realloc(w->marcas, n * sizeof(uint32_t));
+        w->pilha = realloc(w->pilha, 2 * n * sizeof(size_t));
+        if (!w->marcas || !w->pilha) {
+            perror("ERRO: realloc");
+            exit(EXIT_FAILURE);
+        }
+        w->capacidade = n;
+    }
+    // Cópias locais: as escritas na pilha não obrigam o compilador a reler o tabuleiro
+    uint32_t *marcas = w->marcas;
+    size_t *pilha = w->pilha;
+    const size_t largura = t->largura, altura = t->altura;
+    const bool quadrada = t->topologia == TOPOLOGIA_QUADRADA;
+    memset(marcas, 0, n * sizeof(uint32_t));
+    *m = (MetricasTabuleiro){0};
+
+    uint32_t abertura = 0;
+    size_t vx[MAX_VIZINHOS], vy[MAX_VIZINHOS];
+    for (size_t y = 0; y < altura; y++) {
+        for (size_t x = 0; x < largura; x++) {
+            Celula c = CELULA_EM(t, x, y);
+            if (EH_MINA(c) || NUM_MINAS(c) || marcas[INDICE_CELULA(t, x, y)]) continue;
+
+            // Abertura nova: os zeros se espalham, os números da borda só entram na conta
+            size_t topo = 0, tamanho = 0;
+            marcas[INDICE_CELULA(t, x, y)] = ++abertura;
+            pilha[topo++] = x;
+            pilha[topo++] = y;
+            while (topo) {
+                size_t cy = pilha[--topo], cx = pilha[--topo];
+                tamanho++;
+                unsigned qtd = quadrada ? 8 : listar_vizinhos(t, cx, cy, vx, vy);
+                for (unsigned j = 0; j < qtd; j++) {
+                    size_t nx = quadrada ? cx + direcoes[j][0] : vx[j];
+                    size_t ny = quadrada ? cy + direcoes[j][1] : vy[j];
+                    if (nx >= largura || ny >= altura) continue;
+
+                    uint32_t *marca = &marcas[INDICE_CELULA(t, nx, ny)];
+                    if (*marca == abertura) continue;
+                    *marca = abertura;
+                    if (NUM_MINAS(CELULA_EM(t, nx, ny))) {
+                        tamanho++;
+                    } else {
+                        pilha[topo++] = nx;
+                        pilha[topo++] = ny;
+                    }
+                }
+            }
+            m->aberturas++;
+            if (tamanho > m->maior_abertura) m->maior_abertura = tamanho;
+        }
+    }
+
+    for (size_t y = 0; y < altura; y++) {
+        for (size_t x = 0; x < largura; x++) {
+            Celula c = CELULA_EM(t, x, y);
+            if (EH_MINA(c)) continue;
+            unsigned num = NUM_MINAS(c);
+            bool aberta = marcas[INDICE_CELULA(t, x, y)] != 0;
+            m->histograma[num < COLUNAS_HISTOGRAMA ? num : COLUNAS_HISTOGRAMA - 1]++;
+            m->celulas_abertas += aberta;
+            m->isolados += num && !aberta;
+        }
+    }
+    m->bbbv = m->aberturas + m->isolados;
+}
+
+void *trabalhador_analise(void *arg) {
+    TrabalhadorAnalise *w = arg;
+    LoteAnalise *l = w->lote;
+    uint64_t qtd_blocos = (l->quantidade + BLOCO_ANALISE - 1) / BLOCO_ANALISE;
+    w->t = (Tabuleiro){ .largura = l->largura, .altura = l->altura, .qtd_minas = l->qtd_minas,
+                        .topologia = l->topologia, .camadas = l->camadas };
+    w->minimo_3bv = SIZE_MAX;
+
+    for (;;) {
+        uint64_t bloco = atomic_fetch_add(&l->proximo_bloco, 1);
+        if (bloco >= qtd_blocos) break;
+        uint64_t inicio = bloco * BLOCO_ANALISE;
+        uint64_t fim = inicio + BLOCO_ANALISE < l->quantidade ? inicio + BLOCO_ANALISE : l->quantidade;
+
+        w->csv.tamanho = 0;
+        for (uint64_t i = inicio; i < fim; i++) {
+            MetricasTabuleiro m;
+            w->t.semente = l->semente + i;
+            iniciar_jogo(&w->t);
+            medir_tabuleiro(w, &m);
+
+            quadro_reservar(&w->csv, TAM_LINHA_ANALISE);
+            char *p = w->csv.dados + w->csv.tamanho;
+            size_t campos[] = { m.bbbv, m.aberturas, m.maior_abertura, m.celulas_abertas, m.isolados };
+            p = escrever_decimal(p, w->t.semente);
+            for (size_t k = 0; k < sizeof(campos) / sizeof(campos[0]); k++) {
+                *p++ = ',';
+                p = escrever_decimal(p, campos[k]);
+            }
+            for (size_t k = 0; k < COLUNAS_HISTOGRAMA; k++) {
+                *p++ = ',';
+                p = escrever_decimal(p, m.histograma[k]);
+                w->histograma[k] += m.histograma[k];
+            }
+            *p++ = '\n';
+            w->csv.tamanho = (size_t)(p - w->csv.dados);
+
+            w->tabuleiros++;
+            w->soma_3bv += m.bbbv;
+            w->soma_aberturas += m.aberturas;
+            w->soma_isolados += m.isolados;
+            w->soma_abertas += m.celulas_abertas;
+            if (m.bbbv < w->minimo_3bv) w->minimo_3bv = m.bbbv;
+            if (m.bbbv > w->maximo_3bv) w->maximo_3bv = m.bbbv;
+        }
+
+        // Espera a vez do bloco para o CSV sair na ordem das sementes
+        pthread_mutex_lock(&l->trava);
+        while (l->bloco_da_vez != bloco) pthread_cond_wait(&l->vez, &l->trava);
+        quadro_enviar(&w->csv, STDOUT_FILENO);
+        l->bloco_da_vez++;
+        pthread_cond_broadcast(&l->vez);
+        pthread_mutex_unlock(&l->trava);
+    }
+
+    liberar_memoria_jogo(&w->t);
+    free(passada_local.memoria);
+    passada_local = (PassadaNumeros){0};
+    return NULL;
+}
+
+// Lê F, M, D ou LxAxM (como no menu: no 3D a altura e as minas são por camada).
+bool ler_dificuldade(const char *texto, size_t camadas, size_t *largura, size_t *altura, size_t *minas) {
+    const char *nomes = "FMD";
+    const char *d = texto[0] && !texto[1] ? strchr(nomes, texto[0]) : NULL;
+    if (d) {
+        *largura = dificuldades[d - nomes][0];
+        *altura = dificuldades[d - nomes][1] * camadas;
+        *minas = dificuldades[d - nomes][2] * camadas;
+        return true;
+    }
+    if (sscanf(texto, "%zux%zux%zu", largura, altura, minas) != 3 || *largura == 0 || *altura == 0 ||
+        *largura > MAX_LADO_PERSONALIZADO || *altura > MAX_LADO_PERSONALIZADO / camadas)
+        return false;
+    *altura *= camadas;
+    return *minas < *largura * *altura;
+}
+
+// --analisar N: métricas de N tabuleiros em CSV no stdout, com todas as threads.
+int analisar_tabuleiros(uint64_t quantidade, uint64_t semente, const char *dificuldade,
+                        Topologia topologia, size_t camadas) {
+    LoteAnalise l = { .topologia = topologia, .camadas = camadas, .semente = semente,
+                      .quantidade = quantidade };
+    if (!ler_dificuldade(dificuldade, camadas, &l.largura, &l.altura, &l.qtd_minas) ||
+        !topologia_valida(topologia, l.largura, l.altura, camadas)) {
+        fprintf(stderr, "ERRO: dificuldade inválida: %s (F, M, D ou LxAxM)\n", dificuldade);
+        return EXIT_FAILURE;
+    }
+    atomic_init(&l.proximo_bloco, 0);
+    pthread_mutex_init(&l.trava, NULL);
+    pthread_cond_init(&l.vez, NULL);
+
+    size_t qtd = threads_do_gerador();
+    TrabalhadorAnalise *w = calloc(qtd, sizeof(TrabalhadorAnalise));
+    pthread_t *threads = calloc(qtd, sizeof(pthread_t));
+    if (!w || !threads) return EXIT_FAILURE;
+
+    printf("semente,3bv,aberturas,maior_abertura,celulas_abertas,numeros_isolados");
+    for (size_t k = 0; k < COLUNAS_HISTOGRAMA; k++) printf(",n%zu%s", k, k + 1 < COLUNAS_HISTOGRAMA ? "" : "+");
+    printf("\n");
+    fflush(stdout);
+
+    uint64_t inicio = agora_ns();
+    for (size_t i = 0; i < qtd; i++) {
+        w[i].lote = &l;
+        pthread_create(&threads[i], NULL, trabalhador_analise, &w[i]);
+    }
+
+    uint64_t tabuleiros = 0, soma_3bv = 0, soma_aberturas = 0, soma_isolados = 0, soma_abertas = 0;
+    uint64_t histograma[COLUNAS_HISTOGRAMA] = {0};
+    size_t minimo_3bv = SIZE_MAX, maximo_3bv = 0;
+    for (size_t i = 0; i < qtd; i++) {
+        pthread_join(threads[i], NULL);
+        tabuleiros += w[i].tabuleiros;
+        soma_3bv += w[i].soma_3bv;
+        soma_aberturas += w[i].soma_aberturas;
+        soma_isolados += w[i].soma_isolados;
+        soma_abertas += w[i].soma_abertas;
+        for (size_t k = 0; k < COLUNAS_HISTOGRAMA; k++) histograma[k] += w[i].histograma[k];
+        if (w[i].tabuleiros && w[i].minimo_3bv < minimo_3bv) minimo_3bv = w[i].minimo_3bv;
+        if (w[i].maximo_3bv > maximo_3bv) maximo_3bv = w[i].maximo_3bv;
+        free(w[i].marcas);
+        free(w[i].pilha);
+        free(w[i].csv.dados);
+    }
+    double s = (agora_ns() - inicio) / 1e9;
+
+    if (tabuleiros) {
+        double livres = (double)tabuleiros * (l.largura * l.altura - l.qtd_minas);
+        fprintf(stderr, "%llu tabuleiros %zux%zu com %zu minas (%s) em %.3f s: %.0f tabuleiros/s com %zu threads\n",
+                (unsigned long long)tabuleiros, l.largura, l.altura, l.qtd_minas, nomes_topologia[topologia],
+                s, tabuleiros / s, qtd);
+        fprintf(stderr, "3BV médio %.2f (mín %zu, máx %zu) | %.2f aberturas, %.2f números isolados, "
+                        "%.1f%% das células livres em aberturas\n",
+                (double)soma_3bv / tabuleiros, minimo_3bv, maximo_3bv, (double)soma_aberturas / tabuleiros,
+                (double)soma_isolados / tabuleiros, 100.0 * soma_abertas / livres);
+        fprintf(stderr, "Números das células livres:");
+        for (size_t k = 0; k < COLUNAS_HISTOGRAMA; k++)
+            fprintf(stderr, " %zu%s %.2f%%", k, k + 1 < COLUNAS_HISTOGRAMA ? ":" : "+:", 100.0 * histograma[k] / livres);
+        fprintf(stderr, "\n");
+    }
+
+    pthread_mutex_destroy(&l.trava);
+    pthread_cond_destroy(&l.vez);
+    free(w);
+    free(threads);
+    return EXIT_SUCCESS;
+}
+
+// --- BOTS (PLUG-INS COM DLOPEN, --bot) ---
+
+/*
+ * Roda um bot (ver bot.h) em partidas com sementes seguidas e mede cada decisão. A BotVista
+ * aponta para t->visivel, que o motor mantém junto com os bitboards: não há cópia por decisão, e
+ * as células escondidas chegam só com o bit de bandeira. As jogadas passam por aplicar_movimento,
+ * como as do replay, então undo, linha do tempo e --validar valem para elas como para o jogador.
+ * A separação é da interface: código carregado no processo ainda pode ler qualquer memória dele.
+ */
+
+// A vista usa os mesmos bits, topologias e resultados do motor
+_Static_assert(BOT_REVELADA == 1 << DESLOC_REVELADA && BOT_BANDEIRA == 1 << DESLOC_BANDEIRA &&
+               BOT_MINA == 1 << DESLOC_MINA && BOT_NUMERO == MASCARA_MINAS, "bits da vista");
+_Static_assert(BOT_MAX_VIZINHOS == MAX_VIZINHOS, "vizinhos da vista");
+_Static_assert(BOT_QUADRADA == (int)TOPOLOGIA_QUADRADA && BOT_TORO == (int)TOPOLOGIA_TORO &&
+               BOT_HEX == (int)TOPOLOGIA_HEX && BOT_3D == (int)TOPOLOGIA_3D, "topologias da vista");
+_Static_assert(BOT_NADA == (int)JOGADA_NADA && BOT_FEITA == (int)JOGADA_FEITA &&
+               BOT_PERDEU == (int)JOGADA_MINA && BOT_VENCEU == (int)JOGADA_VITORIA, "resultados da vista");
+
+typedef struct {
+    BotVista vista;       // primeiro campo: bot_vizinhos volta da vista para a sessão
+    Tabuleiro t;
+    ResultadoJogada resultado;
+    size_t mudancas;      // jogadas que mudaram o tabuleiro na decisão atual
+    uint64_t ns_motor;    // tempo dentro de bot_jogar na decisão atual
+} SessaoBot;
+
+unsigned bot_vizinhos(const BotVista *vista, size_t x, size_t y, size_t *vx, size_t *vy) {
+    const SessaoBot *s = (const SessaoBot *)vista;
+    if (x >= s->t.largura || y >= s->t.altura) return 0;
+    return listar_vizinhos(&s->t, x, y, vx, vy);
+}
+
+// BotJogar: aplica a jogada do bot. Depois do fim da partida nada mais muda.
+int bot_jogar(void *contexto, int acao, size_t x, size_t y) {
+    SessaoBot *s = contexto;
+    Tabuleiro *t = &s->t;
+    if (s->resultado == JOGADA_MINA || s->resultado == JOGADA_VITORIA) return s->resultado;
+    if (x >= t->largura || y >= t->altura || (acao != BOT_JOGAR_REVELAR && acao != BOT_JOGAR_BANDEIRA))
+        return BOT_NADA;
+
+    uint64_t inicio = agora_ns();
+    Celula antes = CELULA_EM(t, x, y);
+    TipoMovimento tipo = acao == BOT_JOGAR_BANDEIRA ? MOV_BANDEIRA : ESTA_REVELADA(antes) ? MOV_ACORDE : MOV_REVELAR;
+    ResultadoJogada r = aplicar_movimento(t, tipo, x, y);
+    if (r != JOGADA_NADA) {
+        s->mudancas++;
+        s->resultado = r;
+        if (tipo == MOV_BANDEIRA) s->vista.bandeiras += TEM_BANDEIRA(antes) ? (size_t)-1 : 1;
+    }
+    s->vista.reveladas = t->celulas_reveladas;
+    s->ns_motor += agora_ns() - inicio;
+    return r;
+}
+
+void histograma_somar(Histograma *h, uint64_t ns) {
+    h->baldes[balde_histograma(ns)]++;
+    h->quantidade++;
+    h->total_ns += ns;
+    if (ns > h->maximo_ns) h->maximo_ns = ns;
+}
+
+void imprimir_tempos_bot(const char *nome, const Histograma *h) {
+    char p50[16], p99[16], maximo[16];
+    formatar_duracao(p50, sizeof(p50), percentil_histograma(h, 50));
+    formatar_duracao(p99, sizeof(p99), percentil_histograma(h, 99));
+    formatar_duracao(maximo, sizeof(maximo), h->maximo_ns);
+    printf("%-*s média %7.2f µs | p50 %s | p99 %s | máx %s\n", 18 + bytes_extras_utf8(nome), nome,
+           h->quantidade ? h->total_ns / 1e3 / h->quantidade : 0.0, p50, p99, maximo);
+}
+
+// Joga 'partidas' partidas do bot no tabuleiro de 's' (tamanho, topologia e expor_visivel já
+// definidos), sementes a partir de 'semente', e imprime o resumo.
+void jogar_partidas_bot(const Bot *bot, SessaoBot *s, uint64_t partidas, uint64_t semente) {
+    Tabuleiro *t = &s->t;
+    Histograma decisoes = {0}, pensando = {0};
+    uint64_t vitorias = 0, derrotas = 0, desistencias = 0, jogadas = 0;
+    uint64_t inicio = agora_ns();
+    for (uint64_t p = 0; p < partidas; p++) {
+        t->semente = semente + p;
+        iniciar_jogo(t);
+        s->vista = (BotVista){
+            .largura = t->largura, .altura = t->altura, .qtd_minas = t->qtd_minas,
+            .topologia = (int)t->topologia, .camadas = t->camadas,
+            .celulas = t->visivel, .vizinhos = bot_vizinhos,
+        };
+        s->resultado = JOGADA_NADA;
+        void *estado = bot->iniciar ? bot->iniciar(&s->vista, t->semente) : NULL;
+
+        for (;;) {
+            s->mudancas = 0;
+            s->ns_motor = 0;
+            uint64_t comeco = agora_ns();
+            int pedido = bot->decidir(estado, &s->vista, bot_jogar, s);
+            uint64_t duracao = agora_ns() - comeco;
+            histograma_somar(&decisoes, duracao);
+            histograma_somar(&pensando, duracao - s->ns_motor);
+            jogadas += s->mudancas;
+
+            if (s->resultado == JOGADA_MINA)    { derrotas++; break; }
+            if (s->resultado == JOGADA_VITORIA) { vitorias++; break; }
+            // Uma decisão que não muda nada se repetiria para sempre
+            if (pedido != BOT_CONTINUAR || !s->mudancas) { desistencias++; break; }
+        }
+
+        if (bot->encerrar) bot->encerrar(estado);
+        liberar_memoria_jogo(t);
+    }
+    double segundos = (agora_ns() - inicio) / 1e9;
+
+    printf("Vitórias %llu (%.1f%%) | derrotas %llu | desistências %llu | %.1f jogadas por partida\n",
+           (unsigned long long)vitorias, partidas ? 100.0 * vitorias / partidas : 0.0,
+           (unsigned long long)derrotas, (unsigned long long)desistencias,
+           partidas ? (double)jogadas / partidas : 0.0);
+    printf("%llu decisões em %.3f s (%.0f partidas/s)\n", (unsigned long long)decisoes.quantidade,
+           segundos, segundos > 0 ? partidas / segundos : 0.0);
+    imprimir_tempos_bot("Decisão inteira", &decisoes);
+    imprimir_tempos_bot("Só o bot", &pensando);
+}
+
+// --bot ARQ.so: 'partidas' partidas do bot, sementes a partir de 'semente'.
+int rodar_bot(const char *caminho, uint64_t partidas, uint64_t semente, const char *dificuldade,
+              Topologia topologia, size_t camadas) {
+    SessaoBot *s = calloc(1, sizeof(SessaoBot));
+    if (!s) return EXIT_FAILURE;
+    Tabuleiro *t = &s->t;
+    if (!ler_dificuldade(dificuldade, camadas, &t->largura, &t->altura, &t->qtd_minas) ||
+        !topologia_valida(topologia, t->largura, t->altura, camadas)) {
+        fprintf(stderr, "ERRO: dificuldade inválida: %s (F, M, D ou LxAxM)\n", dificuldade);
+        free(s);
+        return EXIT_FAILURE;
+    }
+
+    // dlopen só procura no caminho de bibliotecas quando o nome não tem '/'
+    char local[4096];
+    snprintf(local, sizeof(local), "%s%s", strchr(caminho, '/') ? "" : "./", caminho);
+    void *biblioteca = dlopen(local, RTLD_NOW | RTLD_LOCAL);
+    const Bot *bot = biblioteca ? dlsym(biblioteca, BOT_SIMBOLO) : NULL;
+    if (!bot || bot->versao != BOT_VERSAO || !bot->decidir) {
+        if (!biblioteca) fprintf(stderr, "ERRO: %s\n", dlerror());
+        else if (!bot) fprintf(stderr, "ERRO: %s não exporta %s\n", caminho, BOT_SIMBOLO);
+        else fprintf(stderr, "ERRO: %s é da versão %u da interface, o jogo é da %d\n", caminho, bot->versao, BOT_VERSAO);
+        if (biblioteca) dlclose(biblioteca);
+        free(s);
+        return EXIT_FAILURE;
+    }
+
+    t->topologia = topologia;
+    t->camadas = camadas;
+    t->expor_visivel = true;
+    printf("Bot \"%s\" (%s): %llu partidas %zux%zu com %zu minas (%s), sementes a partir de %llu\n",
+           bot->nome ? bot->nome : "?", caminho, (unsigned long long)partidas, t->largura, t->altura,
+           t->qtd_minas, nomes_topologia[topologia], (unsigned long long)semente);
+    jogar_partidas_bot(bot, s, partidas, semente);
+
+    dlclose(biblioteca);
+    free(s);
+    return EXIT_SUCCESS;
+}
+
 // --- MAIN ---
 
-int main(void) {
-    srand(time(NULL));
+int main(int argc, char **argv) {
+    bool modo_teclado = false;
+    bool tempo_real = false;
+    const char *arquivo_gravar = NULL;
+    const char *arquivo_reproduzir = NULL;
+    const char *arquivo_continuar = NULL;
+    size_t repeticoes = 1;
+    size_t limite_lotes = 0, limite_bytes = 0;
+    bool sem_chute = false;
+    const char *socket_servidor = NULL, *socket_carga = NULL;
+    const char *socket_espectadores = NULL, *socket_assistir = NULL;
+    size_t espectadores_bench = 0;
+    uint64_t tabuleiros_analise = 0;
+    const char *dificuldade_analise = "M";
+    const char *biblioteca_bot = NULL;
+    uint64_t partidas_bot = 100;
+    size_t conexoes = 4, sessoes = 250;
+    size_t jogadores_coop = 0;
+    bool bench = false;
+    size_t lado_bench = LADO_BENCH;
+    Topologia topologia = TOPOLOGIA_QUADRADA;
+    size_t camadas = 0;
+    uint64_t semente = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+
+    for (int i = 1; i < argc; i++) {
+        // Opções que recebem um valor no argumento seguinte
+        bool tem_valor = i + 1 < argc;
+
+        if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--teclado") == 0) {
+            modo_teclado = true;
+        } else if ((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--semente") == 0) && tem_valor) {
+            semente = ler_numero_opcao(argv, ++i, UINT64_MAX);
+        } else if ((strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--gravar") == 0) && tem_valor) {
+            arquivo_gravar = argv[++i];
+        } else if ((strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--reproduzir") == 0) && tem_valor) {
+            arquivo_reproduzir = argv[++i];
+        } else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--continuar") == 0) && tem_valor) {
+            arquivo_continuar = argv[++i];
+        } else if (strcmp(argv[i], "--tempo-real") == 0) {
+            tempo_real = true;
+        } else if (strcmp(argv[i], "--repetir") == 0 && tem_valor) {
+            repeticoes = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--trace") == 0 && tem_valor) {
+            trace_iniciar(argv[++i]);
+        } else if (strcmp(argv[i], "--desfazer-lotes") == 0 && tem_valor) {
+            limite_lotes = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--desfazer-bytes") == 0 && tem_valor) {
+            limite_bytes = ler_tamanho(argv, ++i);
+        } else if (strcmp(argv[i], "--resolver") == 0 && tem_valor) {
+            return resolver_tabuleiro(argv[++i]);
+        } else if (strcmp(argv[i], "--servidor") == 0 && tem_valor) {
+            socket_servidor = argv[++i];
+        } else if (strcmp(argv[i], "--espectadores") == 0 && tem_valor) {
+            socket_espectadores = argv[++i];
+        } else if (strcmp(argv[i], "--assistir") == 0 && tem_valor) {
+            socket_assistir = argv[++i];
+        } else if (strcmp(argv[i], "--bench-espectadores") == 0 && tem_valor) {
+            espectadores_bench = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--analisar") == 0 && tem_valor) {
+            tabuleiros_analise = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--dificuldade") == 0 && tem_valor) {
+            dificuldade_analise = argv[++i];
+        } else if (strcmp(argv[i], "--bot") == 0 && tem_valor) {
+            biblioteca_bot = argv[++i];
+        } else if (strcmp(argv[i], "--partidas") == 0 && tem_valor) {
+            partidas_bot = ler_numero_opcao(argv, ++i, UINT64_MAX);
+        } else if (strcmp(argv[i], "--carga") == 0 && tem_valor) {
+            socket_carga = argv[++i];
+        } else if (strcmp(argv[i], "--conexoes") == 0 && tem_valor) {
+            conexoes = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--sessoes") == 0 && tem_valor) {
+            sessoes = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--coop") == 0 && tem_valor) {
+            jogadores_coop = ler_numero_opcao(argv, ++i, SIZE_MAX);
+            if (jogadores_coop == 0) jogadores_coop = SIZE_MAX;
+        } else if (strcmp(argv[i], "--sem-chute") == 0) {
+            sem_chute = true;
+        } else if (strcmp(argv[i], "--topologia") == 0 && tem_valor) {
+            if (!ler_topologia(argv[++i], &topologia)) {
+                fprintf(stderr, "ERRO: topologia desconhecida: %s (quadrada, toro, hex ou 3d)\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--validar") == 0) {
+            validar_jogadas = true;
+        } else if (strcmp(argv[i], "--lado") == 0 && tem_valor) {
+            lado_bench = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else if (strcmp(argv[i], "--paginas") == 0 && tem_valor) {
+            i++;
+            size_t m = 0;
+            while (m < QTD_MODOS_PAGINAS && strcmp(argv[i], nomes_paginas[m]) != 0) m++;
+            if (m == QTD_MODOS_PAGINAS) {
+                fprintf(stderr, "ERRO: modo de páginas desconhecido: %s (normais, thp ou hugetlb)\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            modo_paginas = (ModoPaginas)m;
+        } else if (strcmp(argv[i], "--fatia") == 0 && tem_valor) {
+            fatia_revelar_ns = ler_numero_opcao(argv, ++i, UINT64_MAX / 1000) * 1000;
+        } else if (strcmp(argv[i], "--camadas") == 0 && tem_valor) {
+            camadas = ler_numero_opcao(argv, ++i, SIZE_MAX);
+        } else {
+            fprintf(stderr, "Opção desconhecida: %s\n", argv[i]);
+            imprimir_uso(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Só o 3D empilha camadas; ele usa 3 se o número não foi dado
+    if (topologia != TOPOLOGIA_3D) camadas = 1;
+    else if (camadas == 0) camadas = 3;
+    if (camadas > MAX_LADO_PERSONALIZADO / dificuldades[1][1]) {
+        fprintf(stderr, "ERRO: no máximo %zu camadas\n", MAX_LADO_PERSONALIZADO / dificuldades[1][1]);
+        return EXIT_FAILURE;
+    }
+    if (lado_bench < 64) {
+        fprintf(stderr, "ERRO: --lado precisa ser pelo menos 64\n");
+        return EXIT_FAILURE;
+    }
+    if (sem_chute && topologia != TOPOLOGIA_QUADRADA) {
+        fprintf(stderr, "ERRO: --sem-chute só funciona na topologia quadrada\n");
+        return EXIT_FAILURE;
+    }
+
+    if (arquivo_reproduzir)
+        return reproduzir_replay(arquivo_reproduzir, tempo_real, repeticoes);
+    if (socket_servidor)
+        return servir(socket_servidor);
+    if (socket_carga)
+        return rodar_carga(socket_carga, conexoes, sessoes);
+    if (jogadores_coop)
+        return bench_cooperativo(jogadores_coop, semente);
+    if (socket_assistir)
+        return assistir(socket_assistir);
+    if (tabuleiros_analise)
+        return analisar_tabuleiros(tabuleiros_analise, semente, dificuldade_analise, topologia, camadas);
+    if (biblioteca_bot)
+        return rodar_bot(biblioteca_bot, partidas_bot, semente, dificuldade_analise, topologia, camadas);
+    if (espectadores_bench)
+        return bench_espectadores(espectadores_bench, semente);
+    if (bench)
+        return rodar_bench(semente, topologia, camadas, lado_bench);
+
+    if (arquivo_gravar && !gravador_abrir(&gravador, arquivo_gravar))
+        return EXIT_FAILURE;
+
     Tabuleiro tabuleiro = {0};
+    tabuleiro.limite_lotes = limite_lotes;
+    tabuleiro.limite_bytes = limite_bytes;
+    tabuleiro.sem_chute = sem_chute;
     char buf[TAM_BUFFER_ENTRADA] = {0};
+    pregeracao_iniciar(&pregerador, topologia, camadas);
+    if (!modo_teclado) {
+        // O modo teclado redesenha só as células que mudaram e mede a própria latência
+        renderizador_iniciar(&renderizador);
+        atexit(renderizador_encerrar);
+    }
+    if (socket_espectadores) {
+        if (!transmissao_iniciar(&transmissor, socket_espectadores)) return EXIT_FAILURE;
+        atexit(transmissao_encerrar);
+    }
+
+    if (arquivo_continuar) {
+        if (!carregar_sessao(&tabuleiro, arquivo_continuar)) return EXIT_FAILURE;
+        goto _partida_carregada;
+    }
 
 _inicio_do_jogo:
+    pregeracao_pedir(&pregerador, semente);
+    // Uma sessão carregada pode ter vindo de outra topologia; as partidas novas usam a da sessão
+    tabuleiro.topologia = topologia;
+    tabuleiro.camadas = camadas;
 
     // --- SELEÇÃO DE DIFICULDADE ---
+    size_t vaga;
     for (;;) {
-        imprimir_menu();
+        imprimir_menu(topologia, camadas);
         printf("> ");
-        ler_entrada(buf, TAM_BUFFER_ENTRADA);
+        if (!ler_entrada(buf, TAM_BUFFER_ENTRADA)) goto _sair_do_jogo;
 
         if (strcmp(buf, "sair") == 0) goto _sair_do_jogo;
 
@@ -548,44 +7864,64 @@ _inicio_do_jogo:
             continue;
         }
 
-        if (strcmp(buf, "F") == 0) { 
-            tabuleiro.largura = 9;  
-            tabuleiro.altura = 9;  
-            tabuleiro.qtd_minas = 10; 
-        }
-        else if (strcmp(buf, "M") == 0) { 
-            tabuleiro.largura = 16; 
-            tabuleiro.altura = 16; 
-            tabuleiro.qtd_minas = 40; 
-        }
-        else if (strcmp(buf, "D") == 0) { 
-            tabuleiro.largura = 30; 
-            tabuleiro.altura = 16; 
-            tabuleiro.qtd_minas = 99; 
+        size_t largura, altura, minas;
+        if (strcmp(buf, "F") == 0) vaga = 0;
+        else if (strcmp(buf, "M") == 0) vaga = 1;
+        else if (strcmp(buf, "D") == 0) vaga = 2;
+        else if (sscanf(buf, "P %zu %zu %zu", &largura, &altura, &minas) == 3 &&
+                 largura > 0 && altura > 0 && largura <= MAX_LADO_PERSONALIZADO &&
+                 altura <= MAX_LADO_PERSONALIZADO / camadas && minas < largura * altura * camadas &&
+                 topologia_valida(topologia, largura, altura * camadas, camadas)) {
+            vaga = VAGA_PERSONALIZADA;
         }
         else continue;
 
+        // No 3D a altura pedida é a de uma camada (e as minas de F, M e D também são por camada)
+        if (vaga == VAGA_PERSONALIZADA) {
+            tabuleiro.largura = largura;
+            tabuleiro.altura = altura * camadas;
+            tabuleiro.qtd_minas = minas;
+        } else {
+            tabuleiro.largura = dificuldades[vaga][0];
+            tabuleiro.altura = dificuldades[vaga][1] * camadas;
+            tabuleiro.qtd_minas = dificuldades[vaga][2] * camadas;
+        }
         break;
     }
 
-    iniciar_jogo(&tabuleiro);
+    tabuleiro.semente = semente++;
+    pregeracao_pegar(&pregerador, &tabuleiro, vaga);
+    gravador_iniciar_partida(&gravador, &tabuleiro);
+
+_partida_carregada:
+    if (modo_teclado) {
+        ResultadoJogada resultado = jogar_com_teclado(&tabuleiro);
+        if (resultado == JOGADA_SAIR) goto _sair_do_jogo;
+        if (resultado != JOGADA_NADA) goto _reiniciar_jogo;
+        // Terminal não aceita modo cru: segue no modo de linhas
+    }
+
     atualizar_tela(&tabuleiro);
 
     // --- LOOP PRINCIPAL ---
     for (;;) {
         printf("\nComando > ");
-        ler_entrada(buf, TAM_BUFFER_ENTRADA);
+        if (!ler_entrada(buf, TAM_BUFFER_ENTRADA)) goto _sair_do_jogo;
 
-        if (strcmp(buf, "sair") == 0) goto _sair_do_jogo;
+        uint64_t inicio_entrada = agora_ns();
+        Comando cmd = interpretar_comando(buf);
+        registrar_tempo(&tabuleiro, OP_ENTRADA, inicio_entrada, strlen(buf));
+
+        if (cmd.tipo == CMD_SAIR) goto _sair_do_jogo;
         
-        if (strcmp(buf, "ajuda") == 0) {
+        if (cmd.tipo == CMD_AJUDA) {
             imprimir_menu_ajuda();
             atualizar_tela(&tabuleiro);
             continue;
         }
 
-        if (strcmp(buf, "d") == 0) {
-            if (pilha_desfazer(&tabuleiro))
+        if (cmd.tipo == CMD_DESFAZER) {
+            if (jogar(&tabuleiro, MOV_DESFAZER, 0, 0) != JOGADA_NADA)
                 printf("Desfeito.\n");
             else
                 printf("Nada para desfazer.\n");
@@ -593,50 +7929,114 @@ _inicio_do_jogo:
             atualizar_tela(&tabuleiro);
             continue;
         }
-        if (strcmp(buf, "lb") == 0) {
+        if (cmd.tipo == CMD_REFAZER || cmd.tipo == CMD_IR) {
+            ResultadoJogada resultado = cmd.tipo == CMD_REFAZER
+                ? jogar(&tabuleiro, MOV_REFAZER, 0, 0)
+                : jogar(&tabuleiro, MOV_IR, cmd.x, 0);
+
+            atualizar_tela(&tabuleiro);
+            if (resultado == JOGADA_NADA)
+                printf(cmd.tipo == CMD_REFAZER ? "Nada para refazer.\n" : "Jogada inexistente.\n");
+            else
+                printf("Na jogada %zu de %zu.\n", tabuleiro.linha.posicao, tabuleiro.linha.qtd_jogadas);
+
+            if (resultado == JOGADA_MINA) {
+                revelar_tabuleiro(&tabuleiro);
+                atualizar_tela(&tabuleiro);
+                printf("\n\x1b[31mBOOM! Você acertou uma mina!\x1b[0m\n");
+                break;
+            }
+            if (resultado == JOGADA_VITORIA) {
+                printf("\n\x1b[32mPARABÉNS! Você limpou o campo!\x1b[0m\n");
+                break;
+            }
+            continue;
+        }
+        if (cmd.tipo == CMD_LISTAR_BANDEIRAS) {
             listar_bandeiras(&tabuleiro);
             atualizar_tela(&tabuleiro);
             continue;
         }
+        if (cmd.tipo == CMD_MELHOR) {
+            imprimir_melhor_jogada(&tabuleiro);
+            continue;
+        }
+        if (cmd.tipo == CMD_SALVAR) {
+            salvar_sessao(&tabuleiro, cmd.arquivo);
+            continue;
+        }
+        if (cmd.tipo == CMD_CARREGAR) {
+            if (carregar_sessao(&tabuleiro, cmd.arquivo)) {
+                gravador_finalizar_partida(&gravador);
+                atualizar_tela(&tabuleiro);
+                printf("Na jogada %zu de %zu.\n", tabuleiro.linha.posicao, tabuleiro.linha.qtd_jogadas);
+            }
+            continue;
+        }
+        if (cmd.tipo == CMD_ESTATISTICAS) {
+            pregeracao_recolher(&pregerador, &tabuleiro);
+            imprimir_estatisticas(&tabuleiro);
+            printf("Pressione Enter...");
+            ler_entrada(buf, TAM_BUFFER_ENTRADA);
+            atualizar_tela(&tabuleiro);
+            continue;
+        }
 
-        char acao;
-        size_t x, y;
-        if (sscanf(buf, "%c %zu %zu", &acao, &y, &x) == 3) {
-            if (x >= tabuleiro.largura || y >= tabuleiro.altura) {
+        if (cmd.area) {
+            // "*" vai até a última linha ou coluna
+            if (cmd.x_fim == SIZE_MAX) cmd.x_fim = tabuleiro.largura - 1;
+            if (cmd.y_fim == SIZE_MAX) cmd.y_fim = tabuleiro.altura - 1;
+            if (cmd.x_fim >= tabuleiro.largura || cmd.y_fim >= tabuleiro.altura) {
                 printf("Coordenadas inválidas.\n");
                 continue;
             }
 
-            if (acao == 'b') {
-                alternar_bandeira(&tabuleiro, x, y);   // função abaixo
+            TipoMovimento tipo = cmd.tipo == CMD_REVELAR  ? MOV_REVELAR_AREA :
+                                 cmd.tipo == CMD_BANDEIRA ? MOV_BANDEIRA_AREA : MOV_LIMPAR_AREA;
+            ResultadoJogada resultado = jogar_area(&tabuleiro, tipo, cmd.x, cmd.y, cmd.x_fim, cmd.y_fim);
+            if (resultado == JOGADA_MINA) {
+                revelar_tabuleiro(&tabuleiro);
                 atualizar_tela(&tabuleiro);
+                printf("\n\x1b[31mBOOM! Você acertou uma mina!\x1b[0m\n");
+                break;
+            }
+            atualizar_tela(&tabuleiro);
+            if (resultado == JOGADA_VITORIA) {
+                printf("\n\x1b[32mPARABÉNS! Você limpou o campo!\x1b[0m\n");
+                break;
+            }
+            continue;
+        }
+
+        if (cmd.tipo == CMD_REVELAR || cmd.tipo == CMD_BANDEIRA) {
+            size_t x = cmd.x, y = cmd.y;
+            if (x >= tabuleiro.largura || y >= tabuleiro.altura) {
+                printf("Coordenadas inválidas.\n");
+                continue;
             }
-            else if (acao == 'r') {
-                Celula atual = CELULA_EM(&tabuleiro, x, y);
 
+            if (cmd.tipo == CMD_BANDEIRA) {
+                jogar(&tabuleiro, MOV_BANDEIRA, x, y);
+                atualizar_tela(&tabuleiro);
+            }
+            else {
                 // usar os defines que você tem
-                if (TEM_BANDEIRA(atual)) {
+                if (TEM_BANDEIRA(CELULA_EM(&tabuleiro, x, y))) {
                     printf("A célula está marcada com bandeira. Remova primeiro.\n");
                     continue;
                 }
 
-                bool acertou_mina = false;
-
-                if (ESTA_REVELADA(atual)) {
-                    acertou_mina = revelar_ao_redor(&tabuleiro, x, y);
-                } else {
-                    revelar_celula(&tabuleiro, x, y);
-                    if (EH_MINA(CELULA_EM(&tabuleiro, x, y))) acertou_mina = true;
-                }
+                TipoMovimento tipo = ESTA_REVELADA(CELULA_EM(&tabuleiro, x, y)) ? MOV_ACORDE : MOV_REVELAR;
+                ResultadoJogada resultado = jogar(&tabuleiro, tipo, x, y);
 
-                if (acertou_mina) {
+                if (resultado == JOGADA_MINA) {
                     revelar_tabuleiro(&tabuleiro);
                     atualizar_tela(&tabuleiro);
                     printf("\n\x1b[31mBOOM! Você acertou uma mina!\x1b[0m\n");
                     break;
                 }
 
-                if (verificar_vitoria(&tabuleiro)) {
+                if (resultado == JOGADA_VITORIA) {
                     atualizar_tela(&tabuleiro);
                     printf("\n\x1b[32mPARABÉNS! Você limpou o campo!\x1b[0m\n");
                     break;
@@ -651,12 +8051,15 @@ _inicio_do_jogo:
 
 
     // --- REINICIAR JOGO ---
+_reiniciar_jogo:
+    pregeracao_pedir(&pregerador, semente);
     for (;;) {
         printf("Jogar novamente? (S/N) > ");
-        ler_entrada(buf, TAM_BUFFER_ENTRADA);
+        if (!ler_entrada(buf, TAM_BUFFER_ENTRADA)) break;
 
         if (strcmp(buf, "S") == 0 || strcmp(buf, "s") == 0) {
-            liberar_memoria_jogo(&tabuleiro);
+            gravador_finalizar_partida(&gravador);
+            pregeracao_descartar(&pregerador, &tabuleiro);
             goto _inicio_do_jogo;
         } 
         else if (strcmp(buf, "N") == 0 || strcmp(buf, "n") == 0) {
@@ -665,7 +8068,12 @@ _inicio_do_jogo:
     }
 
 _sair_do_jogo:
+    gravador_fechar(&gravador);
     liberar_memoria_jogo(&tabuleiro);
+    pregeracao_encerrar(&pregerador, &tabuleiro);
+    renderizador_encerrar();
+    transmissao_encerrar();
+    imprimir_estatisticas(&tabuleiro);
     printf("Até mais!\n");
     return 0;
 }
\ No newline at end of file
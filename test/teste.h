@@ -0,0 +1,53 @@
+/*
+ * Campo Minado - apoio dos testes (make teste)
+ *
+ * Cada test/teste_*.c inclui o jogo inteiro, com o main dele renomeado para jogo_main, e confere
+ * o motor por dentro. CONFERIR anota a falha e segue; o programa sai com erro se alguma falhou.
+ */
+#ifndef TESTE_H
+#define TESTE_H
+
+#define main jogo_main
+#include "../main.c"
+#undef main
+
+int falhas_teste = 0;
+FILE *relatorio_teste = NULL;   // onde saem as falhas e o resultado (NULL = stderr)
+
+#define CONFERIR(cond) do {                                                         \
+        if (!(cond)) {                                                              \
+            fprintf(relatorio_teste ? relatorio_teste : stderr,                     \
+                    "%s:%d: falhou: %s\n", __FILE__, __LINE__, #cond);              \
+            falhas_teste++;                                                         \
+        }                                                                           \
+    } while (0)
+
+// Manda o que o jogo imprime (mensagens de salvar, erros esperados) para /dev/null; as falhas
+// e o resultado continuam saindo no stderr de antes.
+void silenciar_jogo(void) {
+    fflush(stdout);
+    fflush(stderr);
+    relatorio_teste = fdopen(dup(STDERR_FILENO), "w");
+    int nulo = open("/dev/null", O_WRONLY);
+    dup2(nulo, STDOUT_FILENO);
+    dup2(nulo, STDERR_FILENO);
+    close(nulo);
+}
+
+// Última linha do main de cada teste
+int fim_dos_testes(const char *nome) {
+    fprintf(relatorio_teste ? relatorio_teste : stdout, "%s: %s\n", nome, falhas_teste ? "FALHOU" : "ok");
+    return falhas_teste ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Sorteio dos testes (xorshift64), independente do gerador do tabuleiro
+uint64_t estado_teste = 88172645463325252u;
+
+size_t sortear_teste(size_t n) {
+    estado_teste ^= estado_teste << 13;
+    estado_teste ^= estado_teste >> 7;
+    estado_teste ^= estado_teste << 17;
+    return (size_t)(estado_teste % n);
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Bots (--bot): partidas do bots/simples.so (make bots) por jogar_partidas_bot, embrulhado num
+ * bot que confere a vista antes de cada decisão e depois de cada jogada.
+ *   - a vista é t->visivel e nunca mostra mina nem número de uma célula escondida
+ *   - revelada, a célula aparece com o byte do tabuleiro; reveladas e bandeiras batem
+ * Em todas as topologias.
+ */
+#include "teste.h"
+
+#define BOT_TESTE "./bots/simples.so"
+
+const Bot *bot_simples;
+size_t decisoes_conferidas, jogadas_conferidas;
+
+bool vista_confere(const BotVista *v, const SessaoBot *s) {
+    const Tabuleiro *t = &s->t;
+    if (v->celulas != t->visivel || v->reveladas != t->celulas_reveladas || v->bandeiras != t->qtd_bandeiras)
+        return false;
+    for (size_t y = 0; y < t->altura; y++) {
+        for (size_t x = 0; x < t->largura; x++) {
+            uint8_t c = v->celulas[y * t->largura + x];
+            Celula real = CELULA_EM(t, x, y);
+            if (ESTA_REVELADA(real) ? c != real : c != (TEM_BANDEIRA(real) ? BOT_BANDEIRA : 0)) return false;
+        }
+    }
+    return true;
+}
+
+int jogar_conferindo(void *contexto, int acao, size_t x, size_t y) {
+    SessaoBot *s = contexto;
+    int r = bot_jogar(contexto, acao, x, y);
+    CONFERIR(vista_confere(&s->vista, s));
+    jogadas_conferidas++;
+    return r;
+}
+
+void *iniciar_conferindo(const BotVista *vista, uint64_t semente) {
+    return bot_simples->iniciar ? bot_simples->iniciar(vista, semente) : NULL;
+}
+
+int decidir_conferindo(void *estado, const BotVista *vista, BotJogar jogar, void *contexto) {
+    (void)jogar;
+    CONFERIR(vista_confere(vista, contexto));
+    decisoes_conferidas++;
+    return bot_simples->decidir(estado, vista, jogar_conferindo, contexto);
+}
+
+void encerrar_conferindo(void *estado) {
+    if (bot_simples->encerrar) bot_simples->encerrar(estado);
+}
+
+const Bot bot_conferindo = { BOT_VERSAO, "conferindo", iniciar_conferindo, decidir_conferindo, encerrar_conferindo };
+
+void testar_topologia(Topologia topologia, size_t camadas, const char *dificuldade) {
+    SessaoBot *s = calloc(1, sizeof(SessaoBot));
+    CONFERIR(s && ler_dificuldade(dificuldade, camadas, &s->t.largura, &s->t.altura, &s->t.qtd_minas));
+    if (!s) return;
+    s->t.topologia = topologia;
+    s->t.camadas = camadas;
+    s->t.expor_visivel = true;
+    jogar_partidas_bot(&bot_conferindo, s, 40, 1);
+    free(s);
+}
+
+int main(void) {
+    void *biblioteca = dlopen(BOT_TESTE, RTLD_NOW | RTLD_LOCAL);
+    bot_simples = biblioteca ? dlsym(biblioteca, BOT_SIMBOLO) : NULL;
+    CONFERIR(bot_simples && bot_simples->versao == BOT_VERSAO);
+    if (!bot_simples) return fim_dos_testes("bot");
+
+    // O resumo de cada rodada não interessa aqui
+    silenciar_jogo();
+    testar_topologia(TOPOLOGIA_QUADRADA, 1, "F");
+    testar_topologia(TOPOLOGIA_QUADRADA, 1, "D");
+    testar_topologia(TOPOLOGIA_TORO, 1, "M");
+    testar_topologia(TOPOLOGIA_HEX, 1, "M");
+    testar_topologia(TOPOLOGIA_3D, 3, "F");
+    CONFERIR(decisoes_conferidas > 0 && jogadas_conferidas >= decisoes_conferidas);
+
+    dlclose(biblioteca);
+    return fim_dos_testes("bot");
+}
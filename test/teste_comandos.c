@@ -0,0 +1,83 @@
+/*
+ * Modo de linhas: interpretar_comando (tokenizador e tabela de comandos).
+ *   - intervalos "N", "N-M" e "*" nas linhas e nas colunas; sem colunas, a linha inteira
+ *   - intervalo invertido, número que estoura, lixo no fim e arquivo faltando são recusados
+ */
+#include "teste.h"
+
+typedef struct {
+    const char *linha;
+    TipoComando tipo;           // CMD_INVALIDO: recusado (o resto não é conferido)
+    size_t y, y_fim, x, x_fim;
+    bool area;
+} CasoComando;
+
+static const CasoComando casos[] = {
+    // Uma célula, como antes dos intervalos
+    { "r 3 4",               CMD_REVELAR,  3, 3, 4, 4, false },
+    { "  b\t7 2  ",          CMD_BANDEIRA, 7, 7, 2, 2, false },
+    { "r 0 0",               CMD_REVELAR,  0, 0, 0, 0, false },
+
+    // Intervalos
+    { "r 0-15 0-29",         CMD_REVELAR,  0, 15, 0, 29, true },
+    { "r 0 - 15 2 -3",       CMD_REVELAR,  0, 15, 2, 3, true },
+    { "b 3 *",               CMD_BANDEIRA, 3, 3, 0, SIZE_MAX, true },
+    { "b 3",                 CMD_BANDEIRA, 3, 3, 0, SIZE_MAX, true },
+    { "r * 5",               CMD_REVELAR,  0, SIZE_MAX, 5, 5, true },
+    { "l *",                 CMD_LIMPAR,   0, SIZE_MAX, 0, SIZE_MAX, true },
+    { "l 2 4",               CMD_LIMPAR,   2, 2, 4, 4, true },
+    { "r 5-5 1",             CMD_REVELAR,  5, 5, 1, 1, true },
+
+    // Recusados
+    { .linha = "r 5-3",               .tipo = CMD_INVALIDO },
+    { .linha = "r 1 9-2",             .tipo = CMD_INVALIDO },
+    { .linha = "r 99999999999999999999999 0", .tipo = CMD_INVALIDO },
+    { .linha = "r 0 18446744073709551616",    .tipo = CMD_INVALIDO },
+    { .linha = "r 0-99999999999999999999999", .tipo = CMD_INVALIDO },
+    { .linha = "ir 99999999999999999999999",  .tipo = CMD_INVALIDO },
+    { .linha = "r",                   .tipo = CMD_INVALIDO },
+    { .linha = "r 1-",                .tipo = CMD_INVALIDO },
+    { .linha = "r -1 2",              .tipo = CMD_INVALIDO },
+    { .linha = "r 1 2 3",             .tipo = CMD_INVALIDO },
+    { .linha = "r 1 2x",              .tipo = CMD_INVALIDO },
+    { .linha = "b 1 **",              .tipo = CMD_INVALIDO },
+    { .linha = "d agora",             .tipo = CMD_INVALIDO },
+    { .linha = "ir",                  .tipo = CMD_INVALIDO },
+    { .linha = "ir x",                .tipo = CMD_INVALIDO },
+    { .linha = "salvar",              .tipo = CMD_INVALIDO },
+    { .linha = "salvar   ",           .tipo = CMD_INVALIDO },
+    { .linha = "salvar/tmp/x",        .tipo = CMD_INVALIDO },
+    { .linha = "carregar",            .tipo = CMD_INVALIDO },
+    { .linha = "revelar 1 2",         .tipo = CMD_INVALIDO },
+    { .linha = "",                    .tipo = CMD_INVALIDO },
+    { .linha = "3 4",                 .tipo = CMD_INVALIDO },
+    { .linha = "r 1 2 é",             .tipo = CMD_INVALIDO },
+};
+
+void testar_caso(const CasoComando *c) {
+    Comando cmd = interpretar_comando(c->linha);
+    if (cmd.tipo != c->tipo) {
+        fprintf(stderr, "'%s': tipo %d, esperado %d\n", c->linha, (int)cmd.tipo, (int)c->tipo);
+        falhas_teste++;
+        return;
+    }
+    if (c->tipo == CMD_INVALIDO) return;
+    CONFERIR(cmd.y == c->y && cmd.y_fim == c->y_fim && cmd.x == c->x && cmd.x_fim == c->x_fim &&
+             cmd.area == c->area);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(casos) / sizeof(casos[0]); i++) testar_caso(&casos[i]);
+
+    // Comandos sem intervalo e os que levam o resto da linha
+    Comando cmd = interpretar_comando("ir 12");
+    CONFERIR(cmd.tipo == CMD_IR && cmd.x == 12);
+    cmd = interpretar_comando("rf");
+    CONFERIR(cmd.tipo == CMD_REFAZER);
+    cmd = interpretar_comando("salvar  /tmp/sessão 1.cms");
+    CONFERIR(cmd.tipo == CMD_SALVAR && strcmp(cmd.arquivo, "/tmp/sessão 1.cms") == 0);
+    cmd = interpretar_comando("carregar x");
+    CONFERIR(cmd.tipo == CMD_CARREGAR && strcmp(cmd.arquivo, "x") == 0);
+
+    return fim_dos_testes("comandos");
+}
@@ -0,0 +1,168 @@
+/*
+ * Partida cooperativa: várias threads no mesmo tabuleiro sem trava.
+ *   - nenhuma revelação se perde nem conta em dobro, e desfazer tudo volta ao começo
+ *   - desfazer uma bandeira respeita a troca que outro jogador fez depois
+ *   - desfazer a mina de um jogador não apaga a mina que outro revelou
+ *   - bandeiras trocadas e desfeitas ao mesmo tempo deixam hash e bitboard de acordo com as células
+ */
+#include "teste.h"
+
+#define LADO_TESTE 256
+
+void preparar_partida(Tabuleiro *t, PartidaCooperativa *p, uint64_t semente) {
+    *t = (Tabuleiro){ .largura = LADO_TESTE, .altura = LADO_TESTE, .semente = semente };
+    t->qtd_minas = t->largura * t->altura * 15 / 100;
+    iniciar_jogo(t);
+    t->primeiro_clique_pendente = false;
+    for (size_t i = 0; i < FATIAS_CONTADOR; i++) atomic_init(&p->reveladas[i].valor, 0);
+    atomic_init(&p->minas_reveladas, 0);
+    p->t = t;
+}
+
+// Bitboard de bandeiras igual ao bit das células
+bool bandeiras_conferem(const Tabuleiro *t) {
+    for (size_t y = 0; y < t->altura; y++) {
+        const uint64_t *linha = LINHA_DE_BITS(t, t->bits_bandeira, y);
+        for (size_t x = 0; x < t->largura; x++) {
+            size_t b = x + GUARDA_BITS;
+            if (((linha[b >> 6] >> (b & 63)) & 1) != TEM_BANDEIRA(CELULA_EM(t, x, y))) return false;
+        }
+    }
+    return true;
+}
+
+void testar_revelacoes_concorrentes(PartidaCooperativa *p) {
+    for (size_t qtd = 1; qtd <= 8; qtd *= 2) {
+        Tabuleiro t;
+        preparar_partida(&t, p, 100 + qtd);
+        size_t seguras = t.largura * t.altura - t.qtd_minas;
+
+        TarefaCooperativa tarefas[8];
+        atomic_size_t proxima_faixa;
+        atomic_init(&proxima_faixa, 0);
+        for (size_t i = 0; i < qtd; i++)
+            tarefas[i] = (TarefaCooperativa){ .jogador = { .p = p, .fatia = i }, .proxima_faixa = &proxima_faixa };
+        rodar_jogadores(tarefas, qtd, jogar_cooperativo);
+
+        size_t trocas = 0, varridas = 0;
+        for (size_t i = 0; i < qtd; i++) trocas += tarefas[i].jogador.qtd_trocas;
+        for (size_t i = 0; i < CELULAS_ALOCADAS(&t); i++) varridas += ESTA_REVELADA(t.celulas[i]);
+        CONFERIR(total_reveladas_cooperativa(p) == seguras);
+        CONFERIR(trocas == seguras);
+        CONFERIR(varridas == seguras);
+        CONFERIR(t.hash == hash_completo(&t));
+
+        rodar_jogadores(tarefas, qtd, desfazer_tudo_cooperativo);
+        CONFERIR(total_reveladas_cooperativa(p) == 0);
+        CONFERIR(t.hash == 0);
+        for (size_t i = 0; i < qtd; i++) liberar_jogador(&tarefas[i].jogador);
+        liberar_memoria_jogo(&t);
+    }
+}
+
+void testar_desfazer_bandeira_de_outro(PartidaCooperativa *p) {
+    Tabuleiro t;
+    preparar_partida(&t, p, 7);
+    Jogador a = { .p = p, .fatia = 0 }, b = { .p = p, .fatia = 1 };
+
+    // A põe, B tira: desfazer de A não devolve a bandeira que B tirou
+    CONFERIR(alternar_bandeira_cooperativa(&a, 3, 4) == JOGADA_FEITA);
+    CONFERIR(alternar_bandeira_cooperativa(&b, 3, 4) == JOGADA_FEITA);
+    CONFERIR(desfazer_cooperativo(&a));
+    CONFERIR(!TEM_BANDEIRA(CELULA_EM(&t, 3, 4)));
+
+    // Desfazer de B volta a bandeira, que era o que havia antes da jogada dele
+    CONFERIR(desfazer_cooperativo(&b));
+    CONFERIR(TEM_BANDEIRA(CELULA_EM(&t, 3, 4)));
+
+    // Sem ninguém no meio, desfazer tira a própria bandeira
+    CONFERIR(alternar_bandeira_cooperativa(&a, 5, 5) == JOGADA_FEITA);
+    CONFERIR(desfazer_cooperativo(&a));
+    CONFERIR(!TEM_BANDEIRA(CELULA_EM(&t, 5, 5)));
+    CONFERIR(t.hash == hash_completo(&t));
+    CONFERIR(bandeiras_conferem(&t));
+
+    liberar_jogador(&a);
+    liberar_jogador(&b);
+    liberar_memoria_jogo(&t);
+}
+
+// Índice da n-ésima célula que é (ou não é) mina
+size_t achar_celula(const Tabuleiro *t, bool mina, size_t n) {
+    for (size_t i = 0; i < t->largura * t->altura; i++)
+        if (EH_MINA(CELULA_EM(t, i % t->largura, i / t->largura)) == mina && n-- == 0) return i;
+    return 0;
+}
+
+void testar_desfazer_mina_de_um(PartidaCooperativa *p) {
+    Tabuleiro t;
+    preparar_partida(&t, p, 13);
+    Jogador a = { .p = p, .fatia = 0 }, b = { .p = p, .fatia = 1 };
+    size_t mina_a = achar_celula(&t, true, 0), mina_b = achar_celula(&t, true, 1);
+    size_t segura_1 = achar_celula(&t, false, 0), segura_2 = achar_celula(&t, false, 1);
+
+    // Os dois pisam numa mina; A desfaz a dele e a de B continua explodida
+    CONFERIR(revelar_cooperativo(&a, mina_a % t.largura, mina_a / t.largura) == JOGADA_MINA);
+    CONFERIR(revelar_cooperativo(&b, mina_b % t.largura, mina_b / t.largura) == JOGADA_MINA);
+    CONFERIR(desfazer_cooperativo(&a));
+    CONFERIR(atomic_load(&p->minas_reveladas) == 1);
+    CONFERIR(revelar_cooperativo(&a, segura_1 % t.largura, segura_1 / t.largura) == JOGADA_MINA);
+
+    // B desfaz a dele: agora não há mina à vista
+    CONFERIR(desfazer_cooperativo(&b));
+    CONFERIR(atomic_load(&p->minas_reveladas) == 0);
+    CONFERIR(revelar_cooperativo(&a, segura_2 % t.largura, segura_2 / t.largura) != JOGADA_MINA);
+    CONFERIR(t.hash == hash_completo(&t));
+
+    liberar_jogador(&a);
+    liberar_jogador(&b);
+    liberar_memoria_jogo(&t);
+}
+
+typedef struct {
+    Jogador jogador;
+    uint64_t semente;
+} TarefaBandeiras;
+
+// Alterna bandeiras num canto pequeno (para as threads disputarem as mesmas células) e desfaz tudo
+void *alternar_e_desfazer(void *arg) {
+    TarefaBandeiras *tarefa = arg;
+    uint64_t s = tarefa->semente;
+    for (int k = 0; k < 20000; k++) {
+        s ^= s << 13;
+        s ^= s >> 7;
+        s ^= s << 17;
+        alternar_bandeira_cooperativa(&tarefa->jogador, s % 16, (s >> 8) % 16);
+        if (s % 5 == 0) desfazer_cooperativo(&tarefa->jogador);
+    }
+    while (desfazer_cooperativo(&tarefa->jogador)) {}
+    return NULL;
+}
+
+void testar_bandeiras_concorrentes(PartidaCooperativa *p) {
+    Tabuleiro t;
+    preparar_partida(&t, p, 11);
+
+    TarefaBandeiras tarefas[4];
+    pthread_t threads[4];
+    for (size_t i = 0; i < 4; i++) {
+        tarefas[i] = (TarefaBandeiras){ .jogador = { .p = p, .fatia = i }, .semente = 0x9e3779b97f4a7c15u * (i + 1) };
+        pthread_create(&threads[i], NULL, alternar_e_desfazer, &tarefas[i]);
+    }
+    for (size_t i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+
+    CONFERIR(t.hash == hash_completo(&t));
+    CONFERIR(bandeiras_conferem(&t));
+    for (size_t i = 0; i < 4; i++) liberar_jogador(&tarefas[i].jogador);
+    liberar_memoria_jogo(&t);
+}
+
+int main(void) {
+    PartidaCooperativa *p = aligned_alloc(_Alignof(PartidaCooperativa), sizeof(PartidaCooperativa));
+    testar_revelacoes_concorrentes(p);
+    testar_desfazer_bandeira_de_outro(p);
+    testar_desfazer_mina_de_um(p);
+    testar_bandeiras_concorrentes(p);
+    free(p);
+    return fim_dos_testes("cooperativo");
+}
@@ -0,0 +1,88 @@
+/*
+ * Limite do undo (--desfazer-lotes e --desfazer-bytes): os lotes mais antigos saem pelo fundo.
+ *   - a pilha fica no limite, encadeada nos dois sentidos até fundo_desfazer, e os contadores
+ *     (lotes_desfazer, bytes_desfazer, lotes_descartados) batem com os nós
+ *   - cada lote que ficou desfaz de volta ao tabuleiro de antes dele; passando do fundo, a linha
+ *     do tempo continua voltando até a jogada 0
+ */
+#include "teste.h"
+
+#define JOGADAS_TESTE 300
+
+// Hash e reveladas depois de cada jogada (o índice é t->linha.posicao)
+uint64_t hashes[JOGADAS_TESTE + 1];
+size_t reveladas[JOGADAS_TESTE + 1];
+
+// A pilha vai do topo ao fundo pelos 'proximo' e volta pelos 'anterior'; os contadores batem
+bool pilha_confere(const Tabuleiro *t) {
+    size_t nos = 0, lotes = 0;
+    const NoPilha *ultimo = NULL;
+    for (const NoPilha *n = t->pilha_desfazer; n; ultimo = n, n = n->proximo) {
+        if (n->anterior != ultimo) return false;
+        nos++;
+        lotes += n->inicio_lote;
+    }
+    return ultimo == t->fundo_desfazer && (!ultimo || ultimo->inicio_lote) &&
+           nos * sizeof(NoPilha) == t->bytes_desfazer && lotes == t->lotes_desfazer;
+}
+
+// Uma jogada que muda o tabuleiro: revelar uma célula segura escondida ou trocar uma bandeira
+void jogar_sorteado(Tabuleiro *t) {
+    size_t antes = t->linha.posicao;
+    while (t->linha.posicao == antes) {
+        size_t x = sortear_teste(t->largura), y = sortear_teste(t->altura);
+        Celula c = CELULA_EM(t, x, y);
+        if (ESTA_REVELADA(c)) continue;
+        bool revelar = !EH_MINA(c) && !TEM_BANDEIRA(c) && sortear_teste(3) != 0;
+        aplicar_movimento(t, revelar ? MOV_REVELAR : MOV_BANDEIRA, x, y);
+    }
+    hashes[t->linha.posicao] = t->hash;
+    reveladas[t->linha.posicao] = t->celulas_reveladas;
+}
+
+// Joga JOGADAS_TESTE vezes conferindo o limite; depois desfaz tudo conferindo cada volta
+void testar_limite(size_t limite_lotes, size_t limite_bytes, uint64_t semente) {
+    Tabuleiro t = { .largura = 60, .altura = 40, .qtd_minas = 60 * 40 / 6, .semente = semente,
+                    .limite_lotes = limite_lotes, .limite_bytes = limite_bytes };
+    iniciar_jogo(&t);
+    hashes[0] = t.hash;
+    reveladas[0] = 0;
+
+    size_t lotes_vistos = 0;
+    for (int k = 0; k < JOGADAS_TESTE; k++) {
+        jogar_sorteado(&t);
+        CONFERIR(pilha_confere(&t));
+        if (limite_lotes) CONFERIR(t.lotes_desfazer <= limite_lotes);
+        if (limite_bytes) CONFERIR(t.lotes_desfazer <= 1 || bytes_historico(&t) <= limite_bytes);
+        if (t.lotes_desfazer > lotes_vistos) lotes_vistos = t.lotes_desfazer;
+    }
+    // O limite cortou de verdade, e pelo fundo: nada foi descartado sem motivo
+    CONFERIR(t.lotes_descartados > 0);
+    CONFERIR(t.lotes_descartados + t.lotes_desfazer == JOGADAS_TESTE);
+    if (limite_lotes) CONFERIR(lotes_vistos == limite_lotes);
+
+    // Os lotes que ficaram voltam pela pilha; os descartados, pela linha do tempo
+    size_t pela_pilha = t.lotes_desfazer;
+    while (t.linha.posicao > 0) {
+        size_t lotes = t.lotes_desfazer;
+        CONFERIR(desfazer_jogada(&t) != JOGADA_NADA);
+        if (t.linha.posicao >= JOGADAS_TESTE - pela_pilha) CONFERIR(t.lotes_desfazer == lotes - 1);
+        CONFERIR(t.hash == hashes[t.linha.posicao]);
+        CONFERIR(t.celulas_reveladas == reveladas[t.linha.posicao]);
+        CONFERIR(pilha_confere(&t));
+    }
+    CONFERIR(t.hash == hash_completo(&t));
+    CONFERIR(validar_tabuleiro(&t));
+    liberar_memoria_jogo(&t);
+}
+
+int main(void) {
+    silenciar_jogo();
+    for (uint64_t semente = 1; semente <= 4; semente++) {
+        testar_limite(1, 0, semente);
+        testar_limite(10, 0, semente);
+        testar_limite(0, 8 * 1024, semente);
+        testar_limite(25, 16 * 1024, semente);
+    }
+    return fim_dos_testes("desfazer");
+}
@@ -0,0 +1,99 @@
+/*
+ * Transmissão: transmissao_publicar copia só as linhas que mudaram (Tabuleiro.linhas_mudadas).
+ *   - o quadro publicado mostra o mesmo que o tabuleiro depois de jogar, desfazer, pular na
+ *     linha do tempo, revelar tudo no fim, carregar um snapshot e começar outra partida
+ *   - os números do rodapé são os do tabuleiro
+ * Sem a thread de transmissão: o teste pega cada quadro direto do triplo buffer.
+ */
+#include "teste.h"
+
+#define ARQUIVO_TESTE "/tmp/teste_espectadores.cms"
+
+// O quadro que acabou de ser publicado tem o estado visível de 't' (e o número das reveladas)
+bool quadro_confere(Transmissor *tr, const Tabuleiro *t) {
+    const QuadroTela *f = &tr->quadros[atomic_load(&tr->meio) & 3];
+    if (f->largura != t->largura || f->altura != t->altura) return false;
+    Tabuleiro vista = vista_do_quadro(f);
+    for (size_t y = 0; y < t->altura; y++) {
+        for (size_t x = 0; x < t->largura; x++) {
+            Celula a = CELULA_EM(&vista, x, y), b = CELULA_EM(t, x, y);
+            if (ESTADO_VISIVEL(a) != ESTADO_VISIVEL(b) || (ESTA_REVELADA(b) && a != b)) return false;
+        }
+    }
+    ContadoresRodape c = contadores_rodape(t);
+    return f->contadores.posicao == c.posicao && f->contadores.bandeiras == c.bandeiras &&
+           f->contadores.lotes_desfazer == c.lotes_desfazer && f->contadores.qtd_jogadas == c.qtd_jogadas;
+}
+
+// Publica e confere; a thread não existe, então o quadro do meio fica sempre como o mais novo
+void publicar_e_conferir(Transmissor *tr, Tabuleiro *t) {
+    transmissao_publicar(tr, t);
+    CONFERIR(quadro_confere(tr, t));
+}
+
+void jogar_sorteado(Transmissor *tr, Tabuleiro *t) {
+    static const TipoMovimento tipos[] = { MOV_REVELAR, MOV_REVELAR, MOV_BANDEIRA, MOV_ACORDE,
+                                           MOV_DESFAZER, MOV_REFAZER, MOV_IR };
+    TipoMovimento tipo = tipos[sortear_teste(sizeof(tipos) / sizeof(tipos[0]))];
+    size_t x = sortear_teste(t->largura), y = sortear_teste(t->altura);
+    if (tipo == MOV_IR) x = sortear_teste(t->linha.qtd_jogadas + 1);
+    if (aplicar_movimento(t, tipo, x, y) == JOGADA_MINA) {
+        // Fim de jogo na tela: tudo revelado de uma vez, depois a partida volta uma jogada
+        publicar_e_conferir(tr, t);
+        revelar_tabuleiro(t);
+        publicar_e_conferir(tr, t);
+        aplicar_movimento(t, MOV_IR, t->linha.posicao - 1, 0);
+    }
+    publicar_e_conferir(tr, t);
+}
+
+void testar_partida(Transmissor *tr, Topologia topologia, size_t camadas, uint64_t semente) {
+    size_t largura = topologia == TOPOLOGIA_3D ? 9 : 70, altura = topologia == TOPOLOGIA_3D ? 9 * camadas : 130;
+    Tabuleiro t = { .largura = largura, .altura = altura, .qtd_minas = largura * altura / 8,
+                    .semente = semente, .topologia = topologia, .camadas = camadas };
+    iniciar_jogo(&t);
+    publicar_e_conferir(tr, &t);
+    for (int k = 0; k < 200; k++) jogar_sorteado(tr, &t);
+
+    // Snapshot de agora, mais jogadas, e a volta para ele
+    CONFERIR(salvar_sessao(&t, ARQUIVO_TESTE));
+    for (int k = 0; k < 50; k++) jogar_sorteado(tr, &t);
+    CONFERIR(carregar_sessao(&t, ARQUIVO_TESTE));
+    publicar_e_conferir(tr, &t);
+
+    // Outra partida do mesmo tamanho: nenhuma linha do quadro antigo pode sobrar
+    liberar_memoria_jogo(&t);
+    t.semente++;
+    iniciar_jogo(&t);
+    publicar_e_conferir(tr, &t);
+    for (int k = 0; k < 100; k++) jogar_sorteado(tr, &t);
+    liberar_memoria_jogo(&t);
+}
+
+int main(void) {
+    silenciar_jogo();
+
+    Transmissor *tr = &transmissor;
+    if (pipe(tr->acordar) != 0) return EXIT_FAILURE;
+    fcntl(tr->acordar[1], F_SETFL, fcntl(tr->acordar[1], F_GETFL) | O_NONBLOCK);
+    tr->meio = 1;
+    tr->escrita = 0;
+    tr->leitura = 2;
+    tr->ativa = true;
+
+    for (uint64_t semente = 1; semente <= 5; semente++) {
+        testar_partida(tr, TOPOLOGIA_QUADRADA, 1, semente);
+        testar_partida(tr, TOPOLOGIA_HEX, 1, semente);
+        testar_partida(tr, TOPOLOGIA_3D, 3, semente);
+    }
+
+    for (size_t i = 0; i < 3; i++) {
+        free(tr->quadros[i].celulas);
+        free(tr->quadros[i].rodape.dados);
+        free(tr->linhas_atrasadas[i]);
+    }
+    close(tr->acordar[0]);
+    close(tr->acordar[1]);
+    remove(ARQUIVO_TESTE);
+    return fim_dos_testes("espectadores");
+}
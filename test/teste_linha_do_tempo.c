@@ -0,0 +1,78 @@
+/*
+ * Linha do tempo com --desfazer-bytes: os checkpoints antigos são afinados e "ir N" para perto
+ * deles refaz a partir do checkpoint 0.
+ *   - ir para qualquer jogada, para trás e para frente, deixa o tabuleiro igual ao de uma partida
+ *     sem limite na mesma jogada (células, hash e reveladas)
+ *   - jogar depois de voltar corta o futuro e os checkpoints afinados continuam valendo
+ */
+#include "teste.h"
+
+#define JOGADAS_TESTE 600
+#define LIMITE_TESTE  (8 * 1024)
+
+// Uma jogada que muda o tabuleiro, a mesma nos dois: revelar uma célula segura ou trocar uma bandeira
+void jogar_nos_dois(Tabuleiro *t, Tabuleiro *sem_limite) {
+    size_t antes = t->linha.posicao;
+    while (t->linha.posicao == antes) {
+        size_t x = sortear_teste(t->largura), y = sortear_teste(t->altura);
+        Celula c = CELULA_EM(t, x, y);
+        if (ESTA_REVELADA(c)) continue;
+        TipoMovimento tipo = !EH_MINA(c) && !TEM_BANDEIRA(c) && sortear_teste(3) != 0 ? MOV_REVELAR : MOV_BANDEIRA;
+        aplicar_movimento(t, tipo, x, y);
+        aplicar_movimento(sem_limite, tipo, x, y);
+    }
+}
+
+bool iguais(const Tabuleiro *a, const Tabuleiro *b) {
+    return a->linha.posicao == b->linha.posicao && a->hash == b->hash &&
+           a->celulas_reveladas == b->celulas_reveladas &&
+           memcmp(a->celulas, b->celulas, CELULAS_ALOCADAS(a)) == 0;
+}
+
+// Pula os dois para 'destino' e compara
+void ir_nos_dois(Tabuleiro *t, Tabuleiro *sem_limite, size_t destino) {
+    aplicar_movimento(t, MOV_IR, destino, 0);
+    aplicar_movimento(sem_limite, MOV_IR, destino, 0);
+    CONFERIR(t->linha.posicao == destino);
+    CONFERIR(iguais(t, sem_limite));
+}
+
+void testar_saltos(uint64_t semente) {
+    Tabuleiro t = { .largura = 60, .altura = 40, .qtd_minas = 60 * 40 / 6, .semente = semente,
+                    .limite_bytes = LIMITE_TESTE };
+    Tabuleiro sem_limite = { .largura = 60, .altura = 40, .qtd_minas = 60 * 40 / 6, .semente = semente };
+    iniciar_jogo(&t);
+    iniciar_jogo(&sem_limite);
+
+    for (int k = 0; k < JOGADAS_TESTE; k++) jogar_nos_dois(&t, &sem_limite);
+    CONFERIR(iguais(&t, &sem_limite));
+    CONFERIR(t.linha.checkpoints_afinados > 0);
+    CONFERIR(t.linha.checkpoints[t.linha.checkpoints_afinados].celulas == NULL);
+    // Acima do limite só ficam o checkpoint 0 e o último
+    CONFERIR(bytes_historico(&t) <= LIMITE_TESTE || t.linha.checkpoints_afinados + 2 == t.linha.qtd_checkpoints);
+
+    // Saltos sorteados, incluindo o começo, o fim e as jogadas de checkpoints afinados
+    ir_nos_dois(&t, &sem_limite, 0);
+    ir_nos_dois(&t, &sem_limite, JOGADAS_TESTE);
+    ir_nos_dois(&t, &sem_limite, INTERVALO_CHECKPOINT + 1);
+    ir_nos_dois(&t, &sem_limite, INTERVALO_CHECKPOINT * t.linha.checkpoints_afinados + 5);
+    for (int k = 0; k < 100; k++) ir_nos_dois(&t, &sem_limite, sortear_teste(JOGADAS_TESTE + 1));
+
+    // Volta para o meio e joga: o futuro some e a partida segue igual à sem limite
+    ir_nos_dois(&t, &sem_limite, JOGADAS_TESTE / 2 + 3);
+    for (int k = 0; k < 200; k++) jogar_nos_dois(&t, &sem_limite);
+    CONFERIR(t.linha.qtd_jogadas == JOGADAS_TESTE / 2 + 3 + 200);
+    CONFERIR(iguais(&t, &sem_limite));
+    for (int k = 0; k < 100; k++) ir_nos_dois(&t, &sem_limite, sortear_teste(t.linha.qtd_jogadas + 1));
+
+    CONFERIR(t.hash == hash_completo(&t));
+    CONFERIR(validar_tabuleiro(&t));
+    liberar_memoria_jogo(&t);
+    liberar_memoria_jogo(&sem_limite);
+}
+
+int main(void) {
+    silenciar_jogo();
+    for (uint64_t semente = 1; semente <= 4; semente++) testar_saltos(semente);
+    return fim_dos_testes("linha_do_tempo");
+}
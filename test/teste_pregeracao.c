@@ -0,0 +1,70 @@
+/*
+ * Pré-geração: "Jogar novamente" (S) entrega a partida para a thread liberar e o tabuleiro da
+ * sessão tem de ficar sem nada dela.
+ *   - S seguido do mesmo tamanho personalizado, com a vaga ainda não pronta (células em mmap)
+ *   - tabuleiro grande (mmap), pequeno (realloc) e grande de novo
+ */
+#include "teste.h"
+
+// Tamanho do relato original: 2000x2000 quase só de minas, células num mmap próprio
+#define LADO_GRANDE 2000
+
+void jogar_um_pouco(Tabuleiro *t) {
+    aplicar_movimento(t, MOV_REVELAR, 0, 0);
+    aplicar_movimento(t, MOV_BANDEIRA, t->largura - 1, t->altura - 1);
+    aplicar_movimento(t, MOV_REVELAR, t->largura / 2, t->altura / 2);
+}
+
+// 't' não guarda nada da partida entregue
+bool nada_da_partida(const Tabuleiro *t) {
+    return !t->celulas && !t->bytes_mapeados && !t->inicio_bandeiras && !t->qtd_bandeiras && !t->pilha_desfazer &&
+           !t->fundo_desfazer && !t->lotes_desfazer && !t->bytes_desfazer && !t->linha.jogadas &&
+           !t->linha.checkpoints && !t->bits_bandeira && !t->bits_revelada && !t->linhas_mudadas && !t->visivel &&
+           !t->revelacao.ativa && !t->revelacao.inicio;
+}
+
+// Escolhe um tamanho como no menu: a vaga personalizada guarda o pedido, mas nunca com esta semente
+void nova_partida(PreGerador *g, Tabuleiro *t, size_t largura, size_t altura, size_t minas) {
+    t->largura = largura;
+    t->altura = altura;
+    t->qtd_minas = minas;
+    t->semente++;
+    pregeracao_pegar(g, t, VAGA_PERSONALIZADA);
+}
+
+int main(void) {
+    PreGerador g;
+    pregeracao_iniciar(&g, TOPOLOGIA_QUADRADA, 1);
+    CONFERIR(g.ativa);
+
+    Tabuleiro t = { .semente = 7, .camadas = 1 };
+    t.expor_visivel = true;
+    nova_partida(&g, &t, LADO_GRANDE, LADO_GRANDE, LADO_GRANDE * LADO_GRANDE - 10000);
+    CONFERIR(t.bytes_mapeados != 0);
+    jogar_um_pouco(&t);
+
+    // S e o mesmo tamanho de novo
+    pregeracao_descartar(&g, &t);
+    CONFERIR(nada_da_partida(&t));
+    nova_partida(&g, &t, LADO_GRANDE, LADO_GRANDE, LADO_GRANDE * LADO_GRANDE - 10000);
+    CONFERIR(t.celulas && t.bytes_mapeados != 0);
+    CONFERIR(validar_tabuleiro(&t));
+    jogar_um_pouco(&t);
+    CONFERIR(validar_tabuleiro(&t));
+
+    // Grande, pequeno, grande: o pequeno não pode herdar o mmap nem o grande o realloc
+    pregeracao_descartar(&g, &t);
+    nova_partida(&g, &t, 9, 9, 10);
+    CONFERIR(t.bytes_mapeados == 0);
+    jogar_um_pouco(&t);
+    CONFERIR(validar_tabuleiro(&t));
+    pregeracao_descartar(&g, &t);
+    CONFERIR(nada_da_partida(&t));
+    nova_partida(&g, &t, LADO_GRANDE, LADO_GRANDE, LADO_GRANDE * LADO_GRANDE - 10000);
+    jogar_um_pouco(&t);
+    CONFERIR(validar_tabuleiro(&t));
+
+    liberar_memoria_jogo(&t);
+    pregeracao_encerrar(&g, &t);
+    return fim_dos_testes("pregeracao");
+}
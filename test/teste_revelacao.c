@@ -0,0 +1,117 @@
+/*
+ * Revelação em fatias: cancelar_movimento no meio de avancar_revelacao.
+ *   - o tabuleiro volta a ser o de antes da jogada (células, hash, reveladas, bitboards) e a
+ *     jogada não entra na linha do tempo
+ *   - vale no primeiro clique (as minas trocadas voltam pelo checkpoint), numa jogada comum e
+ *     com --desfazer-bytes apertado
+ *   - entre as fatias o tabuleiro está sempre consistente
+ */
+#include "teste.h"
+
+#define LADO_TESTE 200
+#define FATIA_TESTE 4     // células por fatia: pequena para a inundação parar no meio
+
+typedef struct {
+    Celula *celulas;
+    uint64_t hash;
+    size_t reveladas, qtd_jogadas, lotes;
+} Antes;
+
+Antes guardar(const Tabuleiro *t) {
+    Antes a = { .celulas = malloc(CELULAS_ALOCADAS(t)), .hash = t->hash, .reveladas = t->celulas_reveladas,
+                .qtd_jogadas = t->linha.qtd_jogadas, .lotes = t->lotes_desfazer };
+    if (a.celulas) memcpy(a.celulas, t->celulas, CELULAS_ALOCADAS(t));
+    return a;
+}
+
+// Com --desfazer-bytes, a inundação que cresceu pode ter tirado lotes antigos do fundo
+bool voltou(const Tabuleiro *t, const Antes *a) {
+    return a->celulas && memcmp(a->celulas, t->celulas, CELULAS_ALOCADAS(t)) == 0 && t->hash == a->hash &&
+           t->celulas_reveladas == a->reveladas && t->linha.qtd_jogadas == a->qtd_jogadas &&
+           t->linha.posicao == a->qtd_jogadas && !t->revelacao.ativa &&
+           (t->limite_bytes ? t->lotes_desfazer <= a->lotes : t->lotes_desfazer == a->lotes);
+}
+
+// Célula escondida, sem bandeira e sem minas em volta: revelar nela inunda
+bool achar_vazia(const Tabuleiro *t, size_t *x, size_t *y) {
+    for (size_t i = 0; i < t->largura * t->altura; i++) {
+        size_t cx = (i * 7919) % (t->largura * t->altura) % t->largura;
+        size_t cy = (i * 7919) % (t->largura * t->altura) / t->largura;
+        Celula c = CELULA_EM(t, cx, cy);
+        if (!ESTA_REVELADA(c) && !TEM_BANDEIRA(c) && !EH_MINA(c) && NUM_MINAS(c) == 0) {
+            *x = cx;
+            *y = cy;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Começa a revelar (x, y) em fatias pequenas, anda algumas delas e cancela. Devolve false se a
+// inundação coube na primeira fatia (aí é uma jogada comum e não há o que cancelar).
+bool revelar_e_cancelar(Tabuleiro *t, size_t x, size_t y, size_t fatias) {
+    Antes a = guardar(t);
+    if (comecar_movimento(t, MOV_REVELAR, x, y, FATIA_TESTE, 0) != JOGADA_EM_ANDAMENTO) {
+        CONFERIR(t->linha.qtd_jogadas == a.qtd_jogadas + 1);
+        free(a.celulas);
+        return false;
+    }
+    for (size_t k = 0; k < fatias && t->revelacao.ativa; k++) {
+        CONFERIR(t->celulas_reveladas > a.reveladas);
+        CONFERIR(t->hash == hash_completo(t));
+        CONFERIR(validar_tabuleiro(t));
+        continuar_movimento(t, FATIA_TESTE, 0);
+    }
+    CONFERIR(t->revelacao.ativa);
+
+    cancelar_movimento(t);
+    CONFERIR(voltou(t, &a));
+    CONFERIR(t->hash == hash_completo(t));
+    CONFERIR(validar_tabuleiro(t));
+    free(a.celulas);
+    return true;
+}
+
+void testar_cancelar(size_t limite_bytes, uint64_t semente) {
+    Tabuleiro t = { .largura = LADO_TESTE, .altura = LADO_TESTE, .qtd_minas = LADO_TESTE * LADO_TESTE / 8,
+                    .semente = semente, .limite_bytes = limite_bytes };
+    iniciar_jogo(&t);
+
+    // Primeiro clique: cancelado, as minas têm de voltar para onde estavam
+    CONFERIR(revelar_e_cancelar(&t, LADO_TESTE / 2, LADO_TESTE / 2, 3));
+    CONFERIR(t.primeiro_clique_pendente);
+
+    // Agora de verdade, e uma jogada comum cancelada depois de outras
+    aplicar_movimento(&t, MOV_REVELAR, 0, 0);
+    size_t canceladas = 0;
+    for (int k = 0; k < 20; k++) {
+        size_t x, y;
+        if (!achar_vazia(&t, &x, &y)) break;
+        aplicar_movimento(&t, MOV_BANDEIRA, (x + 3) % t.largura, y);
+        if (!achar_vazia(&t, &x, &y)) break;
+        canceladas += revelar_e_cancelar(&t, x, y, (size_t)k % 4);
+    }
+    CONFERIR(canceladas >= 5);
+
+    // Depois de cancelar, a mesma jogada vai até o fim e desfazer também volta
+    size_t x, y;
+    if (achar_vazia(&t, &x, &y)) {
+        Antes a = guardar(&t);
+        CONFERIR(aplicar_movimento(&t, MOV_REVELAR, x, y) != JOGADA_NADA);
+        CONFERIR(t.linha.qtd_jogadas == a.qtd_jogadas + 1);
+        CONFERIR(aplicar_movimento(&t, MOV_DESFAZER, 0, 0) != JOGADA_NADA);
+        CONFERIR(t.hash == a.hash && t.celulas_reveladas == a.reveladas);
+        free(a.celulas);
+    }
+    CONFERIR(validar_tabuleiro(&t));
+    liberar_memoria_jogo(&t);
+}
+
+int main(void) {
+    silenciar_jogo();
+    for (uint64_t semente = 1; semente <= 3; semente++) {
+        testar_cancelar(0, semente);
+        testar_cancelar(4 * 1024, semente);
+    }
+    return fim_dos_testes("revelacao");
+}
@@ -0,0 +1,167 @@
+/*
+ * Snapshot (salvar/carregar): ida e volta em todas as topologias e no gerador sem chute.
+ *   - a sessão carregada tem o mesmo estado visível, bandeiras na mesma ordem, undo e linha do tempo
+ *   - as duas seguem iguais jogando, desfazendo e pulando na linha do tempo
+ *   - arquivo truncado ou adulterado é recusado e a sessão atual fica como estava
+ */
+#include "teste.h"
+
+#define ARQUIVO_TESTE "/tmp/teste_snapshot.cms"
+
+// Uma jogada qualquer do repertório do jogo (também em área, desfazer, refazer e ir)
+void jogada_sorteada(Tabuleiro *t, size_t *tipo, size_t *x, size_t *y, size_t *x_fim, size_t *y_fim) {
+    static const size_t tipos[] = { MOV_REVELAR, MOV_BANDEIRA, MOV_BANDEIRA, MOV_ACORDE, MOV_DESFAZER,
+                                    MOV_REFAZER, MOV_IR, MOV_REVELAR_AREA, MOV_BANDEIRA_AREA, MOV_LIMPAR_AREA };
+    *tipo = tipos[sortear_teste(sizeof(tipos) / sizeof(tipos[0]))];
+    *x = sortear_teste(t->largura);
+    *y = sortear_teste(t->altura);
+    *x_fim = *x + sortear_teste(4);
+    *y_fim = *y + sortear_teste(4);
+    if (*x_fim >= t->largura) *x_fim = t->largura - 1;
+    if (*y_fim >= t->altura) *y_fim = t->altura - 1;
+    if (*tipo == MOV_IR) *x = sortear_teste(t->linha.qtd_jogadas + 1);
+}
+
+ResultadoJogada aplicar_sorteada(Tabuleiro *t, size_t tipo, size_t x, size_t y, size_t x_fim, size_t y_fim) {
+    if (MOVIMENTO_EM_AREA(tipo)) return aplicar_area(t, (TipoMovimento)tipo, x, y, x_fim, y_fim);
+    return aplicar_movimento(t, (TipoMovimento)tipo, x, y);
+}
+
+bool mesma_sessao(const Tabuleiro *a, const Tabuleiro *b) {
+    if (a->hash != b->hash || a->celulas_reveladas != b->celulas_reveladas ||
+        a->lotes_desfazer != b->lotes_desfazer || a->bytes_desfazer != b->bytes_desfazer ||
+        a->linha.posicao != b->linha.posicao || a->linha.qtd_jogadas != b->linha.qtd_jogadas ||
+        a->primeiro_clique_pendente != b->primeiro_clique_pendente)
+        return false;
+
+    for (size_t y = 0; y < a->altura; y++)
+        for (size_t x = 0; x < a->largura; x++)
+            if (CELULA_EM(a, x, y) != CELULA_EM(b, x, y)) return false;
+
+    const NoListaDupla *na = a->inicio_bandeiras, *nb = b->inicio_bandeiras;
+    for (; na && nb; na = na->proximo, nb = nb->proximo)
+        if (na->x != nb->x || na->y != nb->y) return false;
+    if (na || nb) return false;
+
+    // Nó de início de lote só marca a divisa: a célula dele não vale nada
+    const NoPilha *pa = a->pilha_desfazer, *pb = b->pilha_desfazer;
+    for (; pa && pb; pa = pa->proximo, pb = pb->proximo)
+        if (pa->inicio_lote != pb->inicio_lote ||
+            (!pa->inicio_lote && (pa->x != pb->x || pa->y != pb->y || pa->valor_antigo != pb->valor_antigo)))
+            return false;
+    if (pa || pb) return false;
+
+    for (size_t i = 0; i < a->linha.qtd_jogadas; i++) {
+        const Jogada *ja = &a->linha.jogadas[i], *jb = &b->linha.jogadas[i];
+        if (ja->tipo != jb->tipo || ja->x != jb->x || ja->y != jb->y ||
+            ja->x_fim != jb->x_fim || ja->y_fim != jb->y_fim)
+            return false;
+    }
+    return true;
+}
+
+void testar_ida_e_volta(Topologia topologia, size_t camadas, bool sem_chute, uint64_t semente) {
+    size_t largura = topologia == TOPOLOGIA_3D ? 7 : 16, altura = topologia == TOPOLOGIA_3D ? 7 * camadas : 12;
+    Tabuleiro a = { .largura = largura, .altura = altura, .qtd_minas = largura * altura / 7,
+                    .semente = semente, .topologia = topologia, .camadas = camadas, .sem_chute = sem_chute };
+    iniciar_jogo(&a);
+
+    // Meia partida antes de salvar; uma mina desfeita não encerra o teste
+    for (int k = 0; k < 60; k++) {
+        size_t tipo, x, y, x_fim, y_fim;
+        jogada_sorteada(&a, &tipo, &x, &y, &x_fim, &y_fim);
+        ResultadoJogada r = aplicar_sorteada(&a, tipo, x, y, x_fim, y_fim);
+        if (r == JOGADA_MINA) aplicar_movimento(&a, MOV_DESFAZER, 0, 0);
+    }
+
+    CONFERIR(salvar_sessao(&a, ARQUIVO_TESTE));
+    Tabuleiro b = {0};
+    CONFERIR(carregar_sessao(&b, ARQUIVO_TESTE));
+    CONFERIR(mesma_sessao(&a, &b));
+    CONFERIR(validar_tabuleiro(&b));
+
+    // Daqui em diante as duas sessões recebem as mesmas jogadas
+    for (int k = 0; k < 60; k++) {
+        size_t tipo, x, y, x_fim, y_fim;
+        jogada_sorteada(&a, &tipo, &x, &y, &x_fim, &y_fim);
+        ResultadoJogada ra = aplicar_sorteada(&a, tipo, x, y, x_fim, y_fim);
+        ResultadoJogada rb = aplicar_sorteada(&b, tipo, x, y, x_fim, y_fim);
+        CONFERIR(ra == rb);
+        CONFERIR(a.hash == b.hash);
+        if (ra == JOGADA_MINA) {
+            aplicar_movimento(&a, MOV_DESFAZER, 0, 0);
+            aplicar_movimento(&b, MOV_DESFAZER, 0, 0);
+        }
+    }
+    for (size_t destino = 0; destino <= a.linha.qtd_jogadas; destino += 7) {
+        aplicar_movimento(&a, MOV_IR, destino, 0);
+        aplicar_movimento(&b, MOV_IR, destino, 0);
+        CONFERIR(a.hash == b.hash);
+    }
+
+    liberar_memoria_jogo(&a);
+    liberar_memoria_jogo(&b);
+}
+
+void testar_arquivo_ruim(void) {
+    Tabuleiro a = { .largura = 16, .altura = 16, .qtd_minas = 40, .semente = 5, .camadas = 1 };
+    iniciar_jogo(&a);
+    aplicar_movimento(&a, MOV_REVELAR, 8, 8);
+    aplicar_movimento(&a, MOV_BANDEIRA, 0, 0);
+    CONFERIR(salvar_sessao(&a, ARQUIVO_TESTE));
+
+    size_t tamanho;
+    unsigned char *dados = ler_arquivo(ARQUIVO_TESTE, &tamanho);
+    CONFERIR(dados != NULL);
+    if (!dados) return;
+
+    Tabuleiro b = { .largura = 9, .altura = 9, .qtd_minas = 10, .semente = 1, .camadas = 1 };
+    iniciar_jogo(&b);
+    aplicar_movimento(&b, MOV_REVELAR, 4, 4);
+    uint64_t hash = b.hash;
+
+    // Cada corte do arquivo e cada byte trocado: ou é recusado, ou carrega algo consistente
+    for (size_t n = 0; n < tamanho; n++) {
+        FILE *f = fopen(ARQUIVO_TESTE, "wb");
+        fwrite(dados, 1, n, f);
+        fclose(f);
+        CONFERIR(!carregar_sessao(&b, ARQUIVO_TESTE));
+        CONFERIR(b.hash == hash && b.largura == 9);
+    }
+    for (size_t i = 0; i < tamanho; i++) {
+        dados[i] ^= 0x5a;
+        FILE *f = fopen(ARQUIVO_TESTE, "wb");
+        fwrite(dados, 1, tamanho, f);
+        fclose(f);
+        dados[i] ^= 0x5a;
+        if (carregar_sessao(&b, ARQUIVO_TESTE)) {
+            CONFERIR(validar_tabuleiro(&b));
+            liberar_memoria_jogo(&b);
+            b = (Tabuleiro){ .largura = 9, .altura = 9, .qtd_minas = 10, .semente = 1, .camadas = 1 };
+            iniciar_jogo(&b);
+            aplicar_movimento(&b, MOV_REVELAR, 4, 4);
+        } else {
+            CONFERIR(b.hash == hash && b.largura == 9);
+        }
+    }
+
+    free(dados);
+    liberar_memoria_jogo(&a);
+    liberar_memoria_jogo(&b);
+}
+
+int main(void) {
+    // As mensagens de salvar/carregar (e de arquivo ruim) não interessam aqui
+    silenciar_jogo();
+
+    for (uint64_t semente = 1; semente <= 20; semente++) {
+        testar_ida_e_volta(TOPOLOGIA_QUADRADA, 1, false, semente);
+        testar_ida_e_volta(TOPOLOGIA_TORO, 1, false, semente);
+        testar_ida_e_volta(TOPOLOGIA_HEX, 1, false, semente);
+        testar_ida_e_volta(TOPOLOGIA_3D, 3, false, semente);
+        testar_ida_e_volta(TOPOLOGIA_QUADRADA, 1, true, semente);
+    }
+    testar_arquivo_ruim();
+    remove(ARQUIVO_TESTE);
+    return fim_dos_testes("snapshot");
+}